@@ -75,6 +75,123 @@ LLDEBUG_API int lldebug_setencoding(lua_State *L, lldebug_Encoding encoding);
 /// Get the encoding type for displaying on debugger.
 LLDEBUG_API lldebug_Encoding lldebug_getencoding(lua_State *L);
 
+/// Get the number of the logpoint messages and the dropped ones.
+/**
+ * The messages are dropped when they are output faster than the transport.
+ */
+LLDEBUG_API int lldebug_getlogpointcount(lua_State *L, unsigned long *posted,
+										 unsigned long *dropped);
+
+/// Start the sampling profiler.
+/**
+ * @param interval  Sampling interval in milliseconds.
+ */
+LLDEBUG_API int lldebug_profile_start(lua_State *L, int interval);
+/// Stop the profiler and save the folded stacks for flamegraph.pl.
+/**
+ * @param filename  The output file, or NULL to discard the result.
+ */
+LLDEBUG_API int lldebug_profile_stop(lua_State *L, const char *filename);
+
+/// Start the function profiler, it records the calls and the times.
+LLDEBUG_API int lldebug_funcprofile_start(lua_State *L);
+/// Stop the function profiler and save the report.
+/**
+ * Each line of the report is "calls total self total_cpu self_cpu name source:line"
+ * separated by tabs, and the times are in seconds.
+ * @param filename  The output file, or NULL to discard the result.
+ */
+LLDEBUG_API int lldebug_funcprofile_stop(lua_State *L, const char *filename);
+
+/// Start the line coverage.
+/**
+ * @param firstHitOnly  If nonzero, the covered functions run without
+ *                      the line hook, and the hit counts aren't exact.
+ */
+LLDEBUG_API int lldebug_coverage_start(lua_State *L, int firstHitOnly);
+/// Stop the line coverage and save the lcov tracefile. (.info)
+/**
+ * @param filename  The output file, or NULL to discard the result.
+ */
+LLDEBUG_API int lldebug_coverage_stop(lua_State *L, const char *filename);
+
+/// Start the allocation profiler, it records the allocations of each function.
+/**
+ * It needs the state created after lldebug_setallocprofiling(1).
+ */
+LLDEBUG_API int lldebug_allocprofile_start(lua_State *L);
+/// Stop the allocation profiler and save the report.
+/**
+ * Each line of the report is "live allocated freed allocs frees source:line"
+ * separated by tabs, and the sizes are in bytes. The most live bytes first.
+ * @param filename  The output file, or NULL to discard the result.
+ */
+LLDEBUG_API int lldebug_allocprofile_stop(lua_State *L, const char *filename);
+
+/// Start the scheduler profiler, it records the resumes and the yields.
+LLDEBUG_API int lldebug_schedprofile_start(lua_State *L);
+/// Stop the scheduler profiler and save the report.
+/**
+ * Each record has the creation site of the coroutines, the number of
+ * the coroutines, the resumes and the yields, the total and the longest
+ * run time, and the total and the longest wait from a yield to the next
+ * resume. The times are in seconds. The most run time first.
+ * @param filename  The output file, it's written in json if it ends with
+ *                  ".json", otherwise in csv. NULL discards the result.
+ */
+LLDEBUG_API int lldebug_schedprofile_stop(lua_State *L, const char *filename);
+
+/// Start the call tracer, it records the timeline of the calls.
+/**
+ * @param bufferSize  The number of the latest calls kept by each OS thread.
+ * @param prefix      Only the functions whose file name starts with it are
+ *                    traced, NULL or "" traces all functions.
+ */
+LLDEBUG_API int lldebug_trace_start(lua_State *L, int bufferSize,
+									const char *prefix);
+/// Save the current events of the call tracer, it keeps tracing.
+/**
+ * The file is in the trace event format of Chrome (json), which
+ * chrome://tracing and Perfetto can open. Each lua_State has its own track.
+ */
+LLDEBUG_API int lldebug_trace_save(lua_State *L, const char *filename);
+/// Stop the call tracer and save the events.
+/**
+ * @param filename  The output file, or NULL to discard the events.
+ */
+LLDEBUG_API int lldebug_trace_stop(lua_State *L, const char *filename);
+
+/// Save the snapshot of the all reachable objects.
+/**
+ * The roots are the registry, the globals and the resuming coroutines.
+ * @param filename  The output file of the binary snapshot.
+ */
+LLDEBUG_API int lldebug_heapsnapshot(lua_State *L, const char *filename);
+/// Write the objects that 'after' has and 'before' doesn't have.
+/**
+ * Each line of the report is "bytes objects type path" separated by tabs.
+ * The new objects are grouped by the path from the root.
+ */
+LLDEBUG_API int lldebug_heapdiff(const char *before, const char *after,
+								 const char *filename);
+
+/// Start the GC monitor, it samples the heap size on the count hook.
+/**
+ * Each line of the file is "time,kbytes,peak_kbytes,collected_kbytes",
+ * and the peak and the collected size are of the interval.
+ * @param interval  Sampling interval in milliseconds.
+ * @param filename  The output csv file, or NULL not to write it.
+ */
+LLDEBUG_API int lldebug_gcmonitor_start(lua_State *L, int interval,
+										const char *filename);
+/// Stop the GC monitor and close the csv file.
+LLDEBUG_API int lldebug_gcmonitor_stop(lua_State *L);
+/// Break when the heap exceeds 'kbytes', 0 disarms it.
+/**
+ * It's disarmed when it breaks, and needs the frame to break.
+ */
+LLDEBUG_API int lldebug_setgcthreshold(lua_State *L, int kbytes);
+
 
 /// Set the host address and service name if you want to debug remotely.
 /**
@@ -87,6 +204,24 @@ LLDEBUG_API void lldebug_setremoteaddress(const char *hostname,
 LLDEBUG_API void lldebug_getremoteaddress(const char **hostname,
 										  unsigned short *port);
 
+/// Set whether the new states use the allocator of lldebug.
+/**
+ * The allocation profiler needs it, and each block has a small header.
+ * It must be called before lldebug_open, and the default value is 0.
+ */
+LLDEBUG_API void lldebug_setallocprofiling(int enabled);
+/// Get whether the new states use the allocator of lldebug.
+LLDEBUG_API int lldebug_getallocprofiling(void);
+
+/// Set whether the new states connect to the frame.
+/**
+ * Without the frame, the states are hooked only by the profilers.
+ * It must be called before lldebug_open, and the default value is 1.
+ */
+LLDEBUG_API void lldebug_setframeenabled(int enabled);
+/// Get whether the new states connect to the frame.
+LLDEBUG_API int lldebug_getframeenabled(void);
+
 
 #if !defined(LLDEBUG_CONTEXT) && !defined(LLDEBUG_VISUAL)
 #undef lua_open
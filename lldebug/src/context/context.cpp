@@ -32,7 +32,9 @@
 #include "context/execute.h"
 #include "context/luautils.h"
 #include "context/luaiterate.h"
+#include "context/heapwalker.h"
 
+#include <boost/thread/tss.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/convenience.hpp>
 #include <boost/filesystem/exception.hpp>
@@ -54,11 +56,37 @@
 /// Dummy function name for eval.
 #define DUMMY_FUNCNAME "__LLDEBUG_DUMMY_FUNCTION__"
 
+/// Instruction count between the polls of the commands while running.
+#define HOOK_COUNT_INTERVAL 1000
+
+/// Instruction count the predicate of a field query may run for a field.
+#define QUERY_INSTRUCTION_LIMIT 1000000
+
 namespace lldebug {
 namespace context {
 
 /**
  * @brief Convert lua_State* to 'Context' used by Context::Find and others.
+ *
+ * Context::s_HookCallback is called on every line, call and return event,
+ * so it uses 'Pin' that looks up a small per-thread cache first and
+ * takes the global lock only when the cache misses.
+ *
+ * The cached pointer isn't owned, so the hook pins the context while
+ * it runs: the thread publishes the pointer in its cache (a hazard
+ * pointer) and then checks that the entry is still valid. 'Erase'
+ * counts the generation up before 'WaitForHooks' looks at the published
+ * pointers, so either the hook sees the new generation and doesn't use
+ * the context, or 'WaitForHooks' sees the pin and waits for the hook.
+ *
+ * The coroutines are tracked weakly. Each one has a sentinel userdata in
+ * the weak keyed table of the registry, and its finalizer evicts
+ * the entry after the coroutine was collected. The threads of each
+ * context are also indexed, so 'Erase' doesn't scan the all entries.
+ *
+ * The cached entry of an evicted thread is wrong only if its address is
+ * reused by a thread of another context, so the generation isn't changed
+ * by the evictions and the new threads while there is only one context.
  */
 class Context::ContextManager {
 public:
@@ -75,15 +103,64 @@ public:
 		return m_map.empty();
 	}
 
-	/// Add the pair of (L, ctx).
-	void Add(shared_ptr<Context> ctx, lua_State *L) {
+	/// Add the pair of (L, ctx), and return the serial number of the entry.
+	/**
+	 * The address of a collected thread may be reused before its finalizer
+	 * is called, so the finalizer evicts the entry only if the serial
+	 * number is the same.
+	 */
+	unsigned long Add(shared_ptr<Context> ctx, lua_State *L) {
 		scoped_lock lock(m_mutex);
 
 		if (ctx == NULL || L == NULL) {
-			return;
+			return 0;
+		}
+
+		Map::iterator it = m_map.find(L);
+		if (it != m_map.end()) {
+			// The stale entry of the collected thread.
+			if ((*it).second.ctx != ctx) {
+				m_threads[(*it).second.ctx.get()].erase(L);
+				++ms_generation;
+			}
+		}
+		else {
+			it = m_map.insert(std::make_pair(L, Entry())).first;
+
+			// The address may have been evicted from another context.
+			if (m_threads.size() > 1
+				|| m_threads.find(ctx.get()) == m_threads.end()) {
+				++ms_generation;
+			}
+		}
+
+		(*it).second.ctx = ctx;
+		(*it).second.serial = ++ms_serial;
+		m_threads[ctx.get()].insert(L);
+		return ms_serial;
+	}
+
+	/// Evict the entry of the collected thread.
+	/**
+	 * It returns the context of the thread, or NULL if it was already evicted.
+	 */
+	shared_ptr<Context> Evict(lua_State *L, unsigned long serial) {
+		scoped_lock lock(m_mutex);
+
+		Map::iterator it = m_map.find(L);
+		if (it == m_map.end() || (*it).second.serial != serial) {
+			return shared_ptr<Context>();
 		}
 
-		m_map.insert(std::make_pair(L, ctx));
+		shared_ptr<Context> ctx = (*it).second.ctx;
+		m_threads[ctx.get()].erase(L);
+		m_map.erase(it);
+
+		// The address may be reused by the thread of another context.
+		if (m_threads.size() > 1) {
+			++ms_generation;
+		}
+		return ctx;
 	}
 
 	/// Erase (not delete) the 'ctx' and corresponding lua_State objects.
@@ -94,16 +171,40 @@ public:
 			return;
 		}
 
-		for (Map::iterator it = m_map.begin(); it != m_map.end(); ) {
-			shared_ptr<Context> p = (*it).second;
- 
-			if (p == ctx) {
-				m_map.erase(it++);
-			}
-			else {
-				++it;
-			}
+		// Invalidate the cached entries of all threads.
+		++ms_generation;
+
+		ThreadMap::iterator threads = m_threads.find(ctx.get());
+		if (threads == m_threads.end()) {
+			return;
+		}
+
+		ThreadSet::const_iterator it;
+		for (it = (*threads).second.begin(); it != (*threads).second.end(); ++it) {
+			m_map.erase(*it);
+		}
+
+		m_threads.erase(threads);
+	}
+
+	/// Get the serial number of the entry, or 0 if 'L' isn't of the 'ctx'.
+	unsigned long GetSerial(Context *ctx, lua_State *L) {
+		scoped_lock lock(m_mutex);
+
+		Map::const_iterator it = m_map.find(L);
+		if (it == m_map.end() || (*it).second.ctx.get() != ctx) {
+			return 0;
 		}
+
+		return (*it).second.serial;
+	}
+
+	/// Get the number of the lua_State objects of the 'ctx'.
+	std::size_t GetThreadCount(Context *ctx) {
+		scoped_lock lock(m_mutex);
+
+		ThreadMap::const_iterator it = m_threads.find(ctx);
+		return (it != m_threads.end() ? (*it).second.size() : 0);
 	}
 
 	/// Find the Context object from a lua_State object.
@@ -119,15 +220,173 @@ public:
 			return shared_ptr<Context>();
 		}
 
-		return (*it).second;
+		return (*it).second.ctx;
+	}
+
+	/// Find the Context object and pin it, without the global lock if possible.
+	/**
+	 * The pinned context isn't deleted until 'Unpin' is called with 'outer',
+	 * the context the thread pinned before. It returns NULL without pinning
+	 * if 'L' isn't registered.
+	 */
+	Context *Pin(lua_State *L, Context *&outer) {
+		if (L == NULL) {
+			return NULL;
+		}
+
+		ThreadCache *cache = ms_cache.get();
+		if (cache == NULL) {
+			cache = new ThreadCache;
+			ms_cache.reset(cache);
+		}
+
+		outer = cache->pinned;
+		CacheEntry &entry = cache->entries[
+			(reinterpret_cast<std::size_t>(L) >> 4) & (CACHE_SIZE - 1)];
+		if (entry.L == L && entry.ctx != NULL) {
+			// Publish it first, and then check the entry.
+			cache->pinned = entry.ctx;
+			++cache->pins;
+			if (entry.generation == ms_generation) {
+				return entry.ctx;
+			}
+
+			cache->pinned = outer;
+			--cache->pins;
+		}
+		++cache->misses;
+
+		// 'Erase' can't come between the lookup and the pin in the lock.
+		scoped_lock lock(m_mutex);
+
+		Map::iterator it = m_map.find(L);
+		if (it == m_map.end()) {
+			return NULL;
+		}
+
+		cache->pinned = (*it).second.ctx.get();
+		++cache->pins;
+
+		entry.L = L;
+		entry.ctx = cache->pinned;
+		entry.generation = ms_generation;
+		return entry.ctx;
+	}
+
+	/// Get the number of the pins that missed the cache on the calling thread.
+	static unsigned long GetPinMisses() {
+		ThreadCache *cache = ms_cache.get();
+		return (cache != NULL ? cache->misses : 0);
+	}
+
+	/// Unpin the context 'Pin' returned, 'outer' is pinned again.
+	static void Unpin(Context *outer) {
+		ThreadCache *cache = ms_cache.get();
+
+		cache->pinned = outer;
+		--cache->pins;
+	}
+
+	/// Wait until no other thread pins the 'ctx', it must be erased already.
+	/**
+	 * The pinning hooks may wait for the lock of the context, so it must
+	 * be called without the lock. The pin of the calling thread is ignored,
+	 * so the context can't be deleted in its own hook.
+	 */
+	static void WaitForHooks(Context *ctx) {
+		for (;;) {
+			bool isPinned = false;
+			{
+				scoped_lock lock(ms_cacheMutex);
+
+				ThreadCache *self = ms_cache.get();
+				CacheSet::const_iterator it;
+				for (it = ms_caches.begin(); it != ms_caches.end(); ++it) {
+					if (*it != self && (*it)->pins > 0 && (*it)->pinned == ctx) {
+						isPinned = true;
+						break;
+					}
+				}
+			}
+
+			if (!isPinned) {
+				break;
+			}
+
+			boost::thread::yield();
+		}
 	}
 
 private:
-	typedef std::map<lua_State *, shared_ptr<Context> > Map;
+	struct Entry {
+		Entry() : serial(0) {}
+		shared_ptr<Context> ctx;
+		unsigned long serial;
+	};
+	typedef std::map<lua_State *, Entry> Map;
+	typedef std::set<lua_State *> ThreadSet;
+	typedef std::map<Context *, ThreadSet> ThreadMap;
 	Map m_map;
+	ThreadMap m_threads;
 	mutex m_mutex;
+
+	/// Cached pair of (L, ctx) for each OS thread.
+	enum { CACHE_SIZE = 16 };
+	struct CacheEntry {
+		CacheEntry() : L(NULL), ctx(NULL), generation(-1) {}
+		lua_State *L;
+		Context *ctx;
+		long generation;
+	};
+
+	/// The cache and the pinned context of an OS thread.
+	/**
+	 * 'pins' is the depth of the hooks, the hook in the hook (e.g. by
+	 * the condition of the breakpoint) pins the context again.
+	 */
+	struct ThreadCache : private boost::noncopyable {
+		ThreadCache() : pinned(NULL), pins(0), misses(0) {
+			scoped_lock lock(ms_cacheMutex);
+			ms_caches.insert(this);
+		}
+		~ThreadCache() {
+			scoped_lock lock(ms_cacheMutex);
+			ms_caches.erase(this);
+		}
+		CacheEntry entries[CACHE_SIZE];
+		Context *pinned;
+		boost::detail::atomic_count pins;
+		unsigned long misses; ///< only the owner thread uses it
+	};
+	typedef std::set<ThreadCache *> CacheSet;
+
+	// These are static, because the manager object may be recreated
+	// while some threads still have their caches.
+	static boost::thread_specific_ptr<ThreadCache> ms_cache;
+	static boost::detail::atomic_count ms_generation;
+	static CacheSet ms_caches;
+	static mutex ms_cacheMutex;
+
+	// The finalizers of the old threads may be called with the new manager.
+	static unsigned long ms_serial;
 };
 
+boost::thread_specific_ptr<Context::ContextManager::ThreadCache>
+	Context::ContextManager::ms_cache;
+boost::detail::atomic_count Context::ContextManager::ms_generation(0);
+Context::ContextManager::CacheSet Context::ContextManager::ms_caches;
+mutex Context::ContextManager::ms_cacheMutex;
+unsigned long Context::ContextManager::ms_serial = 0;
+
+/// The id of each OS thread, it's assigned at the first use.
+static boost::thread_specific_ptr<int> s_threadId;
+static boost::detail::atomic_count s_threadSerial(0);
+
+/// The serial number of the contexts, the address of a context may be reused.
+static boost::detail::atomic_count s_contextSerial(0);
+
+boost::thread_specific_ptr<Context::CurrentThread> Context::ms_currentThread;
+
 
 /*-----------------------------------------------------------------*/
 shared_ptr<Context::ContextManager> Context::ms_manager;
@@ -148,16 +407,18 @@ struct StdOutLogger {
 			std::cout << name << "(" << data.GetLine() << "): ";
 		}
 
-		std::cout << data.GetLog() << std::endl;
+		// Don't flush on each log, the logpoints may be hit very frequently.
+		std::cout << data.GetLog() << "\n";
 	}
 };
 
 Context::Context()
-	: m_lua(NULL)/*, m_state(STATE_INITIAL)*/
-	, m_debugState(DEBUGSTATE_INITIAL), m_isEnabled(true)
+	: m_id((unsigned long)++s_contextSerial), m_lua(NULL)/*, m_state(STATE_INITIAL)*/
+	, m_hookMask(LUA_MASKLINE | LUA_MASKCALL | LUA_MASKRET)
 	, m_updateCount(0), m_waitUpdateCount(0), m_isMustUpdate(false)
-	, m_engine(new RemoteEngine)
-	, m_sourceManager(m_engine), m_breakpoints(m_engine) {
+	, m_mainThread(0), m_selectedThread(0), m_pendingCommands(0), m_engine(new RemoteEngine)
+	, m_sourceManager(m_engine), m_breakpoints(m_engine), m_sourceGeneration(0)
+	, m_debugFilter(DEBUGFILTER_ALL), m_filterSerial(0) {
 
 	m_engine->SetOnRemoteCommand(
 		boost::bind1st(boost::mem_fn(&Context::OnRemoteCommand), this));
@@ -167,7 +428,19 @@ Context::Context()
 int Context::Initialize() {
 	scoped_lock lock(m_mutex);
 
-	lua_State *L = lua_open();
+	lua_State *L = NULL;
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM >= 501
+	// The allocation profiler needs the allocator of lldebug.
+	if (lldebug_getallocprofiling() != 0) {
+		L = lua_newstate(Context::s_Alloc, this);
+		m_allocProfiler.SetWrapped(L != NULL);
+	}
+	else {
+		L = lua_open();
+	}
+#else
+	L = lua_open();
+#endif
 	if (L == NULL) {
 		return -1;
 	}
@@ -177,11 +450,23 @@ int Context::Initialize() {
 		return -1;
 	}
 
-	SetHook(L);
+	// Without the frame, only the profilers need the hook.
+	if (lldebug_getframeenabled() == 0) {
+		m_hookMask = 0;
+	}
+
+	SetHook(L, m_hookMask);
 	m_lua = L;
 //	m_state = STATE_DEBUG;
-	m_debugState = DEBUGSTATE_STEPINTO; //NORMAL;
-	m_coroutines.push_back(CoroutineInfo(L));
+
+	// The thread that opened the state breaks at the first line.
+	m_mainThread = GetThreadId();
+	m_selectedThread = m_mainThread;
+	shared_ptr<ThreadInfo> thread(
+		new ThreadInfo(m_mainThread, DEBUGSTATE_STEPINTO)); //NORMAL;
+	thread->coroutines.push_back(CoroutineInfo(L));
+	m_threads[m_mainThread] = thread;
+	UpdateHookMask(*thread);
 
 	// Add this to manager.
 	if (ms_manager == NULL) {
@@ -191,7 +476,7 @@ int Context::Initialize() {
 
 	// After the all initialization was done,
 	// we create a new frame for this context.
-	if (CreateDebuggerFrame() != 0) {
+	if (m_hookMask != 0 && CreateDebuggerFrame() != 0) {
 		//return -1;
 	}
 
@@ -230,7 +515,12 @@ int Context::CreateDebuggerFrame() {
 		"lldebug doesn't work correctly, because the frame was not found.\n"
 		"Now this program starts without debugging.\n"
 		"(If you want to debug visually, please excute 'lldebug_frame(.exe)' first.)");
-	SetDebugEnable(false);
+
+	// Only the profilers need the hook from now.
+	m_hookMask = 0;
+	SetHook(m_lua, m_hookMask);
+	GetThread(m_lua).coroutines.back().hookMask = m_hookMask;
+	UpdateHookMask();
 	return -1;
 }
 
@@ -280,17 +570,30 @@ Context::~Context() {
 	}
 }
 
+/**
+ * The hooks running on the other threads may still use this,
+ * so it waits for them after this is erased. Don't delete the context
+ * while its lua runs on the other threads, they may wait for the frame.
+ */
 void Context::Delete() {
-	scoped_lock lock(m_mutex);
+	shared_ptr<ContextManager> manager;
+	{
+		scoped_lock lock(m_mutex);
 
-	if (ms_manager == NULL) {
-		return;
+		if (ms_manager == NULL) {
+			return;
+		}
+
+		// Erase this from the context manager.
+		manager = ms_manager;
+		manager->Erase(shared_from_this());
 	}
 
-	// Erase this from the context manager.
-	ms_manager->Erase(shared_from_this());
+	// The hooks may wait for the lock, so it isn't held.
+	ContextManager::WaitForHooks(this);
 
-	if (ms_manager->IsEmpty()) {
+	scoped_lock lock(m_mutex);
+	if (ms_manager == manager && manager->IsEmpty()) {
 		ms_manager.reset();
 	}
 }
@@ -320,7 +623,9 @@ int Context::LoadConfig() {
 
 		// Set values.
 		m_breakpoints = bps;
+		UpdateBreakpoints();
 		m_engine->SendChangedBreakpointList(m_breakpoints);
+		UpdateHookMask();
 	}
 	catch (std::exception &ex) {
 		OutputLog(
@@ -478,6 +783,31 @@ void Context::OutputLog(LogType type, const std::string &str,
 	OutputLogInternal(LogData(type, str, key, line), true);
 }
 
+void Context::OutputLogpoint(const LogData &logData) {
+	scoped_lock lock(m_mutex);
+
+	// It's sent with other logs later, because the logpoint may be hit
+	// very frequently. The frame shows it, so the logger isn't called.
+	if (m_engine->IsConnecting()) {
+		m_engine->PostOutputLog(logData);
+		return;
+	}
+
+	if (!m_logger.empty()) {
+		LoggerType logger = m_logger;
+
+		lock.unlock();
+		logger(shared_from_this(), logData);
+		lock.lock();
+	}
+}
+
+void Context::GetLogpointCount(unsigned long &posted, unsigned long &dropped) {
+	scoped_lock lock(m_mutex);
+
+	m_engine->GetPostedLogCount(posted, dropped);
+}
+
 void Context::OutputLuaError(const char *str) {
 	if (str == NULL) {
 		return;
@@ -489,24 +819,89 @@ void Context::OutputLuaError(const char *str) {
 
 void Context::OnRemoteCommand(const Command &command) {
 	m_readCommands.push(command);
+	++m_pendingCommands; // after push, so the command surely exists
 	m_commandCond.notify_all();
 }
 
-int Context::HandleCommand() {
+/// Does the command inspect the state of the lua ?
+static bool is_inspecting_command(RemoteCommandType type) {
+	switch (type) {
+	case REMOTECOMMANDTYPE_EVALS_TO_VARLIST:
+	case REMOTECOMMANDTYPE_EVAL_TO_MULTIVAR:
+	case REMOTECOMMANDTYPE_EVAL_TO_VAR:
+	case REMOTECOMMANDTYPE_REQUEST_FIELDSVARLIST:
+	case REMOTECOMMANDTYPE_REQUEST_FIELDSQUERY:
+	case REMOTECOMMANDTYPE_REQUEST_LOCALVARLIST:
+	case REMOTECOMMANDTYPE_REQUEST_GLOBALVARLIST:
+	case REMOTECOMMANDTYPE_REQUEST_REGISTRYVARLIST:
+	case REMOTECOMMANDTYPE_REQUEST_STACKLIST:
+	case REMOTECOMMANDTYPE_REQUEST_BACKTRACELIST:
+	case REMOTECOMMANDTYPE_REQUEST_COROUTINELIST:
+	case REMOTECOMMANDTYPE_REQUEST_COROUTINEBACKTRACE:
+	case REMOTECOMMANDTYPE_SAVE_HEAPSNAPSHOT:
+	case REMOTECOMMANDTYPE_BATCH:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/// Handle the commands from the frame.
+/**
+ * 'thread' is the calling thread, or NULL if it isn't running lua.
+ * While the selected thread is stopping, the commands that inspect
+ * the lua are deferred to it, and the others are handled by any thread.
+ * The lua is inspected without the lock of the context, so the hooks
+ * of the other threads don't wait for it.
+ */
+int Context::HandleCommand(ThreadInfo *thread) {
+	// This is called on every line event, so check
+	// the pending commands without any locks first.
+	if (m_pendingCommands == 0) {
+		return 0;
+	}
+
 	scoped_lock lock(m_mutex);
 
 	// Process the command.
-	while (!m_readCommands.empty()) {
-		Command command = m_readCommands.front();
-		m_readCommands.pop();
+	for (;;) {
+		bool isInspecting = IsInspecting(thread);
+		Command command;
+
+		if (isInspecting && !m_deferredCommands.empty()) {
+			command = m_deferredCommands.front();
+			m_deferredCommands.pop_front();
+		}
+		else if (!m_readCommands.empty()) {
+			command = m_readCommands.front();
+			m_readCommands.pop();
+
+			if (!isInspecting && !command.IsResponse()
+				&& is_inspecting_command(command.GetType())) {
+				m_deferredCommands.push_back(command); // still pending
+				m_commandCond.notify_all();
+				continue;
+			}
+		}
+		else {
+			break;
+		}
+		--m_pendingCommands;
 
 		if (command.IsResponse()) {
 			command.CallResponse();
 			continue;
 		}
 
+		bool isUnlocked = (command.GetType() != REMOTECOMMANDTYPE_BATCH
+			&& is_inspecting_command(command.GetType()));
+		if (isUnlocked) {
+			lock.unlock();
+		}
+
 		switch (command.GetType()) {
 		case REMOTECOMMANDTYPE_START_CONNECTION:
+		case REMOTECOMMANDTYPE_PING:
 			break;
 		case REMOTECOMMANDTYPE_END_CONNECTION:
 			return -1;
@@ -530,6 +925,25 @@ int Context::HandleCommand() {
 		case REMOTECOMMANDTYPE_RESUME:
 			SetDebugState(DEBUGSTATE_RUNNING);
 			break;
+		case REMOTECOMMANDTYPE_BATCH:
+			{
+				// The commands in the batch are handled before the others.
+				std::vector<Command> commands;
+				m_engine->SplitBatch(command, commands);
+				m_deferredCommands.insert(m_deferredCommands.begin(),
+					commands.begin(), commands.end());
+				for (std::size_t i = 0; i < commands.size(); ++i) {
+					++m_pendingCommands;
+				}
+			}
+			break;
+		case REMOTECOMMANDTYPE_SELECT_THREAD:
+			{
+				int id;
+				command.GetData().Get_SelectThread(id);
+				SelectThread(id);
+			}
+			break;
 
 		case REMOTECOMMANDTYPE_FORCE_UPDATESOURCE:
 			m_isMustUpdate = true;
@@ -559,6 +973,15 @@ int Context::HandleCommand() {
 				OutputLogInternal(logData, false);
 			}
 			break;
+		case REMOTECOMMANDTYPE_OUTPUT_LOGLIST:
+			{
+				LogDataList logs;
+				command.GetData().Get_OutputLogList(logs);
+				for (LogDataList::size_type i = 0; i < logs.size(); ++i) {
+					OutputLogInternal(logs[i], false);
+				}
+			}
+			break;
 
 		case REMOTECOMMANDTYPE_EVALS_TO_VARLIST:
 			{
@@ -566,6 +989,12 @@ int Context::HandleCommand() {
 				LuaStackFrame stackFrame;
 				command.GetData().Get_EvalsToVarList(evals, stackFrame);
 				m_engine->ResponseVarList(command, LuaEvalsToVarList(evals, stackFrame, true));
+
+				// They're evaluated again with the next break.
+				if (stackFrame.GetLua() == LuaHandle() && stackFrame.GetLevel() == 0) {
+					scoped_lock watchLock(m_mutex);
+					m_watchEvals = evals;
+				}
 			}
 			break;
 		case REMOTECOMMANDTYPE_EVAL_TO_MULTIVAR:
@@ -590,6 +1019,8 @@ int Context::HandleCommand() {
 				Breakpoint bp;
 				command.GetData().Get_SetBreakpoint(bp);
 				m_breakpoints.Set(bp);
+				UpdateBreakpoints();
+				UpdateHookMask();
 			}
 			break;
 		case REMOTECOMMANDTYPE_REMOVE_BREAKPOINT:
@@ -597,14 +1028,34 @@ int Context::HandleCommand() {
 				Breakpoint bp;
 				command.GetData().Get_RemoveBreakpoint(bp);
 				m_breakpoints.Remove(bp);
+				UpdateBreakpoints();
+				UpdateHookMask();
 			}
 			break;
 
 		case REMOTECOMMANDTYPE_REQUEST_FIELDSVARLIST:
 			{
 				LuaVar var;
-				command.GetData().Get_RequestFieldVarList(var);
-				m_engine->ResponseVarList(command, LuaGetFields(var));
+				int offset, count, resume;
+				int total = 0;
+				command.GetData().Get_RequestFieldVarList(
+					var, offset, count, resume);
+				LuaVarList vars = LuaGetFields(var, offset, count, total, resume);
+				m_engine->ResponseVarPage(command, vars, total, resume, "");
+			}
+			break;
+		case REMOTECOMMANDTYPE_REQUEST_FIELDSQUERY:
+			{
+				LuaVar var;
+				LuaFieldQuery query;
+				int offset, count;
+				int total = 0;
+				std::string error;
+				command.GetData().Get_RequestFieldsQuery(
+					var, query, offset, count);
+				LuaVarList vars = LuaQueryFields(
+					var, query, offset, count, total, error);
+				m_engine->ResponseVarPage(command, vars, total, 0, error);
 			}
 			break;
 		case REMOTECOMMANDTYPE_REQUEST_LOCALVARLIST:
@@ -637,6 +1088,124 @@ int Context::HandleCommand() {
 		case REMOTECOMMANDTYPE_REQUEST_BACKTRACELIST:
 			m_engine->ResponseBacktraceList(command, LuaGetBacktrace());
 			break;
+		case REMOTECOMMANDTYPE_REQUEST_COROUTINELIST:
+			{
+				int offset, count, sortKey;
+				bool isAscending;
+				int total = 0;
+				command.GetData().Get_RequestCoroutineList(
+					offset, count, sortKey, isAscending);
+				LuaCoroutineList coroutines = LuaGetCoroutines(
+					offset, count, sortKey, isAscending, total);
+				m_engine->ResponseCoroutineList(command, coroutines, total);
+			}
+			break;
+		case REMOTECOMMANDTYPE_REQUEST_COROUTINEBACKTRACE:
+			{
+				LuaHandle lua;
+				command.GetData().Get_RequestCoroutineBacktrace(lua);
+				m_engine->ResponseBacktraceList(command, LuaGetBacktrace(lua));
+			}
+			break;
+
+		case REMOTECOMMANDTYPE_START_PROFILE:
+			{
+				int interval;
+				command.GetData().Get_StartProfile(interval);
+				if (StartProfile(interval) != 0) {
+					OutputLog(LOGTYPE_ERROR, "Couldn't start the profiler.");
+				}
+			}
+			break;
+		case REMOTECOMMANDTYPE_STOP_PROFILE:
+			m_engine->ResponseString(command, StopProfile());
+			break;
+		case REMOTECOMMANDTYPE_START_FUNCPROFILE:
+			StartFuncProfile();
+			break;
+		case REMOTECOMMANDTYPE_STOP_FUNCPROFILE:
+			StopFuncProfile();
+			break;
+		case REMOTECOMMANDTYPE_REQUEST_FUNCPROFILELIST:
+			m_engine->ResponseFuncProfileList(command, GetFuncProfile());
+			break;
+		case REMOTECOMMANDTYPE_START_COVERAGE:
+			{
+				bool firstHitOnly;
+				command.GetData().Get_StartCoverage(firstHitOnly);
+				StartCoverage(firstHitOnly);
+			}
+			break;
+		case REMOTECOMMANDTYPE_STOP_COVERAGE:
+			StopCoverage();
+			m_engine->ResponseCoverageList(command, GetCoverage());
+			break;
+		case REMOTECOMMANDTYPE_START_ALLOCPROFILE:
+			if (StartAllocProfile() != 0) {
+				OutputLog(LOGTYPE_ERROR,
+					"The allocation profiler needs 'lldebug_setallocprofiling'.");
+			}
+			break;
+		case REMOTECOMMANDTYPE_STOP_ALLOCPROFILE:
+			StopAllocProfile();
+			m_engine->ResponseAllocProfileList(command, GetAllocProfile());
+			break;
+		case REMOTECOMMANDTYPE_START_SCHEDPROFILE:
+			StartSchedProfile();
+			break;
+		case REMOTECOMMANDTYPE_STOP_SCHEDPROFILE:
+			StopSchedProfile();
+			m_engine->ResponseSchedProfileList(command, GetSchedProfile());
+			break;
+		case REMOTECOMMANDTYPE_START_TRACE:
+			{
+				int bufferSize;
+				std::string prefix;
+				command.GetData().Get_StartTrace(bufferSize, prefix);
+				StartTrace(bufferSize, prefix);
+			}
+			break;
+		case REMOTECOMMANDTYPE_STOP_TRACE:
+			StopTrace();
+			m_engine->ResponseString(command, GetTrace());
+			break;
+		case REMOTECOMMANDTYPE_SAVE_HEAPSNAPSHOT:
+			{
+				std::string filename;
+				command.GetData().Get_SaveHeapSnapshot(filename);
+				if (SaveHeapSnapshot(filename) != 0) {
+					OutputLog(LOGTYPE_ERROR,
+						"Couldn't save the heap snapshot to '" + filename + "'.");
+				}
+			}
+			break;
+		case REMOTECOMMANDTYPE_START_GCMONITOR:
+			{
+				int interval;
+				command.GetData().Get_StartGcMonitor(interval);
+				if (StartGcMonitor(interval, std::string()) != 0) {
+					OutputLog(LOGTYPE_ERROR, "Couldn't start the GC monitor.");
+				}
+			}
+			break;
+		case REMOTECOMMANDTYPE_STOP_GCMONITOR:
+			StopGcMonitor();
+			break;
+		case REMOTECOMMANDTYPE_SET_GCTHRESHOLD:
+			{
+				int kbytes;
+				command.GetData().Get_SetGcThreshold(kbytes);
+				SetGcThreshold(kbytes);
+			}
+			break;
+		case REMOTECOMMANDTYPE_SET_DEBUGFILTER:
+			{
+				int type;
+				std::string pattern;
+				command.GetData().Get_SetDebugFilter(type, pattern);
+				SetDebugFilter((DebugFilterType)type, pattern);
+			}
+			break;
 
 		case REMOTECOMMANDTYPE_SUCCESSED:
 		case REMOTECOMMANDTYPE_FAILED:
@@ -651,48 +1220,1144 @@ int Context::HandleCommand() {
 		case REMOTECOMMANDTYPE_VALUE_VAR:
 		case REMOTECOMMANDTYPE_VALUE_VARLIST:
 		case REMOTECOMMANDTYPE_VALUE_BACKTRACELIST:
+		case REMOTECOMMANDTYPE_VALUE_FUNCPROFILELIST:
+		case REMOTECOMMANDTYPE_VALUE_COVERAGELIST:
+		case REMOTECOMMANDTYPE_CHANGED_COVERAGE:
+		case REMOTECOMMANDTYPE_VALUE_ALLOCPROFILELIST:
+		case REMOTECOMMANDTYPE_VALUE_SCHEDPROFILELIST:
+		case REMOTECOMMANDTYPE_VALUE_COROUTINELIST:
+		case REMOTECOMMANDTYPE_VALUE_BATCH:
+		case REMOTECOMMANDTYPE_VALUE_VARPAGE:
+		case REMOTECOMMANDTYPE_CHANGED_GCSTATS:
+		case REMOTECOMMANDTYPE_CHANGED_THREADLIST:
 			assert(false && "Command type is invalid.");
 			break;
 		}
+
+		if (isUnlocked) {
+			lock.lock();
+		}
 	}
 
 	return 0;
 }
 
-void Context::SetHook(lua_State *L) {
-	int mask = LUA_MASKLINE | LUA_MASKCALL | LUA_MASKRET;
-	lua_sethook(L, Context::s_HookCallback, mask, 0);
+void *Context::s_Alloc(void *ud, void *ptr, std::size_t osize,
+						std::size_t nsize) {
+	return static_cast<Context *>(ud)->Alloc(ptr, osize, nsize);
 }
 
-void Context::s_HookCallback(lua_State *L, lua_Debug *ar) {
-	shared_ptr<Context> ctx = Context::Find(L);
+/// Allocate the block, and charge it to the running lua function.
+/**
+ * The site comes from the activations the hook keeps, so it doesn't
+ * call lua_getinfo. C functions are charged to the lua caller.
+ * Only the owner thread uses its activations, so the lock is taken
+ * just for the profiler, and not at all while the profiler stops,
+ * except to credit the blocks it charged.
+ * (the running state is checked again in the lock)
+ */
+void *Context::Alloc(void *ptr, std::size_t osize, std::size_t nsize) {
+	if (!m_allocProfiler.IsRunning() && !m_allocProfiler.IsCharged(ptr)) {
+		return AllocationProfiler::AllocUncharged(ptr, nsize);
+	}
+
+	ActivationInfo *activation = NULL;
+	if (nsize > 0 && m_allocProfiler.IsRunning()) {
+		ThreadInfo *thread = FindCurrentThread();
+		if (thread != NULL && !thread->coroutines.empty()) {
+			CoroutineInfo &current = thread->coroutines.back();
+			ActivationList::reverse_iterator it;
+			for (it = current.activations.rbegin();
+				it != current.activations.rend(); ++it) {
+				if (it->sourceId >= 0) {
+					activation = &*it;
+					break;
+				}
+			}
+		}
+	}
+
+	scoped_lock lock(m_mutex);
+
+	int site = -1;
+	if (nsize > 0 && m_allocProfiler.IsRunning()) {
+		if (activation == NULL) {
+			site = m_allocProfiler.GetSite(-1, 0);
+		}
+		else {
+			if (activation->allocSite < 0) {
+				activation->allocSite = m_allocProfiler.GetSite(
+					activation->sourceId, activation->lineDefined);
+			}
+			site = activation->allocSite;
+		}
+	}
+
+	return m_allocProfiler.Alloc(ptr, osize, nsize, site);
+}
+
+void Context::SetHook(lua_State *L, int mask) {
+	int count = ((mask & LUA_MASKCOUNT) != 0 ? HOOK_COUNT_INTERVAL : 0);
+	lua_sethook(L, Context::s_HookCallback, mask, count);
+}
+
+/// Decide the hook settings of all threads.
+void Context::UpdateHookMask() {
+	scoped_lock lock(m_mutex);
 
-	if (ctx != NULL) {
-		ctx->HookCallback(L, ar);
+	ThreadMap::iterator it;
+	for (it = m_threads.begin(); it != m_threads.end(); ++it) {
+		UpdateHookMask(*it->second);
 	}
 }
 
-void Context::SetDebugState(DebugState state) {
+/// Decide the hook settings of the thread from its own debug state.
+/**
+ * The thread applies them in its next hook event, and the count hook
+ * keeps the latency of the 'BREAK' command bounded.
+ */
+void Context::UpdateHookMask(ThreadInfo &thread) {
 	scoped_lock lock(m_mutex);
+	HookSettings settings;
+
+	// The count hook is enough, if the thread is running.
+	settings.state = thread.debugState;
+	if (m_hookMask == 0) {
+		settings.frameMask = 0;
+	}
+	else if (thread.debugState == DEBUGSTATE_RUNNING
+		&& m_breakpoints.IsEmpty()) {
+		settings.frameMask = LUA_MASKCOUNT;
+	}
+	else {
+		settings.frameMask = m_hookMask;
+	}
+
+	settings.profilerMask = GetProfilerMask();
+	settings.isSampling = m_profiler.IsRunning();
+	settings.isProfiling = m_funcProfiler.IsRunning();
+	settings.isTracing = m_tracer.IsRunning();
+	settings.isScheduling = m_schedProfiler.IsRunning();
+	settings.isWatchingGc = (m_gcMonitor.IsRunning() || m_gcMonitor.IsArmed());
+	settings.isCovering = m_coverage.IsRunning();
+	settings.isAllocating = m_allocProfiler.IsRunning();
+	settings.isFiltering = (m_debugFilter != DEBUGFILTER_ALL);
+	settings.filterSerial = m_filterSerial;
+	settings.breakpoints = m_breakpointSnapshot;
+
+	scoped_lock threadLock(thread.settingsMutex);
+	thread.settings = settings;
+	++thread.changes;
+}
 
-	if (state == m_debugState) {
+/// Copy the hook settings of the calling thread, if they were changed.
+/**
+ * The running activations need the line hook, if the breakpoints
+ * were set in them or the coverage was started.
+ */
+void Context::RefreshHook(ThreadInfo &thread) {
+	if (thread.changes == thread.seenChanges) {
 		return;
 	}
 
-	switch (m_debugState) {
-	case DEBUGSTATE_INITIAL:
-		break;
-	case DEBUGSTATE_RUNNING:
-		switch (state) {
-		case DEBUGSTATE_BREAK:
-			m_debugState = state;
-			m_engine->SendChangedState(true);
-			break;
-		case DEBUGSTATE_STEPOVER:
-		case DEBUGSTATE_STEPINTO:
-		case DEBUGSTATE_STEPRETURN:
-			/* ignore */
-			break;
+	HookSettings old = thread.hook;
+	{
+		scoped_lock threadLock(thread.settingsMutex);
+		thread.seenChanges = thread.changes;
+		thread.hook = thread.settings;
+	}
+	const HookSettings &hook = thread.hook;
+
+	// The steps are counted from the call that is stopping now.
+	if (hook.state != old.state
+		&& (hook.state == DEBUGSTATE_STEPOVER
+			|| hook.state == DEBUGSTATE_STEPRETURN)
+		&& !thread.coroutines.empty()) {
+		thread.stepinfo = thread.coroutines.back();
+	}
+
+	if (hook.frameMask == 0 && !hook.isCovering) {
+		return;
+	}
+
+	scoped_lock lock(m_mutex);
+	bool isCoverageStarted = (hook.isCovering && !old.isCovering);
+	CoroutineList::iterator co;
+	for (co = thread.coroutines.begin(); co != thread.coroutines.end(); ++co) {
+		ActivationList::iterator it;
+		for (it = co->activations.begin(); it != co->activations.end(); ++it) {
+			// The source may get the id, or lose its breakpoints.
+			if (it->source != NULL) {
+				it->sourceId = GetSourceId(thread, NULL, it->source);
+			}
+
+			if (it->needsLine) {
+				continue;
+			}
+
+			// The line number of breakpoints starts from 0.
+			it->needsLine = (isCoverageStarted
+				|| (hook.frameMask != 0 && it->sourceId >= 0
+					&& it->lastLineDefined >= 0 && hook.breakpoints != NULL
+					&& hook.breakpoints->Contains(it->sourceId,
+						it->lineDefined - 1, it->lastLineDefined - 1)));
+		}
+	}
+}
+
+/// Get the id of the calling OS thread, it's numbered at the first call.
+int Context::GetThreadId() {
+	int *id = s_threadId.get();
+
+	if (id == NULL) {
+		id = new int((int)++s_threadSerial);
+		s_threadId.reset(id);
+	}
+
+	return *id;
+}
+
+/// Find the debug state of the thread, or NULL.
+Context::ThreadInfo *Context::FindThread(int id) {
+	scoped_lock lock(m_mutex);
+
+	ThreadMap::iterator it = m_threads.find(id);
+	if (it == m_threads.end()) {
+		return NULL;
+	}
+
+	return it->second.get();
+}
+
+/// Find the debug state of the calling thread, or NULL.
+/**
+ * It's cached for each OS thread, so the hook doesn't need the lock.
+ */
+Context::ThreadInfo *Context::FindCurrentThread() {
+	CurrentThread *current = ms_currentThread.get();
+	if (current != NULL && current->contextId == m_id
+		&& current->thread != NULL) {
+		return current->thread.get();
+	}
+
+	scoped_lock lock(m_mutex);
+	ThreadMap::iterator it = m_threads.find(GetThreadId());
+	if (it == m_threads.end()) {
+		return NULL;
+	}
+
+	if (current == NULL) {
+		current = new CurrentThread;
+		ms_currentThread.reset(current);
+	}
+	current->contextId = m_id;
+	current->thread = it->second;
+	return it->second.get();
+}
+
+/// Get the debug state of the calling thread, it's made at the first call.
+/**
+ * L is the lua_State the new thread starts with, or NULL.
+ */
+Context::ThreadInfo &Context::GetThread(lua_State *L) {
+	ThreadInfo *thread = FindCurrentThread();
+	if (thread != NULL && (L == NULL || !thread->coroutines.empty())) {
+		return *thread;
+	}
+
+	scoped_lock lock(m_mutex);
+	if (thread == NULL) {
+		shared_ptr<ThreadInfo> info(new ThreadInfo(GetThreadId()));
+		m_threads.insert(std::make_pair(info->id, info));
+		UpdateHookMask(*info);
+		SendThreadList();
+
+		thread = FindCurrentThread();
+	}
+
+	if (thread->coroutines.empty() && L != NULL) {
+		scoped_lock chainLock(thread->chainMutex);
+		thread->coroutines.push_back(CoroutineInfo(L));
+	}
+
+	return *thread;
+}
+
+/// Can the thread handle the commands that inspect the lua ?
+/**
+ * While the selected thread is stopping, only it can do, because
+ * the others are running their own lua_State.
+ */
+bool Context::IsInspecting(const ThreadInfo *thread) {
+	scoped_lock lock(m_mutex);
+
+	ThreadInfo *selected = FindThread(m_selectedThread);
+	return (selected == NULL
+		|| selected->debugState != DEBUGSTATE_BREAK
+		|| selected == thread);
+}
+
+/// Select the thread the frame inspects and steps.
+void Context::SelectThread(int id) {
+	scoped_lock lock(m_mutex);
+
+	ThreadInfo *thread = FindThread(id);
+	if (thread == NULL || id == m_selectedThread) {
+		return;
+	}
+
+	// The break loop of the thread sends its source again.
+	m_selectedThread = id;
+	thread->isShown = false;
+
+	m_engine->SendChangedState(thread->debugState == DEBUGSTATE_BREAK);
+	SendThreadList();
+	m_commandCond.notify_all();
+}
+
+/// Send the states of the threads to the frame.
+void Context::SendThreadList() {
+	scoped_lock lock(m_mutex);
+
+	// Without the frame, nobody needs them.
+	if (m_hookMask == 0) {
+		return;
+	}
+
+	LuaThreadList threads;
+	ThreadMap::const_iterator it;
+	for (it = m_threads.begin(); it != m_threads.end(); ++it) {
+		ThreadInfo &info = *it->second;
+		bool isBreak = (info.debugState == DEBUGSTATE_BREAK);
+
+		std::string title;
+		const Source *source = m_sourceManager.Get(info.breakKey);
+		if (isBreak && source != NULL) {
+			title = source->GetTitle();
+		}
+
+		scoped_lock chainLock(info.chainMutex);
+		threads.push_back(LuaThread(
+			info.id,
+			(info.coroutines.empty() ? m_lua : info.coroutines.back().L),
+			isBreak, (info.id == m_selectedThread),
+			(isBreak ? info.breakKey : std::string()), title,
+			(isBreak ? info.breakLine : -1)));
+	}
+
+	m_engine->SendChangedThreadList(threads);
+}
+
+/// Get the hook mask for the current activation of the coroutine.
+/**
+ * 'thread' is the calling thread that resumes the coroutine,
+ * the mask is decided from its hook settings without any lock.
+ */
+int Context::GetHookMask(const ThreadInfo &thread, const CoroutineInfo &info) {
+	const HookSettings &hook = thread.hook;
+
+	// The coroutine out of the debug filter isn't hooked by the frame.
+	// (it's hooked until the new filter is checked)
+	int mask = hook.frameMask;
+	if (!info.isDebugged && info.filterSerial == hook.filterSerial) {
+		mask = 0;
+	}
+
+	// The count hook polls the commands instead of the line hook.
+	if (mask != 0 && hook.state == DEBUGSTATE_RUNNING
+		&& !info.IsLineNeeded()) {
+		mask = ((mask & ~LUA_MASKLINE) | LUA_MASKCOUNT);
+	}
+
+	// The coverage needs the lines of the activations not covered yet.
+	mask |= hook.profilerMask;
+	if (hook.isCovering && info.IsLineNeeded()) {
+		mask |= LUA_MASKLINE;
+	}
+
+	return mask;
+}
+
+/// Set the hook mask of the coroutine the calling thread resumes.
+/**
+ * The activations are forgotten, if the calls weren't hooked.
+ * (unknown means 'line needed')
+ */
+void Context::ApplyHookMask(ThreadInfo &thread, CoroutineInfo &info) {
+	int mask = GetHookMask(thread, info);
+	if ((info.hookMask & LUA_MASKCALL) == 0 && (mask & LUA_MASKCALL) != 0) {
+		info.activations.clear();
+	}
+
+	info.hookMask = mask;
+	if (lua_gethookmask(info.L) != mask) {
+		SetHook(info.L, mask);
+	}
+}
+
+/// Get the hook mask the profilers need.
+int Context::GetProfilerMask() {
+	scoped_lock lock(m_mutex);
+	int mask = 0;
+
+	// The profiler samples the stacks on the count hook.
+	if (m_profiler.IsRunning()) {
+		mask |= LUA_MASKCOUNT;
+	}
+
+	// The function profiler needs all calls and returns.
+	if (m_funcProfiler.IsRunning()) {
+		mask |= LUA_MASKCALL | LUA_MASKRET;
+	}
+
+	// The call tracer needs all calls and returns.
+	if (m_tracer.IsRunning()) {
+		mask |= LUA_MASKCALL | LUA_MASKRET;
+	}
+
+	// The allocation profiler needs the current activation.
+	if (m_allocProfiler.IsRunning()) {
+		mask |= LUA_MASKCALL | LUA_MASKRET;
+	}
+
+	// The coverage needs the activations.
+	if (m_coverage.IsRunning()) {
+		mask |= LUA_MASKCALL | LUA_MASKRET;
+	}
+
+	// The GC monitor observes the heap size on the count hook.
+	// (the threshold is checked only with the frame)
+	if (m_gcMonitor.IsRunning()
+		|| (m_hookMask != 0 && m_gcMonitor.IsArmed())) {
+		mask |= LUA_MASKCOUNT;
+	}
+
+	return mask;
+}
+
+/// Capture the stacks of all the resuming coroutines.
+void Context::SampleStacks(lua_State *L) {
+	scoped_lock lock(m_mutex);
+
+	m_profiler.BeginSample();
+
+	const CoroutineList &coroutines = GetThread(L).coroutines;
+	CoroutineList::const_iterator it;
+	for (it = coroutines.begin(); it != coroutines.end(); ++it) {
+		m_profiler.AddStack(it->L);
+	}
+
+	// 'L' may be resumed without 'coroutine.resume'.
+	if (coroutines.empty() || coroutines.back().L != L) {
+		m_profiler.AddStack(L);
+	}
+
+	m_profiler.EndSample();
+}
+
+int Context::StartProfile(int interval) {
+	scoped_lock lock(m_mutex);
+
+	if (m_profiler.Start(interval) != 0) {
+		return -1;
+	}
+
+	ApplyHookMasks();
+	return 0;
+}
+
+std::string Context::StopProfile() {
+	scoped_lock lock(m_mutex);
+
+	m_profiler.Stop();
+	UpdateHookMask();
+	std::string result = m_profiler.GetFoldedStacks();
+	m_profiler.Clear();
+	return result;
+}
+
+void Context::StartFuncProfile() {
+	scoped_lock lock(m_mutex);
+
+	m_funcProfiler.Clear();
+	m_funcProfiler.Start();
+	ApplyHookMasks();
+}
+
+void Context::StopFuncProfile() {
+	scoped_lock lock(m_mutex);
+
+	m_funcProfiler.Stop(GetThreadId());
+	UpdateHookMask();
+}
+
+LuaFuncProfileList Context::GetFuncProfile() {
+	scoped_lock lock(m_mutex);
+
+	return m_funcProfiler.GetRecords(GetThreadId());
+}
+
+void Context::StartCoverage(bool firstHitOnly) {
+	scoped_lock lock(m_mutex);
+
+	m_coverage.Clear();
+	m_coverage.Start(firstHitOnly);
+
+	// The running activations need the line hook again. (see RefreshHook)
+	ApplyHookMasks();
+}
+
+void Context::StopCoverage() {
+	scoped_lock lock(m_mutex);
+
+	m_coverage.Stop();
+	ApplyHookMasks();
+}
+
+int Context::StartAllocProfile() {
+	scoped_lock lock(m_mutex);
+
+	if (!m_allocProfiler.IsWrapped()) {
+		return -1;
+	}
+
+	m_allocProfiler.Clear();
+	m_allocProfiler.Start();
+
+	// The activations that weren't hooked are forgotten. (see ApplyHookMask)
+	ApplyHookMasks();
+	return 0;
+}
+
+void Context::StopAllocProfile() {
+	scoped_lock lock(m_mutex);
+
+	m_allocProfiler.Stop();
+	ApplyHookMasks();
+}
+
+/// Compare the live bytes of the allocation records.
+struct LiveBytesGreater {
+	bool operator()(const LuaAllocProfile &x, const LuaAllocProfile &y) const {
+		return (x.GetLiveBytes() > y.GetLiveBytes());
+	}
+};
+
+LuaAllocProfileList Context::GetAllocProfile() {
+	scoped_lock lock(m_mutex);
+
+	// The sites have only the source ids.
+	std::map<int, Source> sourceMap;
+	std::list<Source> sources = m_sourceManager.GetList();
+	std::list<Source>::const_iterator sit;
+	for (sit = sources.begin(); sit != sources.end(); ++sit) {
+		sourceMap.insert(std::make_pair(m_sourceManager.GetId(sit->GetKey()), *sit));
+	}
+
+	LuaAllocProfileList result;
+	const AllocationProfiler::SiteList &sites = m_allocProfiler.GetSites();
+	AllocationProfiler::SiteList::const_iterator it;
+	for (it = sites.begin(); it != sites.end(); ++it) {
+		std::string key, title = "?";
+		std::map<int, Source>::const_iterator found = sourceMap.find(it->sourceId);
+		if (found != sourceMap.end()) {
+			const Source &source = found->second;
+			key = source.GetKey();
+			title = (source.GetPath().empty() ? source.GetTitle() : source.GetPath());
+		}
+
+		result.push_back(LuaAllocProfile(key, title, it->line,
+			it->allocs, it->frees, it->allocBytes, it->freeBytes));
+	}
+
+	std::sort(result.begin(), result.end(), LiveBytesGreater());
+	return result;
+}
+
+int Context::SaveHeapSnapshot(const std::string &filename) {
+	lua_State *L = GetLua();
+	scoped_lua scoped(this, L);
+
+	safe_ofstream ofs;
+	if (!ofs.open(filename, std::ios::out | std::ios::binary)) {
+		return -1;
+	}
+
+	HeapSnapshotWriter writer(ofs.stream());
+	HeapWalker walker(L, writer);
+
+	lua_pushvalue(L, LUA_REGISTRYINDEX);
+	walker.AddRoot(-1, "(registry)");
+	lua_pop(L, 1);
+
+	lua_pushvalue(L, LUA_GLOBALSINDEX);
+	walker.AddRoot(-1, "_G");
+	lua_pop(L, 1);
+
+	// The coroutines this thread resumes, the others are reachable
+	// from them. (the stacks of the other threads may be changing)
+	ThreadInfo &thread = GetThread(L);
+	for (CoroutineList::size_type i = 0; i < thread.coroutines.size(); ++i) {
+		lua_State *co = thread.coroutines[i].L;
+		std::stringstream name;
+		name << "(coroutine " << i << ")";
+
+		lua_checkstack(co, 1);
+		lua_pushthread(co);
+		if (co != L) {
+			lua_xmove(co, L, 1);
+		}
+		walker.AddRoot(-1, name.str());
+		lua_pop(L, 1);
+	}
+
+	walker.Walk();
+	ofs.commit();
+	return 0;
+}
+
+void Context::OnThreadFreed(lua_State *L) {
+	scoped_lock lock(m_mutex);
+
+	m_funcProfiler.OnThreadFreed(L);
+	m_schedProfiler.OnThreadFreed(L);
+	m_tracer.OnThreadFreed(L);
+}
+
+void Context::StartSchedProfile() {
+	scoped_lock lock(m_mutex);
+
+	m_schedProfiler.Clear();
+	m_schedProfiler.Start();
+}
+
+void Context::StopSchedProfile() {
+	scoped_lock lock(m_mutex);
+
+	m_schedProfiler.Stop();
+}
+
+void Context::StartTrace(int bufferSize, const std::string &prefix) {
+	scoped_lock lock(m_mutex);
+
+	m_tracer.Start(bufferSize, prefix);
+	ApplyHookMasks();
+}
+
+void Context::StopTrace() {
+	scoped_lock lock(m_mutex);
+
+	m_tracer.Stop();
+	UpdateHookMask();
+}
+
+std::string Context::GetTrace() {
+	scoped_lock lock(m_mutex);
+
+	return m_tracer.GetTrace();
+}
+
+/// Compare the run time of the scheduler records.
+struct RunTimeGreater {
+	bool operator()(const LuaSchedProfile &x, const LuaSchedProfile &y) const {
+		return (x.GetRunTime() > y.GetRunTime());
+	}
+};
+
+LuaSchedProfileList Context::GetSchedProfile() {
+	scoped_lock lock(m_mutex);
+	const double NSEC = 1000.0 * 1000.0 * 1000.0;
+
+	LuaSchedProfileList result;
+	const SchedulerProfiler::SiteList &sites = m_schedProfiler.GetSites();
+	SchedulerProfiler::SiteList::const_iterator it;
+	for (it = sites.begin(); it != sites.end(); ++it) {
+		std::string key, title = "?";
+		if (it->site == SchedulerProfiler::OVERFLOW_SITE) {
+			title = "(other)";
+		}
+		else if (it->site >= 0) {
+			key = m_threadSites[it->site];
+			const Source *source = m_sourceManager.Get(key);
+			title = (source != NULL ? source->GetTitle() : key);
+		}
+
+		result.push_back(LuaSchedProfile(key, title, it->line,
+			it->coroutines, it->resumes, it->yields,
+			it->runTime / NSEC, it->maxRunTime / NSEC,
+			it->waitTime / NSEC, it->maxWaitTime / NSEC));
+	}
+
+	std::sort(result.begin(), result.end(), RunTimeGreater());
+	return result;
+}
+
+int Context::StartGcMonitor(int interval, const std::string &filename) {
+	scoped_lock lock(m_mutex);
+
+	if (m_gcMonitor.Start(interval, filename) != 0) {
+		return -1;
+	}
+
+	ApplyHookMasks();
+	return 0;
+}
+
+void Context::StopGcMonitor() {
+	scoped_lock lock(m_mutex);
+
+	m_gcMonitor.Stop();
+	UpdateHookMask();
+}
+
+void Context::SetGcThreshold(int kbytes) {
+	scoped_lock lock(m_mutex);
+
+	m_gcMonitor.SetThreshold(kbytes > 0 ? kbytes : 0);
+	ApplyHookMasks();
+}
+
+void Context::SetDebugFilter(DebugFilterType type, const std::string &pattern) {
+	scoped_lock lock(m_mutex);
+
+	m_debugFilter = type;
+	m_debugPattern = pattern;
+	++m_filterSerial;
+
+	// The resuming coroutines check the new filter in their next hook.
+	ApplyHookMasks();
+	RecheckDebugTargets();
+}
+
+/// Does the coroutine pass the debug filter ?
+bool Context::IsDebugTarget(int site, int tag, bool isMarked) {
+	scoped_lock lock(m_mutex);
+
+	switch (m_debugFilter) {
+	case DEBUGFILTER_ALL:
+		return true;
+	case DEBUGFILTER_MARKED:
+		return isMarked;
+	case DEBUGFILTER_SITE:
+		return (isMarked || (site >= 0
+			&& m_threadSites[site].find(m_debugPattern) != std::string::npos));
+	case DEBUGFILTER_TAG:
+		return (isMarked || (tag >= 0 && m_threadTags[tag] == m_debugPattern));
+	}
+
+	return true;
+}
+
+/// The mark or the tag of the coroutine was changed.
+/**
+ * If the current OS thread resumes it, the hook is applied now.
+ */
+void Context::RefreshDebugTarget(lua_State *L1, int site, int tag,
+								 bool isMarked) {
+	scoped_lock lock(m_mutex);
+
+	ThreadInfo &thread = GetThread(NULL);
+	RefreshHook(thread);
+
+	CoroutineList::iterator it;
+	for (it = thread.coroutines.begin(); it != thread.coroutines.end(); ++it) {
+		if (it->L == L1) {
+			it->isDebugged = IsDebugTarget(site, tag, isMarked);
+			it->filterSerial = m_filterSerial;
+			ApplyHookMask(thread, *it);
+		}
+	}
+}
+
+/// Sample the heap size, and break if it exceeds the threshold.
+void Context::CheckGc(lua_State *L) {
+	scoped_lock lock(m_mutex);
+
+	std::size_t bytes = (std::size_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024
+		+ lua_gc(L, LUA_GCCOUNTB, 0);
+
+	if (m_gcMonitor.IsRunning()) {
+		if (m_gcMonitor.IsTicked()) {
+			LuaGcSample sample = m_gcMonitor.TakeSample(bytes);
+			if (m_hookMask != 0) {
+				m_engine->SendChangedGcStats(sample);
+			}
+		}
+		else {
+			m_gcMonitor.OnCount(bytes);
+		}
+	}
+
+	// The state becomes BREAK, and it breaks at the next line.
+	if (m_hookMask != 0 && m_gcMonitor.IsExceeded(bytes)) {
+		std::stringstream stream;
+		stream << "The heap (" << bytes / 1024 << " KB) exceeded "
+			<< m_gcMonitor.GetThreshold() << " KB.";
+
+		m_gcMonitor.SetThreshold(0);
+		UpdateHookMask();
+		OutputLog(LOGTYPE_WARNING, stream.str());
+		SetDebugState(GetThread(L), DEBUGSTATE_BREAK);
+	}
+}
+
+/// Get the timeline of the function profiler the thread records 'L' into,
+/// or NULL.
+FunctionProfiler::Timeline *Context::GetFuncTimeline(ThreadInfo &thread,
+													 lua_State *L) {
+	FunctionProfiler::Timeline *timeline = thread.funcTimeline.get();
+	if (timeline != NULL && m_funcProfiler.IsCurrent(*timeline, L)) {
+		return timeline;
+	}
+
+	// The thread switched to another lua_State, or the profiler restarted.
+	scoped_lock lock(m_mutex);
+	if (!m_funcProfiler.IsRunning()) {
+		return NULL;
+	}
+
+	// The timeline of the old session is kept until the thread makes the new one.
+	if (timeline == NULL || timeline->session != m_funcProfiler.GetSession()) {
+		thread.funcTimeline = m_funcProfiler.NewTimeline(thread.id);
+		timeline = thread.funcTimeline.get();
+	}
+
+	m_funcProfiler.SetCurrent(*timeline, L);
+	return timeline;
+}
+
+/// Get the ring of the call tracer the thread records 'L' into, or NULL.
+CallTracer::Ring *Context::GetTraceRing(ThreadInfo &thread, lua_State *L) {
+	CallTracer::Ring *ring = thread.traceRing.get();
+	if (ring != NULL && m_tracer.IsCurrent(*ring, L)) {
+		return ring;
+	}
+
+	// The thread switched to another lua_State, or the tracer restarted.
+	scoped_lock lock(m_mutex);
+	if (!m_tracer.IsRunning()) {
+		return NULL;
+	}
+
+	// The ring of the old session is kept until the thread makes the new one.
+	if (ring == NULL || ring->session != m_tracer.GetSession()) {
+		thread.traceRing = m_tracer.NewRing(thread.id);
+		ring = thread.traceRing.get();
+	}
+
+	m_tracer.SetCurrent(*ring, L);
+	return ring;
+}
+
+SourceCoverageList Context::GetCoverage() {
+	scoped_lock lock(m_mutex);
+	SourceCoverageList result;
+
+	std::list<Source> sources = m_sourceManager.GetList();
+	std::list<Source>::const_iterator it;
+	for (it = sources.begin(); it != sources.end(); ++it) {
+		std::vector<int> hits;
+		int id = m_sourceManager.GetId(it->GetKey());
+		if (!m_coverage.GetHits(id, hits)) {
+			continue;
+		}
+
+		// The string source has no path, so use the title.
+		const std::string &path =
+			(it->GetPath().empty() ? it->GetTitle() : it->GetPath());
+		result.push_back(SourceCoverage(it->GetKey(), path, hits));
+	}
+
+	return result;
+}
+
+/// Apply the hook mask of the profilers to the resuming coroutines now.
+/**
+ * The profilers need it, because the hook may not be called.
+ * Each thread decides its own mask in the next hook event.
+ */
+void Context::ApplyHookMasks() {
+	scoped_lock lock(m_mutex);
+
+	UpdateHookMask();
+	int mask = GetProfilerMask();
+
+	ThreadMap::const_iterator thread;
+	for (thread = m_threads.begin(); thread != m_threads.end(); ++thread) {
+		scoped_lock chainLock(thread->second->chainMutex);
+		const CoroutineList &coroutines = thread->second->coroutines;
+		CoroutineList::const_iterator it;
+		for (it = coroutines.begin(); it != coroutines.end(); ++it) {
+			int oldMask = lua_gethookmask(it->L);
+			if ((oldMask & mask) != mask) {
+				SetHook(it->L, oldMask | mask);
+			}
+		}
+	}
+}
+
+/// Make the resuming coroutines check the new debug filter soon.
+/**
+ * The coroutine out of the old filter may run without any hook,
+ * so the count hook is set until its thread checks the filter.
+ * The other thread's lua_State is only hooked, it isn't read here.
+ */
+void Context::RecheckDebugTargets() {
+	scoped_lock lock(m_mutex);
+
+	if (m_hookMask == 0) {
+		return;
+	}
+
+	ThreadMap::const_iterator thread;
+	for (thread = m_threads.begin(); thread != m_threads.end(); ++thread) {
+		scoped_lock chainLock(thread->second->chainMutex);
+		const CoroutineList &coroutines = thread->second->coroutines;
+		CoroutineList::const_iterator it;
+		for (it = coroutines.begin(); it != coroutines.end(); ++it) {
+			int oldMask = lua_gethookmask(it->L);
+			if ((oldMask & LUA_MASKCOUNT) == 0) {
+				SetHook(it->L, oldMask | LUA_MASKCOUNT);
+			}
+		}
+	}
+}
+
+/// Make the info of the function activation called now.
+/**
+ * The source id is saved to check breakpoints fast on the line event.
+ * While running, only the functions that contain any breakpoints
+ * need the line hook. The others run without line events.
+ * The breakpoints are checked in the snapshot of the hook settings,
+ * so the lock is taken only for the coverage.
+ */
+Context::ActivationInfo Context::MakeActivationInfo(ThreadInfo &thread,
+													lua_State *L,
+													lua_Debug *ar,
+													int call,
+													DebugState state) {
+	lua_getinfo(L, "S", ar);
+	if (*ar->what == 'C') {
+		// C function has no lines.
+		return ActivationInfo(call, -1, false);
+	}
+
+	// The new source id may come with the new snapshot.
+	int sourceId = GetSourceId(thread, L, ar->source);
+	RefreshHook(thread);
+	const HookSettings &hook = thread.hook;
+
+	bool needsCoverage = false;
+	if (hook.isCovering) {
+		scoped_lock lock(m_mutex);
+
+		// The coverage needs the sources not loaded by lldebug too.
+		if (sourceId < 0 && m_coverage.IsRunning() && *ar->source != '='
+			&& !m_coverage.IsUnknownSource(ar->source)) {
+			const char *src = (*ar->source == '@' ? ar->source + 1 : ar->source);
+			if (AddSource(ar->source, src) == 0) {
+				sourceId = GetSourceId(thread, L, ar->source);
+			}
+			if (sourceId < 0) {
+				m_coverage.AddUnknownSource(ar->source);
+			}
+		}
+
+		needsCoverage =
+			(m_coverage.IsRunning() && m_coverage.OnCall(L, ar, sourceId));
+	}
+
+	// The breakpoints set later are checked with the last line.
+	int lastLineDefined = -1;
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM >= 501
+	if (*ar->what == 'L') {
+		lastLineDefined = ar->lastlinedefined;
+	}
+#endif
+
+	// Without the frame, only the coverage needs the line hook.
+	// Stepping needs all lines, and so do the main chunk and the tail call.
+	// The source without any id has no breakpoints.
+	bool needsLine = true;
+	if (hook.frameMask == 0) {
+		needsLine = needsCoverage;
+	}
+	else if (state == DEBUGSTATE_RUNNING && lastLineDefined >= 0) {
+		// The line number of breakpoints starts from 0.
+		needsLine = (needsCoverage
+			|| (hook.breakpoints != NULL
+				&& hook.breakpoints->Contains(sourceId,
+					ar->linedefined - 1, lastLineDefined - 1)));
+	}
+
+	return ActivationInfo(call, sourceId, needsLine, ar->linedefined,
+		lastLineDefined, ar->source);
+}
+
+/// Get the id of the source string of the running function, or -1.
+/**
+ * The source strings are interned by lua, so each thread caches the ids
+ * by their addresses, and the call and the line events do no string work.
+ * The source that has an id is anchored in the registry once, so its
+ * address isn't reused by another source. The caches are checked again
+ * when the sources or the breakpoints are changed, and the source that has
+ * any breakpoint gets the id here. -1 means it has no breakpoints.
+ * If 'L' is NULL, the id that isn't anchored yet isn't cached.
+ */
+int Context::GetSourceId(ThreadInfo &thread, lua_State *L,
+						 const char *source) {
+	std::size_t address = reinterpret_cast<std::size_t>(source);
+	SourceCacheEntry *set = thread.sourceCache[
+		((address >> 4) ^ (address >> 10)) & (SOURCE_CACHE_SETS - 1)];
+
+	// The hit entry moves to the first, and a new one drops the last.
+	int way = 0;
+	while (way < SOURCE_CACHE_WAYS - 1 && set[way].source != source) {
+		++way;
+	}
+	if (set[way].source == source && set[way].generation == m_sourceGeneration) {
+		SourceCacheEntry hit = set[way];
+		std::copy_backward(set, set + way, set + way + 1);
+		set[0] = hit;
+		return hit.id;
+	}
+
+	scoped_lock lock(m_mutex);
+	int id = m_sourceManager.GetId(source);
+
+	// The source loaded without lldebug (e.g. by 'require').
+	if (id < 0 && m_breakpoints.First(source).IsOk()) {
+		const char *src = (*source == '@' ? source + 1 : source);
+		if (*source == '=' || AddSource(source, src) != 0) {
+			// The source can't be opened, only the id is made.
+			m_sourceManager.Intern(source);
+			UpdateBreakpoints();
+		}
+		id = m_sourceManager.GetId(source);
+	}
+
+	if (id >= 0 && !m_sourceManager.IsAnchored(id)) {
+		if (L == NULL) {
+			return id;
+		}
+
+		// registry[address][source] = true
+		lua_checkstack(L, 3);
+		lua_pushlightuserdata(L, (void *)&llutil_address_for_source_table);
+		lua_rawget(L, LUA_REGISTRYINDEX);
+		if (!lua_istable(L, -1)) {
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_pushlightuserdata(L, (void *)&llutil_address_for_source_table);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, LUA_REGISTRYINDEX);
+		}
+		lua_pushstring(L, source);
+		lua_pushboolean(L, 1);
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
+		m_sourceManager.SetAnchored(id);
+	}
+
+	std::copy_backward(set, set + way, set + way + 1);
+	set[0].source = source;
+	set[0].id = id;
+	set[0].generation = m_sourceGeneration;
+	return id;
+}
+
+/// Add the source, and index the breakpoints in it.
+int Context::AddSource(const std::string &key, const std::string &src) {
+	scoped_lock lock(m_mutex);
+
+	if (m_sourceManager.Add(key, src) != 0) {
+		return -1;
+	}
+
+	UpdateBreakpoints();
+	return 0;
+}
+
+/// Rebuild the index of the breakpoints by the source ids.
+/**
+ * The source ids the threads cached are checked again, and the threads
+ * take the new snapshot of the breakpoints with their hook settings.
+ */
+void Context::UpdateBreakpoints() {
+	scoped_lock lock(m_mutex);
+
+	m_breakpoints.UpdateIndex(m_sourceManager);
+	m_breakpointSnapshot.reset(new BreakpointList(m_breakpoints));
+	++m_sourceGeneration;
+	UpdateHookMask();
+}
+
+void Context::s_HookCallback(lua_State *L, lua_Debug *ar) {
+	if (ms_manager == NULL) {
+		return;
+	}
+
+	// Don't copy shared_ptr here, it's the hottest path.
+	// The context is pinned instead, so it isn't deleted while it's used.
+	Context *outer;
+	Context *ctx = ms_manager->Pin(L, outer);
+	if (ctx == NULL) {
+		return;
+	}
+
+	int result = ctx->HookCallback(L, ar);
+	ContextManager::Unpin(outer);
+
+	// The error jumps out of the hook, so it's raised after unpinning.
+	if (result != 0) {
+		luaL_error(L, "");
+	}
+}
+
+/// Set the state of the selected thread.
+/**
+ * The thread applies the new state in its next hook.
+ */
+void Context::SetDebugState(DebugState state) {
+	scoped_lock lock(m_mutex);
+
+	ThreadInfo *thread = FindThread(m_selectedThread);
+	if (thread != NULL) {
+		SetDebugState(*thread, state);
+	}
+}
+
+void Context::SetDebugState(ThreadInfo &thread, DebugState state) {
+	scoped_lock lock(m_mutex);
+
+	if (state == thread.debugState) {
+		return;
+	}
+
+	// The posted logs must reach the frame before breaking.
+	if (state == DEBUGSTATE_BREAK) {
+		m_engine->FlushOutputLogs();
+
+		// The frame shows the hit counts at the break.
+		if (m_coverage.IsRunning()) {
+			m_engine->SendChangedCoverage(GetCoverage());
+		}
+	}
+
+	DebugState prevState = thread.debugState;
+	switch (thread.debugState) {
+	case DEBUGSTATE_INITIAL:
+		break;
+	case DEBUGSTATE_RUNNING:
+		switch (state) {
+		case DEBUGSTATE_BREAK:
+			thread.debugState = state;
+			break;
+		case DEBUGSTATE_STEPOVER:
+		case DEBUGSTATE_STEPINTO:
+		case DEBUGSTATE_STEPRETURN:
+			/* ignore */
+			break;
 		default:
 			/* error */
 			assert(false && "Value of 'state' is illegal.");
@@ -705,14 +2370,10 @@ void Context::SetDebugState(DebugState state) {
 		}
 		switch (state) {
 		case DEBUGSTATE_RUNNING:
-			m_debugState = state;
-			m_engine->SendChangedState(false);
-			break;
 		case DEBUGSTATE_STEPOVER:
 		case DEBUGSTATE_STEPINTO:
 		case DEBUGSTATE_STEPRETURN:
-			m_debugState = state;
-			m_engine->SendChangedState(false);
+			thread.debugState = state;
 			break;
 		default:
 			/* error */
@@ -731,8 +2392,7 @@ void Context::SetDebugState(DebugState state) {
 			/* ignore */
 			break;
 		case DEBUGSTATE_BREAK:
-			m_engine->SendChangedState(true);
-			m_debugState = state;
+			thread.debugState = state;
 			break;
 		default:
 			/* error */
@@ -742,11 +2402,91 @@ void Context::SetDebugState(DebugState state) {
 		break;
 	}
 
-	// Set stepinfo that has lua_State* and call count.
-	if (m_debugState == DEBUGSTATE_STEPOVER
-		|| m_debugState == DEBUGSTATE_STEPRETURN) {
-		m_stepinfo = m_coroutines.back();
+	bool wasBreak = (prevState == DEBUGSTATE_BREAK);
+	bool isBreak = (thread.debugState == DEBUGSTATE_BREAK);
+	if (isBreak != wasBreak) {
+		// The frame shows the first thread that breaks,
+		// the others wait until they are selected.
+		if (isBreak) {
+			ThreadInfo *selected = FindThread(m_selectedThread);
+			if (selected == NULL
+				|| selected->debugState != DEBUGSTATE_BREAK) {
+				m_selectedThread = thread.id;
+			}
+		}
+
+		if (thread.id == m_selectedThread) {
+			m_engine->SendChangedState(isBreak);
+		}
+		SendThreadList();
+
+		// The break loop of the thread checks the new state.
+		m_commandCond.notify_all();
+	}
+
+	// 'stepinfo' is set by the thread itself. (see RefreshHook)
+	UpdateHookMask(thread);
+}
+
+/// Is the breakpoint of the line hit ?
+/**
+ * The breakpoint is found by the source id of the running function.
+ * (the source that has any breakpoint always has the id)
+ * The lock is held only to find the breakpoint, the condition
+ * is evaluated without it.
+ */
+bool Context::IsBreakpointHit(lua_State *L, lua_Debug *ar, int sourceId) {
+	Breakpoint bp;
+	{
+		scoped_lock lock(m_mutex);
+		bp = m_breakpoints.Find(sourceId, ar->currentline - 1);
+	}
+	if (!bp.IsOk()) {
+		return false;
+	}
+
+	// The condition is evaluated in the running function.
+	if (bp.HasCondition()) {
+		std::string error;
+		int ret = LuaEvalCondition(L, 0, bp.GetCondition(), error);
+		if (ret < 0 && bp.IsLogpoint()) {
+			// Don't stop, but warn it.
+			OutputLogpoint(LogData(LOGTYPE_WARNING,
+				ParseLuaError(error).message, bp.GetKey(), bp.GetLine() + 1));
+			return false;
+		}
+		else if (ret < 0) {
+			// Break to let the user fix the condition.
+			OutputLog(LOGTYPE_ERROR,
+				"Error in the breakpoint condition: " + ParseLuaError(error).message,
+				bp.GetKey(), bp.GetLine() + 1);
+			return true;
+		}
+		else if (ret == 0) {
+			return false;
+		}
+	}
+
+	if (bp.HasHitCondition()) {
+		scoped_lock lock(m_mutex);
+		if (!bp.IsBreakHit(m_breakpoints.Hit(bp))) {
+			return false;
+		}
+	}
+
+	// The logpoint outputs the message and never stops.
+	if (bp.IsLogpoint()) {
+		std::string msg;
+		LogType type = LOGTYPE_MESSAGE;
+		if (LuaFormatLogpoint(L, 0, bp.GetLogMessage(), msg) != 0) {
+			type = LOGTYPE_WARNING;
+		}
+
+		OutputLogpoint(LogData(type, msg, bp.GetKey(), bp.GetLine() + 1));
+		return false;
 	}
+
+	return true;
 }
 
 /**
@@ -765,13 +2505,74 @@ struct UpdateResponseWaiter {
 	int *m_count;
 	};
 
-void Context::HookCallback(lua_State *L, lua_Debug *ar) {
-	if (!m_isEnabled) {
-		return;
+/// The hook of the context.
+/**
+ * It returns -1 to stop the lua by an error, 's_HookCallback' raises it.
+ */
+int Context::HookCallback(lua_State *L, lua_Debug *ar) {
+	// Each OS thread has its own state, it's made at the first hook.
+	// (the hooks of the threads take the lock only for the shared data)
+	ThreadInfo &thread = GetThread(L);
+	if (!thread.isEnabled) {
+		return 0;
 	}
 
-	scoped_lock lock(m_mutex);
-	assert(m_debugState != DEBUGSTATE_INITIAL && "Not initialized !!!");
+	RefreshHook(thread);
+	const HookSettings &hook = thread.hook;
+
+	// Sample the stacks once per tick of the profiler's timer.
+	if (hook.isSampling) {
+		long ticks = m_profiler.GetTicks();
+		if (ticks != thread.sampledTicks) {
+			thread.sampledTicks = ticks;
+			SampleStacks(L);
+		}
+	}
+
+	// The function profiler records into the timeline of the thread.
+	if (hook.isProfiling && ar->event != LUA_HOOKLINE
+		&& ar->event != LUA_HOOKCOUNT) {
+		FunctionProfiler::Timeline *timeline = GetFuncTimeline(thread, L);
+		if (timeline != NULL) {
+			m_funcProfiler.OnHook(*timeline, L, ar);
+		}
+	}
+
+	// The tracer records into the ring of the thread.
+	if (hook.isTracing && ar->event != LUA_HOOKLINE
+		&& ar->event != LUA_HOOKCOUNT) {
+		CallTracer::Ring *ring = GetTraceRing(thread, L);
+		if (ring != NULL) {
+			m_tracer.OnHook(*ring, L, ar);
+		}
+	}
+
+	// Observe the heap size, only the count event needs the lock.
+	if (hook.isWatchingGc && ar->event == LUA_HOOKCOUNT) {
+		CheckGc(L);
+	}
+
+	// The GC monitor may break.
+	RefreshHook(thread);
+
+	// The debug filter was changed after the coroutine was resumed.
+	CoroutineInfo *current = &thread.coroutines.back();
+	if (current->filterSerial != hook.filterSerial) {
+		UpdateDebugTarget(thread, *current);
+	}
+
+	// Without the frame or out of the debug filter,
+	// only the profilers use the hook.
+	bool isDebugging = (hook.frameMask != 0 && current->isDebugged);
+	if (!isDebugging && !hook.isCovering && !hook.isAllocating) {
+		// The activations aren't tracked meanwhile.
+		current->activations.clear();
+		ApplyHookMask(thread, *current);
+		return 0;
+	}
+
+	assert((hook.frameMask == 0 || hook.state != DEBUGSTATE_INITIAL)
+		&& "Not initialized !!!");
 
 #if 0
 	{
@@ -793,35 +2594,92 @@ void Context::HookCallback(lua_State *L, lua_Debug *ar) {
 	}
 #endif
 
+	// Only poll the pending commands (e.g. BREAK) on the count event.
+	if (isDebugging && ar->event == LUA_HOOKCOUNT) {
+		if (HandleCommand(&thread) != 0 || !m_engine->IsConnecting()) {
+			thread.isCallSuccess = true;
+			return -1;
+		}
+		RefreshHook(thread);
+
+		// The commands may resume the coroutines.
+		current = &thread.coroutines.back();
+	}
+
 	switch (ar->event) {
 	case LUA_HOOKCALL:
-		++m_coroutines.back().call;
-		return;
+		++current->call;
+		current->activations.push_back(
+			MakeActivationInfo(thread, L, ar, current->call, hook.state));
+		break;
 	case LUA_HOOKRET:
 	case LUA_HOOKTAILRET:
-		if (m_debugState == DEBUGSTATE_STEPRETURN) {
-			const CoroutineInfo &info = m_coroutines.back();
-			if (m_stepinfo.L == info.L  && info.call <= m_stepinfo.call) {
-				SetDebugState(DEBUGSTATE_BREAK);
+		if (hook.state == DEBUGSTATE_STEPRETURN) {
+			const CoroutineInfo &step = thread.stepinfo;
+			if (step.L == current->L  && current->call <= step.call) {
+				SetDebugState(thread, DEBUGSTATE_BREAK);
+				RefreshHook(thread);
 			}
 		}
-		--m_coroutines.back().call;
-		return;
+
+		// Eliminate the returning activation.
+		while (!current->activations.empty()
+			&& current->activations.back().call >= current->call) {
+			current->activations.pop_back();
+		}
+		--current->call;
+		break;
 	default:
 		break;
 	}
 
+	// Apply the hook mask, if it was changed.
+	ApplyHookMask(thread, *current);
+
+	if (ar->event != LUA_HOOKLINE) {
+		return 0;
+	}
+
+	// The source id is resolved only if the activation is unknown.
+	const ActivationInfo *activation = current->GetActivation();
+	int sourceId;
+	if (activation != NULL) {
+		sourceId = activation->sourceId;
+	}
+	else {
+		lua_getinfo(L, "S", ar);
+		sourceId = GetSourceId(thread, L, ar->source);
+	}
+
+	// Count the line, and stop the line hook of the covered function.
+	if (hook.isCovering) {
+		scoped_lock lock(m_mutex);
+
+		if (m_coverage.OnLine(sourceId, ar->currentline)
+			&& activation != NULL && sourceId >= 0) {
+			ActivationInfo &last = current->activations.back();
+			last = MakeActivationInfo(thread, L, ar, last.call, hook.state);
+			ApplyHookMask(thread, *current);
+		}
+	}
+
+	// Without the frame or out of the debug filter,
+	// only the coverage uses the line event.
+	if (!isDebugging) {
+		return 0;
+	}
+
 	// Stop running if need.
-	switch (m_debugState) {
+	switch (hook.state) {
 	case DEBUGSTATE_STEPOVER: {
-		const CoroutineInfo &info = m_coroutines.back();
-		if (m_stepinfo.L == info.L  && info.call <= m_stepinfo.call) {
-			SetDebugState(DEBUGSTATE_BREAK);
+		const CoroutineInfo &step = thread.stepinfo;
+		if (step.L == current->L  && current->call <= step.call) {
+			SetDebugState(thread, DEBUGSTATE_BREAK);
 		}
 		}
 		break;
 	case DEBUGSTATE_STEPINTO:
-		SetDebugState(DEBUGSTATE_BREAK);
+		SetDebugState(thread, DEBUGSTATE_BREAK);
 		break;
 	case DEBUGSTATE_INITIAL:
 	case DEBUGSTATE_RUNNING:
@@ -829,82 +2687,203 @@ void Context::HookCallback(lua_State *L, lua_Debug *ar) {
 	case DEBUGSTATE_BREAK:
 		break;
 	} 
-
-	// Get the infomation of the current function.
-	lua_getinfo(L, "nSl", ar);
+	RefreshHook(thread);
 
 	// Break and stop program, if any.
-	Breakpoint bp = m_breakpoints.Find(ar->source, ar->currentline - 1);
-	if (bp.IsOk()) {
-		SetDebugState(DEBUGSTATE_BREAK);
+	// (ar->currentline is already set, and breakpoint lines start from 0)
+	if (hook.state != DEBUGSTATE_BREAK) {
+		bool exists = (hook.breakpoints != NULL
+			&& hook.breakpoints->Exists(sourceId, ar->currentline - 1));
+
+		if (exists && IsBreakpointHit(L, ar, sourceId)) {
+			SetDebugState(thread, DEBUGSTATE_BREAK);
+			RefreshHook(thread);
+		}
 	}
 
 	// Update the frame.
-	DebugState prevState = DEBUGSTATE_RUNNING;
+	// (the lock is released while the commands inspect the lua)
+	bool isStopped = false;
 	for (;;) {
 		// handle event and message queue
-		if (HandleCommand() != 0 || !m_engine->IsConnecting()) {
-			m_isCallSuccess = true;
-			luaL_error(L, "");
-			return;
+		if (HandleCommand(&thread) != 0 || !m_engine->IsConnecting()) {
+			thread.isCallSuccess = true;
+			return -1;
 		}
 
 		// Break this loop if the state isn't STATE_BREAK.
-		if (m_debugState != DEBUGSTATE_BREAK) {
+		RefreshHook(thread);
+		if (hook.state != DEBUGSTATE_BREAK) {
 			break;
 		}
-		if (m_isMustUpdate || prevState != DEBUGSTATE_BREAK) {
+
+		if (!isStopped) {
+			// Get the infomation of the current function.
+			lua_getinfo(L, "nSl", ar);
+			scoped_lock lock(m_mutex);
+
 			if (m_sourceManager.Get(ar->source) == NULL) {
-				if (m_sourceManager.Add(ar->source, ar->short_src) != 0) {
+				if (AddSource(ar->source, ar->short_src) != 0) {
 					OutputLog(LOGTYPE_ERROR,
 						std::string("Couldn't open the '") + ar->short_src + "' file.");
 				}
 			}
-			m_isMustUpdate = false;
 
-			// If the state has been 'break', this update is only for refresh.
+			// The thread list shows where the thread stops.
+			thread.breakKey = ar->source;
+			thread.breakLine = ar->currentline;
+			isStopped = true;
+			SendThreadList();
+		}
+
+		// Only the selected thread is shown by the frame.
+		bool isUpdated = false, isShown = false;
+		{
+			scoped_lock lock(m_mutex);
+			isUpdated = (thread.id == m_selectedThread
+				&& (m_isMustUpdate || !thread.isShown));
+			isShown = thread.isShown;
+		}
+
+		if (isUpdated) {
+			// If the thread has been shown, this update is only for refresh.
+			// Otherwise the values of the new break are sent with it.
+			LuaBreakSnapshot snapshot =
+				(isShown ? LuaBreakSnapshot() : LuaGetBreakSnapshot());
+
+			scoped_lock lock(m_mutex);
+			m_isMustUpdate = false;
 			m_engine->SendUpdateSource(
-				ar->source, ar->currentline,
-				++m_updateCount, (prevState == DEBUGSTATE_BREAK),
+				thread.breakKey, thread.breakLine,
+				++m_updateCount, isShown, snapshot,
 				UpdateResponseWaiter(&m_waitUpdateCount));
+			thread.isShown = true;
 		}
-		prevState = m_debugState;
 
 		// Wait...
-		if (m_readCommands.empty()) {
+		// (the deferred commands are pending until the selected thread takes them)
+		scoped_lock lock(m_mutex);
+		if (thread.debugState == DEBUGSTATE_BREAK
+			&& (m_pendingCommands == 0
+				|| (!IsInspecting(&thread) && m_readCommands.empty()))) {
 			boost::xtime xt;
 			boost::xtime_get(&xt, boost::TIME_UTC);
 			xt.sec += 1;
 			m_commandCond.timed_wait(lock, xt);
 		}
 	}
+
+	scoped_lock lock(m_mutex);
+	thread.isShown = false;
+	return 0;
 }
 
+/// The coroutine 'L' is resumed by the calling thread.
+/**
+ * The chain of the coroutines is the state of the thread, so the lock
+ * of the context is taken only for the profilers that are running.
+ */
 void Context::BeginCoroutine(lua_State *L) {
-	scoped_lock lock(m_mutex);
+	ThreadInfo &thread = GetThread(NULL);
+	lua_State *from =
+		(thread.coroutines.empty() ? NULL : thread.coroutines.back().L);
+
+	// The coroutine may be created before the profilers started.
+	RefreshHook(thread);
+	const HookSettings &hook = thread.hook;
+
+	// The creation site is looked up only at the first resume.
+	if (hook.isScheduling) {
+		scoped_lock lock(m_mutex);
+
+		if (m_schedProfiler.IsRunning()) {
+			if (!m_schedProfiler.IsTracked(L)) {
+				int line;
+				int site = FindThreadSite(L, line);
+				m_schedProfiler.AddThread(L, site, line);
+			}
+			m_schedProfiler.OnResume(L, from);
+		}
+	}
 
 	CoroutineInfo info(L);
-	m_coroutines.push_back(info);
+	UpdateDebugTarget(thread, info);
+
+	// The one out of the debug filter drops the hook of the frame.
+	int mask = GetHookMask(thread, info);
+	int oldMask = lua_gethookmask(L);
+	if ((oldMask & mask) != mask || (!info.isDebugged && oldMask != mask)) {
+		SetHook(L, mask);
+	}
+	info.hookMask = lua_gethookmask(L);
+	{
+		scoped_lock chainLock(thread.chainMutex);
+		thread.coroutines.push_back(info);
+	}
+
+	if (hook.isProfiling) {
+		FunctionProfiler::Timeline *timeline = GetFuncTimeline(thread, L);
+		if (timeline != NULL) {
+			m_funcProfiler.OnResume(*timeline);
+		}
+	}
+
+	if (hook.isTracing) {
+		CallTracer::Ring *ring = GetTraceRing(thread, L);
+		if (ring != NULL) {
+			m_tracer.OnResume(*ring);
+		}
+	}
 }
 
+/// The coroutine 'L' yielded or finished.
 void Context::EndCoroutine(lua_State *L) {
-	scoped_lock lock(m_mutex);
-
-	if (m_coroutines.empty() || m_coroutines.back().L != L) {
+	ThreadInfo &thread = GetThread(NULL);
+	if (thread.coroutines.empty() || thread.coroutines.back().L != L) {
 		assert(0 && "Couldn't end coroutine.");
 		return;
 	}
 
+	RefreshHook(thread);
+	const HookSettings &hook = thread.hook;
+
 	// When it goes through the coroutine set break mark,
 	// we force to break.
-	if (m_debugState == DEBUGSTATE_STEPOVER
-		|| m_debugState == DEBUGSTATE_STEPRETURN) {
-		if (m_stepinfo.L == L) {
-			SetDebugState(DEBUGSTATE_BREAK);
+	if (hook.state == DEBUGSTATE_STEPOVER
+		|| hook.state == DEBUGSTATE_STEPRETURN) {
+		if (thread.stepinfo.L == L) {
+			SetDebugState(thread, DEBUGSTATE_BREAK);
+		}
+	}
+
+	{
+		scoped_lock chainLock(thread.chainMutex);
+		thread.coroutines.pop_back();
+	}
+	lua_State *from =
+		(thread.coroutines.empty() ? NULL : thread.coroutines.back().L);
+
+	if (hook.isScheduling) {
+		scoped_lock lock(m_mutex);
+
+		if (m_schedProfiler.IsRunning()) {
+			m_schedProfiler.OnYield(L, from, (lua_status(L) == LUA_YIELD));
+		}
+	}
+
+	if (hook.isProfiling) {
+		FunctionProfiler::Timeline *timeline = GetFuncTimeline(thread, L);
+		if (timeline != NULL) {
+			m_funcProfiler.OnYield(*timeline, L);
 		}
 	}
 
-	m_coroutines.pop_back();
+	if (hook.isTracing) {
+		CallTracer::Ring *ring = GetTraceRing(thread, L);
+		if (ring != NULL) {
+			m_tracer.OnYield(*ring);
+		}
+	}
 }
 
 /**
@@ -933,6 +2912,209 @@ public:
 		return 0;
 	}
 
+	/// The sentinel of a coroutine, it's finalized after the coroutine.
+	/** 'site' is the index of Context::m_threadSites, or -1 if unknown.
+	 */
+	/** 'tag' is the index of Context::m_threadTags, or -1 if it isn't tagged.
+	 */
+	struct ThreadSentinel {
+		lua_State *L;
+		unsigned long serial;
+		int site;
+		int line;
+		int tag;
+		bool isMarked; ///< lldebug.debug_this() was called
+	};
+
+	static int threadgc(lua_State *L) {
+		ThreadSentinel *sentinel =
+			static_cast<ThreadSentinel *>(lua_touserdata(L, 1));
+		if (sentinel == NULL || Context::ms_manager == NULL) {
+			return 0;
+		}
+
+		shared_ptr<Context> ctx =
+			Context::ms_manager->Evict(sentinel->L, sentinel->serial);
+		if (ctx != NULL) {
+			ctx->OnThreadFreed(sentinel->L);
+		}
+
+		return 0;
+	}
+
+	/// Watch the thread on the top of L, the stack isn't changed.
+	static void watchthread(lua_State *L, unsigned long serial,
+							int site, int line) {
+		lua_checkstack(L, 4);
+
+		// registry[address] = setmetatable({}, {__mode = "k"})
+		lua_pushlightuserdata(L, (void *)&llutil_address_for_thread_table);
+		lua_rawget(L, LUA_REGISTRYINDEX);
+		if (!lua_istable(L, -1)) {
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_newtable(L);
+			lua_pushliteral(L, "k");
+			lua_setfield(L, -2, "__mode");
+			lua_setmetatable(L, -2);
+			lua_pushlightuserdata(L, (void *)&llutil_address_for_thread_table);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, LUA_REGISTRYINDEX);
+		}
+
+		// table[thread] = sentinel
+		lua_pushvalue(L, -2);
+		ThreadSentinel *sentinel = static_cast<ThreadSentinel *>(
+			lua_newuserdata(L, sizeof(ThreadSentinel)));
+		sentinel->L = lua_tothread(L, -3);
+		sentinel->serial = serial;
+		sentinel->site = site;
+		sentinel->line = line;
+		sentinel->tag = -1;
+		sentinel->isMarked = false;
+		if (luaL_newmetatable(L, "lldebug.ThreadSentinel")) {
+			lua_pushcfunction(L, LuaImpl::threadgc);
+			lua_setfield(L, -2, "__gc");
+		}
+		lua_setmetatable(L, -2);
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
+
+		// index[address] = thread, the value is weak.
+		lua_pushlightuserdata(L, (void *)&llutil_address_for_thread_index);
+		lua_rawget(L, LUA_REGISTRYINDEX);
+		if (!lua_istable(L, -1)) {
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_newtable(L);
+			lua_pushliteral(L, "v");
+			lua_setfield(L, -2, "__mode");
+			lua_setmetatable(L, -2);
+			lua_pushlightuserdata(L, (void *)&llutil_address_for_thread_index);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, LUA_REGISTRYINDEX);
+		}
+
+		lua_pushlightuserdata(L, (void *)lua_tothread(L, -2));
+		lua_pushvalue(L, -3);
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
+	}
+
+	/// Push the thread 'L1' if it isn't collected, nothing is pushed if not.
+	static bool pushthread(lua_State *L, lua_State *L1) {
+		lua_checkstack(L, 2);
+
+		lua_pushlightuserdata(L, (void *)&llutil_address_for_thread_index);
+		lua_rawget(L, LUA_REGISTRYINDEX);
+		if (!lua_istable(L, -1)) {
+			lua_pop(L, 1);
+			return false;
+		}
+
+		lua_pushlightuserdata(L, (void *)L1);
+		lua_rawget(L, -2);
+		lua_remove(L, -2);
+		if (lua_tothread(L, -1) != L1) {
+			lua_pop(L, 1);
+			return false;
+		}
+
+		return true;
+	}
+
+	/// lldebug.threadcount(), the number of the tracked lua_States.
+	static int threadcount(lua_State *L) {
+		shared_ptr<Context> ctx = Context::Find(L);
+		if (ctx == NULL || Context::ms_manager == NULL) {
+			return 0;
+		}
+
+		lua_pushnumber(L,
+			(lua_Number)Context::ms_manager->GetThreadCount(ctx.get()));
+		return 1;
+	}
+
+	/// lldebug.pinmisses(), the number of the hooks on this OS thread
+	/// that missed the cache of the contexts.
+	static int pinmisses(lua_State *L) {
+		lua_pushnumber(L, (lua_Number)ContextManager::GetPinMisses());
+		return 1;
+	}
+
+	/// Get the sentinel of the thread at 'idx', or NULL if it isn't watched.
+	static ThreadSentinel *findsentinel(lua_State *L, int idx) {
+		ThreadSentinel *sentinel = NULL;
+		idx = (idx < 0 ? lua_gettop(L) + idx + 1 : idx);
+		lua_checkstack(L, 2);
+
+		lua_pushlightuserdata(L, (void *)&llutil_address_for_thread_table);
+		lua_rawget(L, LUA_REGISTRYINDEX);
+		if (lua_istable(L, -1)) {
+			lua_pushvalue(L, idx);
+			lua_rawget(L, -2);
+			sentinel = static_cast<ThreadSentinel *>(lua_touserdata(L, -1));
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+		return sentinel;
+	}
+
+	/// lldebug.debug_this([enable]), the running coroutine passes
+	/// the debug filter. It returns false for the main state.
+	static int debug_this(lua_State *L) {
+		shared_ptr<Context> ctx = Context::Find(L);
+		if (ctx == NULL) {
+			return 0;
+		}
+
+		bool isMarked = (lua_isnoneornil(L, 1) || lua_toboolean(L, 1));
+		lua_pushthread(L);
+		ThreadSentinel *sentinel = findsentinel(L, -1);
+		lua_pop(L, 1);
+		if (sentinel == NULL) {
+			lua_pushboolean(L, 0);
+			return 1;
+		}
+
+		sentinel->isMarked = isMarked;
+		ctx->RefreshDebugTarget(L, sentinel->site, sentinel->tag,
+			sentinel->isMarked);
+		lua_pushboolean(L, 1);
+		return 1;
+	}
+
+	/// lldebug.settag(tag [, co]), tag the coroutine for the debug filter.
+	/// The running one is tagged without 'co', and nil removes the tag.
+	static int settag(lua_State *L) {
+		shared_ptr<Context> ctx = Context::Find(L);
+		if (ctx == NULL) {
+			return 0;
+		}
+
+		const char *tag = luaL_optstring(L, 1, NULL);
+		if (lua_isnoneornil(L, 2)) {
+			lua_pushthread(L);
+		}
+		else {
+			luaL_checktype(L, 2, LUA_TTHREAD);
+			lua_pushvalue(L, 2);
+		}
+		lua_State *co = lua_tothread(L, -1);
+		ThreadSentinel *sentinel = findsentinel(L, -1);
+		lua_pop(L, 1);
+		if (sentinel == NULL) {
+			lua_pushboolean(L, 0);
+			return 1;
+		}
+
+		sentinel->tag = (tag != NULL ? ctx->MakeThreadTag(tag) : -1);
+		ctx->RefreshDebugTarget(co, sentinel->site, sentinel->tag,
+			sentinel->isMarked);
+		lua_pushboolean(L, 1);
+		return 1;
+	}
+
 	static int cocreate(lua_State *L) {
 		shared_ptr<Context> ctx = Context::Find(L);
 		if (ctx == NULL) {
@@ -1001,8 +3183,18 @@ public:
 			{NULL, NULL}
 		};
 
+		const luaL_reg s_lldebugregs[] = {
+			{"threadcount", LuaImpl::threadcount},
+			{"pinmisses", LuaImpl::pinmisses},
+			{"debug_this", LuaImpl::debug_this},
+			{"settag", LuaImpl::settag},
+			{NULL, NULL}
+		};
+
 		lua_register(L, "assert", lldebug_assert);
 		luaL_openlib(L, LUA_COLIBNAME, s_coregs, 0);
+		luaL_openlib(L, LUA_LLDEBUGLIBNAME, s_lldebugregs, 0);
+		lua_pop(L, 1);
 	}
 };
 
@@ -1027,7 +3219,7 @@ int Context::LoadFile(lua_State *L, const char *filename) {
 
 	int ret = luaL_loadfile(L, name.c_str());
 	if (ret != 0) {
-		m_sourceManager.Add(std::string("@") + name, name);
+		AddSource(std::string("@") + name, name);
 		OutputLuaError(lua_tostring(L, -1));
 		return ret;
 	}
@@ -1039,7 +3231,7 @@ int Context::LoadFile(lua_State *L, const char *filename) {
 		LoadConfig();
 	}
 
-	m_sourceManager.Add(std::string("@") + name, name);
+	AddSource(std::string("@") + name, name);
 	return 0;
 }
 
@@ -1048,12 +3240,12 @@ int Context::LoadString(lua_State *L, const char *str) {
 	
 	int ret = luaL_loadbuffer(L, str, strlen(str), str);
 	if (ret != 0) {
-		m_sourceManager.Add(str, str);
+		AddSource(str, str);
 		OutputLuaError(lua_tostring(L, -1));
 		return ret;
 	}
 
-	m_sourceManager.Add(str, str);
+	AddSource(str, str);
 	return 0;
 }
 
@@ -1117,16 +3309,51 @@ lua_State *Context::NewThread(lua_State *L) {
 		return NULL;
 	}
 
+	int line;
+	int site = ctx->MakeThreadSite(L, line);
 	lua_State *NL = lua_newthread(L);
 
-	// Set the hook function to NL.
-	Context::SetHook(NL);
+	// Set the hook function to NL,
+	// only the creation site is known for the debug filter.
+	CoroutineInfo info(NL);
+	info.isDebugged = ctx->IsDebugTarget(site, -1, false);
+	info.filterSerial = ctx->m_filterSerial;
+	ctx->SetHook(NL, ctx->GetHookMask(ctx->GetThread(L), info));
 
-	// Connect the context of L with NL.
-	Context::ms_manager->Add(ctx, NL);
+	// Connect the context of L with NL, until NL is collected.
+	unsigned long serial = Context::ms_manager->Add(ctx, NL);
+	LuaImpl::watchthread(L, serial, site, line);
 	return NL;
 }
 
+/// Get the site of the lua function that creates a coroutine now.
+int Context::MakeThreadSite(lua_State *L, int &line) {
+	lua_Debug ar;
+
+	for (int level = 0; lua_getstack(L, level, &ar); ++level) {
+		lua_getinfo(L, "Sl", &ar);
+		if (ar.currentline < 0) {
+			continue; // C functions such as coroutine.create
+		}
+
+		scoped_lock lock(m_mutex);
+		std::map<std::string, int>::iterator it =
+			m_threadSiteIds.find(ar.source);
+		if (it == m_threadSiteIds.end()) {
+			it = m_threadSiteIds.insert(
+				std::make_pair(std::string(ar.source),
+				(int)m_threadSites.size())).first;
+			m_threadSites.push_back(ar.source);
+		}
+
+		line = ar.currentline;
+		return it->second;
+	}
+
+	line = -1;
+	return -1;
+}
+
 struct call_info {
 	int nargs;
 	int nresults;
@@ -1164,19 +3391,50 @@ struct call_info {
 	return;
 }*/
 
-int Context::PCall(lua_State *L, int nargs, int nresults, int errfunc) {
+/// Count the call of the calling thread, its state is kept while calling.
+void Context::BeginCall(lua_State *L) {
+	scoped_lock lock(m_mutex);
+
+	ThreadInfo &thread = GetThread(L);
+	++thread.calls;
+	thread.isCallSuccess = false;
+}
+
+/// It returns true if the call was stopped by the debugger.
+bool Context::EndCall(lua_State *L, int ret) {
 	scoped_lock lock(m_mutex);
+
+	ThreadInfo &thread = GetThread(L);
+	bool isAborted = (ret != 0 && thread.isCallSuccess);
+	thread.isCallSuccess = (ret == 0);
+	--thread.calls;
+
+	// The host may not use the idle thread any more, so forget it.
+	if (thread.calls <= 0 && thread.id != m_mainThread
+		&& thread.debugState == DEBUGSTATE_RUNNING) {
+		if (m_selectedThread == thread.id) {
+			m_selectedThread = m_mainThread;
+		}
+		int id = thread.id;
+		ms_currentThread.reset();
+		m_threads.erase(id);
+		SendThreadList();
+	}
+
+	return isAborted;
+}
+
+/// The lock isn't held while calling, the other threads run lua meanwhile.
+int Context::PCall(lua_State *L, int nargs, int nresults, int errfunc) {
 	scoped_lua scoped(L);
 
-	m_isCallSuccess = false;
+	BeginCall(L);
 	int ret = lua_pcall(L, nargs, nresults, errfunc);
-	if (ret == 0) {
-		m_isCallSuccess = true;
+	if (EndCall(L, ret)) {
+		lua_pop(L, 1);
 		return 0;
 	}
-
-	if (m_isCallSuccess) {
-		lua_pop(L, 1);
+	if (ret == 0) {
 		return 0;
 	}
 
@@ -1185,135 +3443,766 @@ int Context::PCall(lua_State *L, int nargs, int nresults, int errfunc) {
 }
 
 int Context::Resume(lua_State *L, int nargs) {
-	scoped_lock lock(m_mutex);
 	scoped_lua scoped(L);
 
-	m_isCallSuccess = false;
+	BeginCall(L);
 	int ret = lua_resume(L, nargs);
-	if (ret == 0
 #ifdef LUA_YIELD
-		|| ret == LUA_YIELD
+	if (ret == LUA_YIELD) {
+		ret = 0;
+	}
 #endif
-		) {
-		m_isCallSuccess = true;
+	if (EndCall(L, ret)) {
+		lua_pop(L, 1);
+		return 0;
+	}
+	if (ret == 0) {
 		return 0;
 	}
 
-	if (m_isCallSuccess) {
+	OutputLuaError(lua_tostring(L, -1));
+	return ret;
+}
+
+
+/*-----------------------------------------------------------------*/
+LuaVarList Context::LuaGetGlobals() {
+	// Get the fields of the global table.
+	varlist_maker callback;
+	if (iterate_fields(callback, GetLua(), LUA_GLOBALSINDEX) != 0) {
+		return LuaVarList();
+	}
+
+	return callback.get_result();
+}
+
+LuaVarList Context::LuaGetRegistories() {
+	// Get the fields of the registory table.
+	varlist_maker callback;
+	if (iterate_fields(callback, GetLua(), LUA_REGISTRYINDEX) != 0) {
+		return LuaVarList();
+	}
+
+	return callback.get_result();
+}
+
+LuaVarList Context::LuaGetFields(const LuaVar &var, int offset, int count,
+								 int &total, int &resume) {
+	// Get the fields of var, only the page is made.
+	varlist_maker callback;
+	if (iterate_var_page(callback, var, offset, count, total, resume) != 0) {
+		resume = 0;
+		return LuaVarList();
+	}
+
+	return callback.get_result();
+}
+
+/// A field that matched the query, its value is in the holder table.
+struct field_entry {
+	std::string name;
+	std::string value;
+	lua_Number number;
+	bool isNumber;
+	int index; ///< index in the holder table, it's the table order
+};
+
+/// Compare the fields by the sort key, the table order breaks ties.
+/**
+ * The descending order flips only the sort key,
+ * the ties stay in the table order.
+ */
+struct field_entry_less {
+	int m_sortKey;
+	bool m_isAscending;
+
+	explicit field_entry_less(int sortKey, bool isAscending)
+		: m_sortKey(sortKey), m_isAscending(isAscending) {
+	}
+
+	bool operator()(const field_entry &x, const field_entry &y) const {
+		int result = 0;
+
+		switch (m_sortKey) {
+		case FIELDSORT_NAME:
+			result = x.name.compare(y.name);
+			break;
+		case FIELDSORT_VALUE:
+			// The numbers are compared numerically, and come first.
+			if (x.isNumber && y.isNumber) {
+				result = (x.number < y.number ? -1
+					: (y.number < x.number ? 1 : 0));
+			}
+			else if (x.isNumber != y.isNumber) {
+				result = (x.isNumber ? -1 : 1);
+			}
+			else {
+				result = x.value.compare(y.value);
+			}
+			break;
+		}
+
+		if (result != 0) {
+			return (m_isAscending ? result < 0 : result > 0);
+		}
+		return (x.index < y.index);
+	}
+};
+
+/// A dummy object that offers the error of the exceeded query.
+static const int address_for_query_limit_error = 0;
+
+/// The count hook that stops the predicate of the query.
+static void query_limit_hook(lua_State *L, lua_Debug * /*ar*/) {
+	lua_pushlightuserdata(L, (void *)&address_for_query_limit_error);
+	lua_error(L);
+}
+
+/**
+ * @brief Select the fields by the predicate function.
+ *
+ * The matched values are kept in the holder table,
+ * because they are made into LuaVar after the sorting.
+ * The field that the predicate fails on doesn't match,
+ * and only the first error message is kept.
+ * Each call of the predicate runs in the instruction limit, and the
+ * iteration stops at the field it's exceeded on.
+ */
+struct field_query_filter {
+	explicit field_query_filter(int predIdx, int holderIdx, bool needsValue)
+		: m_predIdx(predIdx), m_holderIdx(holderIdx)
+		, m_needsValue(needsValue), m_errorCount(0), m_isExceeded(false) {
+	}
+
+	int operator()(lua_State *L, const std::string &name, int valueIdx) {
+		// Setting the hook resets its count.
+		lua_sethook(L, query_limit_hook, LUA_MASKCOUNT, QUERY_INSTRUCTION_LIMIT);
+
+		lua_pushvalue(L, m_predIdx);
+		lua_pushlstring(L, name.c_str(), name.length());
+		lua_pushvalue(L, valueIdx);
+		if (lua_pcall(L, 2, 1, 0) != 0) {
+			if (lua_touserdata(L, -1) == &address_for_query_limit_error) {
+				lua_pop(L, 1);
+				m_isExceeded = true;
+				m_exceededName = name;
+				return -1;
+			}
+
+			if (m_errorCount++ == 0) {
+				m_error = llutil_tostring_fast(L, -1);
+			}
+			lua_pop(L, 1);
+			return 0;
+		}
+
+		bool matched = (lua_toboolean(L, -1) != 0);
+		lua_pop(L, 1);
+		if (!matched) {
+			return 0;
+		}
+
+		field_entry entry;
+		entry.name = name;
+		entry.isNumber = (lua_type(L, valueIdx) == LUA_TNUMBER);
+		entry.number = (entry.isNumber ? lua_tonumber(L, valueIdx) : 0);
+		if (m_needsValue && !entry.isNumber) {
+			entry.value = llutil_tostring_for_varvalue(L, valueIdx);
+		}
+		entry.index = (int)m_result.size() + 1;
+
+		lua_pushvalue(L, valueIdx);
+		lua_rawseti(L, m_holderIdx, entry.index);
+		m_result.push_back(entry);
+		return 0;
+	}
+
+	/// Get the matched fields.
+	std::vector<field_entry> &get_result() {
+		return m_result;
+	}
+
+	/// Get the first error message of the predicate.
+	const std::string &get_error() const {
+		return m_error;
+	}
+
+	/// Get the number of the fields that the predicate failed on.
+	int get_error_count() const {
+		return m_errorCount;
+	}
+
+	/// Did the predicate exceed the instruction limit ?
+	bool is_exceeded() const {
+		return m_isExceeded;
+	}
+
+	/// Get the name of the field the predicate exceeded the limit on.
+	const std::string &get_exceeded_name() const {
+		return m_exceededName;
+	}
+
+private:
+	int m_predIdx, m_holderIdx;
+	bool m_needsValue;
+	std::vector<field_entry> m_result;
+	std::string m_error;
+	int m_errorCount;
+	bool m_isExceeded;
+	std::string m_exceededName;
+};
+
+LuaVarList Context::LuaQueryFields(const LuaVar &var,
+								   const LuaFieldQuery &query,
+								   int offset, int count, int &total,
+								   std::string &error) {
+	total = 0;
+	error.clear();
+
+	if (!var.IsOk()) {
+		return LuaVarList();
+	}
+
+	lua_State *L = var.GetLua().GetState();
+	scoped_lua scoped(this, L);
+
+	// The chunk makes the predicate function of 'key' and 'value'.
+	const std::string &predicate = query.GetPredicate();
+	std::string str =
+		"local pattern, find = ...\n"
+		"return function(key, value)\n"
+		"if pattern ~= '' and not find(key, pattern) then return false end\n"
+		"return (" + (predicate.empty() ? std::string("true") : predicate)
+		+ "\n)\nend";
+	if (luaL_loadbuffer(L, str.c_str(), str.length(), DUMMY_FUNCNAME) != 0) {
+		error = ParseLuaError(llutil_tostring_fast(L, -1)).message;
+		lua_pop(L, 1);
+		scoped.check(0);
+		return LuaVarList();
+	}
+
+	const std::string &pattern = query.GetKeyPattern();
+	lua_pushlstring(L, pattern.c_str(), pattern.length());
+	lua_getfield(L, LUA_GLOBALSINDEX, "string");
+	if (lua_istable(L, -1)) {
+		lua_getfield(L, -1, "find");
+		lua_remove(L, -2);
+	}
+	if (lua_pcall(L, 2, 1, 0) != 0) {
+		error = ParseLuaError(llutil_tostring_fast(L, -1)).message;
+		lua_pop(L, 1);
+		scoped.check(0);
+		return LuaVarList();
+	}
+	int predIdx = lua_gettop(L);
+
+	lua_newtable(L);
+	int holderIdx = lua_gettop(L);
+
+	if (var.PushTable(L) != 0) {
+		lua_pop(L, 2);
+		scoped.check(0);
+		return LuaVarList();
+	}
+
+	// The count hook stops the predicate that doesn't end,
+	// the hook of the context is restored after it.
+	lua_Hook oldHook = lua_gethook(L);
+	int oldMask = lua_gethookmask(L);
+	int oldCount = lua_gethookcount(L);
+
+	field_query_filter filter(predIdx, holderIdx,
+		query.GetSortKey() == FIELDSORT_VALUE);
+	int ret = iterate_fields(filter, L, lua_gettop(L));
+	lua_sethook(L, oldHook, oldMask, oldCount);
+
+	// The fields matched before it are still returned.
+	if (ret != 0 && !filter.is_exceeded()) {
+		lua_pop(L, 3);
+		scoped.check(0);
+		return LuaVarList();
+	}
+	lua_pop(L, 1); // eliminate the table
+
+	std::vector<field_entry> &entries = filter.get_result();
+	if (query.GetSortKey() != FIELDSORT_NONE) {
+		std::sort(entries.begin(), entries.end(),
+			field_entry_less(query.GetSortKey(), query.IsAscending()));
+	}
+
+	// Make only the requested page.
+	varlist_maker callback;
+	total = (int)entries.size();
+	if (offset < 0) {
+		offset = 0;
+	}
+
+	for (int i = offset; i < total && i - offset < count; ++i) {
+		lua_rawgeti(L, holderIdx, entries[i].index);
+		callback(L, entries[i].name, lua_gettop(L));
+		lua_pop(L, 1);
+	}
+
+	lua_pop(L, 2); // eliminate the holder and the predicate
+	scoped.check(0);
+
+	// The errors of the predicate are reported once with the page.
+	if (filter.is_exceeded()) {
+		std::ostringstream stream;
+		stream << "The predicate didn't end in " << QUERY_INSTRUCTION_LIMIT
+			<< " instructions on the field '" << filter.get_exceeded_name()
+			<< "', the fields after it weren't checked.";
+		error = stream.str();
+	}
+	else if (filter.get_error_count() > 0) {
+		std::ostringstream stream;
+		stream << ParseLuaError(filter.get_error()).message
+			<< " (" << filter.get_error_count() << " fields)";
+		error = stream.str();
+	}
+
+	return callback.get_result();
+}
+
+LuaVarList Context::LuaGetLocals(const LuaStackFrame &stackFrame,
+								 bool checkLocal, bool checkUpvalue,
+								 bool checkEnviron) {
+	lua_State *L = stackFrame.GetLua().GetState();
+
+	// The frame may be of a coroutine that was collected.
+	if (L != NULL && !IsThreadAlive(L)) {
+		return LuaVarList();
+	}
+	
+	varlist_maker callback;
+	if (iterate_locals(
+		callback,
+		(L != NULL ? L : GetLua()),
+		stackFrame.GetLevel(),
+		checkLocal, checkUpvalue, checkEnviron) != 0) {
+		return LuaVarList();
+	}
+
+	return callback.get_result();
+}
+
+LuaVarList Context::LuaGetStack() {
+	varlist_maker callback;
+	if (iterate_stacks(callback, GetLua()) != 0) {
+		return LuaVarList();
+	}
+
+	return callback.get_result();
+}
+
+/// Add the frames of L1 to the array, it returns -1 if the stack is too deep.
+int Context::AddBacktrace(lua_State *L1, LuaBacktraceList &array) {
+	const int LEVEL_MAX = 1024;	// maximum size of the stack
+	scoped_lua scoped(this, L1);
+	lua_Debug ar;
+
+	// level 0 may be this own function
+	for (int level = 0; lua_getstack(L1, level, &ar); ++level) {
+		if (level > LEVEL_MAX) {
+			assert(false && "stack size is too many");
+			scoped.check(0);
+			return -1;
+		}
+
+		lua_getinfo(L1, "Snl", &ar);
+
+		// Source title is also set,
+		// because it is always used when backtrace is shown.
+		std::string sourceTitle;
+		const Source *source = GetSource(ar.source);
+		if (source != NULL) {
+			sourceTitle = source->GetTitle();
+		}
+
+		std::string name = llutil_makefuncname(&ar);
+		array.push_back(LuaBacktrace(
+			L1, name, ar.source, sourceTitle,
+			ar.currentline, level));
+	}
+
+	scoped.check(0);
+	return 0;
+}
+
+LuaBacktraceList Context::LuaGetBacktrace() {
+	LuaBacktraceList array;
+
+	// The coroutines the calling thread resumes.
+	ThreadInfo *thread = FindCurrentThread();
+	if (thread == NULL) {
+		return array;
+	}
+	
+	CoroutineList::reverse_iterator it;
+	for (it = thread->coroutines.rbegin();
+		it != thread->coroutines.rend(); ++it) {
+		if (AddBacktrace(it->L, array) != 0) {
+			break;
+		}
+	}
+
+	return array;
+}
+
+LuaBacktraceList Context::LuaGetBacktrace(const LuaHandle &lua) {
+	LuaBacktraceList array;
+	lua_State *L1 = lua.GetState();
+
+	// The handle may be of a collected coroutine.
+	if (L1 == NULL || !IsThreadAlive(L1)) {
+		return array;
+	}
+
+	AddBacktrace(L1, array);
+	return array;
+}
+
+/// Is L1 the main thread or a coroutine that isn't collected ?
+/**
+ * The entry of the manager remains until the sentinel of the thread is
+ * finalized, one cycle after the thread was collected. So the thread is
+ * confirmed by the weak valued index, and its sentinel must have the
+ * serial of the entry, or the address was reused.
+ */
+bool Context::IsThreadAlive(lua_State *L1) {
+	{
+		scoped_lock lock(m_mutex);
+
+		if (L1 == m_lua) {
+			return true;
+		}
+
+		// The coroutines that the threads resume.
+		ThreadMap::const_iterator thread;
+		for (thread = m_threads.begin(); thread != m_threads.end(); ++thread) {
+			scoped_lock chainLock(thread->second->chainMutex);
+			const CoroutineList &coroutines = thread->second->coroutines;
+			CoroutineList::const_iterator it;
+			for (it = coroutines.begin(); it != coroutines.end(); ++it) {
+				if (it->L == L1) {
+					return true;
+				}
+			}
+		}
+	}
+
+	unsigned long serial =
+		(ms_manager != NULL ? ms_manager->GetSerial(this, L1) : 0);
+	if (serial == 0) {
+		return false;
+	}
+
+	lua_State *L = GetLua();
+	scoped_lua scoped(this, L);
+	bool found = false;
+
+	if (LuaImpl::pushthread(L, L1)) {
+		const LuaImpl::ThreadSentinel *sentinel = LuaImpl::findsentinel(L, -1);
+		found = (sentinel != NULL && sentinel->serial == serial);
 		lua_pop(L, 1);
-		return 0;
 	}
 
-	OutputLuaError(lua_tostring(L, -1));
-	return ret;
+	scoped.check(0);
+	return found;
 }
 
-
-/*-----------------------------------------------------------------*/
-LuaVarList Context::LuaGetGlobals() {
+/// Get the index of the tag of the coroutines.
+int Context::MakeThreadTag(const std::string &tag) {
 	scoped_lock lock(m_mutex);
 
-	// Get the fields of the global table.
-	varlist_maker callback;
-	if (iterate_fields(callback, GetLua(), LUA_GLOBALSINDEX) != 0) {
-		return LuaVarList();
+	std::map<std::string, int>::iterator it = m_threadTagIds.find(tag);
+	if (it == m_threadTagIds.end()) {
+		it = m_threadTagIds.insert(
+			std::make_pair(tag, (int)m_threadTags.size())).first;
+		m_threadTags.push_back(tag);
 	}
 
-	return callback.get_result();
+	return it->second;
 }
 
-LuaVarList Context::LuaGetRegistories() {
-	scoped_lock lock(m_mutex);
+/// Check the debug filter for the running coroutine.
+/**
+ * The filter is known from the hook settings of the thread,
+ * so the lock is taken only if any filter is set.
+ * The main state and the threads made by the host have no sentinel,
+ * they are always debugged so that the host's own code can break.
+ */
+void Context::UpdateDebugTarget(ThreadInfo &thread, CoroutineInfo &info) {
+	const HookSettings &hook = thread.hook;
 
-	// Get the fields of the registory table.
-	varlist_maker callback;
-	if (iterate_fields(callback, GetLua(), LUA_REGISTRYINDEX) != 0) {
-		return LuaVarList();
+	info.isDebugged = true;
+	info.filterSerial = hook.filterSerial;
+	if (!hook.isFiltering) {
+		return;
 	}
 
-	return callback.get_result();
+	// table[L1] is the sentinel, the main state doesn't have it.
+	lua_State *L1 = info.L;
+	scoped_lua scoped(this, L1);
+	lua_checkstack(L1, 3);
+	lua_pushlightuserdata(L1, (void *)&llutil_address_for_thread_table);
+	lua_rawget(L1, LUA_REGISTRYINDEX);
+	if (lua_istable(L1, -1)) {
+		lua_pushthread(L1);
+		lua_rawget(L1, -2);
+		const LuaImpl::ThreadSentinel *sentinel =
+			static_cast<LuaImpl::ThreadSentinel *>(lua_touserdata(L1, -1));
+		if (sentinel != NULL) {
+			info.isDebugged = IsDebugTarget(
+				sentinel->site, sentinel->tag, sentinel->isMarked);
+		}
+		lua_pop(L1, 1);
+	}
+	lua_pop(L1, 1);
+
+	scoped.check(0);
 }
 
-LuaVarList Context::LuaGetFields(const LuaVar &var) {
-	scoped_lock lock(m_mutex);
+/// Find the creation site of the coroutine, or -1 if it's unknown.
+int Context::FindThreadSite(lua_State *L1, int &line) {
+	scoped_lua scoped(this, L1);
+	int site = -1;
+	line = -1;
+
+	// table[L1] is the sentinel that has the site.
+	lua_checkstack(L1, 3);
+	lua_pushlightuserdata(L1, (void *)&llutil_address_for_thread_table);
+	lua_rawget(L1, LUA_REGISTRYINDEX);
+	if (lua_istable(L1, -1)) {
+		lua_pushthread(L1);
+		lua_rawget(L1, -2);
+		const LuaImpl::ThreadSentinel *sentinel =
+			static_cast<LuaImpl::ThreadSentinel *>(lua_touserdata(L1, -1));
+		if (sentinel != NULL) {
+			site = sentinel->site;
+			line = sentinel->line;
+		}
+		lua_pop(L1, 1);
+	}
+	lua_pop(L1, 1);
 
-	// Get the fields of var.
-	varlist_maker callback;
-	if (iterate_var(callback, var) != 0) {
-		return LuaVarList();
+	scoped.check(0);
+	return site;
+}
+
+/// The live coroutine that is listed.
+struct coroutine_entry {
+	lua_State *L;
+	unsigned long serial;
+	int status;
+	int site;
+	int creationLine;
+	std::string key; // the top frame, only when it's sorted by it
+	int line;
+};
+
+/// The status of the coroutines, in the order of the sorting.
+enum {
+	COROUTINESTATUS_RUNNING,
+	COROUTINESTATUS_NORMAL,
+	COROUTINESTATUS_SUSPENDED,
+	COROUTINESTATUS_DEAD,
+};
+
+static const char *coroutine_status_name(int status) {
+	switch (status) {
+	case COROUTINESTATUS_RUNNING: return "running";
+	case COROUTINESTATUS_NORMAL: return "normal";
+	case COROUTINESTATUS_SUSPENDED: return "suspended";
 	}
+	return "dead";
+}
 
-	return callback.get_result();
+/// Get the status of the coroutine that isn't resumed by lldebug.
+/** It's the same as coroutine.status.
+ */
+static int get_coroutine_status(lua_State *co) {
+	lua_Debug ar;
+
+	switch (lua_status(co)) {
+	case LUA_YIELD:
+		return COROUTINESTATUS_SUSPENDED;
+	case 0:
+		if (lua_getstack(co, 0, &ar)) {
+			return COROUTINESTATUS_NORMAL;
+		}
+		else if (lua_gettop(co) == 0) {
+			return COROUTINESTATUS_DEAD;
+		}
+		return COROUTINESTATUS_SUSPENDED; // not started
+	}
+
+	return COROUTINESTATUS_DEAD; // stopped by an error
 }
 
-LuaVarList Context::LuaGetLocals(const LuaStackFrame &stackFrame,
-								 bool checkLocal, bool checkUpvalue,
-								 bool checkEnviron) {
-	scoped_lock lock(m_mutex);
-	lua_State *L = stackFrame.GetLua().GetState();
-	
-	varlist_maker callback;
-	if (iterate_locals(
-		callback,
-		(L != NULL ? L : GetLua()),
-		stackFrame.GetLevel(),
-		checkLocal, checkUpvalue, checkEnviron) != 0) {
-		return LuaVarList();
+/// Get the first lua frame of the coroutine, it returns false if not found.
+static bool get_coroutine_frame(lua_State *co, lua_Debug *ar) {
+	for (int level = 0; lua_getstack(co, level, ar); ++level) {
+		lua_getinfo(co, "Sl", ar);
+		if (ar->currentline >= 0) {
+			return true;
+		}
 	}
 
-	return callback.get_result();
+	return false;
 }
 
-LuaVarList Context::LuaGetStack() {
-	scoped_lock lock(m_mutex);
+/// Compare the coroutines by the sort key, the creation order breaks ties.
+struct coroutine_entry_less {
+	const string_array &m_sites;
+	int m_sortKey;
+	bool m_isAscending;
 
-	varlist_maker callback;
-	if (iterate_stacks(callback, GetLua()) != 0) {
-		return LuaVarList();
+	explicit coroutine_entry_less(const string_array &sites, int sortKey,
+								  bool isAscending)
+		: m_sites(sites), m_sortKey(sortKey), m_isAscending(isAscending) {
 	}
 
-	return callback.get_result();
-}
+	const std::string &site(int index) const {
+		static const std::string empty;
+		return (index >= 0 ? m_sites[index] : empty);
+	}
 
-LuaBacktraceList Context::LuaGetBacktrace() {
-	const int LEVEL_MAX = 1024;	// maximum size of the stack
-	scoped_lock lock(m_mutex);
-	LuaBacktraceList array;
-	
-	CoroutineList::reverse_iterator it;
-	for (it = m_coroutines.rbegin(); it != m_coroutines.rend(); ++it) {
-		lua_State *L1 = it->L;
-		scoped_lua scoped(this, L1);
-		lua_Debug ar;
+	bool operator()(const coroutine_entry &x, const coroutine_entry &y) const {
+		int result = 0;
 
-		// level 0 may be this own function
-		for (int level = 0; lua_getstack(L1, level, &ar); ++level) {
-			if (level > LEVEL_MAX) {
-				assert(false && "stack size is too many");
-				scoped.check(0);
-				return array;
+		switch (m_sortKey) {
+		case COROUTINESORT_STATUS:
+			result = x.status - y.status;
+			break;
+		case COROUTINESORT_CREATION:
+			result = site(x.site).compare(site(y.site));
+			if (result == 0) {
+				result = x.creationLine - y.creationLine;
+			}
+			break;
+		case COROUTINESORT_FRAME:
+			result = x.key.compare(y.key);
+			if (result == 0) {
+				result = x.line - y.line;
 			}
+			break;
+		}
 
-			lua_getinfo(L1, "Snl", &ar);
+		if (result != 0) {
+			return (m_isAscending ? result < 0 : result > 0);
+		}
+		return (x.serial < y.serial);
+	}
+};
 
-			// Source title is also set,
-			// because it is always used when backtrace is shown.
-			std::string sourceTitle;
-			const Source *source = m_sourceManager.Get(ar.source);
-			if (source != NULL) {
-				sourceTitle = source->GetTitle();
+LuaCoroutineList Context::LuaGetCoroutines(int offset, int count,
+										   int sortKey, bool isAscending,
+										   int &total) {
+	lua_State *L = GetLua();
+	scoped_lua scoped(this, L);
+	std::vector<coroutine_entry> entries;
+	lua_Debug ar;
+
+	// The main thread, and the coroutines in the weak table.
+	coroutine_entry mainEntry = {m_lua, 0, 0, -1, -1, std::string(), -1};
+	entries.push_back(mainEntry);
+
+	lua_pushlightuserdata(L, (void *)&llutil_address_for_thread_table);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	if (lua_istable(L, -1)) {
+		lua_pushnil(L);
+		while (lua_next(L, -2) != 0) {
+			const LuaImpl::ThreadSentinel *sentinel =
+				static_cast<LuaImpl::ThreadSentinel *>(lua_touserdata(L, -1));
+			lua_State *co = lua_tothread(L, -2);
+			lua_pop(L, 1);
+			if (co == NULL || sentinel == NULL) {
+				continue;
 			}
 
-			std::string name = llutil_makefuncname(&ar);
-			array.push_back(LuaBacktrace(
-				L1, name, ar.source, sourceTitle,
-				ar.currentline, level));
+			coroutine_entry entry = {co, sentinel->serial, 0,
+				sentinel->site, sentinel->line, std::string(), -1};
+			entries.push_back(entry);
 		}
+	}
+	lua_pop(L, 1);
+	scoped.check(0);
 
-		scoped.check(0);
+	for (size_t i = 0; i < entries.size(); ++i) {
+		coroutine_entry &entry = entries[i];
+		entry.status = get_coroutine_status(entry.L);
+
+		// The top frame is needed only to sort.
+		if (sortKey == COROUTINESORT_FRAME
+			&& get_coroutine_frame(entry.L, &ar)) {
+			entry.key = ar.source;
+			entry.line = ar.currentline;
+		}
 	}
 
-	return array;
+	// The resuming coroutines of each thread, the last one is running.
+	// (the lock isn't held while sorting, so the sites are copied)
+	string_array sites;
+	{
+		scoped_lock lock(m_mutex);
+		ThreadMap::const_iterator thread;
+		for (thread = m_threads.begin(); thread != m_threads.end(); ++thread) {
+			scoped_lock chainLock(thread->second->chainMutex);
+			const CoroutineList &coroutines = thread->second->coroutines;
+			for (size_t i = 0; i < coroutines.size(); ++i) {
+				for (size_t j = 0; j < entries.size(); ++j) {
+					if (entries[j].L == coroutines[i].L) {
+						entries[j].status = (i + 1 == coroutines.size()
+							? COROUTINESTATUS_RUNNING
+							: COROUTINESTATUS_NORMAL);
+						break;
+					}
+				}
+			}
+		}
+		sites = m_threadSites;
+	}
+
+	coroutine_entry_less less(sites, sortKey, isAscending);
+	std::sort(entries.begin(), entries.end(), less);
+
+	// Make only the requested page.
+	LuaCoroutineList result;
+	total = (int)entries.size();
+	if (offset < 0) {
+		offset = 0;
+	}
+
+	for (int i = offset; i < total && i - offset < count; ++i) {
+		const coroutine_entry &entry = entries[i];
+		std::string creationKey, creationTitle;
+		std::string funcName, key, title;
+		int line = -1;
+
+		if (entry.site >= 0) {
+			creationKey = sites[entry.site];
+			const Source *source = GetSource(creationKey);
+			creationTitle = (source != NULL ? source->GetTitle() : creationKey);
+		}
+
+		if (get_coroutine_frame(entry.L, &ar)) {
+			lua_getinfo(entry.L, "n", &ar);
+			funcName = llutil_makefuncname(&ar);
+			key = ar.source;
+			line = ar.currentline;
+
+			const Source *source = GetSource(key);
+			title = (source != NULL ? source->GetTitle() : key);
+		}
+
+		result.push_back(LuaCoroutine(entry.L, entry.serial,
+			coroutine_status_name(entry.status),
+			creationKey, creationTitle, entry.creationLine,
+			funcName, key, title, line));
+	}
+
+	return result;
 }
 
 static int index_for_eval(lua_State *L) {
@@ -1448,24 +4337,31 @@ struct eval_string_reader {
 	}
 	};
 
-int Context::LuaEval(lua_State *L, int level, const std::string &str, bool withDebug) {
-	scoped_lock lock(m_mutex);
-	scoped_lua scoped(this, L, withDebug);
+/// The beginning part of the eval string that uses the local variables.
+static const char *const eval_beginning =
+	"return (function()\n"
+	"  local lldebug = lldebug\n"
+	"  local getlocals = __lldebug_getlocals__\n"
+	"  __lldebug_setmetatable__()\n";
 
-	if (str.empty()) {
-		return 0;
-	}
+/// The ending part of the eval string that uses the local variables.
+static const char *const eval_ending =
+	"\nend)()";
 
-	const char *beginning = NULL;
-	const char *ending = NULL;
-	if (level >= 0) {
-		beginning =
-			"return (function()\n"
-			"  local lldebug = lldebug\n"
-			"  local getlocals = __lldebug_getlocals__\n"
-			"  __lldebug_setmetatable__()\n";
-		ending =
-			"\nend)()";
+/**
+ * @brief Export the functions used by the eval string while this exists.
+ *
+ * The eval string refers the local variables of the function
+ * at the 'level' through these functions.
+ */
+struct scoped_eval_functions {
+	lua_State *L;
+
+	explicit scoped_eval_functions(lua_State *L_, int level)
+		: L(L_) {
+		if (level < 0) {
+			return;
+		}
 
 		// Export functions used here because of preparation for error state
 		// like that all basic functions are unusable.
@@ -1483,18 +4379,26 @@ int Context::LuaEval(lua_State *L, int level, const std::string &str, bool withD
 	}
 
 	// on exit: globals[__lldebug_setmetatable__] = nil
-	struct call_on_exit {
-		lua_State *L;
-		call_on_exit(lua_State *L_) : L(L_) {}
-		~call_on_exit() {
-			lua_pushliteral(L, "__lldebug_setmetatable__");
-			lua_pushnil(L);
-			lua_rawset(L, LUA_GLOBALSINDEX);
-			lua_pushliteral(L, "__lldebug_getlocals__");
-			lua_pushnil(L);
-			lua_rawset(L, LUA_GLOBALSINDEX);
-		}
-	} exit_obj(L);
+	~scoped_eval_functions() {
+		lua_pushliteral(L, "__lldebug_setmetatable__");
+		lua_pushnil(L);
+		lua_rawset(L, LUA_GLOBALSINDEX);
+		lua_pushliteral(L, "__lldebug_getlocals__");
+		lua_pushnil(L);
+		lua_rawset(L, LUA_GLOBALSINDEX);
+	}
+};
+
+int Context::LuaEval(lua_State *L, int level, const std::string &str, bool withDebug) {
+	scoped_lua scoped(this, L, withDebug);
+
+	if (str.empty()) {
+		return 0;
+	}
+
+	const char *beginning = (level >= 0 ? eval_beginning : NULL);
+	const char *ending = (level >= 0 ? eval_ending : NULL);
+	scoped_eval_functions funcs(L, level);
 
 	// Load string (use lua_load).
 	eval_string_reader reader(str, beginning, ending);
@@ -1512,12 +4416,165 @@ int Context::LuaEval(lua_State *L, int level, const std::string &str, bool withD
 	return 0;
 }
 
+/// Push the cache table of the compiled eval strings.
+static void push_eval_cache_table(lua_State *L) {
+	lua_pushlightuserdata(L, (void *)&llutil_address_for_eval_cache_table);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	if (lua_istable(L, -1)) {
+		return;
+	}
+
+	// registry[address] = {}
+	lua_pop(L, 1);
+	lua_newtable(L);
+	lua_pushlightuserdata(L, (void *)&llutil_address_for_eval_cache_table);
+	lua_pushvalue(L, -2);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
+int Context::LuaEvalCached(lua_State *L, int level, const std::string &str,
+						   int nresults) {
+	scoped_lua scoped(this, L, false);
+	scoped_eval_functions funcs(L, level);
+
+	// Find the compiled string (table[str]).
+	push_eval_cache_table(L);
+	lua_pushlstring(L, str.c_str(), str.length());
+	lua_rawget(L, -2);
+
+	// Compile the string only once.
+	if (!lua_isfunction(L, -1)) {
+		lua_pop(L, 1);
+
+		eval_string_reader reader(str, eval_beginning, eval_ending);
+		if (lua_load(L, eval_string_reader::exec, &reader, DUMMY_FUNCNAME) != 0) {
+			lua_remove(L, -2); // eliminate the table
+			scoped.check(1);
+			return -1;
+		}
+
+		// table[str] = compiled function
+		lua_pushlstring(L, str.c_str(), str.length());
+		lua_pushvalue(L, -2);
+		lua_rawset(L, -4);
+	}
+	lua_remove(L, -2); // eliminate the table
+
+	// Do execute !
+	if (lua_pcall(L, 0, nresults, 0) != 0) {
+		scoped.check(1);
+		return -1;
+	}
+
+	return 0;
+}
+
+int Context::LuaEvalCondition(lua_State *L, int level, const std::string &cond,
+							  std::string &error) {
+	scoped_lua scoped(this, L, false);
+
+	if (LuaEvalCached(L, level, "return (" + cond + "\n)", 1) != 0) {
+		error = llutil_tostring_fast(L, -1);
+		lua_pop(L, 1);
+		scoped.check(0);
+		return -1;
+	}
+
+	int result = (lua_toboolean(L, -1) ? 1 : 0);
+	lua_pop(L, 1);
+	scoped.check(0);
+	return result;
+}
+
+/// Make the eval string that returns the parts of the logpoint message.
+/**
+ * "x={x}, n={#t}" becomes 'return "x=", (x), ", n=", (#t)'.
+ */
+static std::string make_logpoint_eval(const std::string &msg) {
+	std::string result = "return \"\"";
+	std::string::size_type pos = 0;
+
+	while (pos < msg.length()) {
+		std::string::size_type open = msg.find('{', pos);
+		std::string::size_type close = msg.npos;
+
+		// Find the pair of '{', the braces may be nested.
+		if (open != msg.npos) {
+			int depth = 0;
+			for (std::string::size_type i = open; i < msg.length(); ++i) {
+				if (msg[i] == '{') {
+					++depth;
+				}
+				else if (msg[i] == '}' && --depth == 0) {
+					close = i;
+					break;
+				}
+			}
+		}
+
+		// The literal part (it's quoted with the decimal escapes)
+		std::string::size_type end = (close != msg.npos ? open : msg.length());
+		result += ", \"";
+		for (std::string::size_type i = pos; i < end; ++i) {
+			unsigned char c = (unsigned char)msg[i];
+			if (c < 0x20 || c == '\\' || c == '"') {
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\%03d", c);
+				result += buffer;
+			}
+			else {
+				result += (char)c;
+			}
+		}
+		result += "\"";
+
+		if (close == msg.npos) {
+			break;
+		}
+
+		// The expression part
+		result += ", (";
+		result += msg.substr(open + 1, close - open - 1);
+		result += "\n)";
+		pos = close + 1;
+	}
+
+	return result;
+}
+
+int Context::LuaFormatLogpoint(lua_State *L, int level, const std::string &msg,
+							   std::string &result) {
+	scoped_lua scoped(this, L, false);
+	int top = lua_gettop(L);
+
+	if (LuaEvalCached(L, level, make_logpoint_eval(msg), LUA_MULTRET) != 0) {
+		result = ParseLuaError(llutil_tostring_fast(L, -1)).message;
+		lua_settop(L, top);
+		scoped.check(0);
+		return -1;
+	}
+
+	// Concat the results, the strings are used as it is.
+	result.clear();
+	for (int idx = top + 1; idx <= lua_gettop(L); ++idx) {
+		if (lua_type(L, idx) == LUA_TSTRING) {
+			result.append(lua_tostring(L, idx), lua_strlen(L, idx));
+		}
+		else {
+			result += llutil_tostring(L, idx);
+		}
+	}
+
+	lua_settop(L, top);
+	scoped.check(0);
+	return 0;
+}
+
 LuaVarList Context::LuaEvalsToVarList(const string_array &evals,
 									  const LuaStackFrame &stackFrame,
 									  bool withDebug) {
 	lua_State *L = stackFrame.GetLua().GetState();
-	if (L == NULL) L = GetLua();
-	scoped_lock lock(m_mutex);
+	if (L == NULL || !IsThreadAlive(L)) L = GetLua();
 	scoped_lua scoped(this, L, withDebug);
 	LuaVarList result;
 
@@ -1530,12 +4587,127 @@ LuaVarList Context::LuaEvalsToVarList(const string_array &evals,
 	return result;
 }
 
+/// The size limit of the break snapshot. (bytes)
+static const std::size_t BREAK_SNAPSHOT_SIZE = 64 * 1024;
+
+/// The encoded size of the fields of an item except the strings. (bytes)
+/**
+ * It's more than the text archive writes, so the estimate isn't short.
+ */
+static const std::size_t SNAPSHOT_ITEM_SIZE = 64;
+
+/// Estimate the encoded size of the variable.
+static std::size_t EstimateSnapshotSize(const LuaVar &var) {
+	return (SNAPSHOT_ITEM_SIZE + var.GetName().size() + var.GetValue().size());
+}
+
+/// Estimate the encoded size of the function call.
+static std::size_t EstimateSnapshotSize(const LuaBacktrace &bt) {
+	return (SNAPSHOT_ITEM_SIZE + bt.GetFuncName().size()
+		+ bt.GetKey().size() + bt.GetTitle().size());
+}
+
+/**
+ * @brief Make a LuaVarList object in the rest of the snapshot's size.
+ *
+ * It stops the iteration when the budget is spent,
+ * so the variables after it aren't converted.
+ */
+struct snapshot_varlist_maker {
+	explicit snapshot_varlist_maker(std::size_t budget)
+		: m_budget(budget), m_size(0) {
+	}
+
+	int operator()(lua_State *L, const std::string &name, int valueIdx) {
+		m_result.push_back(LuaVar(LuaHandle(L), name, valueIdx));
+		m_size += EstimateSnapshotSize(m_result.back());
+		return (m_size <= m_budget ? 0 : 1);
+	}
+
+	/// Is the size in the budget ?
+	bool is_fit() const {
+		return (m_size <= m_budget);
+	}
+
+	/// Get the estimated size.
+	std::size_t get_size() const {
+		return m_size;
+	}
+
+	/// Get the result.
+	LuaVarList &get_result() {
+		return m_result;
+	}
+
+private:
+	std::size_t m_budget;
+	std::size_t m_size;
+	LuaVarList m_result;
+};
+
+/**
+ * The parts are added in the order the frame paints them, while they
+ * are in the size limit. The others are requested by the frame.
+ * The sizes are estimated while the parts are made, and the part that
+ * exceeds the rest of the limit isn't made further. The snapshot is
+ * encoded only once, when it's sent.
+ */
+LuaBreakSnapshot Context::LuaGetBreakSnapshot() {
+	LuaBreakSnapshot snapshot;
+	std::size_t size = 0;
+
+	LuaBacktraceList backtraces = LuaGetBacktrace();
+	std::size_t backtraceSize = 0;
+	LuaBacktraceList::const_iterator bt;
+	for (bt = backtraces.begin(); bt != backtraces.end(); ++bt) {
+		backtraceSize += EstimateSnapshotSize(*bt);
+	}
+	if (size + backtraceSize <= BREAK_SNAPSHOT_SIZE) {
+		snapshot.SetBacktraces(backtraces);
+		size += backtraceSize;
+	}
+
+	// The locals and the upvalues of the top frame.
+	snapshot_varlist_maker locals(BREAK_SNAPSHOT_SIZE - size);
+	if (iterate_locals(locals, GetLua(), 0, true, true, false) == 0
+		&& locals.is_fit()) {
+		snapshot.SetLocals(locals.get_result());
+		size += locals.get_size();
+	}
+
+	string_array watchEvals;
+	{
+		scoped_lock lock(m_mutex);
+		watchEvals = m_watchEvals;
+	}
+
+	// Each watch is evaluated only while the rest is left.
+	if (!watchEvals.empty()) {
+		LuaVarList watches;
+		std::size_t watchSize = 0;
+		string_array::const_iterator it;
+		for (it = watchEvals.begin(); it != watchEvals.end(); ++it) {
+			watches.push_back(LuaEvalToVar(*it, LuaStackFrame(), true));
+			watchSize += it->size() + EstimateSnapshotSize(watches.back());
+			if (size + watchSize > BREAK_SNAPSHOT_SIZE) {
+				break;
+			}
+		}
+
+		if (size + watchSize <= BREAK_SNAPSHOT_SIZE) {
+			snapshot.SetWatches(watchEvals, watches);
+			size += watchSize;
+		}
+	}
+
+	return snapshot;
+}
+
 LuaVarList Context::LuaEvalToMultiVar(const std::string &eval,
 									  const LuaStackFrame &stackFrame,
 									  bool withDebug) {
 	lua_State *L = stackFrame.GetLua().GetState();
-	if (L == NULL) L = GetLua();
-	scoped_lock lock(m_mutex);
+	if (L == NULL || !IsThreadAlive(L)) L = GetLua();
 	scoped_lua scoped(this, L, withDebug);
 	LuaVarList result;
 	int beginningtop = lua_gettop(L);
@@ -1563,8 +4735,7 @@ LuaVar Context::LuaEvalToVar(const std::string &eval,
 							 const LuaStackFrame &stackFrame,
 							 bool withDebug) {
 	lua_State *L = stackFrame.GetLua().GetState();
-	if (L == NULL) L = GetLua();
-	scoped_lock lock(m_mutex);
+	if (L == NULL || !IsThreadAlive(L)) L = GetLua();
 	scoped_lua scoped(this, L, withDebug);
 	int beginningtop = lua_gettop(L);
 
@@ -32,6 +32,12 @@
 #include "luainfo.h"
 #include "queue_mt.h"
 #include "net/command.h"
+#include "context/profiler.h"
+#include "context/coverage.h"
+
+#include <boost/detail/atomic_count.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/noncopyable.hpp>
 
 namespace lldebug {
 namespace context {
@@ -74,6 +80,8 @@ public:
 	void OutputLuaError(const char *str);
 	void OutputLog(LogType type, const std::string &str,
 				   const std::string &key=std::string(""), int line=-1);
+	void OutputLogpoint(const LogData &logData);
+	void GetLogpointCount(unsigned long &posted, unsigned long &dropped);
 
 	void SetEncoding(lldebug_Encoding encoding);
 
@@ -87,27 +95,141 @@ public:
 
 	lua_State *NewThread(lua_State *L);
 
+	/// Start the sampling profiler, it samples every 'interval' msec.
+	int StartProfile(int interval);
+	/// Stop the profiler, and get the folded stacks for flamegraph.
+	std::string StopProfile();
+
+	/// Start the function profiler, the old records are cleared.
+	void StartFuncProfile();
+	/// Stop the function profiler, the records are kept.
+	void StopFuncProfile();
+	/// Get the records of the function profiler.
+	LuaFuncProfileList GetFuncProfile();
+
+	/// Start the line coverage, the old hit counts are cleared.
+	/**
+	 * In the 'firstHitOnly' mode, the covered functions run without
+	 * the line hook, so the hit counts are only 0 or 1 and more.
+	 */
+	void StartCoverage(bool firstHitOnly);
+	/// Stop the line coverage, the hit counts are kept.
+	void StopCoverage();
+	/// Get the hit counts of the sources.
+	SourceCoverageList GetCoverage();
+
+	/// Start the allocation profiler, the old records are cleared.
+	/**
+	 * It needs the allocator of lldebug. (see lldebug_setallocprofiling)
+	 */
+	int StartAllocProfile();
+	/// Stop the allocation profiler, the records are kept.
+	void StopAllocProfile();
+	/// Get the records of the allocation profiler, the most live bytes first.
+	LuaAllocProfileList GetAllocProfile();
+
+	/// Start the scheduler profiler, the old records are cleared.
+	void StartSchedProfile();
+	/// Stop the scheduler profiler, the records are kept.
+	void StopSchedProfile();
+	/// Get the records of the scheduler profiler, the most run time first.
+	LuaSchedProfileList GetSchedProfile();
+
+	/// Start the call tracer, the old events are cleared.
+	/**
+	 * Each OS thread keeps the latest 'bufferSize' calls, and only
+	 * the functions whose file name starts with 'prefix' are traced.
+	 */
+	void StartTrace(int bufferSize, const std::string &prefix);
+	/// Stop the call tracer, the events are kept.
+	void StopTrace();
+	/// Get the events of the call tracer in the trace event format of Chrome.
+	std::string GetTrace();
+
+	/// Save the snapshot of the objects reachable from the registry,
+	/// the globals and the coroutines.
+	int SaveHeapSnapshot(const std::string &filename);
+
+	/// Start the GC monitor, it samples the heap size every 'interval' msec.
+	/**
+	 * The samples are sent to the frame, and written to 'filename'
+	 * in csv if it isn't empty.
+	 */
+	int StartGcMonitor(int interval, const std::string &filename);
+	/// Stop the GC monitor.
+	void StopGcMonitor();
+	/// Break when the heap exceeds 'kbytes', 0 disarms it.
+	/**
+	 * It's checked by the count hook, and disarmed when it breaks.
+	 */
+	void SetGcThreshold(int kbytes);
+
+	/// Debug only the coroutines that pass the filter.
+	/**
+	 * The other coroutines are hooked only by the profilers, and they
+	 * don't break, step or stop at the breakpoints.
+	 */
+	void SetDebugFilter(DebugFilterType type, const std::string &pattern);
+
 	//void Call(lua_State *L, int nargs, int nresults);
 	int PCall(lua_State *L, int nargs, int nresults, int errfunc);
 	int Resume(lua_State *L, int nargs);
 
 	LuaVarList LuaGetGlobals();
 	LuaVarList LuaGetRegistories();
-	LuaVarList LuaGetFields(const LuaVar &var);
+	/// Get the fields of var in [offset, offset + count).
+	/**
+	 * 'total' is set to the number of all the fields.
+	 * 'resume' is the id returned with the previous page, the page
+	 * continues from its last key. It's set to the id for the next page.
+	 */
+	LuaVarList LuaGetFields(const LuaVar &var, int offset, int count,
+							int &total, int &resume);
+	/// Get the fields of var that match the query in [offset, offset + count).
+	/**
+	 * 'total' is set to the number of all the matched fields.
+	 * The fields that the predicate fails on don't match, and 'error' is
+	 * set to the first error, or the error of the query itself.
+	 * Each call of the predicate runs in the limited instructions, if it's
+	 * exceeded, the fields matched before it are returned with 'error'.
+	 */
+	LuaVarList LuaQueryFields(const LuaVar &var, const LuaFieldQuery &query,
+							  int offset, int count, int &total,
+							  std::string &error);
 	LuaVarList LuaGetLocals(const LuaStackFrame &stackFrame, bool checkLocal,
 							bool checkUpvalue, bool checkEnviron);
 	LuaVarList LuaGetStack();
 	LuaBacktraceList LuaGetBacktrace();
+	/// Get the backtrace of the coroutine, it's empty if it was collected.
+	LuaBacktraceList LuaGetBacktrace(const LuaHandle &lua);
+	/// Get a page of the live coroutines sorted by 'sortKey'(CoroutineSortKey).
+	/**
+	 * 'total' is set to the number of all the live coroutines.
+	 */
+	LuaCoroutineList LuaGetCoroutines(int offset, int count, int sortKey,
+									  bool isAscending, int &total);
 
 	int LuaEval(lua_State *L, int level, const std::string &str, bool withDebug);
+	/// Evaluate the breakpoint condition, it returns 1(true), 0(false) or -1(error).
+	int LuaEvalCondition(lua_State *L, int level, const std::string &cond,
+						 std::string &error);
+	/// Format the logpoint message, it returns 0 or -1(error, 'result' has the message).
+	int LuaFormatLogpoint(lua_State *L, int level, const std::string &msg,
+						  std::string &result);
 	LuaVarList LuaEvalsToVarList(const string_array &array, const LuaStackFrame &stackFrame, bool withDebug);
 	LuaVarList LuaEvalToMultiVar(const std::string &str, const LuaStackFrame &stackFrame, bool withDebug);
 	LuaVar LuaEvalToVar(const std::string &str, const LuaStackFrame &stackFrame, bool withDebug);
+	/// Get the values the frame shows first after the break.
+	LuaBreakSnapshot LuaGetBreakSnapshot();
 
-	/// Get the current lua_State object.
+	/// Get the current lua_State object of the calling thread.
 	lua_State *GetLua() {
-		scoped_lock lock(m_mutex);
-		return m_coroutines.back().L;
+		// Only the calling thread changes its coroutines.
+		ThreadInfo *thread = FindCurrentThread();
+		if (thread == NULL || thread->coroutines.empty()) {
+			return GetMainLua();
+		}
+		return thread->coroutines.back().L;
 	}
 
 	/// Get the first lua_State object.
@@ -140,25 +262,28 @@ public:
 		return m_sourceManager.Get(key);
 	}
 
-	/// Is debug enable ?
+	/// Is debug enable on the calling thread ?
 	bool IsDebugEnabled() {
-		scoped_lock lock(m_mutex);
-		return m_isEnabled;
+		return GetThread(NULL).isEnabled;
 	}
 
-	/// Set whether the debug is enabled.
+	/// Set whether the debug is enabled on the calling thread.
+	/**
+	 * The other threads are still debugged, while lldebug evaluates
+	 * the lua on this thread.
+	 */
 	void SetDebugEnable(bool enabled) {
-		scoped_lock lock(m_mutex);
-		m_isEnabled = enabled;
+		GetThread(NULL).isEnabled = enabled;
 	}
 
 private:
+	struct ThreadInfo;
 	int CreateDebuggerFrame();
 	int WaitForDebuggerFrame();
 	int LoadConfig();
 	int SaveConfig();
 	void OnRemoteCommand(const Command &command);
-	int HandleCommand();
+	int HandleCommand(ThreadInfo *thread = NULL);
 
 private:
 	/// Data parsed the lua error.
@@ -174,33 +299,77 @@ private:
 	LuaErrorData ParseLuaError(const std::string &str);
 	void OutputLogInternal(const LogData &logData, bool sendRemote);
 
-	static void SetHook(lua_State *L);
-	void HookCallback(lua_State *L, lua_Debug *ar);
+	int LuaEvalCached(lua_State *L, int level, const std::string &str, int nresults);
+
+	void *Alloc(void *ptr, std::size_t osize, std::size_t nsize);
+	static void *s_Alloc(void *ud, void *ptr, std::size_t osize, std::size_t nsize);
+
+	void SetHook(lua_State *L, int mask);
+	void UpdateHookMask();
+	void UpdateHookMask(ThreadInfo &thread);
+	void RefreshHook(ThreadInfo &thread);
+	int HookCallback(lua_State *L, lua_Debug *ar);
 	static void s_HookCallback(lua_State *L, lua_Debug *ar);
 	void SetDebugState(DebugState state);
+	void SetDebugState(ThreadInfo &thread, DebugState state);
+	bool IsBreakpointHit(lua_State *L, lua_Debug *ar, int sourceId);
 
 	class LuaImpl;
 	friend class LuaImpl;
 	int LuaInitialize(lua_State *L);
 	void BeginCoroutine(lua_State *L);
 	void EndCoroutine(lua_State *L);
+	void OnThreadFreed(lua_State *L);
+	int MakeThreadSite(lua_State *L, int &line);
+	int FindThreadSite(lua_State *L1, int &line);
+	int MakeThreadTag(const std::string &tag);
+	bool IsDebugTarget(int site, int tag, bool isMarked);
+	void RefreshDebugTarget(lua_State *L1, int site, int tag, bool isMarked);
+	bool IsThreadAlive(lua_State *L1);
+	int AddBacktrace(lua_State *L1, LuaBacktraceList &array);
 
 private:
 	class ContextManager;
 	static shared_ptr<ContextManager> ms_manager;
 
 	mutex m_mutex;
+	unsigned long m_id; ///< the serial number of this context
 	lua_State *m_lua;
 	//State m_state;
-	DebugState m_debugState;
-	bool m_isCallSuccess;
-	bool m_isEnabled;
+	int m_hookMask; ///< the hook mask with the frame, 0 if the frame doesn't exist
 	int m_updateCount;
 	int m_waitUpdateCount;
 	bool m_isMustUpdate;
+	string_array m_watchEvals; ///< the last watch expressions of the top frame
 	LoggerType m_logger;
 	lldebug_Encoding m_encoding;
 
+	/**
+	 * @brief Whether the function activation needs the line hook.
+	 *
+	 * 'call' is the call count when the function was called.
+	 * 'source' is the source string of the lua function, it's alive
+	 * while the function runs.
+	 * 'allocSite' is the site of the allocation profiler, or -1 if unknown.
+	 */
+	struct ActivationInfo {
+		ActivationInfo(int call_ = 0, int sourceId_ = -1,
+					   bool needsLine_ = true, int lineDefined_ = 0,
+					   int lastLineDefined_ = -1, const char *source_ = NULL)
+			: call(call_), sourceId(sourceId_), needsLine(needsLine_)
+			, lineDefined(lineDefined_), lastLineDefined(lastLineDefined_)
+			, source(source_), allocSite(-1) {
+		}
+		int call;
+		int sourceId; ///< -1 if the source has no breakpoints
+		bool needsLine;
+		int lineDefined;
+		int lastLineDefined; ///< -1 if unknown
+		const char *source; ///< NULL for C functions
+		int allocSite;
+	};
+	typedef std::vector<ActivationInfo> ActivationList;
+
 	/**
 	 * @brief Saving the call count of each lua_State object.
 	 *
@@ -208,22 +377,195 @@ private:
 	 */
 	struct CoroutineInfo {
 		CoroutineInfo(lua_State *L_ = NULL, int call_ = 0)
-			: L(L_), call(call_) {
+			: L(L_), call(call_), isDebugged(true), filterSerial(0)
+			, hookMask(L_ != NULL ? lua_gethookmask(L_) : 0) {
+		}
+
+		/// Does the current activation need the line hook ?
+		/** If it's unknown, it returns true to be safe.
+		 */
+		bool IsLineNeeded() const {
+			return (activations.empty()
+				|| activations.back().call != call
+				|| activations.back().needsLine);
+		}
+
+		/// Get the current activation, or NULL if it's unknown.
+		const ActivationInfo *GetActivation() const {
+			if (activations.empty() || activations.back().call != call) {
+				return NULL;
+			}
+
+			return &activations.back();
 		}
+
 		lua_State *L;
 		int call;
+		ActivationList activations;
+		bool isDebugged; ///< does it pass the debug filter ?
+		unsigned long filterSerial; ///< the filter 'isDebugged' was decided by
+		int hookMask; ///< the hook mask the thread set last
 	};
 	typedef std::vector<CoroutineInfo> CoroutineList;
-	CoroutineList m_coroutines;
-	CoroutineInfo m_stepinfo;
+
+	/// The source id of an interned source string. (see GetSourceId)
+	struct SourceCacheEntry {
+		SourceCacheEntry() : source(NULL), id(-1), generation(-1) {}
+		const char *source;
+		int id;
+		long generation;
+	};
+	/// The cache is set associative, the recent one is the first of a set.
+	enum { SOURCE_CACHE_SETS = 64, SOURCE_CACHE_WAYS = 4 };
+
+	/**
+	 * @brief The settings the hook of each thread works with.
+	 *
+	 * The context decides them from the debug state of the thread
+	 * and the profilers, and the thread copies them in its next hook.
+	 */
+	struct HookSettings {
+		HookSettings()
+			: state(DEBUGSTATE_RUNNING), frameMask(0), profilerMask(0)
+			, isSampling(false), isProfiling(false), isTracing(false)
+			, isScheduling(false), isWatchingGc(false), isCovering(false), isAllocating(false)
+			, isFiltering(false), filterSerial(0) {
+		}
+		DebugState state;
+		int frameMask; ///< the hook mask the frame needs, 0 without the frame
+		int profilerMask; ///< the hook mask the profilers need
+		bool isSampling; ///< is the sampling profiler running ?
+		bool isProfiling; ///< is the function profiler running ?
+		bool isTracing; ///< is the call tracer running ?
+		bool isScheduling; ///< is the scheduler profiler running ?
+		bool isWatchingGc; ///< is the GC monitor running or armed ?
+		bool isCovering; ///< is the coverage running ?
+		bool isAllocating; ///< is the allocation profiler running ?
+		bool isFiltering; ///< isn't the debug filter DEBUGFILTER_ALL ?
+		unsigned long filterSerial; ///< the serial of the debug filter
+		/// The snapshot of the breakpoints the line hook checks, or NULL.
+		shared_ptr<const BreakpointList> breakpoints;
+	};
+
+	/**
+	 * @brief The debug state of each OS thread that runs lua.
+	 *
+	 * The host may run a lua_State on each thread, and each thread
+	 * breaks, steps and resumes without stopping the others.
+	 * 'coroutines' is the chain of the coroutines the thread resumes.
+	 * 'calls' is the depth of Context::PCall and Context::Resume.
+	 *
+	 * The hook of the thread works with 'hook', 'sampledTicks', 'sourceCache',
+	 * 'funcTimeline', 'traceRing' and the activations without the lock of
+	 * the context, only the owner thread uses them. The context changes
+	 * 'settings' with 'settingsMutex' and counts 'changes' up,
+	 * 'settingsMutex' is the innermost lock.
+	 * 'debugState' and 'isShown' are guarded by the lock of the context.
+	 * Only the owner thread changes the chain of the coroutines, it does
+	 * with 'chainMutex' and reads without any lock. The other threads read
+	 * the chain with the lock of the context and then 'chainMutex'.
+	 */
+	struct ThreadInfo : private boost::noncopyable {
+		explicit ThreadInfo(int id_, DebugState debugState_ = DEBUGSTATE_RUNNING)
+			: id(id_), debugState(debugState_), calls(0)
+			, isCallSuccess(false), isShown(false), breakLine(-1)
+			, isEnabled(true), changes(0), seenChanges(0), sampledTicks(0) {
+		}
+		int id;
+		DebugState debugState;
+		mutex chainMutex;
+		CoroutineList coroutines;
+		CoroutineInfo stepinfo;
+		int calls;
+		bool isCallSuccess;
+		bool isShown; ///< the frame shows the break of this thread
+		std::string breakKey;
+		int breakLine;
+		bool isEnabled; ///< false while lldebug evaluates the lua
+
+		mutex settingsMutex;
+		HookSettings settings; ///< the latest settings
+		boost::detail::atomic_count changes; ///< counted up with 'settings'
+		long seenChanges; ///< 'changes' when 'hook' was copied
+		HookSettings hook; ///< the settings the hook works with
+		long sampledTicks; ///< the tick of the sampler it sampled last
+		SourceCacheEntry sourceCache[SOURCE_CACHE_SETS][SOURCE_CACHE_WAYS];
+		/// The timeline of the function profiler, or NULL.
+		shared_ptr<FunctionProfiler::Timeline> funcTimeline;
+		shared_ptr<CallTracer::Ring> traceRing; ///< the ring of the tracer, or NULL
+	};
+	typedef std::map<int, shared_ptr<ThreadInfo> > ThreadMap;
+	ThreadMap m_threads;
+	int m_mainThread;
+	int m_selectedThread; ///< the thread the frame inspects and steps
+	std::list<Command> m_deferredCommands;
+
+	/// The debug state of the calling thread in the context it used last.
+	struct CurrentThread {
+		unsigned long contextId;
+		shared_ptr<ThreadInfo> thread;
+	};
+	static boost::thread_specific_ptr<CurrentThread> ms_currentThread;
+
+	static int GetThreadId();
+	ThreadInfo *FindThread(int id);
+	ThreadInfo *FindCurrentThread();
+	ThreadInfo &GetThread(lua_State *L);
+	bool IsInspecting(const ThreadInfo *thread);
+	void SelectThread(int id);
+	void SendThreadList();
+	void BeginCall(lua_State *L);
+	bool EndCall(lua_State *L, int ret);
+
+	int GetHookMask(const ThreadInfo &thread, const CoroutineInfo &info);
+	int GetProfilerMask();
+	void ApplyHookMask(ThreadInfo &thread, CoroutineInfo &info);
+	void UpdateDebugTarget(ThreadInfo &thread, CoroutineInfo &info);
+	void SampleStacks(lua_State *L);
+	void CheckGc(lua_State *L);
+	FunctionProfiler::Timeline *GetFuncTimeline(ThreadInfo &thread, lua_State *L);
+	CallTracer::Ring *GetTraceRing(ThreadInfo &thread, lua_State *L);
+	void ApplyHookMasks();
+	void RecheckDebugTargets();
+	ActivationInfo MakeActivationInfo(ThreadInfo &thread, lua_State *L,
+									  lua_Debug *ar, int call,
+									  DebugState state);
+	int GetSourceId(ThreadInfo &thread, lua_State *L, const char *source);
+	int AddSource(const std::string &key, const std::string &src);
+	void UpdateBreakpoints();
 
 	queue_mt<Command> m_readCommands;
+	/// The number of the commands in m_readCommands. (lock free)
+	boost::detail::atomic_count m_pendingCommands;
 	condition m_commandCond;
 
 	shared_ptr<RemoteEngine> m_engine;
 	SourceManager m_sourceManager;
 	BreakpointList m_breakpoints;
+	/// The copy of m_breakpoints the threads share in their settings.
+	shared_ptr<const BreakpointList> m_breakpointSnapshot;
+	/// Counted up when the sources or the breakpoints are changed. (lock free)
+	boost::detail::atomic_count m_sourceGeneration;
 	std::string m_rootFileKey;
+	SamplingProfiler m_profiler;
+	FunctionProfiler m_funcProfiler;
+	CoverageRecorder m_coverage;
+	AllocationProfiler m_allocProfiler;
+	SchedulerProfiler m_schedProfiler;
+	CallTracer m_tracer;
+	GcMonitor m_gcMonitor;
+
+	/// The source keys where the coroutines were created.
+	string_array m_threadSites;
+	std::map<std::string, int> m_threadSiteIds;
+
+	/// The tags of the coroutines set by 'lldebug.settag'.
+	string_array m_threadTags;
+	std::map<std::string, int> m_threadTagIds;
+
+	DebugFilterType m_debugFilter;
+	std::string m_debugPattern;
+	unsigned long m_filterSerial; ///< it's changed with the filter
 };
 
 } // end of namespace context
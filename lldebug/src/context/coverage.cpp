@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "precomp.h"
+#include "context/coverage.h"
+
+namespace lldebug {
+namespace context {
+
+CoverageRecorder::CoverageRecorder()
+	: m_isRunning(false), m_isFirstHitOnly(false) {
+}
+
+CoverageRecorder::~CoverageRecorder() {
+}
+
+void CoverageRecorder::Start(bool firstHitOnly) {
+	m_isFirstHitOnly = firstHitOnly;
+	m_isRunning = true;
+}
+
+void CoverageRecorder::Stop() {
+	m_isRunning = false;
+}
+
+void CoverageRecorder::Clear() {
+	m_sources.clear();
+	m_unknownSources.clear();
+}
+
+void CoverageRecorder::Resize(SourceInfo &info, std::size_t size) {
+	info.hits.resize(size, -1);
+	info.owners.resize(size, -1);
+}
+
+bool CoverageRecorder::OnCall(lua_State *L, lua_Debug *ar, int sourceId) {
+	if (sourceId < 0) {
+		return true;
+	}
+
+	if ((std::size_t)sourceId >= m_sources.size()) {
+		m_sources.resize(sourceId + 1);
+	}
+
+	// The main chunk is defined at the line 0.
+	SourceInfo &info = m_sources[sourceId];
+	int lineDefined = (*ar->what == 'm' ? 0 : ar->linedefined);
+	if (lineDefined < 0) {
+		return true;
+	}
+
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM >= 501
+	int lastLineDefined = (*ar->what == 'm' ? 0 : ar->lastlinedefined);
+#else
+	int lastLineDefined = -1;
+#endif
+
+	if ((std::size_t)lineDefined >= info.defined.size()) {
+		info.defined.resize(lineDefined + 1, -1);
+	}
+
+	int index = info.defined[lineDefined];
+	while (index >= 0
+		&& info.functions[index].lastLineDefined != lastLineDefined) {
+		index = info.functions[index].next;
+	}
+
+	// Register the lines only once.
+	if (index < 0) {
+		FunctionInfo function;
+		function.lastLineDefined = lastLineDefined;
+		function.remains = 0;
+		function.next = info.defined[lineDefined];
+
+		index = (int)info.functions.size();
+		info.functions.push_back(function);
+		info.defined[lineDefined] = index;
+		info.functions[index].remains = RegisterLines(L, ar, info, index);
+	}
+
+	return (!m_isFirstHitOnly || info.functions[index].remains > 0);
+}
+
+/// Register the lines that have the code, and return the uncovered ones.
+int CoverageRecorder::RegisterLines(lua_State *L, lua_Debug *ar,
+									SourceInfo &info, int function) {
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM >= 501
+	// The table of the active lines is pushed.
+	lua_getinfo(L, "L", ar);
+	if (!lua_istable(L, -1)) {
+		lua_pop(L, 1);
+		return 1;
+	}
+
+	int uncovered = 0;
+	lua_pushnil(L);
+	while (lua_next(L, -2) != 0) {
+		int line = (int)lua_tonumber(L, -2);
+		lua_pop(L, 1);
+
+		if (line <= 0) {
+			continue;
+		}
+
+		if ((std::size_t)line >= info.hits.size()) {
+			Resize(info, line + 1);
+		}
+
+		if (info.hits[line] < 0) {
+			info.hits[line] = 0;
+		}
+
+		// The covered line needs no owner.
+		if (info.hits[line] == 0) {
+			OwnerLink link;
+			link.function = function;
+			link.next = info.owners[line];
+			info.owners[line] = (int)info.links.size();
+			info.links.push_back(link);
+			++uncovered;
+		}
+	}
+
+	lua_pop(L, 1);
+	return uncovered;
+#else
+	// The active lines are unknown, so the line hook is always needed.
+	return 1;
+#endif
+}
+
+bool CoverageRecorder::GetHits(int sourceId, std::vector<int> &hits) const {
+	if (sourceId < 0 || (std::size_t)sourceId >= m_sources.size()) {
+		return false;
+	}
+
+	const SourceInfo &info = m_sources[sourceId];
+	if (info.hits.empty()) {
+		return false;
+	}
+
+	// The line 0 has no meaning.
+	hits.assign(info.hits.begin() + 1, info.hits.end());
+	return true;
+}
+
+} // end of namespace context
+} // end of namespace lldebug
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __LLDEBUG_COVERAGE_H__
+#define __LLDEBUG_COVERAGE_H__
+
+namespace lldebug {
+namespace context {
+
+/**
+ * @brief Line coverage of the lua sources.
+ *
+ * The hit counts are kept in the compact arrays indexed by the interned
+ * source id and the line. In the 'first hit only' mode, the functions
+ * whose lines are all covered don't need the line hook any more,
+ * so the hit counts are only 0 or more than 0 in the mode.
+ * A function is identified by its defined line and its last line,
+ * and a line may belong to some functions. (e.g. the one-liner)
+ *
+ * This object must be used with the lock of Context.
+ */
+class CoverageRecorder {
+public:
+	explicit CoverageRecorder();
+	~CoverageRecorder();
+
+	/// Start recording.
+	void Start(bool firstHitOnly);
+
+	/// Stop recording, the hit counts are kept until 'Clear' is called.
+	void Stop();
+
+	/// Forget all the hit counts.
+	void Clear();
+
+	/// Is the coverage running ?
+	bool IsRunning() const {
+		return m_isRunning;
+	}
+
+	/// Register the lines of the calling function.
+	/**
+	 * It returns whether the function needs the line hook.
+	 */
+	bool OnCall(lua_State *L, lua_Debug *ar, int sourceId);
+
+	/// Count up the line. (it starts from 1)
+	/**
+	 * It returns true if all lines of a function were covered by this line.
+	 */
+	bool OnLine(int sourceId, int line) {
+		if (sourceId < 0 || (std::size_t)sourceId >= m_sources.size()
+			|| line <= 0) {
+			return false;
+		}
+
+		SourceInfo &info = m_sources[sourceId];
+		if ((std::size_t)line >= info.hits.size()) {
+			Resize(info, line + 1);
+		}
+
+		int &hit = info.hits[line];
+		if (hit > 0) {
+			++hit;
+			return false;
+		}
+
+		// Only the registered line is counted as uncovered.
+		bool wasRegistered = (hit == 0);
+		hit = 1;
+		if (!wasRegistered) {
+			return false;
+		}
+
+		bool isCovered = false;
+		for (int link = info.owners[line]; link >= 0;
+			link = info.links[link].next) {
+			int &remains = info.functions[info.links[link].function].remains;
+			if (remains > 0 && --remains == 0) {
+				isCovered = true;
+			}
+		}
+
+		return isCovered;
+	}
+
+	/// Get the hit counts of the source id, which are indexed by the line
+	/// starting from 0. It returns false if the source has no record.
+	bool GetHits(int sourceId, std::vector<int> &hits) const;
+
+	/// Has the source failed to be registered ? (it's not retried)
+	bool IsUnknownSource(const void *source) const {
+		return (m_unknownSources.find(source) != m_unknownSources.end());
+	}
+
+	/// Remember the source failed to be registered.
+	void AddUnknownSource(const void *source) {
+		m_unknownSources.insert(source);
+	}
+
+private:
+	/// A function, the functions defined at the same line are chained.
+	struct FunctionInfo {
+		int lastLineDefined;
+		int remains; ///< the uncovered lines
+		int next;    ///< the next function defined at the same line, or -1
+	};
+
+	/// A function that has the uncovered line, the owners are chained.
+	struct OwnerLink {
+		int function;
+		int next;
+	};
+
+	/// The records of a source.
+	struct SourceInfo {
+		std::vector<int> hits;    ///< indexed by line, -1 means no code
+		std::vector<int> owners;  ///< the first link of the line, or -1
+		std::vector<OwnerLink> links;
+		std::vector<int> defined; ///< the first function defined at the line, or -1
+		std::vector<FunctionInfo> functions;
+	};
+	typedef std::vector<SourceInfo> SourceList;
+
+	void Resize(SourceInfo &info, std::size_t size);
+	int RegisterLines(lua_State *L, lua_Debug *ar, SourceInfo &info,
+					  int function);
+
+private:
+	bool m_isRunning;
+	bool m_isFirstHitOnly;
+	SourceList m_sources;
+	std::set<const void *> m_unknownSources;
+};
+
+} // end of namespace context
+} // end of namespace lldebug
+
+#endif
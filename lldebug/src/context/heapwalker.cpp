@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "precomp.h"
+#include "context/heapwalker.h"
+
+#include <cstring>
+
+/// The initial size of the visited set, this must be a power of 2.
+#define HEAPWALKER_SET_SIZE (64 * 1024)
+
+namespace lldebug {
+namespace context {
+
+HeapWalker::PointerSet::PointerSet()
+	: m_table(HEAPWALKER_SET_SIZE, (const void *)NULL), m_count(0) {
+}
+
+static inline std::size_t HashPointer(const void *p) {
+	std::size_t h = reinterpret_cast<std::size_t>(p);
+	return ((h >> 3) ^ (h >> 17)) * 2654435761u;
+}
+
+bool HeapWalker::PointerSet::Insert(const void *p) {
+	std::size_t mask = m_table.size() - 1;
+	std::size_t pos = HashPointer(p) & mask;
+
+	// Linear probing, the table always has empty slots.
+	while (m_table[pos] != NULL) {
+		if (m_table[pos] == p) {
+			return false;
+		}
+		pos = (pos + 1) & mask;
+	}
+
+	// Keep the load factor under 0.5.
+	if ((m_count + 1) * 2 > m_table.size()) {
+		std::vector<const void *> table(m_table.size() * 2, (const void *)NULL);
+		mask = table.size() - 1;
+
+		for (std::size_t i = 0; i < m_table.size(); ++i) {
+			if (m_table[i] != NULL) {
+				std::size_t k = HashPointer(m_table[i]) & mask;
+				while (table[k] != NULL) {
+					k = (k + 1) & mask;
+				}
+				table[k] = m_table[i];
+			}
+		}
+
+		m_table.swap(table);
+		pos = HashPointer(p) & mask;
+		while (m_table[pos] != NULL) {
+			pos = (pos + 1) & mask;
+		}
+	}
+
+	m_table[pos] = p;
+	++m_count;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------*/
+/// Get the identifier of the object, or NULL if it isn't collectable.
+static const void *GetObjectId(lua_State *L, int idx) {
+	switch (lua_type(L, idx)) {
+	case LUA_TSTRING:
+		// The interned string never moves.
+		return lua_tostring(L, idx);
+	case LUA_TTABLE:
+	case LUA_TFUNCTION:
+	case LUA_TUSERDATA:
+	case LUA_TTHREAD:
+		return lua_topointer(L, idx);
+	default:
+		return NULL;
+	}
+}
+
+/// Move the value pushed on 'co' to 'L'.
+static void MoveValue(lua_State *co, lua_State *L) {
+	if (co != L) {
+		lua_xmove(co, L, 1);
+	}
+}
+
+HeapWalker::HeapWalker(lua_State *L, HeapSnapshotWriter &writer)
+	: m_L(L), m_writer(writer), m_pendingCount(0) {
+	lua_checkstack(L, 8);
+
+	// The collector must not free the objects while walking.
+	lua_gc(L, LUA_GCSTOP, 0);
+
+	// The table of the objects to traverse isn't a part of the heap.
+	lua_newtable(L);
+	m_pending = lua_gettop(L);
+	m_visited.Insert(lua_topointer(L, m_pending));
+}
+
+HeapWalker::~HeapWalker() {
+	lua_settop(m_L, m_pending - 1);
+	lua_gc(m_L, LUA_GCRESTART, 0);
+}
+
+void HeapWalker::AddRoot(int idx, const std::string &name) {
+	const void *p = GetObjectId(m_L, idx);
+	if (p == NULL) {
+		return;
+	}
+
+	m_writer.WriteRoot(p, name);
+	Visit(idx, NULL, NULL, 0);
+}
+
+void HeapWalker::Walk() {
+	lua_State *L = m_L;
+
+	while (m_pendingCount > 0) {
+		lua_rawgeti(L, m_pending, m_pendingCount);
+		lua_pushnil(L);
+		lua_rawseti(L, m_pending, m_pendingCount);
+		--m_pendingCount;
+
+		Traverse(lua_gettop(L));
+		lua_pop(L, 1);
+	}
+
+	m_writer.Finish();
+}
+
+/// Write the reference, and add the object to traverse if it's new.
+void HeapWalker::Visit(int idx, const void *from, const char *name,
+					   std::size_t len) {
+	lua_State *L = m_L;
+	const void *p = GetObjectId(L, idx);
+	if (p == NULL) {
+		return;
+	}
+
+	if (from != NULL) {
+		m_writer.WriteEdge(from, p, name, len);
+	}
+
+	if (!m_visited.Insert(p)) {
+		return;
+	}
+
+	// The string has no references.
+	if (lua_type(L, idx) == LUA_TSTRING) {
+		std::size_t size;
+		lua_tolstring(L, idx, &size);
+		m_writer.WriteNode(p, LUA_TSTRING, size + 24);
+		return;
+	}
+
+	lua_pushvalue(L, idx);
+	lua_rawseti(L, m_pending, ++m_pendingCount);
+}
+
+void HeapWalker::VisitName(int idx, const void *from, const char *name) {
+	Visit(idx, from, name, strlen(name));
+}
+
+void HeapWalker::Traverse(int idx) {
+	const void *p = lua_topointer(m_L, idx);
+
+	switch (lua_type(m_L, idx)) {
+	case LUA_TTABLE:
+		TraverseTable(idx, p);
+		break;
+	case LUA_TFUNCTION:
+		TraverseFunction(idx, p);
+		break;
+	case LUA_TUSERDATA:
+		TraverseUserdata(idx, p);
+		break;
+	case LUA_TTHREAD:
+		TraverseThread(idx, p);
+		break;
+	}
+}
+
+void HeapWalker::TraverseTable(int idx, const void *p) {
+	lua_State *L = m_L;
+	bool weakKeys = false, weakValues = false;
+
+	if (lua_getmetatable(L, idx)) {
+		VisitName(-1, p, "(metatable)");
+
+		lua_pushliteral(L, "__mode");
+		lua_rawget(L, -2);
+		if (lua_type(L, -1) == LUA_TSTRING) {
+			const char *mode = lua_tostring(L, -1);
+			weakKeys = (strchr(mode, 'k') != NULL);
+			weakValues = (strchr(mode, 'v') != NULL);
+		}
+		lua_pop(L, 2);
+	}
+
+	std::size_t count = 0;
+	char buffer[64];
+	lua_pushnil(L);
+	while (lua_next(L, idx) != 0) {
+		int keyType = lua_type(L, -2);
+		++count;
+
+		if (!weakValues) {
+			switch (keyType) {
+			case LUA_TSTRING: {
+				std::size_t len;
+				const char *key = lua_tolstring(L, -2, &len);
+				Visit(-1, p, key, len);
+				}
+				break;
+			case LUA_TNUMBER:
+				snprintf(buffer, sizeof(buffer), "[%.14g]", lua_tonumber(L, -2));
+				VisitName(-1, p, buffer);
+				break;
+			case LUA_TBOOLEAN:
+				VisitName(-1, p, (lua_toboolean(L, -2) ? "[true]" : "[false]"));
+				break;
+			default:
+				snprintf(buffer, sizeof(buffer), "[%s]", lua_typename(L, keyType));
+				VisitName(-1, p, buffer);
+				break;
+			}
+		}
+
+		// The string key is counted in the size of the table.
+		if (!weakKeys && keyType != LUA_TSTRING) {
+			VisitName(-2, p, "(key)");
+		}
+
+		lua_pop(L, 1);
+	}
+
+	m_writer.WriteNode(p, LUA_TTABLE, 32 + count * 40);
+}
+
+void HeapWalker::TraverseFunction(int idx, const void *p) {
+	lua_State *L = m_L;
+	lua_Debug ar;
+
+	lua_pushvalue(L, idx);
+	lua_getinfo(L, ">u", &ar);
+
+	for (int i = 1; i <= ar.nups; ++i) {
+		const char *name = lua_getupvalue(L, idx, i);
+		if (name == NULL) {
+			break;
+		}
+
+		// The upvalues of C function have no names.
+		std::string label = std::string("(upvalue ") + name + ")";
+		VisitName(-1, p, label.c_str());
+		lua_pop(L, 1);
+	}
+
+	lua_getfenv(L, idx);
+	VisitName(-1, p, "(environment)");
+	lua_pop(L, 1);
+
+	m_writer.WriteNode(p, LUA_TFUNCTION, 40 + ar.nups * 16);
+}
+
+void HeapWalker::TraverseUserdata(int idx, const void *p) {
+	lua_State *L = m_L;
+
+	if (lua_getmetatable(L, idx)) {
+		VisitName(-1, p, "(metatable)");
+		lua_pop(L, 1);
+	}
+
+	lua_getfenv(L, idx);
+	VisitName(-1, p, "(environment)");
+	lua_pop(L, 1);
+
+	m_writer.WriteNode(p, LUA_TUSERDATA, 40 + lua_objlen(L, idx));
+}
+
+void HeapWalker::TraverseThread(int idx, const void *p) {
+	lua_State *L = m_L;
+	lua_State *co = lua_tothread(L, idx);
+	lua_Debug ar;
+
+	lua_checkstack(co, 2);
+	lua_pushvalue(co, LUA_GLOBALSINDEX);
+	MoveValue(co, L);
+	VisitName(-1, p, "(globals)");
+	lua_pop(L, 1);
+
+	// The functions and the locals of the activations.
+	for (int level = 0; lua_getstack(co, level, &ar); ++level) {
+		char buffer[64];
+		lua_checkstack(co, 2);
+
+		if (lua_getinfo(co, "f", &ar)) {
+			MoveValue(co, L);
+			snprintf(buffer, sizeof(buffer), "(function %d)", level);
+			VisitName(-1, p, buffer);
+			lua_pop(L, 1);
+		}
+
+		const char *name;
+		for (int n = 1; (name = lua_getlocal(co, &ar, n)) != NULL; ++n) {
+			MoveValue(co, L);
+			std::string label = std::string("(local ") + name + ")";
+			VisitName(-1, p, label.c_str());
+			lua_pop(L, 1);
+		}
+	}
+
+	m_writer.WriteNode(p, LUA_TTHREAD, 64 + lua_gettop(co) * 16);
+}
+
+} // end of namespace context
+} // end of namespace lldebug
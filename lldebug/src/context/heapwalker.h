@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __LLDEBUG_HEAPWALKER_H__
+#define __LLDEBUG_HEAPWALKER_H__
+
+#include "heapsnapshot.h"
+
+namespace lldebug {
+namespace context {
+
+/**
+ * @brief Walk the all objects reachable from the roots.
+ *
+ * The objects are written to the snapshot while walking, and only
+ * the objects waiting for the traversal are kept in a lua table.
+ * The references of the weak tables are ignored, because they don't
+ * retain the objects. The sizes are estimated, lua doesn't tell them.
+ */
+class HeapWalker {
+public:
+	explicit HeapWalker(lua_State *L, HeapSnapshotWriter &writer);
+	~HeapWalker();
+
+	/// Add the value at 'idx' as the root.
+	void AddRoot(int idx, const std::string &name);
+
+	/// Walk the all objects, and finish the snapshot.
+	void Walk();
+
+private:
+	/// The set of the visited objects.
+	class PointerSet {
+	public:
+		explicit PointerSet();
+		/// Insert 'p', it returns false if it's already inserted.
+		bool Insert(const void *p);
+	private:
+		std::vector<const void *> m_table;
+		std::size_t m_count;
+	};
+
+	void Visit(int idx, const void *from, const char *name, std::size_t len);
+	void VisitName(int idx, const void *from, const char *name);
+	void Traverse(int idx);
+	void TraverseTable(int idx, const void *p);
+	void TraverseFunction(int idx, const void *p);
+	void TraverseUserdata(int idx, const void *p);
+	void TraverseThread(int idx, const void *p);
+
+private:
+	lua_State *m_L;
+	HeapSnapshotWriter &m_writer;
+	PointerSet m_visited;
+	int m_pending;      ///< the stack index of the table of the objects to traverse
+	int m_pendingCount;
+};
+
+} // end of namespace context
+} // end of namespace lldebug
+
+#endif
@@ -27,6 +27,8 @@
 #include "precomp.h"
 #include "lldebug.h"
 #include "context/context.h"
+#include "configfile.h"
+#include "heapsnapshot.h"
 
 using namespace lldebug;
 using context::Context;
@@ -206,6 +208,294 @@ lldebug_Encoding lldebug_getencoding(lua_State *L) {
 	return ctx->GetEncoding();
 }
 
+int lldebug_getlogpointcount(lua_State *L, unsigned long *posted,
+							 unsigned long *dropped) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	unsigned long p, d;
+	ctx->GetLogpointCount(p, d);
+	if (posted != NULL) {
+		*posted = p;
+	}
+	if (dropped != NULL) {
+		*dropped = d;
+	}
+	return 0;
+}
+
+int lldebug_profile_start(lua_State *L, int interval) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	return ctx->StartProfile(interval);
+}
+
+int lldebug_profile_stop(lua_State *L, const char *filename) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	std::string stacks = ctx->StopProfile();
+	if (filename == NULL) {
+		return 0;
+	}
+
+	safe_ofstream ofs;
+	if (!ofs.open(filename, std::ios::out | std::ios::binary)) {
+		return -1;
+	}
+
+	ofs.stream() << stacks;
+	ofs.commit();
+	return 0;
+}
+
+int lldebug_funcprofile_start(lua_State *L) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	ctx->StartFuncProfile();
+	return 0;
+}
+
+int lldebug_funcprofile_stop(lua_State *L, const char *filename) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	ctx->StopFuncProfile();
+	if (filename == NULL) {
+		return 0;
+	}
+
+	safe_ofstream ofs;
+	if (!ofs.open(filename, std::ios::out)) {
+		return -1;
+	}
+
+	LuaFuncProfileList profiles = ctx->GetFuncProfile();
+	for (LuaFuncProfileList::size_type i = 0; i < profiles.size(); ++i) {
+		const LuaFuncProfile &profile = profiles[i];
+
+		ofs.stream()
+			<< profile.GetCalls() << "\t"
+			<< profile.GetTotalTime() << "\t"
+			<< profile.GetSelfTime() << "\t"
+			<< profile.GetTotalCpuTime() << "\t"
+			<< profile.GetSelfCpuTime() << "\t"
+			<< profile.GetFuncName() << "\t"
+			<< profile.GetTitle() << ":" << profile.GetLine() << "\n";
+	}
+
+	ofs.commit();
+	return 0;
+}
+
+int lldebug_coverage_start(lua_State *L, int firstHitOnly) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	ctx->StartCoverage(firstHitOnly != 0);
+	return 0;
+}
+
+int lldebug_coverage_stop(lua_State *L, const char *filename) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	ctx->StopCoverage();
+	if (filename == NULL) {
+		return 0;
+	}
+
+	safe_ofstream ofs;
+	if (!ofs.open(filename, std::ios::out)) {
+		return -1;
+	}
+
+	WriteLcov(ofs.stream(), ctx->GetCoverage());
+	ofs.commit();
+	return 0;
+}
+
+int lldebug_allocprofile_start(lua_State *L) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	return ctx->StartAllocProfile();
+}
+
+int lldebug_allocprofile_stop(lua_State *L, const char *filename) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	ctx->StopAllocProfile();
+	if (filename == NULL) {
+		return 0;
+	}
+
+	safe_ofstream ofs;
+	if (!ofs.open(filename, std::ios::out)) {
+		return -1;
+	}
+
+	WriteAllocProfile(ofs.stream(), ctx->GetAllocProfile());
+	ofs.commit();
+	return 0;
+}
+
+int lldebug_schedprofile_start(lua_State *L) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	ctx->StartSchedProfile();
+	return 0;
+}
+
+int lldebug_schedprofile_stop(lua_State *L, const char *filename) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	ctx->StopSchedProfile();
+	if (filename == NULL) {
+		return 0;
+	}
+
+	safe_ofstream ofs;
+	if (!ofs.open(filename, std::ios::out)) {
+		return -1;
+	}
+
+	WriteSchedProfile(ofs.stream(), ctx->GetSchedProfile(), filename);
+	ofs.commit();
+	return 0;
+}
+
+int lldebug_trace_start(lua_State *L, int bufferSize, const char *prefix) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL || bufferSize <= 0) {
+		return -1;
+	}
+
+	ctx->StartTrace(bufferSize, (prefix != NULL ? prefix : ""));
+	return 0;
+}
+
+int lldebug_trace_save(lua_State *L, const char *filename) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL || filename == NULL) {
+		return -1;
+	}
+
+	safe_ofstream ofs;
+	if (!ofs.open(filename, std::ios::out | std::ios::binary)) {
+		return -1;
+	}
+
+	ofs.stream() << ctx->GetTrace();
+	ofs.commit();
+	return 0;
+}
+
+int lldebug_trace_stop(lua_State *L, const char *filename) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	ctx->StopTrace();
+	if (filename == NULL) {
+		return 0;
+	}
+
+	return lldebug_trace_save(L, filename);
+}
+
+int lldebug_heapsnapshot(lua_State *L, const char *filename) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL || filename == NULL) {
+		return -1;
+	}
+
+	return ctx->SaveHeapSnapshot(filename);
+}
+
+int lldebug_heapdiff(const char *before, const char *after,
+					 const char *filename) {
+	if (before == NULL || after == NULL || filename == NULL) {
+		return -1;
+	}
+
+	HeapSnapshot snapshots[2];
+	const char *names[2] = {before, after};
+	for (int i = 0; i < 2; ++i) {
+		std::ifstream ifs(names[i], std::ios::in | std::ios::binary);
+		if (!ifs.is_open() || snapshots[i].Read(ifs) != 0) {
+			return -1;
+		}
+	}
+
+	safe_ofstream ofs;
+	if (!ofs.open(filename, std::ios::out)) {
+		return -1;
+	}
+
+	WriteHeapDiff(ofs.stream(), snapshots[0], snapshots[1]);
+	ofs.commit();
+	return 0;
+}
+
+int lldebug_gcmonitor_start(lua_State *L, int interval, const char *filename) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	return ctx->StartGcMonitor(interval,
+		(filename != NULL ? filename : std::string()));
+}
+
+int lldebug_gcmonitor_stop(lua_State *L) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	ctx->StopGcMonitor();
+	return 0;
+}
+
+int lldebug_setgcthreshold(lua_State *L, int kbytes) {
+	shared_ptr<Context> ctx = Context::Find(L);
+	if (ctx == NULL) {
+		return -1;
+	}
+
+	ctx->SetGcThreshold(kbytes);
+	return 0;
+}
+
 
 static std::string s_hostname = "localhost";
 static unsigned short s_port = 24752;
@@ -229,3 +519,23 @@ void lldebug_getremoteaddress(const char **hostname,
 		*port = s_port;
 	}
 }
+
+static int s_isAllocProfiling = 0;
+
+void lldebug_setallocprofiling(int enabled) {
+	s_isAllocProfiling = enabled;
+}
+
+int lldebug_getallocprofiling(void) {
+	return s_isAllocProfiling;
+}
+
+static int s_isFrameEnabled = 1;
+
+void lldebug_setframeenabled(int enabled) {
+	s_isFrameEnabled = enabled;
+}
+
+int lldebug_getframeenabled(void) {
+	return s_isFrameEnabled;
+}
@@ -69,6 +69,20 @@ private:
 };
 
 
+/// Is the field one of the internal tables of lldebug ?
+/**
+ * The key of the field is at the top - 1.
+ */
+inline bool is_internal_field(lua_State *L, int idx) {
+	return (idx == LUA_REGISTRYINDEX && lua_islightuserdata(L, -2)
+		&& (lua_topointer(L, -2) == &llutil_address_for_internal_table
+		||  lua_topointer(L, -2) == &llutil_address_for_eval_cache_table
+		||  lua_topointer(L, -2) == &llutil_address_for_thread_table
+		||  lua_topointer(L, -2) == &llutil_address_for_thread_index
+		||  lua_topointer(L, -2) == &llutil_address_for_source_table
+		||  lua_topointer(L, -2) == &llutil_address_for_field_cursor_table));
+}
+
 /// Iterate the all fields of idx object.
 template<class Fn>
 int iterate_fields(Fn &callback, lua_State *L, int idx) {
@@ -95,10 +109,7 @@ int iterate_fields(Fn &callback, lua_State *L, int idx) {
 	for (int i = 0; lua_next(L, idx) != 0; ++i) {
 		// key index: top - 1, value index: top
 		int top = lua_gettop(L);
-		if (idx == LUA_REGISTRYINDEX && lua_islightuserdata(L, -2)
-			&& lua_topointer(L, -2) == &llutil_address_for_internal_table) {
-		}
-		else {
+		if (!is_internal_field(L, idx)) {
 			int ret = callback(L, llutil_tostring_fast(L, top - 1), top);
 			if (ret != 0) {
 				lua_pop(L, 2);
@@ -115,6 +126,103 @@ int iterate_fields(Fn &callback, lua_State *L, int idx) {
 	return 0;
 }
 
+/// Iterate the fields of idx object in [offset, offset + count).
+/**
+ * The metatable is the first field. The first page walks all the fields
+ * to count them to 'total', and the others aren't converted. The last key
+ * of the page is saved as the cursor, and 'resume' is set to its id.
+ * (0 if it's the last page) The next page with 'resume' continues from
+ * the key, and the fields after it aren't walked.
+ */
+template<class Fn>
+int iterate_fields_page(Fn &callback, lua_State *L, int idx,
+						int offset, int count, int &total, int &resume) {
+	scoped_lua scoped(L);
+	int end = offset + count;
+	int index = 0;
+	bool hasCursor = false;
+
+	// The last key of the page is kept here.
+	lua_pushnil(L);
+	int cursor = lua_gettop(L);
+
+	bool isResumed = (resume != 0 && offset > 0
+		&& llutil_pushfieldcursor(L, idx, resume, offset, total));
+	if (isResumed) {
+		index = offset;
+	}
+	else {
+		// check metatable
+		if (lua_getmetatable(L, idx)) {
+			int top = lua_gettop(L);
+			int ret = 0;
+			if (index >= offset && index < end) {
+				ret = callback(L, std::string("(*metatable)"), top);
+			}
+			lua_pop(L, 1);
+			if (ret != 0) {
+				lua_pop(L, 1);
+				scoped.check(0);
+				return ret;
+			}
+			hasCursor = (++index == end);
+		}
+
+		if (lua_type(L, idx) != LUA_TTABLE) {
+			lua_pop(L, 1);
+			total = index;
+			resume = 0;
+			scoped.check(0);
+			return 0;
+		}
+
+		lua_pushnil(L);  // first key
+	}
+
+	while (lua_next(L, idx) != 0) {
+		// key index: top - 1, value index: top
+		int top = lua_gettop(L);
+		if (!is_internal_field(L, idx)) {
+			if (index >= offset && index < end) {
+				int ret = callback(L, llutil_tostring_fast(L, top - 1), top);
+				if (ret != 0) {
+					lua_pop(L, 3);
+					scoped.check(0);
+					return ret;
+				}
+			}
+
+			if (++index == end) {
+				lua_pushvalue(L, top - 1);
+				lua_replace(L, cursor);
+				hasCursor = true;
+
+				// The total is known, the rest isn't walked.
+				if (isResumed) {
+					lua_pop(L, 2);
+					break;
+				}
+			}
+		}
+
+		// eliminate the value index and pushed value and key index
+		lua_pop(L, 1);
+	}
+
+	if (!isResumed) {
+		total = index;
+	}
+
+	resume = 0;
+	if (hasCursor && end < total) {
+		resume = llutil_savefieldcursor(L, idx, end, total);
+	}
+	lua_pop(L, 1);
+
+	scoped.check(0);
+	return 0;
+}
+
 /// Iterate the all fields of var.
 template<class Fn>
 int iterate_var(Fn &callback, const LuaVar &var) {
@@ -136,6 +244,30 @@ int iterate_var(Fn &callback, const LuaVar &var) {
 	return ret;
 }
 
+/// Iterate the fields of var in [offset, offset + count).
+template<class Fn>
+int iterate_var_page(Fn &callback, const LuaVar &var,
+					 int offset, int count, int &total, int &resume) {
+	lua_State *L = var.GetLua().GetState();
+	scoped_lua scoped(L);
+	total = 0;
+
+	if (!var.IsOk()) {
+		return -1;
+	}
+
+	if (var.PushTable(L) != 0) {
+		scoped.check(0);
+		return -1;
+	}
+
+	int ret = iterate_fields_page(callback, L, lua_gettop(L),
+		offset, count, total, resume);
+	lua_pop(L, 1);
+	scoped.check(0);
+	return ret;
+}
+
 /// Iterate the stacks.
 template<class Fn>
 int iterate_stacks(Fn &callback, lua_State *L) {
@@ -33,6 +33,11 @@ namespace lldebug {
 namespace context {
 
 const int llutil_address_for_internal_table = 0;
+const int llutil_address_for_eval_cache_table = 0;
+const int llutil_address_for_thread_table = 0;
+const int llutil_address_for_thread_index = 0;
+const int llutil_address_for_source_table = 0;
+const int llutil_address_for_field_cursor_table = 0;
 
 /// Get field from the 'lldebug' table.
 int llutil_rawget(lua_State *L, const char *name) {
@@ -107,6 +112,119 @@ int llutil_clonetable(lua_State *L, int idx) {
 	return scoped.check(1);
 }
 
+/// Push the table of the cursors, it's made at the first time.
+/**
+ * cursors[table] = {id, offset, total, key}, the key is weak.
+ * cursors[0] is the last id.
+ */
+static void pushfieldcursors(lua_State *L) {
+	lua_pushlightuserdata(L, (void *)&llutil_address_for_field_cursor_table);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	if (!lua_istable(L, -1)) {
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_newtable(L);
+		lua_pushliteral(L, "k");
+		lua_setfield(L, -2, "__mode");
+		lua_setmetatable(L, -2);
+		lua_pushlightuserdata(L, (void *)&llutil_address_for_field_cursor_table);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, LUA_REGISTRYINDEX);
+	}
+}
+
+bool llutil_pushfieldcursor(lua_State *L, int idx, int resume, int offset,
+							int &total) {
+	scoped_lua scoped(L);
+
+	if (!lua_istable(L, idx)) {
+		return false;
+	}
+
+	if (idx < 0 && idx > LUA_REGISTRYINDEX) {
+		idx = lua_gettop(L) + idx + 1;
+	}
+
+	lua_checkstack(L, 4);
+	pushfieldcursors(L);
+	lua_pushvalue(L, idx);
+	lua_rawget(L, -2);
+	if (!lua_istable(L, -1)) {
+		lua_pop(L, 2);
+		scoped.check(0);
+		return false;
+	}
+
+	// The cursor is of the last page of this table ?
+	lua_rawgeti(L, -1, 1);
+	lua_rawgeti(L, -2, 2);
+	bool isValid = ((int)lua_tonumber(L, -2) == resume
+		&& (int)lua_tonumber(L, -1) == offset);
+	lua_pop(L, 2);
+	if (!isValid) {
+		lua_pop(L, 2);
+		scoped.check(0);
+		return false;
+	}
+
+	lua_rawgeti(L, -1, 3);
+	int cursorTotal = (int)lua_tonumber(L, -1);
+	lua_pop(L, 1);
+
+	// 'lua_next' raises the error with the key removed from the table.
+	lua_rawgeti(L, -1, 4);
+	if (!lua_isnil(L, -1)) {
+		lua_pushvalue(L, -1);
+		lua_rawget(L, idx);
+		isValid = !lua_isnil(L, -1);
+		lua_pop(L, 1);
+		if (!isValid) {
+			lua_pop(L, 3);
+			scoped.check(0);
+			return false;
+		}
+	}
+
+	lua_replace(L, -3);
+	lua_pop(L, 1);
+	total = cursorTotal;
+	scoped.check(1);
+	return true;
+}
+
+int llutil_savefieldcursor(lua_State *L, int idx, int offset, int total) {
+	scoped_lua scoped(L);
+	int key = lua_gettop(L);
+
+	if (idx < 0 && idx > LUA_REGISTRYINDEX) {
+		idx = lua_gettop(L) + idx + 1;
+	}
+
+	lua_checkstack(L, 4);
+	pushfieldcursors(L);
+	lua_rawgeti(L, -1, 0);
+	int id = (int)lua_tonumber(L, -1) + 1;
+	lua_pop(L, 1);
+	lua_pushnumber(L, id);
+	lua_rawseti(L, -2, 0);
+
+	lua_pushvalue(L, idx);
+	lua_newtable(L);
+	lua_pushnumber(L, id);
+	lua_rawseti(L, -2, 1);
+	lua_pushnumber(L, offset);
+	lua_rawseti(L, -2, 2);
+	lua_pushnumber(L, total);
+	lua_rawseti(L, -2, 3);
+	lua_pushvalue(L, key);
+	lua_rawseti(L, -2, 4);
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
+
+	scoped.check(0);
+	return id;
+}
+
 int llutil_getfenv(lua_State *L, int level) {
 	lua_Debug ar;
 	
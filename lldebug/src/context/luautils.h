@@ -55,6 +55,23 @@ private:
 /// A dummy object that offers original address for lua.
 extern const int llutil_address_for_internal_table;
 
+/// A dummy object that offers the address of the compiled eval cache.
+extern const int llutil_address_for_eval_cache_table;
+
+/// A dummy object that offers the address of the weak table of the threads.
+extern const int llutil_address_for_thread_table;
+
+/// A dummy object that offers the address of the weak valued table
+/// that finds the threads by their addresses.
+extern const int llutil_address_for_thread_index;
+
+/// A dummy object that offers the address of the table of the source strings.
+extern const int llutil_address_for_source_table;
+
+/// A dummy object that offers the address of the weak keyed table
+/// of the cursors of the field pages.
+extern const int llutil_address_for_field_cursor_table;
+
 /// Get the original name of the lua function.
 std::string llutil_makefuncname(lua_Debug *ar);
 
@@ -73,6 +90,22 @@ int llutil_setfenv(lua_State *L, int level, int idx);
 int llutil_getlocals(lua_State *L, int level, bool checkLocal,
 					 bool checkUpvalue, bool checkEnv);
 
+/// Push the last key of the page that ends at 'offset' of the table(idx).
+/**
+ * 'resume' is the id that was returned with the page, and 'total' is
+ * set to the number of the fields counted at the first page. If the cursor
+ * is stale or its key was removed, it returns false and pushes nothing.
+ * (nil is pushed if the page ended at the metatable)
+ */
+bool llutil_pushfieldcursor(lua_State *L, int idx, int resume, int offset,
+							int &total);
+
+/// Save the key at the top as the cursor of the table(idx).
+/**
+ * The key isn't popped. It returns the id of the cursor.
+ */
+int llutil_savefieldcursor(lua_State *L, int idx, int offset, int total);
+
 
 /// Convert to the string.
 /** It doesn't use any lua functions
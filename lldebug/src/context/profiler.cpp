@@ -0,0 +1,1524 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "precomp.h"
+#include "context/profiler.h"
+#include "context/luautils.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+#include <time.h>
+#endif
+
+/// The number of the ints preallocated for the samples.
+#define PROFILER_BUFFER_SIZE (256 * 1024)
+
+/// The maximum number of the frames in a sample.
+#define PROFILER_MAX_DEPTH 256
+
+/// The initial size of the record table, this must be a power of 2.
+#define PROFILER_TABLE_SIZE 1024
+
+/// The size of the site table of the scheduler, this must be a power of 2.
+#define SCHEDPROFILER_TABLE_SIZE 512
+
+namespace lldebug {
+namespace context {
+
+/**
+ * @brief The timer thread starter.
+ */
+class TickTimer::ThreadObj {
+public:
+	explicit ThreadObj(TickTimer *timer)
+		: m_timer(timer) {
+	}
+
+	void operator()() const {
+		m_timer->TimerThread();
+	}
+
+private:
+	TickTimer *m_timer;
+};
+
+TickTimer::TickTimer()
+	: m_isRunning(false), m_isExitThread(false), m_interval(1)
+	, m_ticks(0), m_consumedTicks(0) {
+}
+
+TickTimer::~TickTimer() {
+	Stop();
+}
+
+void TickTimer::Start(int interval) {
+	if (m_isRunning) {
+		return;
+	}
+
+	{ scoped_lock lock(m_mutex);
+		m_isExitThread = false;
+		m_interval = (interval > 0 ? interval : 1);
+	}
+
+	m_consumedTicks = m_ticks;
+	m_thread.reset(new boost::thread(ThreadObj(this)));
+	m_isRunning = true;
+}
+
+void TickTimer::Stop() {
+	if (!m_isRunning) {
+		return;
+	}
+
+	{ scoped_lock lock(m_mutex);
+		m_isExitThread = true;
+	}
+
+	// We must join the thread.
+	if (m_thread != NULL) {
+		m_thread->join();
+		m_thread.reset();
+	}
+
+	m_isRunning = false;
+	m_consumedTicks = m_ticks;
+}
+
+/// Timer thread, it only counts the ticks.
+void TickTimer::TimerThread() {
+	for (;;) {
+		int interval;
+		{ scoped_lock lock(m_mutex);
+			if (m_isExitThread) {
+				break;
+			}
+			interval = m_interval;
+		}
+
+		boost::xtime xt;
+		boost::xtime_get(&xt, boost::TIME_UTC);
+		xt.nsec += (interval % 1000) * 1000 * 1000; // 1ms = 1000 * 1000nsec
+		xt.sec += interval / 1000 + xt.nsec / (1000 * 1000 * 1000);
+		xt.nsec %= 1000 * 1000 * 1000;
+		boost::thread::sleep(xt);
+
+		++m_ticks;
+	}
+}
+
+
+/*-----------------------------------------------------------------*/
+/// Hash of the function identity, the source and the defined line.
+static inline std::size_t HashFuncKey(const void *source, int line) {
+	std::size_t h = reinterpret_cast<std::size_t>(source);
+	h ^= (h >> 4) ^ (h >> 12);
+	return (h * 31 + (std::size_t)line);
+}
+
+SamplingProfiler::SamplingProfiler()
+	: m_bufferSize(0), m_sampleBegin(0) {
+}
+
+SamplingProfiler::~SamplingProfiler() {
+	Stop();
+}
+
+int SamplingProfiler::Start(int interval) {
+	if (m_timer.IsRunning()) {
+		return 0;
+	}
+
+	if (m_buffer.empty()) {
+		m_buffer.resize(PROFILER_BUFFER_SIZE);
+	}
+
+	if (m_frameTable.empty()) {
+		m_frameTable.resize(PROFILER_TABLE_SIZE, 0);
+	}
+
+	m_timer.Start(interval);
+	return 0;
+}
+
+void SamplingProfiler::Stop() {
+	m_timer.Stop();
+}
+
+void SamplingProfiler::Clear() {
+	m_bufferSize = 0;
+	m_sampleBegin = 0;
+	m_frames.clear();
+	std::fill(m_frameTable.begin(), m_frameTable.end(), 0);
+	m_stacks.clear();
+}
+
+void SamplingProfiler::BeginSample() {
+	// Make sure that the buffer can hold the whole sample.
+	if (m_bufferSize + PROFILER_MAX_DEPTH + 1 > m_buffer.size()) {
+		Aggregate();
+	}
+
+	// The depth is fixed in 'EndSample'.
+	m_sampleBegin = m_bufferSize;
+	m_buffer[m_bufferSize++] = 0;
+}
+
+void SamplingProfiler::AddStack(lua_State *L) {
+	lua_Debug ar;
+	int level = 0;
+
+	// Count the levels, because the outer frame must be first.
+	while (lua_getstack(L, level, &ar) != 0) {
+		++level;
+	}
+
+	for (--level; level >= 0; --level) {
+		if (m_bufferSize - m_sampleBegin - 1 >= PROFILER_MAX_DEPTH) {
+			break;
+		}
+
+		if (lua_getstack(L, level, &ar) == 0) {
+			continue;
+		}
+
+		m_buffer[m_bufferSize++] = InternFrame(L, &ar);
+	}
+}
+
+void SamplingProfiler::EndSample() {
+	m_buffer[m_sampleBegin] = (int)(m_bufferSize - m_sampleBegin - 1);
+}
+
+/// Get the id of the frame, a new id is assigned to the unknown frame.
+/**
+ * The function is identified by the interned source and the defined line
+ * (or the C function itself) as FunctionProfiler does, so the known frame
+ * costs a probe of the table and nothing is allocated.
+ */
+int SamplingProfiler::InternFrame(lua_State *L, lua_Debug *ar) {
+	lua_getinfo(L, "S", ar);
+
+	const void *source;
+	int line;
+	if (*ar->what == 'C') {
+		lua_getinfo(L, "f", ar);
+		source = lua_topointer(L, -1);
+		lua_pop(L, 1);
+		line = -1;
+	}
+	else {
+		source = ar->source;
+		line = ar->linedefined;
+	}
+
+	// Linear probing, the table always has empty slots.
+	std::size_t mask = m_frameTable.size() - 1;
+	std::size_t pos = HashFuncKey(source, line) & mask;
+	while (m_frameTable[pos] != 0) {
+		const Frame &frame = m_frames[m_frameTable[pos] - 1];
+		if (frame.source == source && frame.line == line) {
+			return (m_frameTable[pos] - 1);
+		}
+
+		pos = (pos + 1) & mask;
+	}
+
+	// Keep the load factor under 0.5.
+	if ((m_frames.size() + 1) * 2 > m_frameTable.size()) {
+		std::vector<int> table(m_frameTable.size() * 2, 0);
+		mask = table.size() - 1;
+
+		for (FrameList::size_type i = 0; i < m_frames.size(); ++i) {
+			std::size_t newPos = HashFuncKey(
+				m_frames[i].source, m_frames[i].line) & mask;
+			while (table[newPos] != 0) {
+				newPos = (newPos + 1) & mask;
+			}
+			table[newPos] = (int)i + 1;
+		}
+
+		m_frameTable.swap(table);
+		pos = HashFuncKey(source, line) & mask;
+		while (m_frameTable[pos] != 0) {
+			pos = (pos + 1) & mask;
+		}
+	}
+
+	lua_getinfo(L, "n", ar);
+
+	Frame frame;
+	frame.source = source;
+	frame.line = line;
+	frame.name = llutil_makefuncname(ar);
+	if (*ar->what != 'C') {
+		frame.title = ar->short_src;
+	}
+
+	int id = (int)m_frames.size();
+	m_frames.push_back(frame);
+	m_frameTable[pos] = id + 1;
+	return id;
+}
+
+/// Move the samples in the buffer to the collapsed stacks.
+void SamplingProfiler::Aggregate() {
+	std::vector<int>::size_type pos = 0;
+
+	while (pos < m_bufferSize) {
+		int depth = m_buffer[pos++];
+		if (depth > 0) {
+			std::vector<int> stack(
+				m_buffer.begin() + pos,
+				m_buffer.begin() + pos + depth);
+			++m_stacks[stack];
+		}
+		pos += depth;
+	}
+
+	m_bufferSize = 0;
+	m_sampleBegin = 0;
+}
+
+std::string SamplingProfiler::GetFoldedStacks() {
+	Aggregate();
+
+	// Format the names of the frames.
+	string_array names;
+	names.reserve(m_frames.size());
+	for (FrameList::size_type i = 0; i < m_frames.size(); ++i) {
+		const Frame &frame = m_frames[i];
+
+		std::stringstream stream;
+		stream << frame.name;
+		if (frame.title.empty()) {
+			stream << " [C]";
+		}
+		else {
+			stream << " (" << frame.title << ":" << frame.line << ")";
+		}
+
+		// ';' is the separator of the folded stacks.
+		std::string name = stream.str();
+		std::replace(name.begin(), name.end(), ';', ':');
+		names.push_back(name);
+	}
+
+	std::stringstream stream;
+	StackMap::const_iterator it;
+	for (it = m_stacks.begin(); it != m_stacks.end(); ++it) {
+		const std::vector<int> &stack = it->first;
+
+		for (std::vector<int>::size_type i = 0; i < stack.size(); ++i) {
+			if (i != 0) {
+				stream << ";";
+			}
+			stream << names[stack[i]];
+		}
+		stream << " " << it->second << "\n";
+	}
+
+	return stream.str();
+}
+
+
+/*-----------------------------------------------------------------*/
+FunctionProfiler::FunctionProfiler()
+	: m_isRunning(false), m_session(0), m_generation(0) {
+}
+
+FunctionProfiler::~FunctionProfiler() {
+}
+
+void FunctionProfiler::Start() {
+	if (m_isRunning) {
+		return;
+	}
+
+	// The threads make the new timelines at their first events.
+	m_timelines.clear();
+	m_stacks.clear();
+	++m_session;
+	++m_generation;
+	m_isRunning = true;
+}
+
+void FunctionProfiler::Stop(int threadId) {
+	if (!m_isRunning) {
+		return;
+	}
+
+	Timestamp now;
+	GetTimestamp(now);
+
+	std::vector<shared_ptr<Timeline> >::iterator tl;
+	for (tl = m_timelines.begin(); tl != m_timelines.end(); ++tl) {
+		Timeline &timeline = **tl;
+		scoped_lock lock(timeline.recordMutex);
+		Charge(timeline, GetEndTime(timeline, threadId, now));
+	}
+
+	// The running functions are counted as they returned now.
+	CallStackMap::iterator it;
+	for (it = m_stacks.begin(); it != m_stacks.end(); ++it) {
+		CallStack &stack = *it->second;
+		Timeline &timeline = *stack.timeline;
+		scoped_lock lock(timeline.recordMutex);
+		Timestamp end = GetEndTime(timeline, threadId, now);
+		while (!stack.frames.empty()) {
+			PopFrame(timeline, stack, end);
+		}
+	}
+
+	// The threads don't record after this, the timelines keep the records.
+	m_stacks.clear();
+	++m_generation;
+	m_isRunning = false;
+}
+
+void FunctionProfiler::Clear() {
+	// The frames refer the records.
+	m_timelines.clear();
+	m_stacks.clear();
+	++m_session;
+	++m_generation;
+}
+
+/// Get the monotonic wall time in nanoseconds.
+static boost::int64_t get_wall_time() {
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+	static LARGE_INTEGER s_freq;
+	if (s_freq.QuadPart == 0) {
+		QueryPerformanceFrequency(&s_freq);
+	}
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (boost::int64_t)(counter.QuadPart * (1.0e9 / s_freq.QuadPart));
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return ((boost::int64_t)t.tv_sec * 1000000000 + t.tv_nsec);
+#endif
+}
+
+void FunctionProfiler::GetTimestamp(Timestamp &ts) {
+	ts.wall = get_wall_time();
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+	// The thread times are in 100nsec.
+	FILETIME creation, exit, kernel, user;
+	GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+	ts.cpu = ((((boost::int64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime)
+		+ (((boost::int64_t)user.dwHighDateTime << 32) | user.dwLowDateTime)) * 100;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+	ts.cpu = (boost::int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+#endif
+}
+
+shared_ptr<FunctionProfiler::Timeline> FunctionProfiler::NewTimeline(int threadId) {
+	shared_ptr<Timeline> timeline(new Timeline);
+	timeline->threadId = threadId;
+	timeline->session = m_session;
+	timeline->table.resize(PROFILER_TABLE_SIZE, 0);
+
+	// The timeline begins at the first event of the thread.
+	GetTimestamp(timeline->lastTime);
+
+	m_timelines.push_back(timeline);
+	return timeline;
+}
+
+bool FunctionProfiler::IsCurrent(const Timeline &timeline, lua_State *L) const {
+	// The generation is changed when a call stack is moved or removed,
+	// and when the profiler stops.
+	return (L == timeline.currentL && timeline.current != NULL
+		&& timeline.session == m_session && timeline.generation == m_generation);
+}
+
+void FunctionProfiler::SetCurrent(Timeline &timeline, lua_State *L) {
+	Timestamp now;
+	GetTimestamp(now);
+
+	// The time until now is of the call stack the thread ran.
+	{
+		scoped_lock lock(timeline.recordMutex);
+		Charge(timeline, now);
+	}
+
+	CallStackMap::iterator it = m_stacks.find(L);
+	if (it == m_stacks.end()) {
+		shared_ptr<CallStack> stack(new CallStack);
+		stack->timeline = &timeline;
+		it = m_stacks.insert(std::make_pair(L, stack)).first;
+	}
+
+	// The coroutine was run by another thread.
+	if (it->second->timeline != &timeline) {
+		MoveStack(*it->second, timeline);
+	}
+
+	timeline.currentL = L;
+	timeline.generation = m_generation;
+	timeline.current = it->second;
+}
+
+/// Move the frames of the call stack into the timeline.
+/**
+ * The records of the frames are found again in the timeline, and the old
+ * timeline forgets their activations. Each timeline is locked in turn,
+ * because its thread may be in the hook.
+ */
+void FunctionProfiler::MoveStack(CallStack &stack, Timeline &timeline) {
+	Timeline &from = *stack.timeline;
+	RecordList records;
+	{
+		scoped_lock lock(from.recordMutex);
+		std::vector<Frame>::const_iterator it;
+		for (it = stack.frames.begin(); it != stack.frames.end(); ++it) {
+			Record record = from.records[it->record];
+			record.calls = 0;
+			record.total = record.self = Timestamp();
+			records.push_back(record);
+
+			if (from.active[it->record] > 0) {
+				--from.active[it->record];
+			}
+		}
+	}
+
+	{
+		scoped_lock lock(timeline.recordMutex);
+		for (RecordList::size_type i = 0; i < records.size(); ++i) {
+			int index = FindRecord(timeline, records[i].source, records[i].line);
+			if (index < 0) {
+				index = AddRecord(timeline, records[i]);
+			}
+
+			++timeline.active[index];
+			stack.frames[i].record = index;
+		}
+	}
+
+	// The old timeline may still refer the call stack as the current one.
+	stack.timeline = &timeline;
+	++m_generation;
+}
+
+/// The time since the last event of the thread is the exclusive time
+/// of the function it runs.
+void FunctionProfiler::Charge(Timeline &timeline, const Timestamp &now) {
+	// The yielded coroutine runs nothing, and the moved one is charged
+	// by its new thread.
+	CallStack *current = timeline.current.get();
+	if (current != NULL && current->timeline == &timeline
+		&& !current->isSuspended && !current->frames.empty()) {
+		Record &record = timeline.records[current->frames.back().record];
+		record.self.wall += now.wall - timeline.lastTime.wall;
+		record.self.cpu += now.cpu - timeline.lastTime.cpu;
+	}
+
+	timeline.lastTime = now;
+}
+
+/// Get the time when the functions running on the thread end now.
+/**
+ * The cpu time of the other threads can't be read,
+ * so it's counted until their last events.
+ */
+FunctionProfiler::Timestamp FunctionProfiler::GetEndTime(const Timeline &timeline,
+														 int callerId,
+														 const Timestamp &now) {
+	Timestamp end = now;
+	if (timeline.threadId != callerId) {
+		end.cpu = timeline.lastTime.cpu;
+	}
+
+	return end;
+}
+
+void FunctionProfiler::PopFrame(Timeline &timeline, CallStack &stack,
+								const Timestamp &now) {
+	const Frame &frame = stack.frames.back();
+	Record &record = timeline.records[frame.record];
+
+	if (timeline.active[frame.record] > 0) {
+		--timeline.active[frame.record];
+	}
+
+	// The recursive calls are counted only in the outermost one,
+	// and the time while the coroutine was yielded isn't counted.
+	// The cpu times of the frames moved between the threads are still
+	// right, because the difference of the clocks is in 'suspended'.
+	if (frame.isOutermost) {
+		record.total.wall += (now.wall - frame.start.wall)
+			- (stack.suspended.wall - frame.suspended.wall);
+		record.total.cpu += (now.cpu - frame.start.cpu)
+			- (stack.suspended.cpu - frame.suspended.cpu);
+	}
+
+	stack.frames.pop_back();
+}
+
+/// Find the record, it returns -1 if it doesn't exist.
+int FunctionProfiler::FindRecord(const Timeline &timeline, const void *source,
+								 int line) {
+	const std::vector<int> &table = timeline.table;
+	std::size_t mask = table.size() - 1;
+	std::size_t pos = HashFuncKey(source, line) & mask;
+
+	// Linear probing, the table always has empty slots.
+	while (table[pos] != 0) {
+		const Record &record = timeline.records[table[pos] - 1];
+		if (record.source == source && record.line == line) {
+			return (table[pos] - 1);
+		}
+
+		pos = (pos + 1) & mask;
+	}
+
+	return -1;
+}
+
+/// Add the new record to the timeline.
+int FunctionProfiler::AddRecord(Timeline &timeline, const Record &record) {
+	RecordList &records = timeline.records;
+
+	// Keep the load factor under 0.5.
+	if ((records.size() + 1) * 2 > timeline.table.size()) {
+		std::vector<int> table(timeline.table.size() * 2, 0);
+		std::size_t mask = table.size() - 1;
+
+		for (RecordList::size_type i = 0; i < records.size(); ++i) {
+			std::size_t pos = HashFuncKey(
+				records[i].source, records[i].line) & mask;
+			while (table[pos] != 0) {
+				pos = (pos + 1) & mask;
+			}
+			table[pos] = (int)i + 1;
+		}
+
+		timeline.table.swap(table);
+	}
+
+	int index = (int)records.size();
+	records.push_back(record);
+	timeline.active.push_back(0);
+
+	std::size_t mask = timeline.table.size() - 1;
+	std::size_t pos = HashFuncKey(record.source, record.line) & mask;
+	while (timeline.table[pos] != 0) {
+		pos = (pos + 1) & mask;
+	}
+	timeline.table[pos] = index + 1;
+
+	return index;
+}
+
+/// Get the identity of the function, the source and the defined line.
+/**
+ * The source string is interned by lua, so its address is used.
+ * The C function uses its own address and -1 as the line.
+ */
+const void *FunctionProfiler::GetFuncKey(lua_State *L, lua_Debug *ar,
+										 int &line) {
+	lua_getinfo(L, "S", ar);
+
+	if (*ar->what == 'C') {
+		lua_getinfo(L, "f", ar);
+		const void *key = lua_topointer(L, -1);
+		lua_pop(L, 1);
+		line = -1;
+		return key;
+	}
+
+	line = ar->linedefined;
+	return ar->source;
+}
+
+void FunctionProfiler::OnHook(Timeline &timeline, lua_State *L, lua_Debug *ar) {
+	if (ar->event != LUA_HOOKCALL && ar->event != LUA_HOOKRET
+		&& ar->event != LUA_HOOKTAILRET) {
+		return;
+	}
+
+	// The lua API is called out of the lock, because the allocation profiler
+	// takes the lock of the context. Only this thread adds the records,
+	// so it finds them without the lock.
+	int line = 0;
+	const void *source = NULL;
+	int index = -1;
+	Record newRecord;
+	if (ar->event != LUA_HOOKTAILRET) {
+		source = GetFuncKey(L, ar, line);
+	}
+	if (ar->event == LUA_HOOKCALL) {
+		index = FindRecord(timeline, source, line);
+		if (index < 0) {
+			lua_getinfo(L, "Sn", ar);
+			newRecord.source = source;
+			newRecord.line = line;
+			newRecord.name = llutil_makefuncname(ar);
+			newRecord.key = ar->source;
+			newRecord.title = ar->short_src;
+			newRecord.calls = 0;
+		}
+	}
+
+	Timestamp now;
+	GetTimestamp(now);
+	CallStack &stack = *timeline.current;
+
+	// Only the merge of the records waits for this.
+	scoped_lock lock(timeline.recordMutex);
+	Charge(timeline, now);
+
+	switch (ar->event) {
+	case LUA_HOOKCALL:
+		{
+			if (index < 0) {
+				index = AddRecord(timeline, newRecord);
+			}
+
+			++timeline.records[index].calls;
+
+			Frame frame;
+			frame.record = index;
+			frame.isOutermost = (timeline.active[index]++ == 0);
+			frame.start = now;
+			frame.suspended = stack.suspended;
+			stack.frames.push_back(frame);
+		}
+		break;
+	case LUA_HOOKTAILRET:
+		// The tail called function returned and its caller is gone too,
+		// lua gives no information about the caller.
+		if (!stack.frames.empty()) {
+			PopFrame(timeline, stack, now);
+		}
+		break;
+	case LUA_HOOKRET:
+		{
+			// The activations above the returning one were unwound
+			// by an error. If it isn't found, it was called before starting.
+			std::vector<Frame>::size_type i = stack.frames.size();
+			while (i > 0) {
+				--i;
+				const Record &record = timeline.records[stack.frames[i].record];
+				if (record.source == source && record.line == line) {
+					while (stack.frames.size() > i) {
+						PopFrame(timeline, stack, now);
+					}
+					break;
+				}
+			}
+		}
+		break;
+	}
+}
+
+void FunctionProfiler::OnResume(Timeline &timeline) {
+	Timestamp now;
+	GetTimestamp(now);
+	CallStack &stack = *timeline.current;
+
+	scoped_lock lock(timeline.recordMutex);
+	Charge(timeline, now);
+	if (stack.isSuspended) {
+		stack.suspended.wall += now.wall - stack.suspendedAt.wall;
+		stack.suspended.cpu += now.cpu - stack.suspendedAt.cpu;
+		stack.isSuspended = false;
+	}
+}
+
+void FunctionProfiler::OnYield(Timeline &timeline, lua_State *L) {
+	Timestamp now;
+	GetTimestamp(now);
+	CallStack &stack = *timeline.current;
+
+	scoped_lock lock(timeline.recordMutex);
+	Charge(timeline, now);
+	if (lua_status(L) == LUA_YIELD) {
+		stack.isSuspended = true;
+		stack.suspendedAt = now;
+	}
+	else {
+		// The coroutine finished or died by an error.
+		while (!stack.frames.empty()) {
+			PopFrame(timeline, stack, now);
+		}
+	}
+}
+
+void FunctionProfiler::OnThreadFreed(lua_State *L) {
+	CallStackMap::iterator it = m_stacks.find(L);
+	if (it == m_stacks.end()) {
+		return;
+	}
+
+	// The abandoned activations end when the coroutine yielded,
+	// or at the last event of the thread that ran it.
+	CallStack &stack = *it->second;
+	Timeline &timeline = *stack.timeline;
+	{
+		scoped_lock lock(timeline.recordMutex);
+		Timestamp end = (stack.isSuspended ? stack.suspendedAt : timeline.lastTime);
+		while (!stack.frames.empty()) {
+			PopFrame(timeline, stack, end);
+		}
+	}
+
+	// The timelines find their call stacks again.
+	m_stacks.erase(it);
+	++m_generation;
+}
+
+LuaFuncProfileList FunctionProfiler::GetRecords(int threadId) const {
+	typedef std::map<std::pair<const void *, int>, int> RecordMap;
+	RecordMap ids;
+	RecordList records;
+
+	// The records of the same function are merged,
+	// 'indices' maps the records of each timeline to the merged ones.
+	std::map<const Timeline *, std::vector<int> > indices;
+	std::vector<shared_ptr<Timeline> >::const_iterator tl;
+	for (tl = m_timelines.begin(); tl != m_timelines.end(); ++tl) {
+		Timeline &timeline = **tl;
+		std::vector<int> &index = indices[&timeline];
+		scoped_lock lock(timeline.recordMutex);
+
+		for (RecordList::size_type i = 0; i < timeline.records.size(); ++i) {
+			const Record &record = timeline.records[i];
+			std::pair<RecordMap::iterator, bool> result = ids.insert(
+				std::make_pair(std::make_pair(record.source, record.line),
+							   (int)records.size()));
+			if (result.second) {
+				records.push_back(record);
+			}
+			else {
+				Record &merged = records[result.first->second];
+				merged.calls += record.calls;
+				merged.total.wall += record.total.wall;
+				merged.total.cpu += record.total.cpu;
+				merged.self.wall += record.self.wall;
+				merged.self.cpu += record.self.cpu;
+			}
+			index.push_back(result.first->second);
+		}
+	}
+
+	// Add the time of the running functions. (only the outermost one)
+	if (m_isRunning) {
+		Timestamp now;
+		GetTimestamp(now);
+
+		std::vector<bool> counted(records.size(), false);
+		CallStackMap::const_iterator it;
+		for (it = m_stacks.begin(); it != m_stacks.end(); ++it) {
+			const CallStack &stack = *it->second;
+			Timeline &timeline = *stack.timeline;
+			const std::vector<int> &index = indices[&timeline];
+			scoped_lock lock(timeline.recordMutex);
+
+			Timestamp end = GetEndTime(timeline, threadId, now);
+			Timestamp suspended = stack.suspended;
+			if (stack.isSuspended) {
+				suspended.wall += end.wall - stack.suspendedAt.wall;
+				suspended.cpu += end.cpu - stack.suspendedAt.cpu;
+			}
+
+			for (std::vector<Frame>::size_type i = 0; i < stack.frames.size(); ++i) {
+				const Frame &frame = stack.frames[i];
+
+				// The record was added after the merge.
+				if ((std::size_t)frame.record >= index.size()
+					|| counted[index[frame.record]]) {
+					continue;
+				}
+
+				Timestamp &total = records[index[frame.record]].total;
+				total.wall += (end.wall - frame.start.wall)
+					- (suspended.wall - frame.suspended.wall);
+				total.cpu += (end.cpu - frame.start.cpu)
+					- (suspended.cpu - frame.suspended.cpu);
+				counted[index[frame.record]] = true;
+			}
+		}
+	}
+
+	LuaFuncProfileList result;
+	result.reserve(records.size());
+	for (RecordList::size_type i = 0; i < records.size(); ++i) {
+		const Record &record = records[i];
+		result.push_back(LuaFuncProfile(
+			record.name, record.key, record.title, record.line, record.calls,
+			record.total.wall * 1.0e-9, record.self.wall * 1.0e-9,
+			record.total.cpu * 1.0e-9, record.self.cpu * 1.0e-9));
+	}
+
+	return result;
+}
+
+
+/*-----------------------------------------------------------------*/
+/**
+ * @brief The header of the block, it keeps the alignment of lua.
+ */
+union AllocHeader {
+	struct {
+		int site;
+		int session;
+	} info;
+	double d;
+	void *p;
+	long l;
+};
+
+AllocationProfiler::AllocationProfiler()
+	: m_isWrapped(false), m_isRunning(0), m_session(0) {
+}
+
+AllocationProfiler::~AllocationProfiler() {
+}
+
+void AllocationProfiler::Start() {
+	if (m_table.empty()) {
+		m_table.resize(PROFILER_TABLE_SIZE, 0);
+	}
+
+	if (m_isRunning == 0) {
+		++m_isRunning;
+	}
+}
+
+void AllocationProfiler::Stop() {
+	if (m_isRunning != 0) {
+		--m_isRunning;
+	}
+}
+
+void AllocationProfiler::Clear() {
+	m_sites.clear();
+	std::fill(m_table.begin(), m_table.end(), 0);
+
+	// The blocks of the old session refer the old sites.
+	++m_session;
+}
+
+bool AllocationProfiler::IsCharged(void *ptr) const {
+	if (ptr == NULL) {
+		return false;
+	}
+
+	const AllocHeader *block = static_cast<AllocHeader *>(ptr) - 1;
+	return (block->info.site >= 0 && block->info.session == (int)m_session);
+}
+
+static inline std::size_t HashSiteKey(int sourceId, int line) {
+	return ((std::size_t)sourceId * 2654435761u + (std::size_t)line);
+}
+
+int AllocationProfiler::GetSite(int sourceId, int line) {
+	std::size_t mask = m_table.size() - 1;
+	std::size_t pos = HashSiteKey(sourceId, line) & mask;
+
+	// Linear probing, the table always has empty slots.
+	while (m_table[pos] != 0) {
+		const Site &site = m_sites[m_table[pos] - 1];
+		if (site.sourceId == sourceId && site.line == line) {
+			return (m_table[pos] - 1);
+		}
+
+		pos = (pos + 1) & mask;
+	}
+
+	// Keep the load factor under 0.5.
+	if ((m_sites.size() + 1) * 2 > m_table.size()) {
+		std::vector<int> table(m_table.size() * 2, 0);
+		mask = table.size() - 1;
+
+		for (SiteList::size_type i = 0; i < m_sites.size(); ++i) {
+			std::size_t p =
+				HashSiteKey(m_sites[i].sourceId, m_sites[i].line) & mask;
+			while (table[p] != 0) {
+				p = (p + 1) & mask;
+			}
+			table[p] = (int)i + 1;
+		}
+
+		m_table.swap(table);
+		pos = HashSiteKey(sourceId, line) & mask;
+		while (m_table[pos] != 0) {
+			pos = (pos + 1) & mask;
+		}
+	}
+
+	Site site;
+	site.sourceId = sourceId;
+	site.line = line;
+	site.allocs = 0;
+	site.frees = 0;
+	site.allocBytes = 0;
+	site.freeBytes = 0;
+	m_sites.push_back(site);
+
+	int index = (int)m_sites.size() - 1;
+	m_table[pos] = index + 1;
+	return index;
+}
+
+void *AllocationProfiler::Alloc(void *ptr, std::size_t osize,
+								std::size_t nsize, int site) {
+	AllocHeader *block = (ptr != NULL ? static_cast<AllocHeader *>(ptr) - 1 : NULL);
+
+	// The site of the old block, if it was allocated in this session.
+	// It's credited even if the profiler stops.
+	int oldSite = (IsCharged(ptr) ? block->info.site : -1);
+	bool isRunning = IsRunning();
+
+	if (nsize == 0) {
+		std::free(block);
+		if (oldSite >= 0) {
+			++m_sites[oldSite].frees;
+			m_sites[oldSite].freeBytes += osize;
+		}
+		return NULL;
+	}
+
+	AllocHeader *newBlock = static_cast<AllocHeader *>(
+		std::realloc(block, sizeof(AllocHeader) + nsize));
+	if (newBlock == NULL) {
+		return NULL;
+	}
+
+	if (oldSite >= 0) {
+		++m_sites[oldSite].frees;
+		m_sites[oldSite].freeBytes += osize;
+	}
+
+	if (isRunning && site >= 0) {
+		++m_sites[site].allocs;
+		m_sites[site].allocBytes += nsize;
+	}
+
+	newBlock->info.site = (isRunning ? site : -1);
+	newBlock->info.session = (int)m_session;
+	return (newBlock + 1);
+}
+
+/**
+ * The stopped profiler charges nothing, so only the header is kept.
+ * The charged blocks must go to 'Alloc' to credit their frees.
+ */
+void *AllocationProfiler::AllocUncharged(void *ptr, std::size_t nsize) {
+	AllocHeader *block = (ptr != NULL ? static_cast<AllocHeader *>(ptr) - 1 : NULL);
+
+	if (nsize == 0) {
+		std::free(block);
+		return NULL;
+	}
+
+	AllocHeader *newBlock = static_cast<AllocHeader *>(
+		std::realloc(block, sizeof(AllocHeader) + nsize));
+	if (newBlock == NULL) {
+		return NULL;
+	}
+
+	newBlock->info.site = -1;
+	newBlock->info.session = 0;
+	return (newBlock + 1);
+}
+
+
+/*-----------------------------------------------------------------*/
+SchedulerProfiler::SchedulerProfiler()
+	: m_isRunning(false) {
+}
+
+SchedulerProfiler::~SchedulerProfiler() {
+}
+
+void SchedulerProfiler::Start() {
+	if (m_table.empty()) {
+		m_table.resize(SCHEDPROFILER_TABLE_SIZE, 0);
+		m_sites.reserve(SCHEDPROFILER_TABLE_SIZE / 2);
+	}
+
+	m_isRunning = true;
+}
+
+void SchedulerProfiler::Stop() {
+	m_isRunning = false;
+}
+
+void SchedulerProfiler::Clear() {
+	m_sites.clear();
+	m_threads.clear();
+	std::fill(m_table.begin(), m_table.end(), 0);
+}
+
+/// Get the index of the site, the overflowed sites share the last one.
+int SchedulerProfiler::GetSite(int site, int line) {
+	std::size_t mask = m_table.size() - 1;
+	std::size_t pos = HashSiteKey(site, line) & mask;
+
+	// Linear probing, the table always has empty slots.
+	while (m_table[pos] != 0) {
+		const Site &s = m_sites[m_table[pos] - 1];
+		if (s.site == site && s.line == line) {
+			return (m_table[pos] - 1);
+		}
+
+		pos = (pos + 1) & mask;
+	}
+
+	// Keep the load factor under 0.5, the table never grows.
+	if ((m_sites.size() + 1) * 2 >= m_table.size()) {
+		if (site != OVERFLOW_SITE) {
+			return GetSite(OVERFLOW_SITE, -1);
+		}
+	}
+
+	Site s;
+	s.site = site;
+	s.line = line;
+	s.coroutines = 0;
+	s.resumes = 0;
+	s.yields = 0;
+	s.runTime = 0;
+	s.maxRunTime = 0;
+	s.waitTime = 0;
+	s.maxWaitTime = 0;
+	m_sites.push_back(s);
+
+	int index = (int)m_sites.size() - 1;
+	m_table[pos] = index + 1;
+	return index;
+}
+
+void SchedulerProfiler::AddThread(lua_State *L, int site, int line) {
+	Thread thread;
+	thread.site = GetSite(site, line);
+	thread.runTime = 0;
+	thread.runStart = 0;
+	thread.yieldedAt = 0;
+	m_threads[L] = thread;
+
+	++m_sites[thread.site].coroutines;
+}
+
+void SchedulerProfiler::OnResume(lua_State *L, lua_State *from) {
+	boost::int64_t now = get_wall_time();
+
+	// The resumer is paused while 'L' runs.
+	ThreadMap::iterator it = m_threads.find(from);
+	if (it != m_threads.end() && it->second.runStart != 0) {
+		it->second.runTime += now - it->second.runStart;
+		it->second.runStart = 0;
+	}
+
+	it = m_threads.find(L);
+	if (it == m_threads.end()) {
+		return;
+	}
+
+	Thread &thread = it->second;
+	Site &site = m_sites[thread.site];
+	if (thread.yieldedAt != 0) {
+		boost::int64_t wait = now - thread.yieldedAt;
+		site.waitTime += wait;
+		site.maxWaitTime = std::max(site.maxWaitTime, wait);
+		thread.yieldedAt = 0;
+	}
+
+	++site.resumes;
+	thread.runTime = 0;
+	thread.runStart = now;
+}
+
+void SchedulerProfiler::OnYield(lua_State *L, lua_State *from, bool isYielded) {
+	boost::int64_t now = get_wall_time();
+
+	ThreadMap::iterator it = m_threads.find(L);
+	if (it != m_threads.end()) {
+		Thread &thread = it->second;
+		Site &site = m_sites[thread.site];
+
+		if (thread.runStart != 0) {
+			thread.runTime += now - thread.runStart;
+			thread.runStart = 0;
+		}
+		site.runTime += thread.runTime;
+		site.maxRunTime = std::max(site.maxRunTime, thread.runTime);
+
+		// The finished coroutine is never resumed again.
+		if (isYielded) {
+			++site.yields;
+			thread.yieldedAt = now;
+		}
+		else {
+			m_threads.erase(it);
+		}
+	}
+
+	// The resumer runs again.
+	it = m_threads.find(from);
+	if (it != m_threads.end()) {
+		it->second.runStart = now;
+	}
+}
+
+void SchedulerProfiler::OnThreadFreed(lua_State *L) {
+	m_threads.erase(L);
+}
+
+
+/*-----------------------------------------------------------------*/
+/// The name of the runs of the coroutines.
+static const int TRACER_RUN_NAME = 0;
+
+CallTracer::CallTracer()
+	: m_isRunning(false), m_bufferSize(0), m_startTime(0)
+	, m_session(0), m_generation(0), m_trackCount(0) {
+}
+
+CallTracer::~CallTracer() {
+}
+
+void CallTracer::Start(int bufferSize, const std::string &prefix) {
+	// The threads make the new rings, the old ones are kept by them.
+	m_rings.clear();
+	m_tracks.clear();
+	m_trackCount = 0; // the track ids start from 1
+	++m_session;
+	++m_generation;
+
+	m_bufferSize = (std::size_t)std::max(bufferSize, 1);
+	m_prefix = prefix;
+	m_startTime = get_wall_time();
+	m_isRunning = true;
+}
+
+void CallTracer::Stop() {
+	m_isRunning = false;
+}
+
+shared_ptr<CallTracer::Ring> CallTracer::NewRing(int threadId) {
+	shared_ptr<Ring> ring(new Ring);
+	ring->threadId = threadId;
+	ring->session = m_session;
+	ring->bufferSize = m_bufferSize;
+	ring->prefix = m_prefix;
+	ring->startTime = m_startTime;
+
+	Name run;
+	run.name = "(running)";
+	ring->names.push_back(run);
+
+	m_rings.push_back(ring);
+	return ring;
+}
+
+bool CallTracer::IsCurrent(const Ring &ring, lua_State *L) const {
+	// The generation is changed when a track is removed,
+	// because its address may be reused by the new lua_State.
+	return (L == ring.currentL && ring.current != NULL
+		&& ring.session == m_session && ring.generation == m_generation);
+}
+
+void CallTracer::SetCurrent(Ring &ring, lua_State *L) {
+	TrackMap::iterator it = m_tracks.find(L);
+	if (it == m_tracks.end()) {
+		shared_ptr<Track> track(new Track);
+		track->id = ++m_trackCount;
+		track->isCoroutine = false;
+		track->resumedAt = 0;
+		it = m_tracks.insert(std::make_pair(L, track)).first;
+	}
+
+	ring.currentL = L;
+	ring.generation = m_generation;
+	ring.current = it->second;
+}
+
+/// Get the index of the name of the calling function, or -1 if it isn't traced.
+int CallTracer::GetName(Ring &ring, lua_State *L, lua_Debug *ar) {
+	lua_getinfo(L, "S", ar);
+
+	// The file names don't have '@'.
+	if (!ring.prefix.empty()) {
+		const char *source = (*ar->source == '@' ? ar->source + 1 : ar->source);
+		if (strncmp(source, ring.prefix.c_str(), ring.prefix.size()) != 0) {
+			return -1;
+		}
+	}
+
+	const void *key;
+	int line;
+	if (*ar->what == 'C') {
+		lua_getinfo(L, "f", ar);
+		key = lua_topointer(L, -1);
+		lua_pop(L, 1);
+		line = -1;
+	}
+	else {
+		key = ar->source;
+		line = ar->linedefined;
+	}
+
+	// Only this thread uses 'nameIds'.
+	std::pair<NameMap::iterator, bool> result = ring.nameIds.insert(
+		std::make_pair(std::make_pair(key, line), (int)ring.names.size()));
+	if (result.second) {
+		lua_getinfo(L, "n", ar);
+
+		Name name;
+		name.name = llutil_makefuncname(ar);
+		if (line >= 0) {
+			std::ostringstream stream;
+			stream << ar->short_src << ":" << line;
+			name.location = stream.str();
+		}
+
+		scoped_lock lock(ring.eventMutex);
+		ring.names.push_back(name);
+	}
+
+	return result.first->second;
+}
+
+void CallTracer::AddEvent(Ring &ring, const Track &track, boost::int64_t start,
+						  boost::int64_t end, int name) {
+	Event event;
+	event.start = start - ring.startTime;
+	event.duration = end - start;
+	event.name = name;
+	event.track = track.id;
+	event.isCoroutine = track.isCoroutine;
+
+	// The memory is bounded, the oldest event is overwritten.
+	scoped_lock lock(ring.eventMutex);
+	if (ring.events.size() < ring.bufferSize) {
+		ring.events.push_back(event);
+	}
+	else {
+		ring.events[ring.next] = event;
+		ring.next = (ring.next + 1) % ring.events.size();
+		++ring.dropped;
+	}
+}
+
+void CallTracer::OnHook(Ring &ring, lua_State *L, lua_Debug *ar) {
+	Track &track = *ring.current;
+
+	switch (ar->event) {
+	case LUA_HOOKCALL:
+		{
+			Frame frame;
+			frame.name = GetName(ring, L, ar);
+			frame.start = (frame.name >= 0 ? get_wall_time() : 0);
+			track.frames.push_back(frame);
+		}
+		break;
+	case LUA_HOOKRET:
+	case LUA_HOOKTAILRET:
+		{
+			// The functions called before the start are unknown.
+			if (track.frames.empty()) {
+				break;
+			}
+
+			const Frame &frame = track.frames.back();
+			if (frame.name >= 0) {
+				AddEvent(ring, track, frame.start,
+					get_wall_time(), frame.name);
+			}
+			track.frames.pop_back();
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void CallTracer::OnResume(Ring &ring) {
+	Track &track = *ring.current;
+
+	track.isCoroutine = true;
+	track.resumedAt = get_wall_time();
+}
+
+void CallTracer::OnYield(Ring &ring) {
+	Track &track = *ring.current;
+
+	if (track.resumedAt != 0) {
+		AddEvent(ring, track, track.resumedAt,
+			get_wall_time(), TRACER_RUN_NAME);
+		track.resumedAt = 0;
+	}
+}
+
+void CallTracer::OnThreadFreed(lua_State *L) {
+	// The rings find their tracks again.
+	if (m_tracks.erase(L) != 0) {
+		++m_generation;
+	}
+}
+
+/**
+ * The tid of each event is the track, and the OS thread is in its args.
+ * The times are in microseconds.
+ */
+std::string CallTracer::GetTrace() const {
+	std::ostringstream stream;
+	std::map<int, bool> tracks;
+	unsigned long dropped = 0;
+	bool isFirst = true;
+
+	stream << "{\"traceEvents\": [\n";
+	std::vector<shared_ptr<Ring> >::const_iterator it;
+	for (it = m_rings.begin(); it != m_rings.end(); ++it) {
+		Ring &ring = **it;
+		scoped_lock lock(ring.eventMutex);
+		dropped += ring.dropped;
+
+		// The oldest event first.
+		for (std::size_t i = 0; i < ring.events.size(); ++i) {
+			const Event &event = ring.events[(ring.next + i) % ring.events.size()];
+			const Name &name = ring.names[event.name];
+			char buffer[128];
+
+			stream << (isFirst ? "" : ",\n") << "{\"name\": ";
+			WriteJsonString(stream, name.name);
+			snprintf(buffer, sizeof(buffer),
+				", \"cat\": \"lua\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f,"
+				" \"pid\": 1, \"tid\": %d, \"args\": {\"thread\": %d",
+				event.start / 1000.0, event.duration / 1000.0,
+				event.track, ring.threadId);
+			stream << buffer;
+			if (!name.location.empty()) {
+				stream << ", \"source\": ";
+				WriteJsonString(stream, name.location);
+			}
+			stream << "}}";
+
+			tracks[event.track] = (tracks[event.track] || event.isCoroutine);
+			isFirst = false;
+		}
+	}
+
+	// The names of the tracks.
+	std::map<int, bool>::const_iterator track;
+	for (track = tracks.begin(); track != tracks.end(); ++track) {
+		stream << (isFirst ? "" : ",\n")
+			<< "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+			<< track->first << ", \"args\": {\"name\": \""
+			<< (track->second ? "coroutine " : "lua_State ")
+			<< track->first << "\"}}";
+		isFirst = false;
+	}
+
+	stream << "\n], \"displayTimeUnit\": \"ns\", \"otherData\": {\"dropped\": "
+		<< dropped << "}}\n";
+	return stream.str();
+}
+
+
+/*-----------------------------------------------------------------*/
+GcMonitor::GcMonitor()
+	: m_lastBytes(0), m_peakBytes(0), m_collectedBytes(0)
+	, m_thresholdBytes(0) {
+	m_startTime.sec = 0;
+	m_startTime.nsec = 0;
+}
+
+GcMonitor::~GcMonitor() {
+	Stop();
+}
+
+int GcMonitor::Start(int interval, const std::string &filename) {
+	if (m_timer.IsRunning()) {
+		return 0;
+	}
+
+	if (!filename.empty()) {
+		m_csv.clear();
+		m_csv.open(filename.c_str(), std::ios::out);
+		if (!m_csv.is_open()) {
+			return -1;
+		}
+
+		WriteGcSampleHeader(m_csv);
+	}
+
+	boost::xtime_get(&m_startTime, boost::TIME_UTC);
+	m_lastBytes = 0;
+	m_peakBytes = 0;
+	m_collectedBytes = 0;
+	m_timer.Start(interval);
+	return 0;
+}
+
+void GcMonitor::Stop() {
+	m_timer.Stop();
+
+	if (m_csv.is_open()) {
+		m_csv.close();
+	}
+}
+
+LuaGcSample GcMonitor::TakeSample(std::size_t bytes) {
+	m_timer.Consume();
+	OnCount(bytes);
+
+	boost::xtime now;
+	boost::xtime_get(&now, boost::TIME_UTC);
+	double time = (double)(now.sec - m_startTime.sec)
+		+ (double)(now.nsec - m_startTime.nsec) / (1000.0 * 1000.0 * 1000.0);
+
+	LuaGcSample sample(time, bytes / 1024.0,
+		m_peakBytes / 1024.0, m_collectedBytes / 1024.0);
+
+	// The samples are flushed one by one, so they survive the crash.
+	if (m_csv.is_open()) {
+		WriteGcSamples(m_csv, LuaGcSampleList(1, sample));
+		m_csv.flush();
+	}
+
+	// Begin the next interval.
+	m_peakBytes = bytes;
+	m_collectedBytes = 0;
+	return sample;
+}
+
+} // end of namespace context
+} // end of namespace lldebug
@@ -0,0 +1,727 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __LLDEBUG_PROFILER_H__
+#define __LLDEBUG_PROFILER_H__
+
+#include "luainfo.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/detail/atomic_count.hpp>
+#include <fstream>
+
+namespace lldebug {
+namespace context {
+
+/**
+ * @brief The timer thread that only counts the ticks.
+ *
+ * The hook checks 'IsTicked' without any lock, so it costs almost nothing
+ * between the ticks.
+ */
+class TickTimer {
+public:
+	explicit TickTimer();
+	~TickTimer();
+
+	/// Start the timer that ticks every 'interval' msec.
+	void Start(int interval);
+
+	/// Stop the timer.
+	void Stop();
+
+	/// Is the timer running ?
+	bool IsRunning() const {
+		return m_isRunning;
+	}
+
+	/// Has the timer ticked since the last 'Consume' ? (lock free)
+	bool IsTicked() const {
+		return (m_ticks != m_consumedTicks);
+	}
+
+	/// Get the count of the ticks. (lock free)
+	long GetTicks() const {
+		return m_ticks;
+	}
+
+	/// Mark the ticks as handled.
+	void Consume() {
+		m_consumedTicks = m_ticks;
+	}
+
+private:
+	void TimerThread();
+
+	class ThreadObj;
+	friend class ThreadObj;
+
+private:
+	mutex m_mutex;
+	shared_ptr<boost::thread> m_thread;
+	bool m_isRunning;
+	bool m_isExitThread;
+	int m_interval;
+	boost::detail::atomic_count m_ticks;
+	long m_consumedTicks;
+};
+
+/**
+ * @brief Sampling profiler of the lua stacks.
+ *
+ * The timer thread only counts the ticks, and the hook of each OS thread
+ * captures its stacks when it finds a new tick. So the hook does almost
+ * nothing between the ticks. The samples are aggregated into the collapsed
+ * stacks that flamegraph.pl can read.
+ *
+ * Except the timer, this object must be used with the lock of Context.
+ */
+class SamplingProfiler {
+public:
+	explicit SamplingProfiler();
+	~SamplingProfiler();
+
+	/// Start the timer that ticks every 'interval' msec.
+	int Start(int interval);
+
+	/// Stop the timer, the samples are kept until 'Clear' is called.
+	void Stop();
+
+	/// Forget all the samples.
+	void Clear();
+
+	/// Is the profiler running ?
+	bool IsRunning() const {
+		return m_timer.IsRunning();
+	}
+
+	/// Get the count of the ticks, each thread keeps the last one
+	/// it sampled. (lock free)
+	long GetTicks() const {
+		return m_timer.GetTicks();
+	}
+
+	/// Begin a new sample.
+	void BeginSample();
+
+	/// Add the stack of 'L' to the sample. (the outer one first)
+	void AddStack(lua_State *L);
+
+	/// End the sample.
+	void EndSample();
+
+	/// Get the collapsed stacks, one line is "outer;...;inner count".
+	std::string GetFoldedStacks();
+
+private:
+	void Aggregate();
+	int InternFrame(lua_State *L, lua_Debug *ar);
+
+private:
+	TickTimer m_timer;
+
+	/// Preallocated buffer of the samples, each is [depth, frame ids...].
+	std::vector<int> m_buffer;
+	std::vector<int>::size_type m_bufferSize;
+	std::vector<int>::size_type m_sampleBegin;
+
+	/// A sampled function, 'source' and 'line' are the key.
+	/// The name is formatted when the stacks are exported.
+	struct Frame {
+		const void *source;
+		int line;
+		std::string name;
+		std::string title; ///< empty if it is a C function
+	};
+	typedef std::vector<Frame> FrameList;
+	FrameList m_frames;
+	std::vector<int> m_frameTable; ///< index + 1 of m_frames, or 0
+
+	typedef std::map<std::vector<int>, unsigned long> StackMap;
+	StackMap m_stacks;
+};
+
+/**
+ * @brief Deterministic profiler of the lua functions.
+ *
+ * It records the calls and the inclusive and exclusive times of each function
+ * from the call and return hooks. The functions are identified by the source
+ * and the defined line (or the C function itself), and the records are kept
+ * in the flat open addressing table, so no allocation is done per call.
+ * Each OS thread has its own timeline and records, so the times of a thread
+ * are never charged to the functions of another, and its cpu time is of
+ * the thread. The records of the threads are merged by 'GetRecords'.
+ *
+ * Except the methods marked lock free, this object must be used with
+ * the lock of Context.
+ */
+class FunctionProfiler {
+public:
+	struct Timeline;
+
+	explicit FunctionProfiler();
+	~FunctionProfiler();
+
+	/// Start recording.
+	void Start();
+
+	/// Stop recording on the OS thread, the records are kept until
+	/// 'Clear' is called.
+	void Stop(int threadId);
+
+	/// Forget all the records.
+	void Clear();
+
+	/// Is the profiler running ?
+	bool IsRunning() const {
+		return m_isRunning;
+	}
+
+	/// Get the session, it's changed by 'Start' and 'Clear'.
+	long GetSession() const {
+		return m_session;
+	}
+
+	/// Make the timeline of the OS thread in this session, the thread keeps it.
+	shared_ptr<Timeline> NewTimeline(int threadId);
+
+	/// Is 'L' the current call stack of the timeline, and is the timeline
+	/// recording now ? (lock free)
+	bool IsCurrent(const Timeline &timeline, lua_State *L) const;
+
+	/// Make 'L' the current call stack of the timeline, only the thread of
+	/// the timeline calls it.
+	void SetCurrent(Timeline &timeline, lua_State *L);
+
+	/// Handle the call and the return events of the current call stack.
+	/// (lock free)
+	void OnHook(Timeline &timeline, lua_State *L, lua_Debug *ar);
+
+	/// The current call stack is resumed by 'coroutine.resume'. (lock free)
+	void OnResume(Timeline &timeline);
+
+	/// The current call stack 'L' yielded or finished. (lock free)
+	void OnYield(Timeline &timeline, lua_State *L);
+
+	/// 'L' was collected, its activations are abandoned.
+	void OnThreadFreed(lua_State *L);
+
+	/// Get the records of all the OS threads, the running functions
+	/// are counted until now on the OS thread.
+	LuaFuncProfileList GetRecords(int threadId) const;
+
+private:
+	/// Wall and cpu time in nanoseconds.
+	struct Timestamp {
+		Timestamp() : wall(0), cpu(0) {
+		}
+		boost::int64_t wall;
+		boost::int64_t cpu;
+	};
+	static void GetTimestamp(Timestamp &ts);
+
+	/// The record of a function, 'source' and 'line' are the key.
+	struct Record {
+		const void *source;
+		int line;
+		std::string name;
+		std::string key;
+		std::string title;
+		unsigned long calls;
+		Timestamp total;
+		Timestamp self;
+	};
+	typedef std::vector<Record> RecordList;
+
+	/// The activation of a function.
+	struct Frame {
+		int record; ///< the index of the records of 'CallStack::timeline'
+		bool isOutermost; ///< isn't it a recursive call ?
+		Timestamp start;
+		Timestamp suspended; ///< 'CallStack::suspended' when it's called
+	};
+
+	/// The activations of a lua_State object.
+	struct CallStack {
+		CallStack() : timeline(NULL), isSuspended(false) {
+		}
+		std::vector<Frame> frames;
+		Timeline *timeline; ///< the timeline of the OS thread that ran it last
+		bool isSuspended;
+		Timestamp suspendedAt;
+		Timestamp suspended; ///< the total time while it was yielded
+	};
+	typedef std::map<lua_State *, shared_ptr<CallStack> > CallStackMap;
+
+public:
+	/// The timeline and the records of an OS thread.
+	/**
+	 * The records, 'active', 'lastTime' and the frames of the call stacks
+	 * recorded in it are changed with 'recordMutex', which only the merge
+	 * of the records contends. Only the thread adds the records, so it reads
+	 * them without the lock. 'currentL', 'generation' and 'current' are
+	 * used only by the thread.
+	 */
+	struct Timeline : private boost::noncopyable {
+		Timeline() : threadId(0), session(0), currentL(NULL), generation(-1) {
+		}
+		int threadId;
+		long session;
+
+		mutex recordMutex;
+		RecordList records;
+		std::vector<int> table; ///< index + 1 of 'records', or 0
+		std::vector<int> active; ///< the activations of each record
+		Timestamp lastTime; ///< the time of the last event
+
+		lua_State *currentL; ///< the lua_State the thread runs now
+		long generation; ///< the generation of the call stacks 'current' was found in
+		shared_ptr<CallStack> current;
+	};
+
+private:
+	void MoveStack(CallStack &stack, Timeline &timeline);
+	void Charge(Timeline &timeline, const Timestamp &now);
+	void PopFrame(Timeline &timeline, CallStack &stack, const Timestamp &now);
+	static Timestamp GetEndTime(const Timeline &timeline, int callerId,
+								const Timestamp &now);
+	static int FindRecord(const Timeline &timeline, const void *source,
+						  int line);
+	static int AddRecord(Timeline &timeline, const Record &record);
+	const void *GetFuncKey(lua_State *L, lua_Debug *ar, int &line);
+
+private:
+	bool m_isRunning;
+	boost::detail::atomic_count m_session; ///< counted up by 'Start' and 'Clear'
+	/// Counted up when the call stacks are moved or removed. (lock free)
+	boost::detail::atomic_count m_generation;
+	std::vector<shared_ptr<Timeline> > m_timelines;
+	CallStackMap m_stacks;
+};
+
+/**
+ * @brief Allocation profiler working in the allocator of lua.
+ *
+ * Each block has a small header that saves the site allocated it,
+ * so the freed bytes are charged to the same site and the live bytes
+ * of each site are exact. The site is the lua function that was running,
+ * Context decides it from the activations the hook keeps.
+ *
+ * The frees of the charged blocks are credited even after the profiler
+ * stops, so the live bytes don't stay inflated.
+ *
+ * Except 'IsRunning', 'IsCharged' and 'AllocUncharged', this object must
+ * be used with the lock of Context.
+ */
+class AllocationProfiler {
+public:
+	/// The totals of a site.
+	struct Site {
+		int sourceId;
+		int line; ///< the line that the function is defined
+		unsigned long allocs;
+		unsigned long frees;
+		boost::uint64_t allocBytes;
+		boost::uint64_t freeBytes;
+	};
+	typedef std::vector<Site> SiteList;
+
+public:
+	explicit AllocationProfiler();
+	~AllocationProfiler();
+
+	/// Does the lua_State object use 'Alloc' ?
+	bool IsWrapped() const {
+		return m_isWrapped;
+	}
+
+	/// Set whether the lua_State object uses 'Alloc'.
+	void SetWrapped(bool wrapped) {
+		m_isWrapped = wrapped;
+	}
+
+	/// Start recording.
+	void Start();
+
+	/// Stop recording, the sites are kept until 'Clear' is called.
+	void Stop();
+
+	/// Forget all the sites, the live blocks are never charged again.
+	void Clear();
+
+	/// Is the profiler running ? (lock free)
+	bool IsRunning() const {
+		return (m_isRunning != 0);
+	}
+
+	/// Is the block charged to a site of this session ? (lock free)
+	bool IsCharged(void *ptr) const;
+
+	/// Get the index of the site, it's added if not found.
+	int GetSite(int sourceId, int line);
+
+	/// Get the sites.
+	const SiteList &GetSites() const {
+		return m_sites;
+	}
+
+	/// The allocator of lua, the new block is charged to 'site'.
+	void *Alloc(void *ptr, std::size_t osize, std::size_t nsize, int site);
+
+	/// The allocator of lua while the profiler stops, 'ptr' must not be
+	/// charged. (lock free)
+	static void *AllocUncharged(void *ptr, std::size_t nsize);
+
+private:
+	bool m_isWrapped;
+	boost::detail::atomic_count m_isRunning; ///< 1 while running
+	boost::detail::atomic_count m_session; ///< it's changed by 'Clear'
+	SiteList m_sites;
+	std::vector<int> m_table; ///< index + 1 of m_sites, or 0
+};
+
+/**
+ * @brief Profiler of the coroutine scheduling.
+ *
+ * 'coroutine.resume' reports the resumes and the yields, and they're
+ * aggregated by the site that created the coroutine. The run time of
+ * a coroutine excludes the coroutines it resumes. The site table has
+ * a fixed size, the sites over it are merged into the last one.
+ *
+ * This object must be used with the lock of Context.
+ */
+class SchedulerProfiler {
+public:
+	/// The totals of a creation site, the times are in nanoseconds.
+	struct Site {
+		int site; ///< the index of Context::m_threadSites, -1 if unknown
+		int line;
+		unsigned long coroutines;
+		unsigned long resumes;
+		unsigned long yields;
+		boost::int64_t runTime;
+		boost::int64_t maxRunTime;
+		boost::int64_t waitTime;
+		boost::int64_t maxWaitTime;
+	};
+	typedef std::vector<Site> SiteList;
+
+	/// The site that has the overflowed sites.
+	static const int OVERFLOW_SITE = -2;
+
+public:
+	explicit SchedulerProfiler();
+	~SchedulerProfiler();
+
+	/// Start recording.
+	void Start();
+
+	/// Stop recording, the sites are kept until 'Clear' is called.
+	void Stop();
+
+	/// Forget all the sites and the coroutines.
+	void Clear();
+
+	/// Is the profiler running ?
+	bool IsRunning() const {
+		return m_isRunning;
+	}
+
+	/// Is the coroutine known ? If not, its creation site must be added.
+	bool IsTracked(lua_State *L) const {
+		return (m_threads.find(L) != m_threads.end());
+	}
+
+	/// Track the coroutine created at 'site' and 'line'.
+	void AddThread(lua_State *L, int site, int line);
+
+	/// 'L' is resumed by 'from'.
+	void OnResume(lua_State *L, lua_State *from);
+
+	/// 'L' yielded or finished, and 'from' runs again.
+	void OnYield(lua_State *L, lua_State *from, bool isYielded);
+
+	/// 'L' was collected.
+	void OnThreadFreed(lua_State *L);
+
+	/// Get the sites.
+	const SiteList &GetSites() const {
+		return m_sites;
+	}
+
+private:
+	/// The coroutine, the times are in nanoseconds.
+	struct Thread {
+		int site; ///< the index of m_sites
+		boost::int64_t runTime; ///< of the current run until 'runStart'
+		boost::int64_t runStart; ///< 0 if it isn't running
+		boost::int64_t yieldedAt; ///< 0 if it isn't yielded
+	};
+	typedef std::map<lua_State *, Thread> ThreadMap;
+
+	int GetSite(int site, int line);
+
+private:
+	bool m_isRunning;
+	SiteList m_sites;
+	std::vector<int> m_table; ///< index + 1 of m_sites, or 0
+	ThreadMap m_threads;
+};
+
+/**
+ * @brief Tracer of the function calls for the timeline.
+ *
+ * Each call is recorded as a complete event when it returns, into the ring
+ * buffer of the OS thread, and the oldest events are overwritten when it's
+ * full. Each lua_State object has its own track, so the calls in a coroutine
+ * nest correctly, and the runs of a coroutine between its resumes and yields
+ * are also recorded. The events are written in the trace event format of
+ * Chrome, which chrome://tracing and Perfetto can read.
+ *
+ * The thread keeps its ring and records into it without the lock of Context,
+ * the ring also has the names of the functions the thread saw. The tracks
+ * are shared by the threads, so only switching the current track of a ring
+ * (e.g. by 'coroutine.resume') needs the lock.
+ *
+ * Except 'IsCurrent', 'OnHook', 'OnResume' and 'OnYield', this object must be
+ * used with the lock of Context.
+ */
+class CallTracer {
+public:
+	struct Ring;
+
+	explicit CallTracer();
+	~CallTracer();
+
+	/// Start tracing, the old events are cleared.
+	/**
+	 * Each OS thread keeps the latest 'bufferSize' events. Only the functions
+	 * whose file name starts with 'prefix' are traced, all if it's empty.
+	 */
+	void Start(int bufferSize, const std::string &prefix);
+
+	/// Stop tracing, the events are kept until 'Start' is called.
+	void Stop();
+
+	/// Is the tracer running ?
+	bool IsRunning() const {
+		return m_isRunning;
+	}
+
+	/// Get the session, it's changed by 'Start'.
+	long GetSession() const {
+		return m_session;
+	}
+
+	/// Make the ring of the OS thread in this session, the thread keeps it.
+	shared_ptr<Ring> NewRing(int threadId);
+
+	/// Is 'L' the current track of the ring, and is the ring of this session ?
+	/// (lock free)
+	bool IsCurrent(const Ring &ring, lua_State *L) const;
+
+	/// Make 'L' the current track of the ring.
+	void SetCurrent(Ring &ring, lua_State *L);
+
+	/// Handle the call and the return events of the current track. (lock free)
+	void OnHook(Ring &ring, lua_State *L, lua_Debug *ar);
+
+	/// The current track is resumed by 'coroutine.resume'. (lock free)
+	void OnResume(Ring &ring);
+
+	/// The current track yielded or finished. (lock free)
+	void OnYield(Ring &ring);
+
+	/// 'L' was collected, its calls are abandoned.
+	void OnThreadFreed(lua_State *L);
+
+	/// Get the events in the trace event format. (json)
+	std::string GetTrace() const;
+
+private:
+	/// A complete event, the times are in nanoseconds.
+	struct Event {
+		boost::int64_t start;
+		boost::int64_t duration;
+		int name; ///< the index of Ring::names
+		int track;
+		bool isCoroutine; ///< is the track of a coroutine ?
+	};
+
+	/// The traced function.
+	struct Name {
+		std::string name;
+		std::string location;
+	};
+	typedef std::map<std::pair<const void *, int>, int> NameMap;
+
+	/// The calls of a lua_State object.
+	struct Frame {
+		boost::int64_t start;
+		int name; ///< -1 if the function isn't traced
+	};
+	struct Track {
+		int id;
+		bool isCoroutine;
+		std::vector<Frame> frames;
+		boost::int64_t resumedAt; ///< 0 if it isn't running as a coroutine
+	};
+	typedef std::map<lua_State *, shared_ptr<Track> > TrackMap;
+
+public:
+	/// The latest events of an OS thread.
+	/**
+	 * The settings of the session are copied, so the thread doesn't read
+	 * the tracer. 'events' and 'names' are changed with 'eventMutex',
+	 * and the other members are used only by the thread.
+	 *
+	 * The hook doesn't run with the lock of the context, so each event
+	 * takes 'eventMutex'. Only 'GetTrace' contends it, otherwise the lock
+	 * costs an atomic operation per event.
+	 */
+	struct Ring : private boost::noncopyable {
+		Ring() : threadId(0), session(0), bufferSize(1), startTime(0)
+			, next(0), dropped(0), currentL(NULL), generation(-1) {
+		}
+		int threadId;
+		long session;
+		std::size_t bufferSize;
+		std::string prefix;
+		boost::int64_t startTime;
+
+		mutex eventMutex;
+		std::vector<Event> events;
+		std::size_t next; ///< the oldest event when it's full
+		unsigned long dropped;
+		std::vector<Name> names;
+		NameMap nameIds;
+
+		lua_State *currentL; ///< the lua_State the thread runs now
+		long generation; ///< the generation of the tracks 'current' was found in
+		shared_ptr<Track> current;
+	};
+
+private:
+	int GetName(Ring &ring, lua_State *L, lua_Debug *ar);
+	void AddEvent(Ring &ring, const Track &track, boost::int64_t start,
+				  boost::int64_t end, int name);
+
+private:
+	bool m_isRunning;
+	std::size_t m_bufferSize;
+	std::string m_prefix;
+	boost::int64_t m_startTime;
+	boost::detail::atomic_count m_session; ///< counted up by 'Start'
+	/// Counted up when the tracks are removed. (lock free)
+	boost::detail::atomic_count m_generation;
+	std::vector<shared_ptr<Ring> > m_rings;
+	TrackMap m_tracks;
+	int m_trackCount;
+};
+
+/**
+ * @brief Monitor of the heap size.
+ *
+ * The count hook observes the heap size, and a sample that has the size,
+ * the peak and the collected size since the previous sample is taken
+ * every interval. The collected size is the decrease between the count
+ * hooks, so it's a lower bound. It also has the threshold of the heap size,
+ * which is checked by the count hook only when it's armed.
+ *
+ * Except the timer, this object must be used with the lock of Context.
+ */
+class GcMonitor {
+public:
+	explicit GcMonitor();
+	~GcMonitor();
+
+	/// Start sampling every 'interval' msec.
+	/**
+	 * If 'filename' isn't empty, the samples are also written to it in csv.
+	 */
+	int Start(int interval, const std::string &filename);
+
+	/// Stop sampling.
+	void Stop();
+
+	/// Is the monitor sampling ?
+	bool IsRunning() const {
+		return m_timer.IsRunning();
+	}
+
+	/// Has the timer ticked since the last sample ? (lock free)
+	bool IsTicked() const {
+		return m_timer.IsTicked();
+	}
+
+	/// Observe the heap size.
+	void OnCount(std::size_t bytes) {
+		if (bytes < m_lastBytes) {
+			m_collectedBytes += m_lastBytes - bytes;
+		}
+		if (bytes > m_peakBytes) {
+			m_peakBytes = bytes;
+		}
+		m_lastBytes = bytes;
+	}
+
+	/// Take a sample, and begin the next interval.
+	LuaGcSample TakeSample(std::size_t bytes);
+
+	/// Set the threshold in kbytes, 0 disarms it.
+	void SetThreshold(std::size_t kbytes) {
+		m_thresholdBytes = kbytes * 1024;
+	}
+
+	/// Get the threshold in kbytes, or 0 if it's disarmed.
+	std::size_t GetThreshold() const {
+		return (m_thresholdBytes / 1024);
+	}
+
+	/// Is the threshold armed ?
+	bool IsArmed() const {
+		return (m_thresholdBytes > 0);
+	}
+
+	/// Does the heap size exceed the threshold ?
+	bool IsExceeded(std::size_t bytes) const {
+		return (m_thresholdBytes > 0 && bytes >= m_thresholdBytes);
+	}
+
+private:
+	TickTimer m_timer;
+	boost::xtime m_startTime;
+	std::size_t m_lastBytes;
+	std::size_t m_peakBytes;
+	boost::uint64_t m_collectedBytes;
+	std::size_t m_thresholdBytes;
+	std::ofstream m_csv;
+};
+
+} // end of namespace context
+} // end of namespace lldebug
+
+#endif
@@ -0,0 +1,543 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "precomp.h"
+#include "heapsnapshot.h"
+#include "luainfo.h"
+
+#include <algorithm>
+#include <cctype>
+
+/// The size of the buffer for reading and writing.
+#define HEAPSNAPSHOT_BUFFER_SIZE (64 * 1024)
+
+/// The max length of the name of the edge.
+#define HEAPSNAPSHOT_MAX_NAME 64
+
+/// The max depth of the path in the report.
+#define HEAPSNAPSHOT_MAX_PATH 32
+
+namespace lldebug {
+
+/// The first bytes of the snapshot, the last char is the version.
+static const char s_signature[8] = {'L', 'L', 'H', 'E', 'A', 'P', '\n', 1};
+
+enum {
+	RECORD_ROOT = 'R',
+	RECORD_NODE = 'N',
+	RECORD_EDGE = 'E',
+	RECORD_END = 'Z',
+};
+
+HeapSnapshotWriter::HeapSnapshotWriter(std::ostream &stream)
+	: m_stream(stream) {
+	m_buffer.reserve(HEAPSNAPSHOT_BUFFER_SIZE);
+	m_buffer.insert(m_buffer.end(), s_signature,
+		s_signature + sizeof(s_signature));
+}
+
+HeapSnapshotWriter::~HeapSnapshotWriter() {
+	Flush();
+}
+
+void HeapSnapshotWriter::Put8(unsigned int value) {
+	m_buffer.push_back((char)(value & 0xff));
+}
+
+/// The numbers are little endian.
+void HeapSnapshotWriter::Put32(boost::uint32_t value) {
+	for (int i = 0; i < 4; ++i) {
+		Put8((unsigned int)(value >> (i * 8)));
+	}
+}
+
+void HeapSnapshotWriter::Put64(boost::uint64_t value) {
+	for (int i = 0; i < 8; ++i) {
+		Put8((unsigned int)(value >> (i * 8)));
+	}
+}
+
+void HeapSnapshotWriter::PutString(const char *str, std::size_t len) {
+	len = std::min(len, (std::size_t)HEAPSNAPSHOT_MAX_NAME);
+	Put8((unsigned int)len);
+	m_buffer.insert(m_buffer.end(), str, str + len);
+}
+
+void HeapSnapshotWriter::Flush() {
+	if (!m_buffer.empty()) {
+		m_stream.write(&m_buffer[0], (std::streamsize)m_buffer.size());
+		m_buffer.clear();
+	}
+}
+
+void HeapSnapshotWriter::WriteRoot(const void *id, const std::string &name) {
+	Put8(RECORD_ROOT);
+	Put64((boost::uint64_t)reinterpret_cast<std::size_t>(id));
+	PutString(name.c_str(), name.length());
+}
+
+void HeapSnapshotWriter::WriteNode(const void *id, int type, std::size_t size) {
+	Put8(RECORD_NODE);
+	Put64((boost::uint64_t)reinterpret_cast<std::size_t>(id));
+	Put8((unsigned int)type);
+	Put32((boost::uint32_t)size);
+
+	if (m_buffer.size() >= HEAPSNAPSHOT_BUFFER_SIZE - 256) {
+		Flush();
+	}
+}
+
+void HeapSnapshotWriter::WriteEdge(const void *from, const void *to,
+								   const char *name, std::size_t len) {
+	Put8(RECORD_EDGE);
+	Put64((boost::uint64_t)reinterpret_cast<std::size_t>(from));
+	Put64((boost::uint64_t)reinterpret_cast<std::size_t>(to));
+	PutString(name, len);
+
+	if (m_buffer.size() >= HEAPSNAPSHOT_BUFFER_SIZE - 256) {
+		Flush();
+	}
+}
+
+void HeapSnapshotWriter::Finish() {
+	Put8(RECORD_END);
+	Flush();
+	m_stream.flush();
+}
+
+
+/*-----------------------------------------------------------------*/
+/**
+ * @brief Buffered reader of the snapshot.
+ */
+class HeapSnapshotReader {
+public:
+	explicit HeapSnapshotReader(std::istream &stream)
+		: m_stream(stream), m_buffer(HEAPSNAPSHOT_BUFFER_SIZE)
+		, m_pos(0), m_size(0), m_isFailed(false) {
+	}
+
+	bool IsFailed() const {
+		return m_isFailed;
+	}
+
+	unsigned int Get8() {
+		if (m_pos >= m_size && !Fill()) {
+			m_isFailed = true;
+			return 0;
+		}
+
+		return (unsigned char)m_buffer[m_pos++];
+	}
+
+	boost::uint32_t Get32() {
+		boost::uint32_t value = 0;
+		for (int i = 0; i < 4; ++i) {
+			value |= (boost::uint32_t)Get8() << (i * 8);
+		}
+		return value;
+	}
+
+	boost::uint64_t Get64() {
+		boost::uint64_t value = 0;
+		for (int i = 0; i < 8; ++i) {
+			value |= (boost::uint64_t)Get8() << (i * 8);
+		}
+		return value;
+	}
+
+	/// Append the string terminated by '\0' to 'names'.
+	std::size_t GetString(std::vector<char> &names) {
+		std::size_t offset = names.size();
+		unsigned int len = Get8();
+		for (unsigned int i = 0; i < len; ++i) {
+			names.push_back((char)Get8());
+		}
+		names.push_back('\0');
+		return offset;
+	}
+
+private:
+	bool Fill() {
+		m_stream.read(&m_buffer[0], (std::streamsize)m_buffer.size());
+		m_size = (std::size_t)m_stream.gcount();
+		m_pos = 0;
+		return (m_size > 0);
+	}
+
+private:
+	std::istream &m_stream;
+	std::vector<char> m_buffer;
+	std::size_t m_pos;
+	std::size_t m_size;
+	bool m_isFailed;
+};
+
+HeapSnapshot::HeapSnapshot() {
+}
+
+HeapSnapshot::~HeapSnapshot() {
+}
+
+int HeapSnapshot::FindNode(boost::uint64_t id) const {
+	std::vector<std::pair<boost::uint64_t, int> >::const_iterator it =
+		std::lower_bound(m_index.begin(), m_index.end(),
+			std::make_pair(id, -1));
+	if (it == m_index.end() || it->first != id) {
+		return -1;
+	}
+
+	return it->second;
+}
+
+int HeapSnapshot::Read(std::istream &stream) {
+	HeapSnapshotReader reader(stream);
+
+	for (std::size_t i = 0; i < sizeof(s_signature); ++i) {
+		if (reader.Get8() != (unsigned char)s_signature[i]) {
+			return -1;
+		}
+	}
+
+	// The edges refer the ids until all nodes are read.
+	std::vector<std::pair<boost::uint64_t, boost::uint64_t> > edgeIds;
+	std::vector<boost::uint64_t> rootIds;
+
+	for (;;) {
+		unsigned int record = reader.Get8();
+		if (reader.IsFailed()) {
+			return -1;
+		}
+
+		if (record == RECORD_END) {
+			break;
+		}
+
+		switch (record) {
+		case RECORD_ROOT: {
+			Root root;
+			rootIds.push_back(reader.Get64());
+			root.node = -1;
+			root.name = reader.GetString(m_names);
+			m_roots.push_back(root);
+			}
+			break;
+		case RECORD_NODE: {
+			Node node;
+			node.id = reader.Get64();
+			node.type = (int)reader.Get8();
+			node.size = reader.Get32();
+			m_nodes.push_back(node);
+			}
+			break;
+		case RECORD_EDGE: {
+			Edge edge;
+			boost::uint64_t from = reader.Get64();
+			boost::uint64_t to = reader.Get64();
+			edgeIds.push_back(std::make_pair(from, to));
+			edge.from = edge.to = -1;
+			edge.name = reader.GetString(m_names);
+			m_edges.push_back(edge);
+			}
+			break;
+		default:
+			return -1;
+		}
+	}
+
+	// Resolve the ids.
+	m_index.reserve(m_nodes.size());
+	for (std::vector<Node>::size_type i = 0; i < m_nodes.size(); ++i) {
+		m_index.push_back(std::make_pair(m_nodes[i].id, (int)i));
+	}
+	std::sort(m_index.begin(), m_index.end());
+
+	for (std::vector<Edge>::size_type i = 0; i < m_edges.size(); ++i) {
+		m_edges[i].from = FindNode(edgeIds[i].first);
+		m_edges[i].to = FindNode(edgeIds[i].second);
+	}
+
+	for (std::vector<Root>::size_type i = 0; i < m_roots.size(); ++i) {
+		m_roots[i].node = FindNode(rootIds[i]);
+	}
+
+	return 0;
+}
+
+
+/*-----------------------------------------------------------------*/
+/// Is the name usable as 'a.name' ?
+static bool IsIdentifier(const char *name) {
+	if (*name == '\0' || isdigit((unsigned char)*name)) {
+		return false;
+	}
+
+	for (; *name != '\0'; ++name) {
+		if (!isalnum((unsigned char)*name) && *name != '_') {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// Append the edge name to the path.
+static void AppendLabel(std::string &path, const char *name) {
+	if (*name == '[') {
+		path += name;
+	}
+	else if (*name == '(' || IsIdentifier(name)) {
+		path += ".";
+		path += name;
+	}
+	else {
+		path += "[\"";
+		path += name;
+		path += "\"]";
+	}
+}
+
+/// The numeric index is grouped as '[*]'.
+static const char *NormalizeLabel(const char *name) {
+	if (*name == '[' && (isdigit((unsigned char)name[1]) || name[1] == '-')) {
+		return "[*]";
+	}
+
+	return name;
+}
+
+/**
+ * @brief The graph of the snapshot for the paths.
+ */
+struct HeapPathFinder {
+	const HeapSnapshot &snapshot;
+	std::vector<int> parent;       ///< -1 means the root or not reachable
+	std::vector<int> parentEdge;   ///< the edge from the parent
+	std::vector<int> rootName;     ///< the root name of the root node, or -1
+	std::vector<int> order;        ///< the nodes in the order of BFS
+
+	explicit HeapPathFinder(const HeapSnapshot &snapshot_)
+		: snapshot(snapshot_) {
+		const std::vector<HeapSnapshot::Node> &nodes = snapshot.GetNodes();
+		const std::vector<HeapSnapshot::Edge> &edges = snapshot.GetEdges();
+		const std::vector<HeapSnapshot::Root> &roots = snapshot.GetRoots();
+		int size = (int)nodes.size();
+
+		// Make the adjacency lists.
+		std::vector<int> offsets(size + 1, 0);
+		std::vector<HeapSnapshot::Edge>::size_type i;
+		for (i = 0; i < edges.size(); ++i) {
+			if (edges[i].from >= 0 && edges[i].to >= 0) {
+				++offsets[edges[i].from + 1];
+			}
+		}
+		for (int n = 0; n < size; ++n) {
+			offsets[n + 1] += offsets[n];
+		}
+
+		std::vector<int> adjacency(offsets[size]);
+		std::vector<int> filled(offsets.begin(), offsets.end() - 1);
+		for (i = 0; i < edges.size(); ++i) {
+			if (edges[i].from >= 0 && edges[i].to >= 0) {
+				adjacency[filled[edges[i].from]++] = (int)i;
+			}
+		}
+
+		// The shortest paths from the roots.
+		parent.assign(size, -1);
+		parentEdge.assign(size, -1);
+		rootName.assign(size, -1);
+		std::vector<bool> visited(size, false);
+		order.reserve(size);
+
+		for (i = 0; i < roots.size(); ++i) {
+			int node = roots[i].node;
+			if (node >= 0 && !visited[node]) {
+				visited[node] = true;
+				rootName[node] = (int)roots[i].name;
+				order.push_back(node);
+			}
+		}
+
+		for (std::vector<int>::size_type head = 0; head < order.size(); ++head) {
+			int node = order[head];
+			for (int k = offsets[node]; k < offsets[node + 1]; ++k) {
+				int to = edges[adjacency[k]].to;
+				if (!visited[to]) {
+					visited[to] = true;
+					parent[to] = node;
+					parentEdge[to] = adjacency[k];
+					order.push_back(to);
+				}
+			}
+		}
+	}
+
+	/// Make the path from the root.
+	std::string GetPath(int node) const {
+		std::vector<const char *> labels;
+		while (node >= 0 && parent[node] >= 0) {
+			if (labels.size() >= HEAPSNAPSHOT_MAX_PATH) {
+				break;
+			}
+			labels.push_back(snapshot.GetName(
+				snapshot.GetEdges()[parentEdge[node]].name));
+			node = parent[node];
+		}
+
+		std::string path;
+		if (node >= 0 && parent[node] >= 0) {
+			path = "...";
+		}
+		else if (node >= 0 && rootName[node] >= 0) {
+			path = snapshot.GetName(rootName[node]);
+		}
+
+		std::vector<const char *>::reverse_iterator it;
+		for (it = labels.rbegin(); it != labels.rend(); ++it) {
+			AppendLabel(path, *it);
+		}
+		return path;
+	}
+};
+
+/**
+ * @brief The new objects retained by a path.
+ */
+struct HeapDiffGroup {
+	HeapDiffGroup() : count(0), bytes(0) {
+	}
+	std::string type;
+	unsigned long count;
+	boost::uint64_t bytes;
+};
+
+/// Compare the bytes of the groups.
+struct HeapDiffGroupGreater {
+	typedef std::pair<std::string, HeapDiffGroup> value_type;
+	bool operator()(const value_type &x, const value_type &y) const {
+		return (x.second.bytes > y.second.bytes);
+	}
+};
+
+/**
+ * The new objects that a new object retains are charged to it, so each
+ * line is a new object referred by an old one, and the index of
+ * the arrays is grouped as '[*]'.
+ */
+void WriteHeapDiff(std::ostream &stream, const HeapSnapshot &before,
+				   const HeapSnapshot &after) {
+	const std::vector<HeapSnapshot::Node> &nodes = after.GetNodes();
+	const std::vector<HeapSnapshot::Edge> &edges = after.GetEdges();
+	HeapPathFinder finder(after);
+
+	// The total of the snapshots.
+	boost::uint64_t beforeBytes = 0, afterBytes = 0, newBytes = 0;
+	unsigned long newCount = 0, freedCount = 0;
+	std::vector<HeapSnapshot::Node>::size_type i;
+	for (i = 0; i < before.GetNodes().size(); ++i) {
+		beforeBytes += before.GetNodes()[i].size;
+		if (after.FindNode(before.GetNodes()[i].id) < 0) {
+			++freedCount;
+		}
+	}
+
+	// The new object is owned by the first new one in its path.
+	std::vector<int> owner(nodes.size(), -1);
+	std::map<int, HeapDiffGroup> owners;
+	for (i = 0; i < finder.order.size(); ++i) {
+		int node = finder.order[i];
+		const HeapSnapshot::Node &info = nodes[node];
+		afterBytes += info.size;
+
+		int index = before.FindNode(info.id);
+		if (index >= 0 && before.GetNodes()[index].type == info.type) {
+			continue;
+		}
+
+		int p = finder.parent[node];
+		owner[node] = (p >= 0 && owner[p] >= 0 ? owner[p] : node);
+
+		HeapDiffGroup &group = owners[owner[node]];
+		if (owner[node] == node) {
+			group.type = LuaGetTypeName(info.type);
+		}
+		++group.count;
+		group.bytes += info.size;
+		++newCount;
+		newBytes += info.size;
+	}
+
+	// Group the owners by the path.
+	std::map<std::string, HeapDiffGroup> groups;
+	std::map<int, std::string> pathCache;
+	std::map<int, HeapDiffGroup>::const_iterator it;
+	for (it = owners.begin(); it != owners.end(); ++it) {
+		int node = it->first;
+		int p = finder.parent[node];
+		std::string path;
+
+		if (p < 0) {
+			path = finder.GetPath(node);
+		}
+		else {
+			std::map<int, std::string>::iterator cached = pathCache.find(p);
+			if (cached == pathCache.end()) {
+				cached = pathCache.insert(
+					std::make_pair(p, finder.GetPath(p))).first;
+			}
+			path = cached->second;
+			AppendLabel(path, NormalizeLabel(
+				after.GetName(edges[finder.parentEdge[node]].name)));
+		}
+
+		HeapDiffGroup &group = groups[path];
+		group.type = it->second.type;
+		group.count += it->second.count;
+		group.bytes += it->second.bytes;
+	}
+
+	std::vector<HeapDiffGroupGreater::value_type> sorted(groups.begin(), groups.end());
+	std::sort(sorted.begin(), sorted.end(), HeapDiffGroupGreater());
+
+	stream << "# before: " << before.GetNodes().size() << " objects, "
+		<< beforeBytes << " bytes" << std::endl;
+	stream << "# after: " << finder.order.size() << " objects, "
+		<< afterBytes << " bytes" << std::endl;
+	stream << "# new: " << newCount << " objects, " << newBytes << " bytes, "
+		<< "freed: " << freedCount << " objects" << std::endl;
+	stream << "# bytes\tobjects\ttype\tpath" << std::endl;
+
+	for (std::vector<HeapDiffGroupGreater::value_type>::size_type k = 0;
+		k < sorted.size(); ++k) {
+		const HeapDiffGroup &group = sorted[k].second;
+		stream << group.bytes << "\t" << group.count << "\t"
+			<< group.type << "\t" << sorted[k].first << "\n";
+	}
+	stream.flush();
+}
+
+} // end of namespace lldebug
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __LLDEBUG_HEAPSNAPSHOT_H__
+#define __LLDEBUG_HEAPSNAPSHOT_H__
+
+#include <boost/cstdint.hpp>
+
+namespace lldebug {
+
+/**
+ * @brief Writer of the heap snapshot.
+ *
+ * The snapshot is a binary stream of the records, so the nodes can be
+ * written while walking the heap. The identifier of the node is
+ * the address of the object, and the type is the lua type.
+ * The edge may be written before the node it refers.
+ */
+class HeapSnapshotWriter {
+public:
+	explicit HeapSnapshotWriter(std::ostream &stream);
+	~HeapSnapshotWriter();
+
+	/// Write the root object and its name.
+	void WriteRoot(const void *id, const std::string &name);
+
+	/// Write the object, 'size' is the estimated bytes.
+	void WriteNode(const void *id, int type, std::size_t size);
+
+	/// Write the reference from 'from' to 'to'.
+	void WriteEdge(const void *from, const void *to,
+				   const char *name, std::size_t len);
+
+	/// Write the end mark and flush, the snapshot is complete.
+	void Finish();
+
+private:
+	void Put8(unsigned int value);
+	void Put32(boost::uint32_t value);
+	void Put64(boost::uint64_t value);
+	void PutString(const char *str, std::size_t len);
+	void Flush();
+
+private:
+	std::ostream &m_stream;
+	std::vector<char> m_buffer;
+};
+
+/**
+ * @brief The heap snapshot read from the file.
+ */
+class HeapSnapshot {
+public:
+	struct Node {
+		boost::uint64_t id;
+		int type;
+		boost::uint32_t size;
+	};
+	struct Edge {
+		int from; ///< the index of the node
+		int to;
+		std::size_t name; ///< the offset in the names
+	};
+	struct Root {
+		int node;
+		std::size_t name;
+	};
+
+public:
+	explicit HeapSnapshot();
+	~HeapSnapshot();
+
+	/// Read the snapshot, it returns 0 or -1(error).
+	int Read(std::istream &stream);
+
+	/// Get the objects.
+	const std::vector<Node> &GetNodes() const {
+		return m_nodes;
+	}
+
+	/// Get the references.
+	const std::vector<Edge> &GetEdges() const {
+		return m_edges;
+	}
+
+	/// Get the roots.
+	const std::vector<Root> &GetRoots() const {
+		return m_roots;
+	}
+
+	/// Get the name of the edge or the root.
+	const char *GetName(std::size_t offset) const {
+		return &m_names[offset];
+	}
+
+	/// Find the node, it returns -1 if it doesn't exist.
+	int FindNode(boost::uint64_t id) const;
+
+private:
+	std::vector<Node> m_nodes;
+	std::vector<Edge> m_edges;
+	std::vector<Root> m_roots;
+	std::vector<char> m_names; ///< the names terminated by '\0'
+	std::vector<std::pair<boost::uint64_t, int> > m_index; ///< sorted by id
+};
+
+/// Write the objects 'after' has and 'before' doesn't have,
+/// they are grouped by the path from the root and the most bytes first.
+void WriteHeapDiff(std::ostream &stream, const HeapSnapshot &before,
+				   const HeapSnapshot &after);
+
+} // end of namespace lldebug
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "lldebug.h"
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file
+ *
+ * Measure the cost of dispatching a hook event to the context while
+ * 1, 4 and 16 threads run their own lua_State objects. The states are
+ * opened without the frame, and no profiler records anything, so an event
+ * only resolves the context of 'L', pins it, finds the calling thread and
+ * returns. The sampling profiler keeps the count hook installed, but its
+ * timer ticks once a second, so it only reads the tick count per event.
+ * The count of the hook is set to 1, and every instruction is an event.
+ *
+ * The same script on the plain lua is the baseline, and the plain lua with
+ * an empty hook shows the cost of the hook in lua itself. The time over
+ * the baseline is divided by the instructions of the script, which are
+ * counted once by a hook on the plain lua.
+ *
+ * 'hook_bench logpoint' measures the logpoints with the frame instead.
+ * Set a logpoint in 'f' on the frame before the script runs, and it
+ * prints the time of a call and the rate of the posted messages.
+ */
+
+// The baseline runs on the plain lua.
+#undef lua_close
+#undef luaL_loadstring
+#undef luaL_openlibs
+
+static const char *s_script =
+	"local function f(x) return x + 1 end\n"
+	"local s = 0\n"
+	"for i = 1, ... do s = f(s) end\n"
+	"return s\n";
+
+/// Open the plain lua_State, the script is on the top.
+static lua_State *open_plain() {
+	lua_State *L = luaL_newstate();
+	if (L == NULL) {
+		return NULL;
+	}
+
+	luaL_openlibs(L);
+	if (luaL_loadstring(L, s_script) != 0) {
+		printf("%s\n", lua_tostring(L, -1));
+		lua_close(L);
+		return NULL;
+	}
+
+	return L;
+}
+
+/// The interval of the sampling profiler, it never samples in a run.
+static const int SAMPLING_INTERVAL = 1000;
+
+/// Open the lua_State of lldebug, the script is on the top.
+/**
+ * If 'isDispatching' is true, every instruction makes a count event.
+ */
+static lua_State *open_hooked(bool isDispatching) {
+	lldebug_setframeenabled(isDispatching ? 0 : 1);
+	lua_State *L = lldebug_open();
+	if (L == NULL) {
+		return NULL;
+	}
+
+	if (lldebug_loadstring(L, s_script) != 0) {
+		printf("%s\n", lua_tostring(L, -1));
+		lldebug_close(L);
+		return NULL;
+	}
+
+	// The context checks only the mask, so the count is kept.
+	if (isDispatching) {
+		lldebug_profile_start(L, SAMPLING_INTERVAL);
+		lua_sethook(L, lua_gethook(L), lua_gethookmask(L), 1);
+	}
+	return L;
+}
+
+static void empty_hook(lua_State * /*L*/, lua_Debug * /*ar*/) {
+}
+
+static double s_instructions = 0.0;
+
+static void count_hook(lua_State * /*L*/, lua_Debug * /*ar*/) {
+	s_instructions += 1.0;
+}
+
+/// Call the script 'calls' times, it runs on its own thread.
+static void run_script(lua_State *L, int calls, double *seconds) {
+	boost::posix_time::ptime start =
+		boost::posix_time::microsec_clock::universal_time();
+
+	lua_pushvalue(L, -1);
+	lua_pushnumber(L, calls);
+	if (lua_pcall(L, 1, 1, 0) != 0) {
+		printf("%s\n", lua_tostring(L, -1));
+	}
+	lua_pop(L, 1);
+
+	boost::posix_time::time_duration elapsed =
+		boost::posix_time::microsec_clock::universal_time() - start;
+	*seconds = elapsed.total_microseconds() * 1.0e-6;
+}
+
+/// Run the script of each state at the same time,
+/// and return the average seconds of the threads.
+static double run_threads(const std::vector<lua_State *> &states, int calls) {
+	std::vector<double> seconds(states.size(), 0.0);
+
+	boost::thread_group group;
+	for (std::vector<lua_State *>::size_type i = 0; i < states.size(); ++i) {
+		group.create_thread(
+			boost::bind(&run_script, states[i], calls, &seconds[i]));
+	}
+	group.join_all();
+
+	double total = 0.0;
+	for (std::vector<double>::size_type i = 0; i < seconds.size(); ++i) {
+		total += seconds[i];
+	}
+
+	return (total / seconds.size());
+}
+
+/// Run the script once with the logpoint that the frame sets.
+static int bench_logpoint(int calls) {
+	lua_State *L = open_hooked(false);
+	if (L == NULL) {
+		printf("Couldn't open the lua_State.\n");
+		return -1;
+	}
+
+	printf("Set a logpoint in 'f' on the frame, and press enter.\n");
+	getchar();
+
+	// The thread that opened the state breaks at the first line,
+	// so the script runs on another thread.
+	std::vector<lua_State *> states(1, L);
+	double seconds = run_threads(states, calls);
+
+	unsigned long posted = 0, dropped = 0;
+	lldebug_getlogpointcount(L, &posted, &dropped);
+	printf("ns/call\tposted/s\tdropped/s\n");
+	printf("%.1f\t%.0f\t%.0f\n", seconds * 1.0e9 / calls,
+		posted / seconds, dropped / seconds);
+
+	lldebug_close(L);
+	return 0;
+}
+
+/// Count the instructions of the script with 'calls'.
+static double count_instructions(int calls) {
+	lua_State *L = open_plain();
+	if (L == NULL) {
+		return 0.0;
+	}
+
+	s_instructions = 0.0;
+	lua_sethook(L, count_hook, LUA_MASKCOUNT, 1);
+	lua_pushnumber(L, calls);
+	if (lua_pcall(L, 1, 1, 0) != 0) {
+		printf("%s\n", lua_tostring(L, -1));
+	}
+	lua_close(L);
+	return s_instructions;
+}
+
+int main(int argc, char **argv) {
+	bool isLogpoint = (argc > 1 && strcmp(argv[1], "logpoint") == 0);
+	if (isLogpoint) {
+		--argc;
+		++argv;
+	}
+
+	int calls = (argc > 1 ? atoi(argv[1]) : 1000000);
+	if (calls <= 0) {
+		printf("Usage: hook_bench [logpoint] [calls]\n");
+		return -1;
+	}
+
+	if (isLogpoint) {
+		return bench_logpoint(calls);
+	}
+
+	double events = count_instructions(calls);
+	if (events <= 0.0) {
+		printf("Couldn't count the instructions.\n");
+		return -1;
+	}
+
+	static const int threads[] = {1, 4, 16};
+	printf("%.0f events/run\n", events);
+	printf("threads\tbase ns/call\tlua hook ns/event\tlldebug ns/event\n");
+
+	for (int i = 0; i < (int)(sizeof(threads) / sizeof(threads[0])); ++i) {
+		std::vector<lua_State *> plains, emptys, hookeds;
+		for (int n = 0; n < threads[i]; ++n) {
+			lua_State *plain = open_plain();
+			lua_State *empty = open_plain();
+			lua_State *hooked = open_hooked(true);
+			if (plain == NULL || empty == NULL || hooked == NULL) {
+				printf("Couldn't open the lua_State.\n");
+				return -1;
+			}
+
+			lua_sethook(empty, empty_hook, LUA_MASKCOUNT, 1);
+			plains.push_back(plain);
+			emptys.push_back(empty);
+			hookeds.push_back(hooked);
+		}
+
+		double base = run_threads(plains, calls);
+		double empty = run_threads(emptys, calls);
+		double hooked = run_threads(hookeds, calls);
+		printf("%d\t%.1f\t%.2f\t%.2f\n", threads[i],
+			base * 1.0e9 / calls,
+			(empty - base) * 1.0e9 / events,
+			(hooked - base) * 1.0e9 / events);
+
+		for (int n = 0; n < threads[i]; ++n) {
+			lua_close(plains[n]);
+			lua_close(emptys[n]);
+			lldebug_profile_stop(hookeds[n], NULL);
+			lldebug_close(hookeds[n]);
+		}
+	}
+
+	return 0;
+}
@@ -256,4 +256,280 @@ LuaBacktrace::LuaBacktrace() {
 LuaBacktrace::~LuaBacktrace() {
 }
 
+
+/*-----------------------------------------------------------------*/
+#ifdef LLDEBUG_CONTEXT
+LuaFuncProfile::LuaFuncProfile(const std::string &name,
+							   const std::string &sourceKey,
+							   const std::string &sourceTitle,
+							   int line, unsigned long calls,
+							   double totalTime, double selfTime,
+							   double totalCpuTime, double selfCpuTime)
+	: m_funcName(name), m_key(sourceKey), m_sourceTitle(sourceTitle)
+	, m_line(line), m_calls(calls)
+	, m_totalTime(totalTime), m_selfTime(selfTime)
+	, m_totalCpuTime(totalCpuTime), m_selfCpuTime(selfCpuTime) {
+}
+#endif
+
+LuaFuncProfile::LuaFuncProfile()
+	: m_line(-1), m_calls(0)
+	, m_totalTime(0.0), m_selfTime(0.0)
+	, m_totalCpuTime(0.0), m_selfCpuTime(0.0) {
+}
+
+LuaFuncProfile::~LuaFuncProfile() {
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef LLDEBUG_CONTEXT
+LuaAllocProfile::LuaAllocProfile(const std::string &sourceKey,
+								 const std::string &sourceTitle, int line,
+								 unsigned long allocs, unsigned long frees,
+								 boost::uint64_t allocBytes,
+								 boost::uint64_t freeBytes)
+	: m_key(sourceKey), m_sourceTitle(sourceTitle), m_line(line)
+	, m_allocs(allocs), m_frees(frees)
+	, m_allocBytes(allocBytes), m_freeBytes(freeBytes) {
+}
+#endif
+
+LuaAllocProfile::LuaAllocProfile()
+	: m_line(-1), m_allocs(0), m_frees(0)
+	, m_allocBytes(0), m_freeBytes(0) {
+}
+
+LuaAllocProfile::~LuaAllocProfile() {
+}
+
+/**
+ * Each line is "live_bytes alloc_bytes free_bytes allocs frees source:line"
+ * separated by tabs.
+ */
+void WriteAllocProfile(std::ostream &stream, const LuaAllocProfileList &profiles) {
+	for (LuaAllocProfileList::size_type i = 0; i < profiles.size(); ++i) {
+		const LuaAllocProfile &profile = profiles[i];
+
+		stream
+			<< profile.GetLiveBytes() << "\t"
+			<< profile.GetAllocBytes() << "\t"
+			<< profile.GetFreeBytes() << "\t"
+			<< profile.GetAllocs() << "\t"
+			<< profile.GetFrees() << "\t"
+			<< profile.GetTitle() << ":" << profile.GetLine() << "\n";
+	}
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef LLDEBUG_CONTEXT
+LuaSchedProfile::LuaSchedProfile(const std::string &sourceKey,
+								 const std::string &sourceTitle, int line,
+								 unsigned long coroutines,
+								 unsigned long resumes, unsigned long yields,
+								 double runTime, double maxRunTime,
+								 double waitTime, double maxWaitTime)
+	: m_key(sourceKey), m_sourceTitle(sourceTitle), m_line(line)
+	, m_coroutines(coroutines), m_resumes(resumes), m_yields(yields)
+	, m_runTime(runTime), m_maxRunTime(maxRunTime)
+	, m_waitTime(waitTime), m_maxWaitTime(maxWaitTime) {
+}
+#endif
+
+LuaSchedProfile::LuaSchedProfile()
+	: m_line(-1), m_coroutines(0), m_resumes(0), m_yields(0)
+	, m_runTime(0.0), m_maxRunTime(0.0)
+	, m_waitTime(0.0), m_maxWaitTime(0.0) {
+}
+
+LuaSchedProfile::~LuaSchedProfile() {
+}
+
+/// The first line is the header, and the times are in seconds.
+static void write_sched_profile_csv(std::ostream &stream,
+									const LuaSchedProfileList &profiles) {
+	stream << "site,coroutines,resumes,yields,run,max_run,wait,max_wait\n";
+
+	for (LuaSchedProfileList::size_type i = 0; i < profiles.size(); ++i) {
+		const LuaSchedProfile &profile = profiles[i];
+		char buffer[256];
+
+		// The site is quoted, the title may have commas.
+		stream << "\"";
+		const std::string &title = profile.GetTitle();
+		for (std::string::size_type j = 0; j < title.size(); ++j) {
+			if (title[j] == '"') {
+				stream << '"';
+			}
+			stream << title[j];
+		}
+		stream << ":" << profile.GetLine() << "\"";
+
+		snprintf(buffer, sizeof(buffer), ",%lu,%lu,%lu,%.6f,%.6f,%.6f,%.6f\n",
+			profile.GetCoroutines(), profile.GetResumes(), profile.GetYields(),
+			profile.GetRunTime(), profile.GetMaxRunTime(),
+			profile.GetWaitTime(), profile.GetMaxWaitTime());
+		stream << buffer;
+	}
+}
+
+void WriteJsonString(std::ostream &stream, const std::string &str) {
+	stream << "\"";
+	for (std::string::size_type i = 0; i < str.size(); ++i) {
+		unsigned char c = (unsigned char)str[i];
+
+		if (c == '"' || c == '\\') {
+			stream << '\\' << (char)c;
+		}
+		else if (c < 0x20) {
+			char buffer[8];
+			snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+			stream << buffer;
+		}
+		else {
+			stream << (char)c;
+		}
+	}
+	stream << "\"";
+}
+
+static void write_sched_profile_json(std::ostream &stream,
+									 const LuaSchedProfileList &profiles) {
+	stream << "[\n";
+
+	for (LuaSchedProfileList::size_type i = 0; i < profiles.size(); ++i) {
+		const LuaSchedProfile &profile = profiles[i];
+		char buffer[256];
+
+		stream << "  {\"source\": ";
+		WriteJsonString(stream, profile.GetTitle());
+		snprintf(buffer, sizeof(buffer),
+			", \"line\": %d, \"coroutines\": %lu, \"resumes\": %lu,"
+			" \"yields\": %lu, \"run\": %.6f, \"max_run\": %.6f,"
+			" \"wait\": %.6f, \"max_wait\": %.6f}",
+			profile.GetLine(), profile.GetCoroutines(),
+			profile.GetResumes(), profile.GetYields(),
+			profile.GetRunTime(), profile.GetMaxRunTime(),
+			profile.GetWaitTime(), profile.GetMaxWaitTime());
+		stream << buffer << (i + 1 < profiles.size() ? ",\n" : "\n");
+	}
+
+	stream << "]\n";
+}
+
+void WriteSchedProfile(std::ostream &stream, const LuaSchedProfileList &profiles,
+					   const std::string &filename) {
+	const std::string ext = ".json";
+
+	if (filename.size() >= ext.size()
+		&& filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0) {
+		write_sched_profile_json(stream, profiles);
+	}
+	else {
+		write_sched_profile_csv(stream, profiles);
+	}
+}
+
+
+/*-----------------------------------------------------------------*/
+LuaGcSample::LuaGcSample(double time, double kbytes,
+						 double peakKBytes, double collectedKBytes)
+	: m_time(time), m_kbytes(kbytes)
+	, m_peakKBytes(peakKBytes), m_collectedKBytes(collectedKBytes) {
+}
+
+LuaGcSample::LuaGcSample()
+	: m_time(0.0), m_kbytes(0.0)
+	, m_peakKBytes(0.0), m_collectedKBytes(0.0) {
+}
+
+LuaGcSample::~LuaGcSample() {
+}
+
+void WriteGcSampleHeader(std::ostream &stream) {
+	stream << "time,kbytes,peak_kbytes,collected_kbytes\n";
+}
+
+void WriteGcSamples(std::ostream &stream, const LuaGcSampleList &samples) {
+	for (LuaGcSampleList::size_type i = 0; i < samples.size(); ++i) {
+		const LuaGcSample &sample = samples[i];
+		char buffer[128];
+
+		snprintf(buffer, sizeof(buffer), "%.3f,%.1f,%.1f,%.1f\n",
+			sample.GetTime(), sample.GetKBytes(),
+			sample.GetPeakKBytes(), sample.GetCollectedKBytes());
+		stream << buffer;
+	}
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef LLDEBUG_CONTEXT
+LuaCoroutine::LuaCoroutine(const LuaHandle &lua, unsigned long serial,
+						   const std::string &status,
+						   const std::string &creationKey,
+						   const std::string &creationTitle,
+						   int creationLine,
+						   const std::string &funcName,
+						   const std::string &key,
+						   const std::string &title,
+						   int line)
+	: m_lua(lua), m_serial(serial), m_status(status)
+	, m_creationKey(creationKey), m_creationTitle(creationTitle)
+	, m_creationLine(creationLine), m_funcName(funcName)
+	, m_key(key), m_title(title), m_line(line) {
+}
+#endif
+
+LuaCoroutine::LuaCoroutine()
+	: m_serial(0), m_creationLine(-1), m_line(-1) {
+}
+
+LuaCoroutine::~LuaCoroutine() {
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef LLDEBUG_CONTEXT
+LuaThread::LuaThread(int id, const LuaHandle &lua, bool isBreak,
+					 bool isSelected, const std::string &key,
+					 const std::string &title, int line)
+	: m_id(id), m_lua(lua), m_isBreak(isBreak), m_isSelected(isSelected)
+	, m_key(key), m_title(title), m_line(line) {
+}
+#endif
+
+LuaThread::LuaThread()
+	: m_id(0), m_isBreak(false), m_isSelected(false), m_line(-1) {
+}
+
+LuaThread::~LuaThread() {
+}
+
+
+/*-----------------------------------------------------------------*/
+LuaFieldQuery::LuaFieldQuery(const std::string &keyPattern,
+							 const std::string &predicate,
+							 int sortKey, bool isAscending)
+	: m_keyPattern(keyPattern), m_predicate(predicate)
+	, m_sortKey(sortKey), m_isAscending(isAscending) {
+}
+
+LuaFieldQuery::LuaFieldQuery()
+	: m_sortKey(FIELDSORT_NONE), m_isAscending(true) {
+}
+
+LuaFieldQuery::~LuaFieldQuery() {
+}
+
+
+/*-----------------------------------------------------------------*/
+LuaBreakSnapshot::LuaBreakSnapshot()
+	: m_hasBacktraces(false), m_hasLocals(false), m_hasWatches(false) {
+}
+
+LuaBreakSnapshot::~LuaBreakSnapshot() {
+}
+
 } // end of namespace lldebug
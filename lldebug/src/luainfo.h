@@ -27,6 +27,8 @@
 #ifndef __LLDEBUG_LUAINFO_H__
 #define __LLDEBUG_LUAINFO_H__
 
+#include <boost/cstdint.hpp>
+
 namespace lldebug {
 
 /// Get the typename.
@@ -289,9 +291,702 @@ public:
 	int m_level;
 };
 
+/**
+ * @brief The profile of a lua function.
+ *
+ * The times are in seconds. 'total' includes the callees, and 'self'
+ * doesn't include them.
+ */
+class LuaFuncProfile {
+public:
+#ifdef LLDEBUG_CONTEXT
+	explicit LuaFuncProfile(const std::string &name,
+							const std::string &sourceKey,
+							const std::string &sourceTitle,
+							int line, unsigned long calls,
+							double totalTime, double selfTime,
+							double totalCpuTime, double selfCpuTime);
+#endif
+	explicit LuaFuncProfile();
+	~LuaFuncProfile();
+
+	/// Get the function name.
+	const std::string &GetFuncName() const {
+		return m_funcName;
+	}
+
+	/// Get the source key.
+	const std::string &GetKey() const {
+		return m_key;
+	}
+
+	/// Get the source title.
+	const std::string &GetTitle() const {
+		return m_sourceTitle;
+	}
+
+	/// Get the line that the function is defined.
+	int GetLine() const {
+		return m_line;
+	}
+
+	/// Get the number of the calls.
+	unsigned long GetCalls() const {
+		return m_calls;
+	}
+
+	/// Get the wall time including the callees.
+	double GetTotalTime() const {
+		return m_totalTime;
+	}
+
+	/// Get the wall time excluding the callees.
+	double GetSelfTime() const {
+		return m_selfTime;
+	}
+
+	/// Get the cpu time including the callees.
+	double GetTotalCpuTime() const {
+		return m_totalCpuTime;
+	}
+
+	/// Get the cpu time excluding the callees.
+	double GetSelfCpuTime() const {
+		return m_selfCpuTime;
+	}
+
+private:
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int) {
+		ar & LLDEBUG_MEMBER_NVP(funcName);
+		ar & LLDEBUG_MEMBER_NVP(key);
+		ar & LLDEBUG_MEMBER_NVP(sourceTitle);
+		ar & LLDEBUG_MEMBER_NVP(line);
+		ar & LLDEBUG_MEMBER_NVP(calls);
+		ar & LLDEBUG_MEMBER_NVP(totalTime);
+		ar & LLDEBUG_MEMBER_NVP(selfTime);
+		ar & LLDEBUG_MEMBER_NVP(totalCpuTime);
+		ar & LLDEBUG_MEMBER_NVP(selfCpuTime);
+	}
+
+private:
+	std::string m_funcName;
+	std::string m_key;
+	std::string m_sourceTitle;
+	int m_line;
+	unsigned long m_calls;
+	double m_totalTime;
+	double m_selfTime;
+	double m_totalCpuTime;
+	double m_selfCpuTime;
+};
+
+/**
+ * @brief The allocations of a lua function.
+ */
+class LuaAllocProfile {
+public:
+#ifdef LLDEBUG_CONTEXT
+	explicit LuaAllocProfile(const std::string &sourceKey,
+							 const std::string &sourceTitle, int line,
+							 unsigned long allocs, unsigned long frees,
+							 boost::uint64_t allocBytes,
+							 boost::uint64_t freeBytes);
+#endif
+	explicit LuaAllocProfile();
+	~LuaAllocProfile();
+
+	/// Get the source key, or empty if the function is unknown.
+	const std::string &GetKey() const {
+		return m_key;
+	}
+
+	/// Get the source title.
+	const std::string &GetTitle() const {
+		return m_sourceTitle;
+	}
+
+	/// Get the line that the function is defined.
+	int GetLine() const {
+		return m_line;
+	}
+
+	/// Get the number of the allocations.
+	unsigned long GetAllocs() const {
+		return m_allocs;
+	}
+
+	/// Get the number of the frees.
+	unsigned long GetFrees() const {
+		return m_frees;
+	}
+
+	/// Get the allocated bytes.
+	boost::uint64_t GetAllocBytes() const {
+		return m_allocBytes;
+	}
+
+	/// Get the freed bytes of the blocks allocated by this function.
+	boost::uint64_t GetFreeBytes() const {
+		return m_freeBytes;
+	}
+
+	/// Get the bytes still alive.
+	boost::uint64_t GetLiveBytes() const {
+		return (m_allocBytes - m_freeBytes);
+	}
+
+private:
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int) {
+		ar & LLDEBUG_MEMBER_NVP(key);
+		ar & LLDEBUG_MEMBER_NVP(sourceTitle);
+		ar & LLDEBUG_MEMBER_NVP(line);
+		ar & LLDEBUG_MEMBER_NVP(allocs);
+		ar & LLDEBUG_MEMBER_NVP(frees);
+		ar & LLDEBUG_MEMBER_NVP(allocBytes);
+		ar & LLDEBUG_MEMBER_NVP(freeBytes);
+	}
+
+private:
+	std::string m_key;
+	std::string m_sourceTitle;
+	int m_line;
+	unsigned long m_allocs;
+	unsigned long m_frees;
+	boost::uint64_t m_allocBytes;
+	boost::uint64_t m_freeBytes;
+};
+
+/**
+ * @brief The scheduling of the coroutines created at a site.
+ *
+ * The run time is the time from a resume to the next yield, excluding
+ * the coroutines it resumes. The wait time is the time from a yield to
+ * the next resume. The times are in seconds.
+ */
+class LuaSchedProfile {
+public:
+#ifdef LLDEBUG_CONTEXT
+	explicit LuaSchedProfile(const std::string &sourceKey,
+							 const std::string &sourceTitle, int line,
+							 unsigned long coroutines, unsigned long resumes,
+							 unsigned long yields,
+							 double runTime, double maxRunTime,
+							 double waitTime, double maxWaitTime);
+#endif
+	explicit LuaSchedProfile();
+	~LuaSchedProfile();
+
+	/// Get the source key of the creation site, or empty if it's unknown.
+	const std::string &GetKey() const {
+		return m_key;
+	}
+
+	/// Get the source title of the creation site.
+	const std::string &GetTitle() const {
+		return m_sourceTitle;
+	}
+
+	/// Get the line of the creation site.
+	int GetLine() const {
+		return m_line;
+	}
+
+	/// Get the number of the coroutines resumed.
+	unsigned long GetCoroutines() const {
+		return m_coroutines;
+	}
+
+	/// Get the number of the resumes.
+	unsigned long GetResumes() const {
+		return m_resumes;
+	}
+
+	/// Get the number of the yields. (the finished runs aren't counted)
+	unsigned long GetYields() const {
+		return m_yields;
+	}
+
+	/// Get the total run time.
+	double GetRunTime() const {
+		return m_runTime;
+	}
+
+	/// Get the longest run between a resume and the next yield.
+	double GetMaxRunTime() const {
+		return m_maxRunTime;
+	}
+
+	/// Get the total time from the yields to the next resumes.
+	double GetWaitTime() const {
+		return m_waitTime;
+	}
+
+	/// Get the longest time from a yield to the next resume.
+	double GetMaxWaitTime() const {
+		return m_maxWaitTime;
+	}
+
+private:
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int) {
+		ar & LLDEBUG_MEMBER_NVP(key);
+		ar & LLDEBUG_MEMBER_NVP(sourceTitle);
+		ar & LLDEBUG_MEMBER_NVP(line);
+		ar & LLDEBUG_MEMBER_NVP(coroutines);
+		ar & LLDEBUG_MEMBER_NVP(resumes);
+		ar & LLDEBUG_MEMBER_NVP(yields);
+		ar & LLDEBUG_MEMBER_NVP(runTime);
+		ar & LLDEBUG_MEMBER_NVP(maxRunTime);
+		ar & LLDEBUG_MEMBER_NVP(waitTime);
+		ar & LLDEBUG_MEMBER_NVP(maxWaitTime);
+	}
+
+private:
+	std::string m_key;
+	std::string m_sourceTitle;
+	int m_line;
+	unsigned long m_coroutines;
+	unsigned long m_resumes;
+	unsigned long m_yields;
+	double m_runTime;
+	double m_maxRunTime;
+	double m_waitTime;
+	double m_maxWaitTime;
+};
+
 typedef std::vector<LuaVar> LuaVarList;
 typedef std::vector<LuaVarList> LuaMultiVarList;
 typedef std::vector<LuaBacktrace> LuaBacktraceList;
+typedef std::vector<LuaFuncProfile> LuaFuncProfileList;
+typedef std::vector<LuaAllocProfile> LuaAllocProfileList;
+
+/// Write the allocation report, a line for each function.
+void WriteAllocProfile(std::ostream &stream, const LuaAllocProfileList &profiles);
+
+typedef std::vector<LuaSchedProfile> LuaSchedProfileList;
+
+/// Write the string literal of json.
+void WriteJsonString(std::ostream &stream, const std::string &str);
+
+/// Write the scheduler report, a record for each creation site.
+/**
+ * It's written in json if 'filename' ends with ".json", otherwise in csv.
+ */
+void WriteSchedProfile(std::ostream &stream, const LuaSchedProfileList &profiles,
+					   const std::string &filename);
+
+/**
+ * @brief The heap size sampled by the GC monitor.
+ *
+ * The peak and the collected size are of the interval since
+ * the previous sample.
+ */
+class LuaGcSample {
+public:
+	explicit LuaGcSample(double time, double kbytes,
+						 double peakKBytes, double collectedKBytes);
+	explicit LuaGcSample();
+	~LuaGcSample();
+
+	/// Get the seconds since the monitor started.
+	double GetTime() const {
+		return m_time;
+	}
+
+	/// Get the heap size in kbytes.
+	double GetKBytes() const {
+		return m_kbytes;
+	}
+
+	/// Get the peak heap size in kbytes.
+	double GetPeakKBytes() const {
+		return m_peakKBytes;
+	}
+
+	/// Get the kbytes that the collector freed.
+	double GetCollectedKBytes() const {
+		return m_collectedKBytes;
+	}
+
+private:
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int) {
+		ar & LLDEBUG_MEMBER_NVP(time);
+		ar & LLDEBUG_MEMBER_NVP(kbytes);
+		ar & LLDEBUG_MEMBER_NVP(peakKBytes);
+		ar & LLDEBUG_MEMBER_NVP(collectedKBytes);
+	}
+
+private:
+	double m_time;
+	double m_kbytes;
+	double m_peakKBytes;
+	double m_collectedKBytes;
+};
+
+typedef std::vector<LuaGcSample> LuaGcSampleList;
+
+/// Write the header line of the GC samples in csv.
+void WriteGcSampleHeader(std::ostream &stream);
+
+/// Write the GC samples in csv, a line for each sample.
+void WriteGcSamples(std::ostream &stream, const LuaGcSampleList &samples);
+
+/// The coroutines that the frame debugs.
+/**
+ * The coroutines that called 'lldebug.debug_this()' are debugged with
+ * any filter, and the main state is always debugged.
+ */
+enum DebugFilterType {
+	DEBUGFILTER_ALL, ///< all coroutines
+	DEBUGFILTER_MARKED, ///< only the marked coroutines
+	DEBUGFILTER_SITE, ///< the coroutines created in the sources that contain the pattern
+	DEBUGFILTER_TAG, ///< the coroutines tagged with the pattern by 'lldebug.settag'
+};
+
+/// The sort key of the coroutine list.
+enum CoroutineSortKey {
+	COROUTINESORT_SERIAL, ///< in the order of the creation
+	COROUTINESORT_STATUS,
+	COROUTINESORT_CREATION, ///< by the creation site
+	COROUTINESORT_FRAME, ///< by the top frame
+};
+
+/// The sort key of the table fields.
+enum FieldSortKey {
+	FIELDSORT_NONE, ///< in the order of the table
+	FIELDSORT_NAME,
+	FIELDSORT_VALUE,
+};
+
+/**
+ * @brief The query of the table fields, it's run by the context.
+ *
+ * 'keyPattern' is a lua pattern for the field names, and 'predicate'
+ * is a lua expression of 'key' and 'value'. The empty ones match all.
+ */
+class LuaFieldQuery {
+public:
+	explicit LuaFieldQuery(const std::string &keyPattern,
+						   const std::string &predicate,
+						   int sortKey, bool isAscending);
+	explicit LuaFieldQuery();
+	~LuaFieldQuery();
+
+	/// Does this match all the fields in the order of the table ?
+	bool IsEmpty() const {
+		return (m_keyPattern.empty() && m_predicate.empty()
+			&& m_sortKey == FIELDSORT_NONE);
+	}
+
+	/// Get the lua pattern for the field names.
+	const std::string &GetKeyPattern() const {
+		return m_keyPattern;
+	}
+
+	/// Get the lua expression that selects the fields.
+	const std::string &GetPredicate() const {
+		return m_predicate;
+	}
+
+	/// Get the sort key (FieldSortKey).
+	int GetSortKey() const {
+		return m_sortKey;
+	}
+
+	/// Is the order ascending ?
+	bool IsAscending() const {
+		return m_isAscending;
+	}
+
+private:
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int) {
+		ar & LLDEBUG_MEMBER_NVP(keyPattern);
+		ar & LLDEBUG_MEMBER_NVP(predicate);
+		ar & LLDEBUG_MEMBER_NVP(sortKey);
+		ar & LLDEBUG_MEMBER_NVP(isAscending);
+	}
+
+private:
+	std::string m_keyPattern;
+	std::string m_predicate;
+	int m_sortKey;
+	bool m_isAscending;
+};
+
+/**
+ * @brief Infomation of a live coroutine.
+ *
+ * The backtrace and the locals are requested with the lua handle.
+ */
+class LuaCoroutine {
+public:
+#ifdef LLDEBUG_CONTEXT
+	explicit LuaCoroutine(const LuaHandle &lua, unsigned long serial,
+						  const std::string &status,
+						  const std::string &creationKey,
+						  const std::string &creationTitle,
+						  int creationLine,
+						  const std::string &funcName,
+						  const std::string &key,
+						  const std::string &title,
+						  int line);
+#endif
+	explicit LuaCoroutine();
+	~LuaCoroutine();
+
+	/// Get the lua handle.
+	const LuaHandle &GetLua() const {
+		return m_lua;
+	}
+
+	/// Get the serial number, it increases in the order of the creation.
+	unsigned long GetSerial() const {
+		return m_serial;
+	}
+
+	/// Get the status such as coroutine.status returns.
+	const std::string &GetStatus() const {
+		return m_status;
+	}
+
+	/// Get the source key where the coroutine was created.
+	const std::string &GetCreationKey() const {
+		return m_creationKey;
+	}
+
+	/// Get the source title where the coroutine was created.
+	const std::string &GetCreationTitle() const {
+		return m_creationTitle;
+	}
+
+	/// Get the line where the coroutine was created, -1 if unknown.
+	int GetCreationLine() const {
+		return m_creationLine;
+	}
+
+	/// Get the function name of the top frame.
+	const std::string &GetFuncName() const {
+		return m_funcName;
+	}
+
+	/// Get the source key of the top frame.
+	const std::string &GetKey() const {
+		return m_key;
+	}
+
+	/// Get the source title of the top frame.
+	const std::string &GetTitle() const {
+		return m_title;
+	}
+
+	/// Get the line of the top frame, -1 if it has no lua frame.
+	int GetLine() const {
+		return m_line;
+	}
+
+private:
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int) {
+		ar & LLDEBUG_MEMBER_NVP(lua);
+		ar & LLDEBUG_MEMBER_NVP(serial);
+		ar & LLDEBUG_MEMBER_NVP(status);
+		ar & LLDEBUG_MEMBER_NVP(creationKey);
+		ar & LLDEBUG_MEMBER_NVP(creationTitle);
+		ar & LLDEBUG_MEMBER_NVP(creationLine);
+		ar & LLDEBUG_MEMBER_NVP(funcName);
+		ar & LLDEBUG_MEMBER_NVP(key);
+		ar & LLDEBUG_MEMBER_NVP(title);
+		ar & LLDEBUG_MEMBER_NVP(line);
+	}
+
+private:
+	LuaHandle m_lua;
+	unsigned long m_serial;
+	std::string m_status;
+	std::string m_creationKey;
+	std::string m_creationTitle;
+	int m_creationLine;
+	std::string m_funcName;
+	std::string m_key;
+	std::string m_title;
+	int m_line;
+};
+
+typedef std::vector<LuaCoroutine> LuaCoroutineList;
+
+/**
+ * @brief The debug state of an OS thread that runs lua.
+ *
+ * Each thread breaks, steps and resumes independently, and the frame
+ * inspects the selected one.
+ */
+class LuaThread {
+public:
+#ifdef LLDEBUG_CONTEXT
+	explicit LuaThread(int id, const LuaHandle &lua, bool isBreak,
+					   bool isSelected, const std::string &key,
+					   const std::string &title, int line);
+#endif
+	explicit LuaThread();
+	~LuaThread();
+
+	/// Get the thread id, it's unique in the context.
+	int GetId() const {
+		return m_id;
+	}
+
+	/// Get the lua handle running on the thread.
+	const LuaHandle &GetLua() const {
+		return m_lua;
+	}
+
+	/// Is the thread stopping ?
+	bool IsBreak() const {
+		return m_isBreak;
+	}
+
+	/// Is the thread inspected by the frame ?
+	bool IsSelected() const {
+		return m_isSelected;
+	}
+
+	/// Get the source key where the thread is stopping.
+	const std::string &GetKey() const {
+		return m_key;
+	}
+
+	/// Get the source title where the thread is stopping.
+	const std::string &GetTitle() const {
+		return m_title;
+	}
+
+	/// Get the line where the thread is stopping, -1 if it's running.
+	int GetLine() const {
+		return m_line;
+	}
+
+private:
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int) {
+		ar & LLDEBUG_MEMBER_NVP(id);
+		ar & LLDEBUG_MEMBER_NVP(lua);
+		ar & LLDEBUG_MEMBER_NVP(isBreak);
+		ar & LLDEBUG_MEMBER_NVP(isSelected);
+		ar & LLDEBUG_MEMBER_NVP(key);
+		ar & LLDEBUG_MEMBER_NVP(title);
+		ar & LLDEBUG_MEMBER_NVP(line);
+	}
+
+private:
+	int m_id;
+	LuaHandle m_lua;
+	bool m_isBreak;
+	bool m_isSelected;
+	std::string m_key;
+	std::string m_title;
+	int m_line;
+};
+
+typedef std::vector<LuaThread> LuaThreadList;
+
+
+/**
+ * @brief The values sent with the break, so the frame doesn't request them.
+ *
+ * A part is left out if it's over the size limit of the snapshot.
+ */
+class LuaBreakSnapshot {
+public:
+	explicit LuaBreakSnapshot();
+	~LuaBreakSnapshot();
+
+	/// Does this have the backtrace ?
+	bool HasBacktraces() const {
+		return m_hasBacktraces;
+	}
+
+	/// Get the backtrace.
+	const LuaBacktraceList &GetBacktraces() const {
+		return m_backtraces;
+	}
+
+	/// Set the backtrace.
+	void SetBacktraces(const LuaBacktraceList &backtraces) {
+		m_backtraces = backtraces;
+		m_hasBacktraces = true;
+	}
+
+	/// Does this have the locals and the upvalues of the top frame ?
+	bool HasLocals() const {
+		return m_hasLocals;
+	}
+
+	/// Get the locals and the upvalues of the top frame.
+	const LuaVarList &GetLocals() const {
+		return m_locals;
+	}
+
+	/// Set the locals and the upvalues of the top frame.
+	void SetLocals(const LuaVarList &locals) {
+		m_locals = locals;
+		m_hasLocals = true;
+	}
+
+	/// Does this have the values of the watch expressions ?
+	bool HasWatches() const {
+		return m_hasWatches;
+	}
+
+	/// Get the watch expressions evaluated on the top frame.
+	const string_array &GetWatchEvals() const {
+		return m_watchEvals;
+	}
+
+	/// Get the values of the watch expressions.
+	const LuaVarList &GetWatches() const {
+		return m_watches;
+	}
+
+	/// Set the watch expressions and their values.
+	void SetWatches(const string_array &evals, const LuaVarList &watches) {
+		m_watchEvals = evals;
+		m_watches = watches;
+		m_hasWatches = true;
+	}
+
+private:
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int) {
+		ar & LLDEBUG_MEMBER_NVP(hasBacktraces);
+		ar & LLDEBUG_MEMBER_NVP(backtraces);
+		ar & LLDEBUG_MEMBER_NVP(hasLocals);
+		ar & LLDEBUG_MEMBER_NVP(locals);
+		ar & LLDEBUG_MEMBER_NVP(hasWatches);
+		ar & LLDEBUG_MEMBER_NVP(watchEvals);
+		ar & LLDEBUG_MEMBER_NVP(watches);
+	}
+
+private:
+	bool m_hasBacktraces;
+	LuaBacktraceList m_backtraces;
+	bool m_hasLocals;
+	LuaVarList m_locals;
+	bool m_hasWatches;
+	string_array m_watchEvals;
+	LuaVarList m_watches;
+};
 
 } // end of namespace lldebug
 
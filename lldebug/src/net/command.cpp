@@ -27,6 +27,7 @@
 #include "precomp.h"
 #include "vectorstream.h"
 #include "net/command.h"
+#include "net/compactarchive.h"
 
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
@@ -42,6 +43,7 @@
 #include <boost/serialization/map.hpp>
 #include <boost/serialization/set.hpp>
 #include <boost/serialization/shared_ptr.hpp>
+#include <boost/serialization/utility.hpp>
 
 namespace lldebug {
 namespace net {
@@ -52,102 +54,198 @@ typedef boost::archive::text_oarchive serialize_oarchive;
 typedef boost::archive::text_iarchive serialize_iarchive;
 
 
+/// The first byte of the compact data, the text archive never starts with it.
+static const char COMPACT_MARKER = '\0';
+
+/**
+ * @brief Writer of the command data in the wire version.
+ *
+ * The compact data starts with COMPACT_MARKER and the wire version,
+ * the other is the text archive.
+ */
+class data_writer {
+public:
+	explicit data_writer(int wireVersion) {
+		if (wireVersion >= WIREVERSION_COMPACT) {
+			m_data.push_back(COMPACT_MARKER);
+			m_data.push_back((char)wireVersion);
+			m_compact.reset(new compact_oarchive(m_data));
+		}
+		else {
+			m_stream.reset(new vector_ostream);
+			m_text.reset(new serialize_oarchive(*m_stream));
+		}
+	}
+
+	template<class T>
+	void put(const T &value) {
+		if (m_compact != NULL) {
+			*m_compact << value;
+		}
+		else {
+			*m_text << BOOST_SERIALIZATION_NVP(value);
+		}
+	}
+
+	container_type container() {
+		if (m_compact != NULL) {
+			return m_data;
+		}
+
+		m_stream->flush();
+		return m_stream->container();
+	}
+
+private:
+	container_type m_data;
+	shared_ptr<compact_oarchive> m_compact;
+	shared_ptr<vector_ostream> m_stream;
+	shared_ptr<serialize_oarchive> m_text;
+};
+
+/**
+ * @brief Reader of the command data in any wire version.
+ */
+class data_reader {
+public:
+	explicit data_reader(const container_type &data) {
+		if (data.size() >= 2 && data[0] == COMPACT_MARKER) {
+			if (data[1] > WIREVERSION_LATEST) {
+				throw boost::archive::archive_exception(
+					boost::archive::archive_exception::unsupported_version);
+			}
+			m_compact.reset(new compact_iarchive(data, 2));
+		}
+		else {
+			m_stream.reset(new vector_istream(data));
+			m_text.reset(new serialize_iarchive(*m_stream));
+		}
+	}
+
+	template<class T>
+	void get(T &value) {
+		if (m_compact != NULL) {
+			*m_compact >> value;
+		}
+		else {
+			*m_text >> BOOST_SERIALIZATION_NVP(value);
+		}
+	}
+
+private:
+	shared_ptr<compact_iarchive> m_compact;
+	shared_ptr<vector_istream> m_stream;
+	shared_ptr<serialize_iarchive> m_text;
+};
+
 /**
  * @brief Serializer class
  */
 struct Serializer {
 	template<class T0>
-	static container_type ToData(const T0 &value0) {
-		vector_ostream stream;
-		serialize_oarchive ar(stream);
+	static container_type ToData(int wireVersion, const T0 &value0) {
+		data_writer writer(wireVersion);
 
-		ar << BOOST_SERIALIZATION_NVP(value0);
-		stream.flush();
-		return stream.container();
+		writer.put(value0);
+		return writer.container();
 	}
 
 	template<class T0, class T1>
-	static container_type ToData(const T0 &value0, const T1 &value1) {
-		vector_ostream stream;
-		serialize_oarchive ar(stream);
-
-		ar << BOOST_SERIALIZATION_NVP(value0);
-		ar << BOOST_SERIALIZATION_NVP(value1);
-		stream.flush();
-		return stream.container();
+	static container_type ToData(int wireVersion, const T0 &value0, const T1 &value1) {
+		data_writer writer(wireVersion);
+
+		writer.put(value0);
+		writer.put(value1);
+		return writer.container();
 	}
 
 	template<class T0, class T1, class T2>
-	static container_type ToData(const T0 &value0, const T1 &value1, const T2 &value2) {
-		vector_ostream stream;
-		serialize_oarchive ar(stream);
-
-		ar << BOOST_SERIALIZATION_NVP(value0);
-		ar << BOOST_SERIALIZATION_NVP(value1);
-		ar << BOOST_SERIALIZATION_NVP(value2);
-		stream.flush();
-		return stream.container();
+	static container_type ToData(int wireVersion, const T0 &value0, const T1 &value1, const T2 &value2) {
+		data_writer writer(wireVersion);
+
+		writer.put(value0);
+		writer.put(value1);
+		writer.put(value2);
+		return writer.container();
 	}
 
 	template<class T0, class T1, class T2, class T3>
-	static container_type ToData(const T0 &value0, const T1 &value1, const T2 &value2, const T3 &value3) {
-		vector_ostream stream;
-		serialize_oarchive ar(stream);
-
-		ar << BOOST_SERIALIZATION_NVP(value0);
-		ar << BOOST_SERIALIZATION_NVP(value1);
-		ar << BOOST_SERIALIZATION_NVP(value2);
-		ar << BOOST_SERIALIZATION_NVP(value3);
-		stream.flush();
-		return stream.container();
+	static container_type ToData(int wireVersion, const T0 &value0, const T1 &value1, const T2 &value2, const T3 &value3) {
+		data_writer writer(wireVersion);
+
+		writer.put(value0);
+		writer.put(value1);
+		writer.put(value2);
+		writer.put(value3);
+		return writer.container();
+	}
+
+	template<class T0, class T1, class T2, class T3, class T4>
+	static container_type ToData(int wireVersion, const T0 &value0, const T1 &value1, const T2 &value2, const T3 &value3, const T4 &value4) {
+		data_writer writer(wireVersion);
+
+		writer.put(value0);
+		writer.put(value1);
+		writer.put(value2);
+		writer.put(value3);
+		writer.put(value4);
+		return writer.container();
 	}
 
 	template<class T0>
 	static void ToValue(const container_type &data, T0 &value0) {
-		vector_istream stream(data);
-		serialize_iarchive ar(stream);
+		data_reader reader(data);
 
-		ar >> BOOST_SERIALIZATION_NVP(value0);
+		reader.get(value0);
 	}
 
 	template<class T0, class T1>
 	static void ToValue(const container_type &data, T0 &value0, T1 &value1) {
-		vector_istream stream(data);
-		serialize_iarchive ar(stream);
+		data_reader reader(data);
 
-		ar >> BOOST_SERIALIZATION_NVP(value0);
-		ar >> BOOST_SERIALIZATION_NVP(value1);
+		reader.get(value0);
+		reader.get(value1);
 	}
 
 	template<class T0, class T1, class T2>
 	static void ToValue(const container_type &data, T0 &value0, T1 &value1, T2 &value2) {
-		vector_istream stream(data);
-		serialize_iarchive ar(stream);
+		data_reader reader(data);
 
-		ar >> BOOST_SERIALIZATION_NVP(value0);
-		ar >> BOOST_SERIALIZATION_NVP(value1);
-		ar >> BOOST_SERIALIZATION_NVP(value2);
+		reader.get(value0);
+		reader.get(value1);
+		reader.get(value2);
 	}
 
 	template<class T0, class T1, class T2, class T3>
 	static void ToValue(const container_type &data, T0 &value0, T1 &value1, T2 &value2, T3 &value3) {
-		vector_istream stream(data);
-		serialize_iarchive ar(stream);
+		data_reader reader(data);
 
-		ar >> BOOST_SERIALIZATION_NVP(value0);
-		ar >> BOOST_SERIALIZATION_NVP(value1);
-		ar >> BOOST_SERIALIZATION_NVP(value2);
-		ar >> BOOST_SERIALIZATION_NVP(value3);
+		reader.get(value0);
+		reader.get(value1);
+		reader.get(value2);
+		reader.get(value3);
+	}
+
+	template<class T0, class T1, class T2, class T3, class T4>
+	static void ToValue(const container_type &data, T0 &value0, T1 &value1, T2 &value2, T3 &value3, T4 &value4) {
+		data_reader reader(data);
+
+		reader.get(value0);
+		reader.get(value1);
+		reader.get(value2);
+		reader.get(value3);
+		reader.get(value4);
 	}
 };
 
 
 /*-----------------------------------------------------------------*/
-CommandData::CommandData() {
+CommandData::CommandData(int wireVersion)
+	: m_wireVersion(wireVersion) {
 }
 
 CommandData::CommandData(const std::vector<char> &data)
-	: m_data(data) {
+	: m_data(data), m_wireVersion(WIREVERSION_TEXT) {
 }
 
 CommandData::~CommandData() {
@@ -157,24 +255,25 @@ void CommandData::Get_ChangedState(bool &isBreak) const {
 	Serializer::ToValue(m_data, isBreak);
 }
 void CommandData::Set_ChangedState(bool isBreak) {
-	m_data = Serializer::ToData(isBreak);
+	m_data = Serializer::ToData(m_wireVersion, isBreak);
 }
 
 void CommandData::Get_UpdateSource(std::string &key, int &line,
-								   int &updateCount,
-								   bool &isRefreshOnly) const {
-	Serializer::ToValue(m_data, key, line, updateCount, isRefreshOnly);
+								   int &updateCount, bool &isRefreshOnly,
+								   LuaBreakSnapshot &snapshot) const {
+	Serializer::ToValue(m_data, key, line, updateCount, isRefreshOnly, snapshot);
 }
 void CommandData::Set_UpdateSource(const std::string &key, int line,
-								   int updateCount, bool isRefreshOnly) {
-	m_data = Serializer::ToData(key, line, updateCount, isRefreshOnly);
+								   int updateCount, bool isRefreshOnly,
+								   const LuaBreakSnapshot &snapshot) {
+	m_data = Serializer::ToData(m_wireVersion, key, line, updateCount, isRefreshOnly, snapshot);
 }
 
 void CommandData::Get_AddedSource(Source &source) const {
 	Serializer::ToValue(m_data, source);
 }
 void CommandData::Set_AddedSource(const Source &source) {
-	m_data = Serializer::ToData(source);
+	m_data = Serializer::ToData(m_wireVersion, source);
 }
 
 void CommandData::Get_SaveSource(std::string &key,
@@ -183,49 +282,56 @@ void CommandData::Get_SaveSource(std::string &key,
 }
 void CommandData::Set_SaveSource(const std::string &key,
 									   const string_array &sources) {
-	m_data = Serializer::ToData(key, sources);
+	m_data = Serializer::ToData(m_wireVersion, key, sources);
 }
 
 void CommandData::Get_SetUpdateCount(int &updateCount) const {
 	Serializer::ToValue(m_data, updateCount);
 }
 void CommandData::Set_SetUpdateCount(int updateCount) {
-	m_data = Serializer::ToData(updateCount);
+	m_data = Serializer::ToData(m_wireVersion, updateCount);
 }
 
 void CommandData::Get_SetBreakpoint(Breakpoint &bp) const {
 	Serializer::ToValue(m_data, bp);
 }
 void CommandData::Set_SetBreakpoint(const Breakpoint &bp) {
-	m_data = Serializer::ToData(bp);
+	m_data = Serializer::ToData(m_wireVersion, bp);
 }
 
 void CommandData::Get_RemoveBreakpoint(Breakpoint &bp) const {
 	Serializer::ToValue(m_data, bp);
 }
 void CommandData::Set_RemoveBreakpoint(const Breakpoint &bp) {
-	m_data = Serializer::ToData(bp);
+	m_data = Serializer::ToData(m_wireVersion, bp);
 }
 
 void CommandData::Get_ChangedBreakpointList(BreakpointList &bps) const {
 	Serializer::ToValue(m_data, bps);
 }
 void CommandData::Set_ChangedBreakpointList(const BreakpointList &bps) {
-	m_data = Serializer::ToData(bps);
+	m_data = Serializer::ToData(m_wireVersion, bps);
 }
 
 void CommandData::Get_SetEncoding(lldebug_Encoding &encoding) const {
 	Serializer::ToValue(m_data, encoding);
 }
 void CommandData::Set_SetEncoding(lldebug_Encoding encoding) {
-	m_data = Serializer::ToData(encoding);
+	m_data = Serializer::ToData(m_wireVersion, encoding);
 }
 
 void CommandData::Get_OutputLog(LogData &logData) const {
 	Serializer::ToValue(m_data, logData);
 }
 void CommandData::Set_OutputLog(const LogData &logData) {
-	m_data = Serializer::ToData(logData);
+	m_data = Serializer::ToData(m_wireVersion, logData);
+}
+
+void CommandData::Get_OutputLogList(LogDataList &logs) const {
+	Serializer::ToValue(m_data, logs);
+}
+void CommandData::Set_OutputLogList(const LogDataList &logs) {
+	m_data = Serializer::ToData(m_wireVersion, logs);
 }
 
 void CommandData::Get_EvalsToVarList(string_array &evals,
@@ -234,7 +340,7 @@ void CommandData::Get_EvalsToVarList(string_array &evals,
 }
 void CommandData::Set_EvalsToVarList(const string_array &evals,
 									 const LuaStackFrame &stackFrame) {
-	m_data = Serializer::ToData(evals, stackFrame);
+	m_data = Serializer::ToData(m_wireVersion, evals, stackFrame);
 }
 
 void CommandData::Get_EvalToMultiVar(std::string &eval,
@@ -243,7 +349,7 @@ void CommandData::Get_EvalToMultiVar(std::string &eval,
 }
 void CommandData::Set_EvalToMultiVar(const std::string &eval,
 									 const LuaStackFrame &stackFrame) {
-	m_data = Serializer::ToData(eval, stackFrame);
+	m_data = Serializer::ToData(m_wireVersion, eval, stackFrame);
 }
 
 void CommandData::Get_EvalToVar(std::string &eval,
@@ -252,14 +358,26 @@ void CommandData::Get_EvalToVar(std::string &eval,
 }
 void CommandData::Set_EvalToVar(const std::string &eval,
 								const LuaStackFrame &stackFrame) {
-	m_data = Serializer::ToData(eval, stackFrame);
+	m_data = Serializer::ToData(m_wireVersion, eval, stackFrame);
 }
 
-void CommandData::Get_RequestFieldVarList(LuaVar &var) const {
-	Serializer::ToValue(m_data, var);
+void CommandData::Get_RequestFieldVarList(LuaVar &var, int &offset,
+										  int &count, int &resume) const {
+	Serializer::ToValue(m_data, var, offset, count, resume);
+}
+void CommandData::Set_RequestFieldVarList(const LuaVar &var, int offset,
+										  int count, int resume) {
+	m_data = Serializer::ToData(m_wireVersion, var, offset, count, resume);
+}
+
+void CommandData::Get_RequestFieldsQuery(LuaVar &var, LuaFieldQuery &query,
+										 int &offset, int &count) const {
+	Serializer::ToValue(m_data, var, query, offset, count);
 }
-void CommandData::Set_RequestFieldVarList(const LuaVar &var) {
-	m_data = Serializer::ToData(var);
+void CommandData::Set_RequestFieldsQuery(const LuaVar &var,
+										 const LuaFieldQuery &query,
+										 int offset, int count) {
+	m_data = Serializer::ToData(m_wireVersion, var, query, offset, count);
 }
 
 void CommandData::Get_RequestLocalVarList(LuaStackFrame &stackFrame,
@@ -274,7 +392,7 @@ void CommandData::Set_RequestLocalVarList(const LuaStackFrame &stackFrame,
 										  bool checkLocal,
 										  bool checkUpvalue,
 										  bool checkEnviron) {
-	m_data = Serializer::ToData(stackFrame,
+	m_data = Serializer::ToData(m_wireVersion, stackFrame,
 		checkLocal, checkUpvalue, checkEnviron);
 }
 
@@ -282,42 +400,196 @@ void CommandData::Get_RequestSource(std::string &key) {
 	Serializer::ToValue(m_data, key);
 }
 void CommandData::Set_RequestSource(const std::string &key) {
-	m_data = Serializer::ToData(key);
+	m_data = Serializer::ToData(m_wireVersion, key);
+}
+
+void CommandData::Get_RequestCoroutineList(int &offset, int &count,
+											int &sortKey,
+											bool &isAscending) const {
+	Serializer::ToValue(m_data, offset, count, sortKey, isAscending);
+}
+void CommandData::Set_RequestCoroutineList(int offset, int count,
+											int sortKey, bool isAscending) {
+	m_data = Serializer::ToData(m_wireVersion, offset, count, sortKey, isAscending);
+}
+
+void CommandData::Get_RequestCoroutineBacktrace(LuaHandle &lua) const {
+	Serializer::ToValue(m_data, lua);
+}
+void CommandData::Set_RequestCoroutineBacktrace(const LuaHandle &lua) {
+	m_data = Serializer::ToData(m_wireVersion, lua);
+}
+
+void CommandData::Get_StartProfile(int &interval) const {
+	Serializer::ToValue(m_data, interval);
+}
+void CommandData::Set_StartProfile(int interval) {
+	m_data = Serializer::ToData(m_wireVersion, interval);
+}
+
+void CommandData::Get_StartTrace(int &bufferSize, std::string &prefix) const {
+	Serializer::ToValue(m_data, bufferSize, prefix);
+}
+void CommandData::Set_StartTrace(int bufferSize, const std::string &prefix) {
+	m_data = Serializer::ToData(m_wireVersion, bufferSize, prefix);
+}
+
+void CommandData::Get_SaveHeapSnapshot(std::string &filename) const {
+	Serializer::ToValue(m_data, filename);
+}
+void CommandData::Set_SaveHeapSnapshot(const std::string &filename) {
+	m_data = Serializer::ToData(m_wireVersion, filename);
+}
+
+void CommandData::Get_StartGcMonitor(int &interval) const {
+	Serializer::ToValue(m_data, interval);
+}
+void CommandData::Set_StartGcMonitor(int interval) {
+	m_data = Serializer::ToData(m_wireVersion, interval);
+}
+
+void CommandData::Get_SetGcThreshold(int &kbytes) const {
+	Serializer::ToValue(m_data, kbytes);
+}
+void CommandData::Set_SetGcThreshold(int kbytes) {
+	m_data = Serializer::ToData(m_wireVersion, kbytes);
+}
+
+void CommandData::Get_ChangedGcStats(LuaGcSample &sample) const {
+	Serializer::ToValue(m_data, sample);
+}
+void CommandData::Set_ChangedGcStats(const LuaGcSample &sample) {
+	m_data = Serializer::ToData(m_wireVersion, sample);
+}
+
+void CommandData::Get_SelectThread(int &id) const {
+	Serializer::ToValue(m_data, id);
+}
+void CommandData::Set_SelectThread(int id) {
+	m_data = Serializer::ToData(m_wireVersion, id);
+}
+
+void CommandData::Get_ChangedThreadList(LuaThreadList &threads) const {
+	Serializer::ToValue(m_data, threads);
+}
+void CommandData::Set_ChangedThreadList(const LuaThreadList &threads) {
+	m_data = Serializer::ToData(m_wireVersion, threads);
+}
+
+void CommandData::Get_SetDebugFilter(int &type, std::string &pattern) const {
+	Serializer::ToValue(m_data, type, pattern);
+}
+void CommandData::Set_SetDebugFilter(int type, const std::string &pattern) {
+	m_data = Serializer::ToData(m_wireVersion, type, pattern);
+}
+
+void CommandData::Get_StartCoverage(bool &firstHitOnly) const {
+	Serializer::ToValue(m_data, firstHitOnly);
+}
+void CommandData::Set_StartCoverage(bool firstHitOnly) {
+	m_data = Serializer::ToData(m_wireVersion, firstHitOnly);
+}
+
+void CommandData::Get_ChangedCoverage(SourceCoverageList &coverages) const {
+	Serializer::ToValue(m_data, coverages);
+}
+void CommandData::Set_ChangedCoverage(const SourceCoverageList &coverages) {
+	m_data = Serializer::ToData(m_wireVersion, coverages);
 }
 
 void CommandData::Get_ValueString(std::string &str) const {
 	Serializer::ToValue(m_data, str);
 }
 void CommandData::Set_ValueString(const std::string &str) {
-	m_data = Serializer::ToData(str);
+	m_data = Serializer::ToData(m_wireVersion, str);
 }
 
 void CommandData::Get_ValueSource(Source &source) const {
 	Serializer::ToValue(m_data, source);
 }
 void CommandData::Set_ValueSource(const Source &source) {
-	m_data = Serializer::ToData(source);
+	m_data = Serializer::ToData(m_wireVersion, source);
 }
 
 void CommandData::Get_ValueVarList(LuaVarList &vars) const {
 	Serializer::ToValue(m_data, vars);
 }
 void CommandData::Set_ValueVarList(const LuaVarList &vars) {
-	m_data = Serializer::ToData(vars);
+	m_data = Serializer::ToData(m_wireVersion, vars);
 }
 
 void CommandData::Get_ValueVar(LuaVar &var) const {
 	Serializer::ToValue(m_data, var);
 }
 void CommandData::Set_ValueVar(const LuaVar &var) {
-	m_data = Serializer::ToData(var);
+	m_data = Serializer::ToData(m_wireVersion, var);
+}
+
+void CommandData::Get_ValueVarPage(LuaVarList &vars, int &total,
+								   int &resume, std::string &error) const {
+	Serializer::ToValue(m_data, vars, total, resume, error);
+}
+void CommandData::Set_ValueVarPage(const LuaVarList &vars, int total,
+								   int resume, const std::string &error) {
+	m_data = Serializer::ToData(m_wireVersion, vars, total, resume, error);
 }
 
 void CommandData::Get_ValueBacktraceList(LuaBacktraceList &backtraces) const {
 	Serializer::ToValue(m_data, backtraces);
 }
 void CommandData::Set_ValueBacktraceList(const LuaBacktraceList &backtraces) {
-	m_data = Serializer::ToData(backtraces);
+	m_data = Serializer::ToData(m_wireVersion, backtraces);
+}
+
+void CommandData::Get_ValueFuncProfileList(LuaFuncProfileList &profiles) const {
+	Serializer::ToValue(m_data, profiles);
+}
+void CommandData::Set_ValueFuncProfileList(const LuaFuncProfileList &profiles) {
+	m_data = Serializer::ToData(m_wireVersion, profiles);
+}
+
+void CommandData::Get_ValueCoverageList(SourceCoverageList &coverages) const {
+	Serializer::ToValue(m_data, coverages);
+}
+void CommandData::Set_ValueCoverageList(const SourceCoverageList &coverages) {
+	m_data = Serializer::ToData(m_wireVersion, coverages);
+}
+
+void CommandData::Get_ValueAllocProfileList(LuaAllocProfileList &profiles) const {
+	Serializer::ToValue(m_data, profiles);
+}
+void CommandData::Set_ValueAllocProfileList(const LuaAllocProfileList &profiles) {
+	m_data = Serializer::ToData(m_wireVersion, profiles);
+}
+
+void CommandData::Get_ValueSchedProfileList(LuaSchedProfileList &profiles) const {
+	Serializer::ToValue(m_data, profiles);
+}
+void CommandData::Set_ValueSchedProfileList(const LuaSchedProfileList &profiles) {
+	m_data = Serializer::ToData(m_wireVersion, profiles);
+}
+
+void CommandData::Get_ValueCoroutineList(LuaCoroutineList &coroutines,
+										 int &total) const {
+	Serializer::ToValue(m_data, coroutines, total);
+}
+void CommandData::Set_ValueCoroutineList(const LuaCoroutineList &coroutines,
+										 int total) {
+	m_data = Serializer::ToData(m_wireVersion, coroutines, total);
+}
+
+void CommandData::Get_Batch(BatchItemList &items) const {
+	Serializer::ToValue(m_data, items);
+}
+void CommandData::Set_Batch(const BatchItemList &items) {
+	m_data = Serializer::ToData(m_wireVersion, items);
+}
+
+void CommandData::Get_ValueBatch(BatchItemList &items) const {
+	Serializer::ToValue(m_data, items);
+}
+void CommandData::Set_ValueBatch(const BatchItemList &items) {
+	m_data = Serializer::ToData(m_wireVersion, items);
 }
 
 } // end of namespace net
@@ -36,10 +36,14 @@ namespace net {
 
 class RemoteEngine;
 class Connection;
+struct BatchResponse;
 
 /// Internal type of the command data impl.
 typedef std::vector<char> container_type;
 
+/// The commands in a batch, the pair of the type and the data.
+typedef std::vector<std::pair<int, container_type> > BatchItemList;
+
 /**
  * @brief Type of the command using TCP connection.
  */
@@ -68,18 +72,47 @@ enum RemoteCommandType {
 
 	REMOTECOMMANDTYPE_SET_ENCODING,
 	REMOTECOMMANDTYPE_OUTPUT_LOG,
+	REMOTECOMMANDTYPE_OUTPUT_LOGLIST,
 
 	REMOTECOMMANDTYPE_EVALS_TO_VARLIST,
 	REMOTECOMMANDTYPE_EVAL_TO_MULTIVAR,
 	REMOTECOMMANDTYPE_EVAL_TO_VAR,
 
 	REMOTECOMMANDTYPE_REQUEST_FIELDSVARLIST,
+	REMOTECOMMANDTYPE_REQUEST_FIELDSQUERY,
 	REMOTECOMMANDTYPE_REQUEST_LOCALVARLIST,
 	REMOTECOMMANDTYPE_REQUEST_GLOBALVARLIST,
 	REMOTECOMMANDTYPE_REQUEST_REGISTRYVARLIST,
 	REMOTECOMMANDTYPE_REQUEST_STACKLIST,
 	REMOTECOMMANDTYPE_REQUEST_SOURCE,
 	REMOTECOMMANDTYPE_REQUEST_BACKTRACELIST,
+	REMOTECOMMANDTYPE_REQUEST_COROUTINELIST,
+	REMOTECOMMANDTYPE_REQUEST_COROUTINEBACKTRACE,
+
+	REMOTECOMMANDTYPE_START_PROFILE,
+	REMOTECOMMANDTYPE_STOP_PROFILE,
+	REMOTECOMMANDTYPE_START_FUNCPROFILE,
+	REMOTECOMMANDTYPE_STOP_FUNCPROFILE,
+	REMOTECOMMANDTYPE_REQUEST_FUNCPROFILELIST,
+	REMOTECOMMANDTYPE_START_COVERAGE,
+	REMOTECOMMANDTYPE_STOP_COVERAGE,
+	REMOTECOMMANDTYPE_CHANGED_COVERAGE,
+	REMOTECOMMANDTYPE_START_ALLOCPROFILE,
+	REMOTECOMMANDTYPE_STOP_ALLOCPROFILE,
+	REMOTECOMMANDTYPE_START_SCHEDPROFILE,
+	REMOTECOMMANDTYPE_STOP_SCHEDPROFILE,
+	REMOTECOMMANDTYPE_START_TRACE,
+	REMOTECOMMANDTYPE_STOP_TRACE,
+	REMOTECOMMANDTYPE_SAVE_HEAPSNAPSHOT,
+	REMOTECOMMANDTYPE_START_GCMONITOR,
+	REMOTECOMMANDTYPE_STOP_GCMONITOR,
+	REMOTECOMMANDTYPE_SET_GCTHRESHOLD,
+	REMOTECOMMANDTYPE_CHANGED_GCSTATS,
+	REMOTECOMMANDTYPE_SELECT_THREAD,
+	REMOTECOMMANDTYPE_CHANGED_THREADLIST,
+	REMOTECOMMANDTYPE_SET_DEBUGFILTER,
+	REMOTECOMMANDTYPE_PING,
+	REMOTECOMMANDTYPE_BATCH,
 
 	REMOTECOMMANDTYPE_SUCCESSED,
 	REMOTECOMMANDTYPE_FAILED,
@@ -89,6 +122,50 @@ enum RemoteCommandType {
 	REMOTECOMMANDTYPE_VALUE_VARLIST,
 	REMOTECOMMANDTYPE_VALUE_VAR,
 	REMOTECOMMANDTYPE_VALUE_BACKTRACELIST,
+	REMOTECOMMANDTYPE_VALUE_FUNCPROFILELIST,
+	REMOTECOMMANDTYPE_VALUE_COVERAGELIST,
+	REMOTECOMMANDTYPE_VALUE_ALLOCPROFILELIST,
+	REMOTECOMMANDTYPE_VALUE_SCHEDPROFILELIST,
+	REMOTECOMMANDTYPE_VALUE_COROUTINELIST,
+	REMOTECOMMANDTYPE_VALUE_BATCH,
+	REMOTECOMMANDTYPE_VALUE_VARPAGE,
+};
+
+/// Can the command be sent in REMOTECOMMANDTYPE_BATCH ?
+/**
+ * They are the requests that only read the state and always respond.
+ */
+inline bool is_batchable_command(RemoteCommandType type) {
+	switch (type) {
+	case REMOTECOMMANDTYPE_EVALS_TO_VARLIST:
+	case REMOTECOMMANDTYPE_EVAL_TO_MULTIVAR:
+	case REMOTECOMMANDTYPE_EVAL_TO_VAR:
+	case REMOTECOMMANDTYPE_REQUEST_FIELDSVARLIST:
+	case REMOTECOMMANDTYPE_REQUEST_FIELDSQUERY:
+	case REMOTECOMMANDTYPE_REQUEST_LOCALVARLIST:
+	case REMOTECOMMANDTYPE_REQUEST_GLOBALVARLIST:
+	case REMOTECOMMANDTYPE_REQUEST_REGISTRYVARLIST:
+	case REMOTECOMMANDTYPE_REQUEST_STACKLIST:
+	case REMOTECOMMANDTYPE_REQUEST_SOURCE:
+	case REMOTECOMMANDTYPE_REQUEST_BACKTRACELIST:
+	case REMOTECOMMANDTYPE_REQUEST_COROUTINELIST:
+	case REMOTECOMMANDTYPE_REQUEST_COROUTINEBACKTRACE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief The encoding of the command data.
+ *
+ * Each side sends the latest version it supports in 'commandId' of
+ * the START_CONNECTION header, and the older one is used.
+ */
+enum WireVersion {
+	WIREVERSION_TEXT = 0, ///< the text archive of boost
+	WIREVERSION_COMPACT = 1, ///< compact_oarchive (net/compactarchive.h)
+	WIREVERSION_LATEST = WIREVERSION_COMPACT,
 };
 
 /**
@@ -111,7 +188,8 @@ BOOST_STATIC_ASSERT(sizeof(CommandHeader) == 4 * 3);
  */
 class CommandData {
 public:
-	explicit CommandData();
+	/// The data is written in 'wireVersion', and read in any version.
+	explicit CommandData(int wireVersion = WIREVERSION_TEXT);
 	explicit CommandData(const container_type &data);
 	~CommandData();
 
@@ -145,9 +223,9 @@ public:
 	void Set_ChangedState(bool isBreak);
 
 	void Get_UpdateSource(std::string &key, int &line, int &updateCount,
-						  bool &isRefreshOnly) const;
+						  bool &isRefreshOnly, LuaBreakSnapshot &snapshot) const;
 	void Set_UpdateSource(const std::string &key, int line, int updateCount,
-						  bool isRefreshOnly);
+						  bool isRefreshOnly, const LuaBreakSnapshot &snapshot);
 
 	void Get_AddedSource(Source &source) const;
 	void Set_AddedSource(const Source &source);
@@ -173,6 +251,9 @@ public:
 	void Get_OutputLog(LogData &logData) const;
 	void Set_OutputLog(const LogData &logData);
 
+	void Get_OutputLogList(LogDataList &logs) const;
+	void Set_OutputLogList(const LogDataList &logs);
+
 	void Get_EvalsToVarList(string_array &evals, LuaStackFrame &stackFrame) const;
 	void Set_EvalsToVarList(const string_array &evals, const LuaStackFrame &stackFrame);
 
@@ -182,8 +263,15 @@ public:
 	void Get_EvalToVar(std::string &eval, LuaStackFrame &stackFrame) const;
 	void Set_EvalToVar(const std::string &eval, const LuaStackFrame &stackFrame);
 
-	void Get_RequestFieldVarList(LuaVar &var) const;
-	void Set_RequestFieldVarList(const LuaVar &var);
+	void Get_RequestFieldVarList(LuaVar &var, int &offset, int &count,
+								 int &resume) const;
+	void Set_RequestFieldVarList(const LuaVar &var, int offset, int count,
+								 int resume);
+
+	void Get_RequestFieldsQuery(LuaVar &var, LuaFieldQuery &query,
+								int &offset, int &count) const;
+	void Set_RequestFieldsQuery(const LuaVar &var, const LuaFieldQuery &query,
+								int offset, int count);
 
 	void Get_RequestLocalVarList(LuaStackFrame &stackFrame, bool &checkLocal,
 								 bool &checkUpvalue, bool &checkEnviron) const;
@@ -193,6 +281,47 @@ public:
 	void Get_RequestSource(std::string &key);
 	void Set_RequestSource(const std::string &key);
 
+	void Get_RequestCoroutineList(int &offset, int &count,
+								  int &sortKey, bool &isAscending) const;
+	void Set_RequestCoroutineList(int offset, int count,
+								  int sortKey, bool isAscending);
+
+	void Get_RequestCoroutineBacktrace(LuaHandle &lua) const;
+	void Set_RequestCoroutineBacktrace(const LuaHandle &lua);
+
+	void Get_StartProfile(int &interval) const;
+	void Set_StartProfile(int interval);
+
+	void Get_StartTrace(int &bufferSize, std::string &prefix) const;
+	void Set_StartTrace(int bufferSize, const std::string &prefix);
+
+	void Get_SaveHeapSnapshot(std::string &filename) const;
+	void Set_SaveHeapSnapshot(const std::string &filename);
+
+	void Get_StartGcMonitor(int &interval) const;
+	void Set_StartGcMonitor(int interval);
+
+	void Get_SetGcThreshold(int &kbytes) const;
+	void Set_SetGcThreshold(int kbytes);
+
+	void Get_ChangedGcStats(LuaGcSample &sample) const;
+	void Set_ChangedGcStats(const LuaGcSample &sample);
+
+	void Get_SelectThread(int &id) const;
+	void Set_SelectThread(int id);
+
+	void Get_ChangedThreadList(LuaThreadList &threads) const;
+	void Set_ChangedThreadList(const LuaThreadList &threads);
+
+	void Get_SetDebugFilter(int &type, std::string &pattern) const;
+	void Set_SetDebugFilter(int type, const std::string &pattern);
+
+	void Get_StartCoverage(bool &firstHitOnly) const;
+	void Set_StartCoverage(bool firstHitOnly);
+
+	void Get_ChangedCoverage(SourceCoverageList &coverages) const;
+	void Set_ChangedCoverage(const SourceCoverageList &coverages);
+
 	void Get_ValueString(std::string &str) const;
 	void Set_ValueString(const std::string &str);
 
@@ -205,11 +334,38 @@ public:
 	void Get_ValueVar(LuaVar &var) const;
 	void Set_ValueVar(const LuaVar &var);
 
+	void Get_ValueVarPage(LuaVarList &vars, int &total, int &resume,
+						  std::string &error) const;
+	void Set_ValueVarPage(const LuaVarList &vars, int total, int resume,
+						  const std::string &error);
+
 	void Get_ValueBacktraceList(LuaBacktraceList &backtraces) const;
 	void Set_ValueBacktraceList(const LuaBacktraceList &backtraces);
 
+	void Get_ValueFuncProfileList(LuaFuncProfileList &profiles) const;
+	void Set_ValueFuncProfileList(const LuaFuncProfileList &profiles);
+
+	void Get_ValueCoverageList(SourceCoverageList &coverages) const;
+	void Set_ValueCoverageList(const SourceCoverageList &coverages);
+
+	void Get_ValueAllocProfileList(LuaAllocProfileList &profiles) const;
+	void Set_ValueAllocProfileList(const LuaAllocProfileList &profiles);
+
+	void Get_ValueSchedProfileList(LuaSchedProfileList &profiles) const;
+	void Set_ValueSchedProfileList(const LuaSchedProfileList &profiles);
+
+	void Get_ValueCoroutineList(LuaCoroutineList &coroutines, int &total) const;
+	void Set_ValueCoroutineList(const LuaCoroutineList &coroutines, int total);
+
+	void Get_Batch(BatchItemList &items) const;
+	void Set_Batch(const BatchItemList &items);
+
+	void Get_ValueBatch(BatchItemList &items) const;
+	void Set_ValueBatch(const BatchItemList &items);
+
 private:
 	container_type m_data;
+	int m_wireVersion;
 };
 
 /**
@@ -224,10 +380,11 @@ public:
 public:
 	explicit Command(const CommandHeader &header,
 					 const CommandData &data)
-		: m_header(header), m_data(data) {
+		: m_header(header), m_data(data), m_batchIndex(0) {
 	}
 
-	explicit Command() {
+	explicit Command()
+		: m_batchIndex(0) {
 	}
 
 	~Command() {
@@ -326,6 +483,10 @@ private:
 	CommandHeader m_header;
 	CommandData m_data;
 	CommandCallback m_response;
+
+	/// The response is collected into it, if this came in a batch.
+	shared_ptr<BatchResponse> m_batch;
+	std::size_t m_batchIndex;
 };
 
 
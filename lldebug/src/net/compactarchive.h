@@ -0,0 +1,439 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __LLDEBUG_COMPACTARCHIVE_H__
+#define __LLDEBUG_COMPACTARCHIVE_H__
+
+#include <boost/archive/archive_exception.hpp>
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/version.hpp>
+#include <boost/type_traits/is_enum.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/type_traits/is_signed.hpp>
+#include <boost/type_traits/is_unsigned.hpp>
+#include <boost/mpl/bool.hpp>
+#include <boost/mpl/eval_if.hpp>
+#include <boost/mpl/identity.hpp>
+#include <boost/cstdint.hpp>
+#include <typeinfo>
+#include <vector>
+#include <list>
+#include <set>
+#include <map>
+#include <string>
+#include <cstring>
+
+namespace lldebug {
+namespace net {
+
+namespace compact_detail {
+
+struct class_tag {};
+struct enum_tag {};
+struct signed_tag {};
+struct unsigned_tag {};
+struct float_tag {};
+
+/// The encoding of T.
+template<class T>
+struct category {
+	typedef typename boost::mpl::eval_if<boost::is_enum<T>,
+		boost::mpl::identity<enum_tag>,
+		boost::mpl::eval_if<boost::is_floating_point<T>,
+			boost::mpl::identity<float_tag>,
+			boost::mpl::eval_if<boost::is_signed<T>,
+				boost::mpl::identity<signed_tag>,
+				boost::mpl::eval_if<boost::is_unsigned<T>,
+					boost::mpl::identity<unsigned_tag>,
+					boost::mpl::identity<class_tag> > > > >::type type;
+};
+
+/// The versions of the classes, they are written only at the first object.
+class class_versions {
+public:
+	/// Find the version of the type, or return false if it's the first.
+	bool find(const std::type_info &type, unsigned int &version) const {
+		for (std::size_t i = 0; i < m_types.size(); ++i) {
+			if (*m_types[i] == type) {
+				version = m_versions[i];
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void add(const std::type_info &type, unsigned int version) {
+		m_types.push_back(&type);
+		m_versions.push_back(version);
+	}
+
+private:
+	std::vector<const std::type_info *> m_types;
+	std::vector<unsigned int> m_versions;
+};
+
+} // end of namespace compact_detail
+
+/**
+ * @brief The binary archive of the command data.
+ *
+ * The integers are varints and the signed ones are zigzag encoded,
+ * the floating numbers are little endian, the strings and the containers
+ * are prefixed by their length, and the version of each class is written
+ * only before its first object. It has no header and no object tracking.
+ * The 'serialize' methods for the boost archives are used as they are.
+ */
+class compact_oarchive {
+public:
+	typedef boost::mpl::bool_<false> is_loading;
+	typedef boost::mpl::bool_<true> is_saving;
+
+	explicit compact_oarchive(std::vector<char> &data)
+		: m_data(data) {
+	}
+
+	template<class T>
+	compact_oarchive &operator <<(const T &value) {
+		save(value);
+		return *this;
+	}
+
+	template<class T>
+	compact_oarchive &operator &(const T &value) {
+		save(value);
+		return *this;
+	}
+
+	/// Write the unsigned integer in 7 bits groups.
+	void save_varint(boost::uint64_t value) {
+		while (value >= 0x80) {
+			m_data.push_back((char)((value & 0x7f) | 0x80));
+			value >>= 7;
+		}
+		m_data.push_back((char)value);
+	}
+
+private:
+	void save(bool value) {
+		m_data.push_back(value ? 1 : 0);
+	}
+
+	void save(const std::string &value) {
+		save_varint(value.size());
+		m_data.insert(m_data.end(), value.begin(), value.end());
+	}
+
+	template<class T>
+	void save(const boost::serialization::nvp<T> &value) {
+		save(value.const_value());
+	}
+
+	template<class T1, class T2>
+	void save(const std::pair<T1, T2> &value) {
+		save(value.first);
+		save(value.second);
+	}
+
+	template<class T, class A>
+	void save(const std::vector<T, A> &value) {
+		save_range(value.size(), value.begin(), value.end());
+	}
+
+	template<class T, class A>
+	void save(const std::list<T, A> &value) {
+		save_range(value.size(), value.begin(), value.end());
+	}
+
+	template<class T, class C, class A>
+	void save(const std::set<T, C, A> &value) {
+		save_range(value.size(), value.begin(), value.end());
+	}
+
+	template<class K, class T, class C, class A>
+	void save(const std::map<K, T, C, A> &value) {
+		save_range(value.size(), value.begin(), value.end());
+	}
+
+	template<class T>
+	void save(const T &value) {
+		save(value, typename compact_detail::category<T>::type());
+	}
+
+	template<class It>
+	void save_range(std::size_t size, It first, It last) {
+		save_varint(size);
+		for (; first != last; ++first) {
+			save(*first);
+		}
+	}
+
+	template<class T>
+	void save(const T &value, compact_detail::enum_tag) {
+		save((boost::int64_t)value, compact_detail::signed_tag());
+	}
+
+	template<class T>
+	void save(const T &value, compact_detail::signed_tag) {
+		boost::int64_t n = value;
+		save_varint(((boost::uint64_t)n << 1) ^ (boost::uint64_t)(n >> 63));
+	}
+
+	template<class T>
+	void save(const T &value, compact_detail::unsigned_tag) {
+		save_varint(value);
+	}
+
+	template<class T>
+	void save(const T &value, compact_detail::float_tag) {
+		unsigned char bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+#ifdef BOOST_BIG_ENDIAN
+		for (std::size_t i = sizeof(T); i > 0; --i) {
+			m_data.push_back((char)bytes[i - 1]);
+		}
+#else
+		m_data.insert(m_data.end(), bytes, bytes + sizeof(T));
+#endif
+	}
+
+	template<class T>
+	void save(const T &value, compact_detail::class_tag) {
+		unsigned int version;
+		if (!m_versions.find(typeid(T), version)) {
+			version = boost::serialization::version<T>::value;
+			m_versions.add(typeid(T), version);
+			save_varint(version);
+		}
+
+		boost::serialization::access::serialize(
+			*this, const_cast<T &>(value), version);
+	}
+
+private:
+	std::vector<char> &m_data;
+	compact_detail::class_versions m_versions;
+};
+
+/**
+ * @brief The reader of compact_oarchive.
+ *
+ * It throws boost::archive::archive_exception for the broken data.
+ */
+class compact_iarchive {
+public:
+	typedef boost::mpl::bool_<true> is_loading;
+	typedef boost::mpl::bool_<false> is_saving;
+
+	explicit compact_iarchive(const std::vector<char> &data,
+							  std::size_t pos = 0)
+		: m_data(data), m_pos(pos) {
+	}
+
+	template<class T>
+	compact_iarchive &operator >>(T &value) {
+		load(value);
+		return *this;
+	}
+
+	template<class T>
+	compact_iarchive &operator >>(const boost::serialization::nvp<T> &value) {
+		load(value.value());
+		return *this;
+	}
+
+	template<class T>
+	compact_iarchive &operator &(T &value) {
+		load(value);
+		return *this;
+	}
+
+	template<class T>
+	compact_iarchive &operator &(const boost::serialization::nvp<T> &value) {
+		load(value.value());
+		return *this;
+	}
+
+	boost::uint64_t load_varint() {
+		boost::uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			unsigned char c = (unsigned char)m_data[check(1)];
+			value |= (boost::uint64_t)(c & 0x7f) << shift;
+			if ((c & 0x80) == 0) {
+				return value;
+			}
+		}
+
+		throw_error();
+		return 0;
+	}
+
+private:
+	/// Get the position of the next 'size' bytes.
+	std::size_t check(std::size_t size) {
+		if (size > m_data.size() - m_pos) {
+			throw_error();
+		}
+
+		std::size_t pos = m_pos;
+		m_pos += size;
+		return pos;
+	}
+
+	/// Get the count of the elements, each of them has one byte at least.
+	std::size_t load_count() {
+		boost::uint64_t count = load_varint();
+		if (count > m_data.size() - m_pos) {
+			throw_error();
+		}
+		return (std::size_t)count;
+	}
+
+	void throw_error() {
+		throw boost::archive::archive_exception(
+			boost::archive::archive_exception::input_stream_error);
+	}
+
+	void load(bool &value) {
+		value = (m_data[check(1)] != 0);
+	}
+
+	void load(std::string &value) {
+		std::size_t size = load_count();
+		std::size_t pos = check(size);
+		value.assign(m_data.begin() + pos, m_data.begin() + pos + size);
+	}
+
+	template<class T>
+	void load(const boost::serialization::nvp<T> &value) {
+		load(value.value());
+	}
+
+	template<class T1, class T2>
+	void load(std::pair<T1, T2> &value) {
+		load(value.first);
+		load(value.second);
+	}
+
+	template<class T, class A>
+	void load(std::vector<T, A> &value) {
+		value.clear();
+		value.resize(load_count());
+		for (std::size_t i = 0; i < value.size(); ++i) {
+			load(value[i]);
+		}
+	}
+
+	template<class T, class A>
+	void load(std::list<T, A> &value) {
+		std::size_t count = load_count();
+		value.clear();
+		for (std::size_t i = 0; i < count; ++i) {
+			value.push_back(T());
+			load(value.back());
+		}
+	}
+
+	template<class T, class C, class A>
+	void load(std::set<T, C, A> &value) {
+		std::size_t count = load_count();
+		value.clear();
+		for (std::size_t i = 0; i < count; ++i) {
+			T item;
+			load(item);
+			value.insert(value.end(), item);
+		}
+	}
+
+	template<class K, class T, class C, class A>
+	void load(std::map<K, T, C, A> &value) {
+		std::size_t count = load_count();
+		value.clear();
+		for (std::size_t i = 0; i < count; ++i) {
+			std::pair<K, T> item;
+			load(item);
+			value.insert(value.end(), item);
+		}
+	}
+
+	template<class T>
+	void load(T &value) {
+		load(value, typename compact_detail::category<T>::type());
+	}
+
+	template<class T>
+	void load(T &value, compact_detail::enum_tag) {
+		boost::int64_t n;
+		load(n, compact_detail::signed_tag());
+		value = (T)n;
+	}
+
+	template<class T>
+	void load(T &value, compact_detail::signed_tag) {
+		boost::uint64_t n = load_varint();
+		value = (T)(boost::int64_t)((n >> 1) ^ (~(n & 1) + 1));
+	}
+
+	template<class T>
+	void load(T &value, compact_detail::unsigned_tag) {
+		value = (T)load_varint();
+	}
+
+	template<class T>
+	void load(T &value, compact_detail::float_tag) {
+		unsigned char bytes[sizeof(T)];
+		std::size_t pos = check(sizeof(T));
+#ifdef BOOST_BIG_ENDIAN
+		for (std::size_t i = 0; i < sizeof(T); ++i) {
+			bytes[sizeof(T) - 1 - i] = (unsigned char)m_data[pos + i];
+		}
+#else
+		std::memcpy(bytes, &m_data[pos], sizeof(T));
+#endif
+		std::memcpy(&value, bytes, sizeof(T));
+	}
+
+	template<class T>
+	void load(T &value, compact_detail::class_tag) {
+		unsigned int version;
+		if (!m_versions.find(typeid(T), version)) {
+			version = (unsigned int)load_varint();
+			m_versions.add(typeid(T), version);
+		}
+
+		boost::serialization::access::serialize(*this, value, version);
+	}
+
+private:
+	const std::vector<char> &m_data;
+	std::size_t m_pos;
+	compact_detail::class_versions m_versions;
+};
+
+} // end of namespace net
+} // end of namespace lldebug
+
+#endif
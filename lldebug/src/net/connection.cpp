@@ -53,14 +53,15 @@ Connector::~Connector() {
 void Connector::BeginConfirmCommand(shared_ptr<Connector> shared_this) {
 	// Try to write command.
 	shared_ptr<CommandHeader> writeHeader(new CommandHeader);
+	// 'commandId' is the latest wire version, the old one sends 0.
 	writeHeader->u.type = REMOTECOMMANDTYPE_START_CONNECTION;
-	writeHeader->commandId = 0;
+	writeHeader->commandId = htonl(WIREVERSION_LATEST);
 	writeHeader->dataSize = 0;
 	m_connection->GetSocket().async_write_some(
 		boost::asio::buffer(&*writeHeader, sizeof(CommandHeader)),
 		boost::bind(
 			&Connector::HandleConfirmCommand, shared_this,
-			writeHeader, boost::asio::placeholders::error));
+			writeHeader, false, boost::asio::placeholders::error));
 
 	// Try to read command.
 	shared_ptr<CommandHeader> readHeader(new CommandHeader);
@@ -69,16 +70,24 @@ void Connector::BeginConfirmCommand(shared_ptr<Connector> shared_this) {
 		boost::asio::transfer_all(),
 		boost::bind(
 			&Connector::HandleConfirmCommand, shared_this,
-			readHeader, boost::asio::placeholders::error));
+			readHeader, true, boost::asio::placeholders::error));
 
 	CONNECTION_TRACE("Confirming whether the connection is correct...");
 }
 
 void Connector::HandleConfirmCommand(shared_ptr<CommandHeader> header,
+									 bool isRead,
 									 const boost::system::error_code &error) {
 	if (!error && header->u.type == REMOTECOMMANDTYPE_START_CONNECTION) {
 		++m_handleCommandCount;
 
+		// Use the older wire version of both sides.
+		if (isRead) {
+			boost::uint32_t version = ntohl(header->commandId);
+			m_connection->m_wireVersion =
+				(version < WIREVERSION_LATEST ? (int)version : WIREVERSION_LATEST);
+		}
+
 		// If the reading and writing commands were done.
 		if (m_handleCommandCount >= 2) {
 			CONNECTION_TRACE("Succeeded in confirming.");
@@ -238,7 +247,8 @@ void ClientConnector::HandleConnect(tcp::resolver::iterator nextEndpoint,
 /*-----------------------------------------------------------------*/
 Connection::Connection(RemoteEngine &engine)
 	: m_engine(engine), m_service(engine.GetService())
-	, m_socket(engine.GetService()), m_isConnected(false) {
+	, m_socket(engine.GetService()), m_isConnected(false)
+	, m_wireVersion(WIREVERSION_TEXT) {
 }
 
 Connection::~Connection() {
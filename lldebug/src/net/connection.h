@@ -57,6 +57,7 @@ public:
 protected:
 	void BeginConfirmCommand(shared_ptr<Connector> shared_this);
 	void HandleConfirmCommand(shared_ptr<CommandHeader> header,
+							  bool isRead,
 							  const boost::system::error_code &error);
 	shared_ptr<Connection> NewConnection();
 	void Connected();
@@ -134,6 +135,11 @@ public:
 		return m_socket;
 	}
 
+	/// Get the wire version agreed with the other side.
+	int GetWireVersion() const {
+		return m_wireVersion;
+	}
+
 private:
 	friend class Connector;
 	explicit Connection(RemoteEngine &engine);
@@ -159,6 +165,7 @@ private:
 	boost::asio::io_service &m_service;
 	boost::asio::ip::tcp::socket m_socket;
 	bool m_isConnected;
+	int m_wireVersion;
 
 	typedef std::queue<Command> WriteCommandQueue;
 	/// Reserved write command queue.
@@ -28,6 +28,10 @@
 #include "net/connection.h"
 #include "net/remoteengine.h"
 #include "net/netutils.h"
+#include <boost/bind.hpp>
+
+/// The maximum number of the posted logs that aren't sent yet.
+#define OUTPUT_LOG_RING_SIZE 4096
 
 namespace lldebug {
 namespace net {
@@ -56,7 +60,10 @@ private:
 
 
 RemoteEngine::RemoteEngine()
-	: m_commandIdCounter(0), m_isFailed(false), m_isExitThread(false) {
+	: m_commandIdCounter(0), m_isFailed(false)
+	, m_wireVersion(WIREVERSION_TEXT), m_batchDepth(0)
+	, m_logHead(0), m_logSize(0), m_postedLogs(0), m_droppedLogs(0)
+	, m_reportedDrops(0) {
 
 	// To avoid duplicating the Id.
 #ifdef LLDEBUG_CONTEXT
@@ -65,6 +72,8 @@ RemoteEngine::RemoteEngine()
 	m_commandIdCounter = 2;
 #endif
 
+	// The thread blocks in the io_service until the engine is destroyed.
+	m_work.reset(new boost::asio::io_service::work(m_service));
 	ThreadObj fn(this, &RemoteEngine::ConnectionThread);
 	m_thread.reset(new boost::thread(fn));
 }
@@ -76,11 +85,12 @@ RemoteEngine::~RemoteEngine() {
 
 	{
 		scoped_lock lock(m_mutex);
-		m_isExitThread = true;
 		m_onRemoteCommand.clear();
 	}
 
-	// We must join the thread.
+	// The pending handlers are discarded, and we must join the thread.
+	m_work.reset();
+	m_service.stop();
 	if (m_thread != NULL) {
 		m_thread->join();
 		m_thread.reset();
@@ -127,35 +137,20 @@ int RemoteEngine::StartContext(const std::string &hostName,
 }
 
 /// Connection thread.
+/**
+ * The handlers are called as soon as the socket is ready, and it returns
+ * when the io_service is stopped by the destructor.
+ */
 void RemoteEngine::ConnectionThread() {
 	for (;;) {
-		{ scoped_lock lock(m_mutex);
-			if (m_isExitThread) {
-				break;
-			}
-		}
-
-		// Do works.
-		size_t doneWorks = 0;
 		try {
-			// 10 works are set.
-			for (int i = 0; i < 100; ++i) {
-				doneWorks += m_service.poll_one();
-			}
-
-			m_service.reset();
+			m_service.run();
+			break;
 		}
 		catch (std::exception &ex) {
+			// The other handlers are still alive.
 			std::cout << ex.what() << std::endl;
 		}
-
-		// Wait, if any ...
-		if (doneWorks == 0) {
-			boost::xtime xt;
-			boost::xtime_get(&xt, boost::TIME_UTC);
-			xt.nsec += 10 * 1000 * 1000; // 1ms = 1000 * 1000nsec
-			boost::thread::sleep(xt);
-		}
 	}
 }
 
@@ -174,6 +169,7 @@ bool RemoteEngine::OnConnectionConnected(shared_ptr<Connection> connection) {
 	}
 	m_connection = connection;
 	m_connector.reset();
+	m_wireVersion = connection->GetWireVersion();
 
 	Command command(
 		InitCommandHeader(REMOTECOMMANDTYPE_START_CONNECTION, 0),
@@ -189,6 +185,7 @@ void RemoteEngine::OnConnectionClosed(shared_ptr<Connection> connection,
 	if (m_connection == connection) {
 		m_connection.reset();
 		m_connector.reset();
+		m_wireVersion = WIREVERSION_TEXT;
 
 		Command command(
 			InitCommandHeader(REMOTECOMMANDTYPE_END_CONNECTION, 0),
@@ -209,6 +206,12 @@ void RemoteEngine::OnRemoteCommand(Command &command) {
 		m_waitResponses.erase(it);
 	}
 
+	// The ping is answered here, it measures only the connection.
+	if (command.GetType() == REMOTECOMMANDTYPE_PING && !command.IsResponse()) {
+		ResponseCommand(command, REMOTECOMMANDTYPE_PING, CommandData());
+		return;
+	}
+
 	if (!m_onRemoteCommand.empty()) {
 		OnRemoteCommandType callback = m_onRemoteCommand;
 		lock.unlock();
@@ -220,7 +223,7 @@ void RemoteEngine::OnRemoteCommand(Command &command) {
 void RemoteEngine::OutputLog(LogType type, const std::string &msg) {
 	scoped_lock lock(m_mutex);
 	LogData logData(type, msg);
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	// Output log to the local.
 	data.Set_OutputLog(logData);
@@ -233,6 +236,83 @@ void RemoteEngine::OutputLog(LogType type, const std::string &msg) {
 	SendOutputLog(logData);
 }
 
+void RemoteEngine::PostOutputLog(const LogData &logData) {
+	scoped_lock lock(m_logMutex);
+
+	// The first log schedules the flush, and the others are sent with it.
+	if (m_logSize == 0) {
+		m_service.post(
+			boost::bind(&RemoteEngine::FlushOutputLogs, this));
+	}
+
+	if (m_logRing.empty()) {
+		m_logRing.resize(OUTPUT_LOG_RING_SIZE);
+	}
+
+	// If the ring is full, the oldest log is overwritten.
+	std::size_t pos = (m_logHead + m_logSize) % m_logRing.size();
+	m_logRing[pos] = logData;
+	m_logRing[pos].SetRemote();
+
+	if (m_logSize < m_logRing.size()) {
+		++m_logSize;
+	}
+	else {
+		m_logHead = (m_logHead + 1) % m_logRing.size();
+		++m_droppedLogs;
+	}
+	++m_postedLogs;
+}
+
+void RemoteEngine::FlushOutputLogs() {
+	LogDataList logs;
+
+	{ scoped_lock lock(m_logMutex);
+		if (m_logSize == 0) {
+			return;
+		}
+
+		logs.reserve(m_logSize + 1);
+		if (m_droppedLogs != m_reportedDrops) {
+			LogData logData(LOGTYPE_WARNING,
+				boost::lexical_cast<std::string>(m_droppedLogs - m_reportedDrops)
+				+ " logs were dropped because they were output too fast.");
+			logData.SetRemote();
+			logs.push_back(logData);
+			m_reportedDrops = m_droppedLogs;
+		}
+
+		for (std::size_t i = 0; i < m_logSize; ++i) {
+			logs.push_back(m_logRing[(m_logHead + i) % m_logRing.size()]);
+		}
+		m_logHead = 0;
+		m_logSize = 0;
+	}
+
+	SendOutputLogList(logs);
+}
+
+void RemoteEngine::GetPostedLogCount(unsigned long &posted,
+									 unsigned long &dropped) {
+	scoped_lock lock(m_logMutex);
+
+	posted = m_postedLogs;
+	dropped = m_droppedLogs;
+}
+
+/**
+ * @brief The responses of the batch, they are sent when all are done.
+ */
+struct BatchResponse {
+	Command command;
+	BatchItemList results;
+	std::size_t remaining;
+
+	explicit BatchResponse(const Command &command_, std::size_t size)
+		: command(command_), results(size), remaining(size) {
+	}
+};
+
 CommandHeader RemoteEngine::InitCommandHeader(RemoteCommandType type,
 											  size_t dataSize,
 											  int commandId) {
@@ -257,6 +337,11 @@ void RemoteEngine::SendCommand(RemoteCommandType type,
 							   const CommandData &data) {
 	scoped_lock lock(m_mutex);
 
+	// Keep the order of the commands.
+	if (IsBatching()) {
+		FlushBatch();
+	}
+
 	if (m_connection != NULL) {
 		CommandHeader header = InitCommandHeader(
 			type,
@@ -271,6 +356,17 @@ void RemoteEngine::SendCommand(RemoteCommandType type,
 							   const CommandCallback &response) {
 	scoped_lock lock(m_mutex);
 
+	if (IsBatching()) {
+		if (is_batchable_command(type)) {
+			m_batchItems.push_back(std::make_pair((int)type, data.GetImplData()));
+			m_batchCallbacks.push_back(response);
+			return;
+		}
+
+		// Keep the order of the commands.
+		FlushBatch();
+	}
+
 	if (m_connection != NULL) {
 		CommandHeader header = InitCommandHeader(
 			type,
@@ -286,6 +382,23 @@ void RemoteEngine::ResponseCommand(const Command &readCommand,
 								   const CommandData &data) {
 	scoped_lock lock(m_mutex);
 
+	// The response of the batched command is sent with the others.
+	if (readCommand.m_batch != NULL) {
+		BatchResponse &batch = *readCommand.m_batch;
+		batch.results[readCommand.m_batchIndex] =
+			std::make_pair((int)type, data.GetImplData());
+
+		if (--batch.remaining == 0) {
+			CommandData batchData(GetWireVersion());
+			batchData.Set_ValueBatch(batch.results);
+			ResponseCommand(
+				batch.command,
+				REMOTECOMMANDTYPE_VALUE_BATCH,
+				batchData);
+		}
+		return;
+	}
+
 	if (m_connection != NULL) {
 		CommandHeader header = InitCommandHeader(
 			type,
@@ -296,8 +409,130 @@ void RemoteEngine::ResponseCommand(const Command &readCommand,
 	}
 }
 
+/**
+ * @brief Handle the response of the batch.
+ */
+struct BatchResponseHandler {
+	std::vector<CommandCallback> m_callbacks;
+
+	explicit BatchResponseHandler(const std::vector<CommandCallback> &callbacks)
+		: m_callbacks(callbacks) {
+	}
+
+	int operator()(const Command &command) {
+		BatchItemList items;
+		command.GetData().Get_ValueBatch(items);
+
+		// Each response is passed as if it's sent separately.
+		int result = 0;
+		std::size_t size = std::min(items.size(), m_callbacks.size());
+		for (std::size_t i = 0; i < size; ++i) {
+			CommandHeader header = command.GetHeader();
+			header.u.type = (RemoteCommandType)items[i].first;
+			header.dataSize = (boost::uint32_t)items[i].second.size();
+
+			Command response(header, CommandData(items[i].second));
+			if (m_callbacks[i](response) != 0) {
+				result = -1;
+			}
+		}
+
+		return result;
+	}
+};
+
+void RemoteEngine::BeginBatch() {
+	scoped_lock lock(m_mutex);
+
+	if (m_batchDepth++ == 0) {
+		m_batchThread = boost::this_thread::get_id();
+	}
+}
+
+void RemoteEngine::EndBatch() {
+	scoped_lock lock(m_mutex);
+
+	if (m_batchDepth > 0 && --m_batchDepth == 0) {
+		FlushBatch();
+	}
+}
+
+/// Is this thread collecting the requests ?
+bool RemoteEngine::IsBatching() {
+	scoped_lock lock(m_mutex);
+	return (m_batchDepth > 0
+		&& m_batchThread == boost::this_thread::get_id());
+}
+
+/// Send the collected requests.
+void RemoteEngine::FlushBatch() {
+	scoped_lock lock(m_mutex);
+
+	BatchItemList items;
+	std::vector<CommandCallback> callbacks;
+	items.swap(m_batchItems);
+	callbacks.swap(m_batchCallbacks);
+
+	// 'm_batchDepth' is kept, so the commands must not be collected again.
+	if (items.empty() || m_connection == NULL) {
+		return;
+	}
+
+	CommandHeader header;
+	if (items.size() == 1) {
+		// The single request is sent as it is.
+		header = InitCommandHeader(
+			(RemoteCommandType)items[0].first,
+			items[0].second.size());
+		m_connection->WriteCommand(header, CommandData(items[0].second));
+		m_waitResponses.insert(std::make_pair(header.commandId, callbacks[0]));
+	}
+	else {
+		CommandData data(GetWireVersion());
+		data.Set_Batch(items);
+
+		header = InitCommandHeader(
+			REMOTECOMMANDTYPE_BATCH,
+			data.GetSize());
+		m_connection->WriteCommand(header, data);
+		m_waitResponses.insert(std::make_pair(header.commandId,
+			CommandCallback(BatchResponseHandler(callbacks))));
+	}
+}
+
+void RemoteEngine::SplitBatch(const Command &command,
+							  std::vector<Command> &commands) {
+	BatchItemList items;
+	command.GetData().Get_Batch(items);
+
+	if (items.empty()) {
+		ResponseCommand(command, REMOTECOMMANDTYPE_VALUE_BATCH, CommandData());
+		return;
+	}
+
+	shared_ptr<BatchResponse> batch(new BatchResponse(command, items.size()));
+	commands.reserve(items.size());
+	for (std::size_t i = 0; i < items.size(); ++i) {
+		CommandHeader header = command.GetHeader();
+		header.u.type = (RemoteCommandType)items[i].first;
+		header.dataSize = (boost::uint32_t)items[i].second.size();
+
+		Command subCommand(header, CommandData(items[i].second));
+		subCommand.m_batch = batch;
+		subCommand.m_batchIndex = i;
+
+		// The others may change the state, so they aren't handled.
+		if (!is_batchable_command(subCommand.GetType())) {
+			ResponseFailed(subCommand);
+			continue;
+		}
+
+		commands.push_back(subCommand);
+	}
+}
+
 void RemoteEngine::SendChangedState(bool isBreak) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_ChangedState(isBreak);
 	SendCommand(
@@ -307,10 +542,11 @@ void RemoteEngine::SendChangedState(bool isBreak) {
 
 void RemoteEngine::SendUpdateSource(const std::string &key, int line,
 									int updateSourceCount, bool isRefreshOnly,
+									const LuaBreakSnapshot &snapshot,
 									const CommandCallback &response) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
-	data.Set_UpdateSource(key, line, updateSourceCount, isRefreshOnly);
+	data.Set_UpdateSource(key, line, updateSourceCount, isRefreshOnly, snapshot);
 	SendCommand(
 		REMOTECOMMANDTYPE_UPDATE_SOURCE,
 		data,
@@ -324,7 +560,7 @@ void RemoteEngine::SendForceUpdateSource() {
 }
 
 void RemoteEngine::SendAddedSource(const Source &source) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_AddedSource(source);
 	SendCommand(
@@ -334,7 +570,7 @@ void RemoteEngine::SendAddedSource(const Source &source) {
 
 void RemoteEngine::SendSaveSource(const std::string &key,
 								  const string_array &sources) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_SaveSource(key, sources);
 	SendCommand(
@@ -343,7 +579,7 @@ void RemoteEngine::SendSaveSource(const std::string &key,
 }
 
 void RemoteEngine::SendSetUpdateCount(int updateCount) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_SetUpdateCount(updateCount);
 	SendCommand(
@@ -353,7 +589,7 @@ void RemoteEngine::SendSetUpdateCount(int updateCount) {
 
 /// Notify that the breakpoint was set.
 void RemoteEngine::SendSetBreakpoint(const Breakpoint &bp) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_SetBreakpoint(bp);
 	SendCommand(
@@ -362,7 +598,7 @@ void RemoteEngine::SendSetBreakpoint(const Breakpoint &bp) {
 }
 
 void RemoteEngine::SendRemoveBreakpoint(const Breakpoint &bp) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_RemoveBreakpoint(bp);
 	SendCommand(
@@ -371,7 +607,7 @@ void RemoteEngine::SendRemoveBreakpoint(const Breakpoint &bp) {
 }
 
 void RemoteEngine::SendChangedBreakpointList(const BreakpointList &bps) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_ChangedBreakpointList(bps);
 	SendCommand(
@@ -410,7 +646,7 @@ void RemoteEngine::SendStepReturn() {
 }
 
 void RemoteEngine::SendSetEncoding(lldebug_Encoding encoding) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_SetEncoding(encoding);
 	SendCommand(
@@ -422,13 +658,22 @@ void RemoteEngine::SendOutputLog(const LogData &logData) {
 	LogData logData_ = logData;
 	logData_.SetRemote();
 
-	CommandData data;
+	CommandData data(GetWireVersion());
 	data.Set_OutputLog(logData_);
 	SendCommand(
 		REMOTECOMMANDTYPE_OUTPUT_LOG,
 		data);
 }
 
+void RemoteEngine::SendOutputLogList(const LogDataList &logs) {
+	CommandData data(GetWireVersion());
+
+	data.Set_OutputLogList(logs);
+	SendCommand(
+		REMOTECOMMANDTYPE_OUTPUT_LOGLIST,
+		data);
+}
+
 /**
  * @brief Handle the response VarList.
  */
@@ -466,7 +711,7 @@ struct LuaVarResponseHandler {
 void RemoteEngine::SendEvalsToVarList(const string_array &evals,
 									  const LuaStackFrame &stackFrame,
 									  const LuaVarListCallback &callback) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_EvalsToVarList(evals, stackFrame);
 	SendCommand(
@@ -478,7 +723,7 @@ void RemoteEngine::SendEvalsToVarList(const string_array &evals,
 void RemoteEngine::SendEvalToMultiVar(const std::string &eval,
 									  const LuaStackFrame &stackFrame,
 									  const LuaVarListCallback &callback) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_EvalToMultiVar(eval, stackFrame);
 	SendCommand(
@@ -490,7 +735,7 @@ void RemoteEngine::SendEvalToMultiVar(const std::string &eval,
 void RemoteEngine::SendEvalToVar(const std::string &eval,
 								 const LuaStackFrame &stackFrame,
 								 const LuaVarCallback &callback) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_EvalToVar(eval, stackFrame);
 	SendCommand(
@@ -499,22 +744,55 @@ void RemoteEngine::SendEvalToVar(const std::string &eval,
 		LuaVarResponseHandler(callback));
 }
 
+/**
+ * @brief Handle the response VarPage.
+ */
+struct LuaVarPageResponseHandler {
+	LuaVarPageCallback m_callback;
+
+	explicit LuaVarPageResponseHandler(const LuaVarPageCallback &callback)
+		: m_callback(callback) {
+	}
+
+	int operator()(const Command &command) {
+		LuaVarList vars;
+		int total, resume;
+		std::string error;
+		command.GetData().Get_ValueVarPage(vars, total, resume, error);
+		return m_callback(command, vars, total, resume, error);
+	}
+};
+
 void RemoteEngine::SendRequestFieldsVarList(const LuaVar &var,
-											const LuaVarListCallback &callback) {
-	CommandData data;
+											int offset, int count, int resume,
+											const LuaVarPageCallback &callback) {
+	CommandData data(GetWireVersion());
 
-	data.Set_RequestFieldVarList(var);
+	data.Set_RequestFieldVarList(var, offset, count, resume);
 	SendCommand(
 		REMOTECOMMANDTYPE_REQUEST_FIELDSVARLIST,
 		data,
-		LuaVarListResponseHandler(callback));
+		LuaVarPageResponseHandler(callback));
+}
+
+void RemoteEngine::SendRequestFieldsQuery(const LuaVar &var,
+										  const LuaFieldQuery &query,
+										  int offset, int count,
+										  const LuaVarPageCallback &callback) {
+	CommandData data(GetWireVersion());
+
+	data.Set_RequestFieldsQuery(var, query, offset, count);
+	SendCommand(
+		REMOTECOMMANDTYPE_REQUEST_FIELDSQUERY,
+		data,
+		LuaVarPageResponseHandler(callback));
 }
 
 void RemoteEngine::SendRequestLocalVarList(const LuaStackFrame &stackFrame,
 										   bool checkLocal, bool checkUpvalue,
 										   bool checkEnviron,
 										   const LuaVarListCallback &callback) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_RequestLocalVarList(
 		stackFrame, checkLocal,checkUpvalue, checkEnviron);
@@ -564,7 +842,7 @@ struct SourceResponseHandler {
 
 void RemoteEngine::SendRequestSource(const std::string &key,
 									 const SourceCallback &callback) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_RequestSource(key);
 	SendCommand(
@@ -597,6 +875,311 @@ void RemoteEngine::SendRequestBacktraceList(const LuaBacktraceListCallback &call
 		BacktraceListHandler(callback));
 }
 
+/**
+ * @brief Handle the response CoroutineList.
+ */
+struct CoroutineListHandler {
+	LuaCoroutineListCallback m_callback;
+
+	explicit CoroutineListHandler(const LuaCoroutineListCallback &callback)
+		: m_callback(callback) {
+	}
+
+	int operator()(const Command &command) {
+		LuaCoroutineList coroutines;
+		int total;
+		command.GetData().Get_ValueCoroutineList(coroutines, total);
+		return m_callback(command, coroutines, total);
+	}
+};
+
+void RemoteEngine::SendRequestCoroutineList(int offset, int count,
+											int sortKey, bool isAscending,
+											const LuaCoroutineListCallback &callback) {
+	CommandData data(GetWireVersion());
+
+	data.Set_RequestCoroutineList(offset, count, sortKey, isAscending);
+	SendCommand(
+		REMOTECOMMANDTYPE_REQUEST_COROUTINELIST,
+		data,
+		CoroutineListHandler(callback));
+}
+
+void RemoteEngine::SendRequestCoroutineBacktrace(const LuaHandle &lua,
+												 const LuaBacktraceListCallback &callback) {
+	CommandData data(GetWireVersion());
+
+	data.Set_RequestCoroutineBacktrace(lua);
+	SendCommand(
+		REMOTECOMMANDTYPE_REQUEST_COROUTINEBACKTRACE,
+		data,
+		BacktraceListHandler(callback));
+}
+
+/**
+ * @brief Handle the response String.
+ */
+struct StringResponseHandler {
+	StringCallback m_callback;
+
+	explicit StringResponseHandler(const StringCallback &callback)
+		: m_callback(callback) {
+	}
+
+	int operator()(const Command &command) {
+		std::string str;
+		command.GetData().Get_ValueString(str);
+		return m_callback(command, str);
+	}
+};
+
+void RemoteEngine::SendStartProfile(int interval) {
+	CommandData data(GetWireVersion());
+
+	data.Set_StartProfile(interval);
+	SendCommand(
+		REMOTECOMMANDTYPE_START_PROFILE,
+		data);
+}
+
+void RemoteEngine::SendStopProfile(const StringCallback &callback) {
+	SendCommand(
+		REMOTECOMMANDTYPE_STOP_PROFILE,
+		CommandData(),
+		StringResponseHandler(callback));
+}
+
+void RemoteEngine::SendStartFuncProfile() {
+	SendCommand(
+		REMOTECOMMANDTYPE_START_FUNCPROFILE,
+		CommandData());
+}
+
+void RemoteEngine::SendStopFuncProfile() {
+	SendCommand(
+		REMOTECOMMANDTYPE_STOP_FUNCPROFILE,
+		CommandData());
+}
+
+/**
+ * @brief Handle the response FuncProfileList.
+ */
+struct FuncProfileListHandler {
+	LuaFuncProfileListCallback m_callback;
+
+	explicit FuncProfileListHandler(const LuaFuncProfileListCallback &callback)
+		: m_callback(callback) {
+	}
+
+	int operator()(const Command &command) {
+		LuaFuncProfileList profiles;
+		command.GetData().Get_ValueFuncProfileList(profiles);
+		return m_callback(command, profiles);
+	}
+};
+
+void RemoteEngine::SendRequestFuncProfileList(const LuaFuncProfileListCallback &callback) {
+	SendCommand(
+		REMOTECOMMANDTYPE_REQUEST_FUNCPROFILELIST,
+		CommandData(),
+		FuncProfileListHandler(callback));
+}
+
+void RemoteEngine::SendStartCoverage(bool firstHitOnly) {
+	CommandData data(GetWireVersion());
+
+	data.Set_StartCoverage(firstHitOnly);
+	SendCommand(
+		REMOTECOMMANDTYPE_START_COVERAGE,
+		data);
+}
+
+/**
+ * @brief Handle the response CoverageList.
+ */
+struct CoverageListHandler {
+	SourceCoverageListCallback m_callback;
+
+	explicit CoverageListHandler(const SourceCoverageListCallback &callback)
+		: m_callback(callback) {
+	}
+
+	int operator()(const Command &command) {
+		SourceCoverageList coverages;
+		command.GetData().Get_ValueCoverageList(coverages);
+		return m_callback(command, coverages);
+	}
+};
+
+void RemoteEngine::SendStopCoverage(const SourceCoverageListCallback &callback) {
+	SendCommand(
+		REMOTECOMMANDTYPE_STOP_COVERAGE,
+		CommandData(),
+		CoverageListHandler(callback));
+}
+
+void RemoteEngine::SendChangedCoverage(const SourceCoverageList &coverages) {
+	CommandData data(GetWireVersion());
+
+	data.Set_ChangedCoverage(coverages);
+	SendCommand(
+		REMOTECOMMANDTYPE_CHANGED_COVERAGE,
+		data);
+}
+
+void RemoteEngine::SendStartAllocProfile() {
+	SendCommand(
+		REMOTECOMMANDTYPE_START_ALLOCPROFILE,
+		CommandData());
+}
+
+/**
+ * @brief Handle the response AllocProfileList.
+ */
+struct AllocProfileListHandler {
+	LuaAllocProfileListCallback m_callback;
+
+	explicit AllocProfileListHandler(const LuaAllocProfileListCallback &callback)
+		: m_callback(callback) {
+	}
+
+	int operator()(const Command &command) {
+		LuaAllocProfileList profiles;
+		command.GetData().Get_ValueAllocProfileList(profiles);
+		return m_callback(command, profiles);
+	}
+};
+
+void RemoteEngine::SendStopAllocProfile(const LuaAllocProfileListCallback &callback) {
+	SendCommand(
+		REMOTECOMMANDTYPE_STOP_ALLOCPROFILE,
+		CommandData(),
+		AllocProfileListHandler(callback));
+}
+
+void RemoteEngine::SendStartSchedProfile() {
+	SendCommand(
+		REMOTECOMMANDTYPE_START_SCHEDPROFILE,
+		CommandData());
+}
+
+/**
+ * @brief Handle the response SchedProfileList.
+ */
+struct SchedProfileListHandler {
+	LuaSchedProfileListCallback m_callback;
+
+	explicit SchedProfileListHandler(const LuaSchedProfileListCallback &callback)
+		: m_callback(callback) {
+	}
+
+	int operator()(const Command &command) {
+		LuaSchedProfileList profiles;
+		command.GetData().Get_ValueSchedProfileList(profiles);
+		return m_callback(command, profiles);
+	}
+};
+
+void RemoteEngine::SendStopSchedProfile(const LuaSchedProfileListCallback &callback) {
+	SendCommand(
+		REMOTECOMMANDTYPE_STOP_SCHEDPROFILE,
+		CommandData(),
+		SchedProfileListHandler(callback));
+}
+
+void RemoteEngine::SendStartTrace(int bufferSize, const std::string &prefix) {
+	CommandData data(GetWireVersion());
+
+	data.Set_StartTrace(bufferSize, prefix);
+	SendCommand(
+		REMOTECOMMANDTYPE_START_TRACE,
+		data);
+}
+
+void RemoteEngine::SendStopTrace(const StringCallback &callback) {
+	SendCommand(
+		REMOTECOMMANDTYPE_STOP_TRACE,
+		CommandData(),
+		StringResponseHandler(callback));
+}
+
+void RemoteEngine::SendSaveHeapSnapshot(const std::string &filename) {
+	CommandData data(GetWireVersion());
+
+	data.Set_SaveHeapSnapshot(filename);
+	SendCommand(
+		REMOTECOMMANDTYPE_SAVE_HEAPSNAPSHOT,
+		data);
+}
+
+void RemoteEngine::SendStartGcMonitor(int interval) {
+	CommandData data(GetWireVersion());
+
+	data.Set_StartGcMonitor(interval);
+	SendCommand(
+		REMOTECOMMANDTYPE_START_GCMONITOR,
+		data);
+}
+
+void RemoteEngine::SendStopGcMonitor() {
+	SendCommand(
+		REMOTECOMMANDTYPE_STOP_GCMONITOR,
+		CommandData());
+}
+
+void RemoteEngine::SendSetGcThreshold(int kbytes) {
+	CommandData data(GetWireVersion());
+
+	data.Set_SetGcThreshold(kbytes);
+	SendCommand(
+		REMOTECOMMANDTYPE_SET_GCTHRESHOLD,
+		data);
+}
+
+void RemoteEngine::SendChangedGcStats(const LuaGcSample &sample) {
+	CommandData data(GetWireVersion());
+
+	data.Set_ChangedGcStats(sample);
+	SendCommand(
+		REMOTECOMMANDTYPE_CHANGED_GCSTATS,
+		data);
+}
+
+void RemoteEngine::SendSelectThread(int id) {
+	CommandData data(GetWireVersion());
+
+	data.Set_SelectThread(id);
+	SendCommand(
+		REMOTECOMMANDTYPE_SELECT_THREAD,
+		data);
+}
+
+void RemoteEngine::SendChangedThreadList(const LuaThreadList &threads) {
+	CommandData data(GetWireVersion());
+
+	data.Set_ChangedThreadList(threads);
+	SendCommand(
+		REMOTECOMMANDTYPE_CHANGED_THREADLIST,
+		data);
+}
+
+void RemoteEngine::SendPing(const CommandCallback &callback) {
+	SendCommand(
+		REMOTECOMMANDTYPE_PING,
+		CommandData(),
+		callback);
+}
+
+void RemoteEngine::SendSetDebugFilter(DebugFilterType type,
+									  const std::string &pattern) {
+	CommandData data(GetWireVersion());
+
+	data.Set_SetDebugFilter((int)type, pattern);
+	SendCommand(
+		REMOTECOMMANDTYPE_SET_DEBUGFILTER,
+		data);
+}
+
 
 void RemoteEngine::ResponseSuccessed(const Command &command) {
 	ResponseCommand(
@@ -613,7 +1196,7 @@ void RemoteEngine::ResponseFailed(const Command &command) {
 }
 
 void RemoteEngine::ResponseString(const Command &command, const std::string &str) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_ValueString(str);
 	ResponseCommand(
@@ -623,7 +1206,7 @@ void RemoteEngine::ResponseString(const Command &command, const std::string &str
 }
 
 void RemoteEngine::ResponseSource(const Command &command, const Source &source) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_ValueSource(source);
 	ResponseCommand(
@@ -634,7 +1217,7 @@ void RemoteEngine::ResponseSource(const Command &command, const Source &source)
 
 void RemoteEngine::ResponseVarList(const Command &command,
 								   const LuaVarList &vars) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_ValueVarList(vars);
 	ResponseCommand(
@@ -644,7 +1227,7 @@ void RemoteEngine::ResponseVarList(const Command &command,
 }
 
 void RemoteEngine::ResponseVar(const Command &command, const LuaVar &var) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_ValueVar(var);
 	ResponseCommand(
@@ -655,7 +1238,7 @@ void RemoteEngine::ResponseVar(const Command &command, const LuaVar &var) {
 
 void RemoteEngine::ResponseBacktraceList(const Command &command,
 										 const LuaBacktraceList &backtraces) {
-	CommandData data;
+	CommandData data(GetWireVersion());
 
 	data.Set_ValueBacktraceList(backtraces);
 	ResponseCommand(
@@ -664,5 +1247,74 @@ void RemoteEngine::ResponseBacktraceList(const Command &command,
 		data);
 }
 
+void RemoteEngine::ResponseFuncProfileList(const Command &command,
+										   const LuaFuncProfileList &profiles) {
+	CommandData data(GetWireVersion());
+
+	data.Set_ValueFuncProfileList(profiles);
+	ResponseCommand(
+		command,
+		REMOTECOMMANDTYPE_VALUE_FUNCPROFILELIST,
+		data);
+}
+
+void RemoteEngine::ResponseCoverageList(const Command &command,
+										const SourceCoverageList &coverages) {
+	CommandData data(GetWireVersion());
+
+	data.Set_ValueCoverageList(coverages);
+	ResponseCommand(
+		command,
+		REMOTECOMMANDTYPE_VALUE_COVERAGELIST,
+		data);
+}
+
+void RemoteEngine::ResponseAllocProfileList(const Command &command,
+											const LuaAllocProfileList &profiles) {
+	CommandData data(GetWireVersion());
+
+	data.Set_ValueAllocProfileList(profiles);
+	ResponseCommand(
+		command,
+		REMOTECOMMANDTYPE_VALUE_ALLOCPROFILELIST,
+		data);
+}
+
+void RemoteEngine::ResponseSchedProfileList(const Command &command,
+											const LuaSchedProfileList &profiles) {
+	CommandData data(GetWireVersion());
+
+	data.Set_ValueSchedProfileList(profiles);
+	ResponseCommand(
+		command,
+		REMOTECOMMANDTYPE_VALUE_SCHEDPROFILELIST,
+		data);
+}
+
+void RemoteEngine::ResponseCoroutineList(const Command &command,
+										 const LuaCoroutineList &coroutines,
+										 int total) {
+	CommandData data(GetWireVersion());
+
+	data.Set_ValueCoroutineList(coroutines, total);
+	ResponseCommand(
+		command,
+		REMOTECOMMANDTYPE_VALUE_COROUTINELIST,
+		data);
+}
+
+void RemoteEngine::ResponseVarPage(const Command &command,
+								   const LuaVarList &vars,
+								   int total, int resume,
+								   const std::string &error) {
+	CommandData data(GetWireVersion());
+
+	data.Set_ValueVarPage(vars, total, resume, error);
+	ResponseCommand(
+		command,
+		REMOTECOMMANDTYPE_VALUE_VARPAGE,
+		data);
+}
+
 } // end of namespace net
 } // end of namespace lldebug
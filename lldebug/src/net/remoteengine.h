@@ -53,9 +53,28 @@ typedef
 typedef
 	boost::function2<int, const Command &, const LuaVar &>
 	LuaVarCallback;
+typedef
+	boost::function5<int, const Command &, const LuaVarList &, int, int,
+					 const std::string &>
+	LuaVarPageCallback;
 typedef
 	boost::function2<int, const Command &, const LuaBacktraceList &>
 	LuaBacktraceListCallback;
+typedef
+	boost::function2<int, const Command &, const LuaFuncProfileList &>
+	LuaFuncProfileListCallback;
+typedef
+	boost::function2<int, const Command &, const SourceCoverageList &>
+	SourceCoverageListCallback;
+typedef
+	boost::function2<int, const Command &, const LuaAllocProfileList &>
+	LuaAllocProfileListCallback;
+typedef
+	boost::function2<int, const Command &, const LuaSchedProfileList &>
+	LuaSchedProfileListCallback;
+typedef
+	boost::function3<int, const Command &, const LuaCoroutineList &, int>
+	LuaCoroutineListCallback;
 
 /**
  * @brief Remote engine for debugger.
@@ -88,6 +107,12 @@ public:
 		return (m_connection != NULL);
 	}
 
+	/// Get the encoding of the command data for the connection.
+	int GetWireVersion() {
+		scoped_lock lock(m_mutex);
+		return m_wireVersion;
+	}
+
 	/// Set the callback function called when it receives some commands.
 	void SetOnRemoteCommand(const OnRemoteCommandType &callback) {
 		scoped_lock lock(m_mutex);
@@ -104,9 +129,31 @@ public:
 	/// Send log to local and remote.
 	void OutputLog(LogType type, const std::string &msg);
 
+	/// Post the log to the ring buffer, it's sent with others later.
+	void PostOutputLog(const LogData &logData);
+
+	/// Send all the posted logs as one command.
+	void FlushOutputLogs();
+
+	/// Get the number of the posted logs and the dropped ones.
+	void GetPostedLogCount(unsigned long &posted, unsigned long &dropped);
+
+	/// Collect the requests sent by this thread into one batch.
+	/**
+	 * It can be nested, and the batch is sent by the last 'EndBatch'.
+	 */
+	void BeginBatch();
+
+	/// Send the collected requests as one command.
+	void EndBatch();
+
+	/// Split the batch into the commands, their responses are sent together.
+	void SplitBatch(const Command &command, std::vector<Command> &commands);
+
 	void SendChangedState(bool isBreak);
 	void SendUpdateSource(const std::string &key, int line, int updateCount,
-						  bool isRefreshOnly, const CommandCallback &response);
+						  bool isRefreshOnly, const LuaBreakSnapshot &snapshot,
+						  const CommandCallback &response);
 	void SendForceUpdateSource();
 	void SendAddedSource(const Source &source);
 	void SendSaveSource(const std::string &key, const string_array &sources);
@@ -124,6 +171,7 @@ public:
 
 	void SendSetEncoding(lldebug_Encoding encoding);
 	void SendOutputLog(const LogData &logData);
+	void SendOutputLogList(const LogDataList &logs);
 	void SendEvalsToVarList(const string_array &eval, const LuaStackFrame &stackFrame,
 							const LuaVarListCallback &callback);
 	void SendEvalToMultiVar(const std::string &eval, const LuaStackFrame &stackFrame,
@@ -131,7 +179,12 @@ public:
 	void SendEvalToVar(const std::string &eval, const LuaStackFrame &stackFrame,
 					   const LuaVarCallback &callback);
 	
-	void SendRequestFieldsVarList(const LuaVar &var, const LuaVarListCallback &callback);
+	void SendRequestFieldsVarList(const LuaVar &var, int offset, int count,
+								  int resume,
+								  const LuaVarPageCallback &callback);
+	void SendRequestFieldsQuery(const LuaVar &var, const LuaFieldQuery &query,
+								int offset, int count,
+								const LuaVarPageCallback &callback);
 	void SendRequestLocalVarList(const LuaStackFrame &stackFrame, bool checkLocal,
 								 bool checkUpvalue, bool checkEnviron,
 								 const LuaVarListCallback &callback);
@@ -140,12 +193,48 @@ public:
 	void SendRequestStackList(const LuaVarListCallback &callback);
 	void SendRequestSource(const std::string &key, const SourceCallback &callback);
 	void SendRequestBacktraceList(const LuaBacktraceListCallback &callback);
+	void SendRequestCoroutineList(int offset, int count,
+								  int sortKey, bool isAscending,
+								  const LuaCoroutineListCallback &callback);
+	void SendRequestCoroutineBacktrace(const LuaHandle &lua,
+									   const LuaBacktraceListCallback &callback);
+
+	void SendStartProfile(int interval);
+	void SendStopProfile(const StringCallback &callback);
+	void SendStartFuncProfile();
+	void SendStopFuncProfile();
+	void SendRequestFuncProfileList(const LuaFuncProfileListCallback &callback);
+	void SendStartCoverage(bool firstHitOnly);
+	void SendStopCoverage(const SourceCoverageListCallback &callback);
+	void SendChangedCoverage(const SourceCoverageList &coverages);
+	void SendStartAllocProfile();
+	void SendStopAllocProfile(const LuaAllocProfileListCallback &callback);
+	void SendStartSchedProfile();
+	void SendStopSchedProfile(const LuaSchedProfileListCallback &callback);
+	void SendStartTrace(int bufferSize, const std::string &prefix);
+	void SendStopTrace(const StringCallback &callback);
+	void SendSaveHeapSnapshot(const std::string &filename);
+	void SendStartGcMonitor(int interval);
+	void SendStopGcMonitor();
+	void SendSetGcThreshold(int kbytes);
+	void SendChangedGcStats(const LuaGcSample &sample);
+	void SendSelectThread(int id);
+	void SendChangedThreadList(const LuaThreadList &threads);
+	void SendSetDebugFilter(DebugFilterType type, const std::string &pattern);
+	void SendPing(const CommandCallback &callback);
 
 	void ResponseSuccessed(const Command &command);
 	void ResponseFailed(const Command &command);
 	void ResponseString(const Command &command, const std::string &str);
 	void ResponseSource(const Command &command, const Source &source);
 	void ResponseBacktraceList(const Command &command, const LuaBacktraceList &backtraces);
+	void ResponseFuncProfileList(const Command &command, const LuaFuncProfileList &profiles);
+	void ResponseCoverageList(const Command &command, const SourceCoverageList &coverages);
+	void ResponseAllocProfileList(const Command &command, const LuaAllocProfileList &profiles);
+	void ResponseSchedProfileList(const Command &command, const LuaSchedProfileList &profiles);
+	void ResponseCoroutineList(const Command &command, const LuaCoroutineList &coroutines, int total);
+	void ResponseVarPage(const Command &command, const LuaVarList &vars,
+						 int total, int resume, const std::string &error);
 	void ResponseVarList(const Command &command, const LuaVarList &vars);
 	void ResponseVar(const Command &command, const LuaVar &var);
 
@@ -172,6 +261,8 @@ private:
 	void ResponseCommand(const Command &readCommand,
 						 RemoteCommandType type,
 						 const CommandData &data);
+	bool IsBatching();
+	void FlushBatch();
 
 private:
 	boost::asio::io_service m_service;
@@ -179,15 +270,31 @@ private:
 	shared_ptr<Connection> m_connection;
 	boost::uint32_t m_commandIdCounter;
 	bool m_isFailed;
+	int m_wireVersion;
 
 	shared_ptr<thread> m_thread;
-	bool m_isExitThread;
+	shared_ptr<boost::asio::io_service::work> m_work;
 	mutex m_mutex;
 
 	typedef std::map<boost::uint32_t, CommandCallback> WaitResponseMap;
 	WaitResponseMap m_waitResponses;
 
 	OnRemoteCommandType m_onRemoteCommand;
+
+	/// The requests collected between 'BeginBatch' and 'EndBatch'.
+	int m_batchDepth;
+	boost::thread::id m_batchThread;
+	BatchItemList m_batchItems;
+	std::vector<CommandCallback> m_batchCallbacks;
+
+	/// The ring buffer of the posted logs. (it has own mutex)
+	mutex m_logMutex;
+	LogDataList m_logRing;
+	std::size_t m_logHead;
+	std::size_t m_logSize;
+	unsigned long m_postedLogs;
+	unsigned long m_droppedLogs;
+	unsigned long m_reportedDrops;
 };
 
 } // end of namespace net
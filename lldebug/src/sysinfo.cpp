@@ -33,13 +33,15 @@
 #include <boost/filesystem/exception.hpp>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 namespace lldebug {
 
 Breakpoint::Breakpoint(const std::string &key, int line,
 					   bool isInternal, bool isTemp)
 	: m_key(key), m_line(line)
-	, m_isInternal(isInternal), m_isTemp(isTemp) {
+	, m_isInternal(isInternal), m_isTemp(isTemp)
+	, m_hitCount(0), m_hitEvery(0) {
 }
 
 Breakpoint::~Breakpoint() {
@@ -65,6 +67,54 @@ Breakpoint BreakpointList::Find(const std::string &key, int line) {
 	return *it;
 }
 
+Breakpoint BreakpointList::Find(int sourceId, int line) const {
+	if (!Exists(sourceId, line)) {
+		return Breakpoint();
+	}
+
+	const LineIndex &index = m_index[sourceId];
+	std::vector<int>::const_iterator it =
+		std::lower_bound(index.lines.begin(), index.lines.end(), line);
+	return index.breakpoints[it - index.lines.begin()];
+}
+
+bool BreakpointList::Contains(int sourceId, int first, int last) const {
+	if (sourceId < 0 || (std::size_t)sourceId >= m_index.size()) {
+		return false;
+	}
+
+	const std::vector<int> &lines = m_index[sourceId].lines;
+	std::vector<int>::const_iterator it =
+		std::lower_bound(lines.begin(), lines.end(), first);
+	return (it != lines.end() && *it <= last);
+}
+
+void BreakpointList::UpdateIndex(SourceManager &sources) {
+	m_index.clear();
+
+	// m_set is sorted by key and line, so 'lines' is also sorted.
+	ImplSet::const_iterator it;
+	for (it = m_set.begin(); it != m_set.end(); ++it) {
+		int id = sources.GetId(it->GetKey());
+		int line = it->GetLine();
+		if (id < 0 || line < 0) {
+			continue;
+		}
+
+		if ((std::size_t)id >= m_index.size()) {
+			m_index.resize(id + 1);
+		}
+
+		LineIndex &index = m_index[id];
+		if ((std::size_t)line >= index.bits.size()) {
+			index.bits.resize(line + 1, false);
+		}
+		index.bits[line] = true;
+		index.lines.push_back(line);
+		index.breakpoints.push_back(*it);
+	}
+}
+
 Breakpoint BreakpointList::First(const std::string &key) {
 	// Find the breakpoint which has the least line number.
 	Breakpoint tmp(key, -1);
@@ -108,6 +158,7 @@ void BreakpointList::Set(const Breakpoint &bp) {
 		m_set.erase(it);
 	}
 	m_set.insert(bp);
+	m_hits.erase(bp);
 
 	shared_ptr<RemoteEngine> pengine = m_engine.lock();
 	if (pengine != NULL) {
@@ -129,6 +180,7 @@ void BreakpointList::Remove(const Breakpoint &bp) {
 		return;
 	}
 	m_set.erase(it);
+	m_hits.erase(bp);
 
 	shared_ptr<RemoteEngine> pengine = m_engine.lock();
 	if (pengine != NULL) {
@@ -153,6 +205,14 @@ void BreakpointList::Toggle(const std::string &key, int line) {
 	}
 }
 
+int BreakpointList::Hit(const Breakpoint &bp) {
+	if (!bp.IsOk()) {
+		return 0;
+	}
+
+	return ++m_hits[bp];
+}
+
 
 /*-----------------------------------------------------------------*/
 Source::Source(const std::string &key, const std::string &title,
@@ -187,6 +247,36 @@ std::list<Source> SourceManager::GetList() {
 	return result;
 }
 
+int SourceManager::GetId(const std::string &key) {
+	IdMap::iterator it = m_idMap.find(key);
+	if (it == m_idMap.end()) {
+		return -1;
+	}
+
+	return it->second;
+}
+
+int SourceManager::Intern(const std::string &key) {
+	IdMap::iterator it = m_idMap.find(key);
+	if (it == m_idMap.end()) {
+		int id = (int)m_idMap.size();
+		it = m_idMap.insert(std::make_pair(key, id)).first;
+	}
+
+	return it->second;
+}
+
+void SourceManager::SetAnchored(int id) {
+	if (id < 0) {
+		return;
+	}
+
+	if ((std::size_t)id >= m_anchored.size()) {
+		m_anchored.resize(id + 1, false);
+	}
+	m_anchored[id] = true;
+}
+
 const Source *SourceManager::Get(const std::string &key) {
 	ImplMap::iterator it = m_sourceMap.find(key);
 	if (it == m_sourceMap.end()) {
@@ -212,6 +302,8 @@ const Source *SourceManager::GetString(const std::string &key) {
 int SourceManager::AddSource(const Source &source, bool sendRemote) {
 	m_sourceMap.insert(std::make_pair(source.GetKey(), source));
 
+	// Intern the key, the id is never changed.
+	Intern(source.GetKey());
 	(void)sendRemote;
 
 #ifdef LLDEBUG_CONTEXT
@@ -308,4 +400,46 @@ int SourceManager::Save(const std::string &key, const string_array &source) {
 	return 0;
 }
 
+
+/*-----------------------------------------------------------------*/
+SourceCoverage::SourceCoverage(const std::string &key,
+							   const std::string &path,
+							   const std::vector<int> &hits)
+	: m_key(key), m_path(path), m_hits(hits) {
+}
+
+SourceCoverage::SourceCoverage() {
+}
+
+SourceCoverage::~SourceCoverage() {
+}
+
+void WriteLcov(std::ostream &stream, const SourceCoverageList &coverage) {
+	stream << "TN:" << std::endl;
+
+	for (SourceCoverageList::size_type i = 0; i < coverage.size(); ++i) {
+		const SourceCoverage &source = coverage[i];
+		const std::vector<int> &hits = source.GetHits();
+		int found = 0, hit = 0;
+
+		stream << "SF:" << source.GetPath() << std::endl;
+		for (std::vector<int>::size_type line = 0; line < hits.size(); ++line) {
+			if (hits[line] < 0) {
+				continue;
+			}
+
+			// The line of lcov starts from 1.
+			stream << "DA:" << (line + 1) << "," << hits[line] << std::endl;
+			++found;
+			if (hits[line] > 0) {
+				++hit;
+			}
+		}
+
+		stream << "LH:" << hit << std::endl;
+		stream << "LF:" << found << std::endl;
+		stream << "end_of_record" << std::endl;
+	}
+}
+
 } // end of namespace lldebug
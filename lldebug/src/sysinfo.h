@@ -125,6 +125,8 @@ private:
 	bool m_isRemote;
 };
 
+typedef std::vector<LogData> LogDataList;
+
 
 /**
  * @brief Break point object for the debugger.
@@ -160,6 +162,72 @@ public:
 		return m_isTemp;
 	}
 
+	/// Get the condition expression. (empty if none)
+	const std::string &GetCondition() const {
+		return m_condition;
+	}
+
+	/// Set the condition expression, it breaks only if this is true.
+	void SetCondition(const std::string &condition) {
+		m_condition = condition;
+	}
+
+	/// Does this have the condition ?
+	bool HasCondition() const {
+		return !m_condition.empty();
+	}
+
+	/// Get the hit count that it starts to break. (0 if none)
+	int GetHitCount() const {
+		return m_hitCount;
+	}
+
+	/// Set the hit count that it starts to break.
+	void SetHitCount(int hitCount) {
+		m_hitCount = hitCount;
+	}
+
+	/// Get N of 'break every N-th hit'. (0 if none)
+	int GetHitEvery() const {
+		return m_hitEvery;
+	}
+
+	/// Set N of 'break every N-th hit'.
+	void SetHitEvery(int hitEvery) {
+		m_hitEvery = hitEvery;
+	}
+
+	/// Does this have the hit count conditions ?
+	bool HasHitCondition() const {
+		return (m_hitCount > 0 || m_hitEvery > 0);
+	}
+
+	/// Get the message of the logpoint. (empty if this isn't a logpoint)
+	/** The '{expr}' parts are replaced by the values in the running function.
+	 */
+	const std::string &GetLogMessage() const {
+		return m_logMessage;
+	}
+
+	/// Set the message, this becomes the logpoint that doesn't stop.
+	void SetLogMessage(const std::string &logMessage) {
+		m_logMessage = logMessage;
+	}
+
+	/// Is this a logpoint ? (it outputs the message and keeps running)
+	bool IsLogpoint() const {
+		return !m_logMessage.empty();
+	}
+
+	/// Should it break at the 'hits'-th hit ?
+	bool IsBreakHit(int hits) const {
+		if (m_hitCount > 0 && hits < m_hitCount) {
+			return false;
+		}
+
+		return (m_hitEvery <= 0 || hits % m_hitEvery == 0);
+	}
+
 	friend bool operator <(const Breakpoint &x, const Breakpoint &y) {
 		return (
 			(x.GetKey() < y.GetKey()) ||
@@ -169,9 +237,21 @@ public:
 private:
 	friend class boost::serialization::access;
 	template<class Archive>
-	void serialize(Archive& ar, const unsigned int) {
+	void serialize(Archive& ar, const unsigned int version) {
 		ar & LLDEBUG_MEMBER_NVP(key);
 		ar & LLDEBUG_MEMBER_NVP(line);
+
+		// The conditions are added in version 1.
+		if (version >= 1) {
+			ar & LLDEBUG_MEMBER_NVP(condition);
+			ar & LLDEBUG_MEMBER_NVP(hitCount);
+			ar & LLDEBUG_MEMBER_NVP(hitEvery);
+		}
+
+		// The logpoint is added in version 2.
+		if (version >= 2) {
+			ar & LLDEBUG_MEMBER_NVP(logMessage);
+		}
 	}
 
 private:
@@ -179,8 +259,14 @@ private:
 	int m_line;
 	bool m_isInternal;
 	bool m_isTemp;
+	std::string m_condition;
+	int m_hitCount;
+	int m_hitEvery;
+	std::string m_logMessage;
 };
 
+class SourceManager;
+
 /**
  * @brief Break point list.
  */
@@ -189,9 +275,39 @@ public:
 	explicit BreakpointList(shared_ptr<RemoteEngine> engine);
 	virtual ~BreakpointList();
 
+	/// Is there no breakpoint ?
+	bool IsEmpty() const {
+		return m_set.empty();
+	}
+
 	/// Find the breakpoint from key and line.
 	Breakpoint Find(const std::string &key, int line);
 
+	/// Find the breakpoint from the source id and line.
+	/** It doesn't compare the keys, so it's used on the hot path.
+	 * The index must be updated by 'UpdateIndex' in advance.
+	 */
+	Breakpoint Find(int sourceId, int line) const;
+
+	/// Is there a breakpoint at the line of the source id ?
+	/** It's used on the hot path, so it only tests a bit.
+	 * The index must be updated by 'UpdateIndex' in advance.
+	 */
+	bool Exists(int sourceId, int line) const {
+		if (sourceId < 0 || (std::size_t)sourceId >= m_index.size()) {
+			return false;
+		}
+
+		const std::vector<bool> &bits = m_index[sourceId].bits;
+		return (line >= 0 && (std::size_t)line < bits.size() && bits[line]);
+	}
+
+	/// Is there any breakpoint between the lines [first, last] of the source id ?
+	bool Contains(int sourceId, int first, int last) const;
+
+	/// Rebuild the index of the breakpoints by the source id.
+	void UpdateIndex(SourceManager &sources);
+
 	/// Find the first breakpoint of the key.
 	Breakpoint First(const std::string &key);
 
@@ -207,11 +323,20 @@ public:
 	/// Toggle on/off of the breakpoint.
 	void Toggle(const std::string &key, int line);
 
+	/// Count up the hit of the breakpoint, and return the hit count.
+	int Hit(const Breakpoint &bp);
+
 private:
 	friend class boost::serialization::access;
 	template<class Archive>
 	void serialize(Archive& ar, const unsigned int) {
 		ar & LLDEBUG_MEMBER_NVP(set);
+
+		// The loaded breakpoints aren't indexed yet.
+		if (Archive::is_loading::value) {
+			m_index.clear();
+			m_hits.clear();
+		}
 	}
 
 private:
@@ -219,6 +344,19 @@ private:
 
 	typedef std::set<Breakpoint> ImplSet;
 	ImplSet m_set;
+
+	/// The line bitmap, the sorted lines and their breakpoints
+	/// of each source id.
+	struct LineIndex {
+		std::vector<bool> bits;
+		std::vector<int> lines;
+		std::vector<Breakpoint> breakpoints;
+	};
+	std::vector<LineIndex> m_index;
+
+	/// The hit counts, they're reset when the breakpoint is set.
+	typedef std::map<Breakpoint, int> HitMap;
+	HitMap m_hits;
 };
 
 /**
@@ -280,6 +418,64 @@ private:
 	string_array m_sources;
 };
 
+/**
+ * @brief The line coverage of a source.
+ *
+ * The hit counts are indexed by the line starting from 0,
+ * and -1 means that the line has no code.
+ */
+class SourceCoverage {
+public:
+	explicit SourceCoverage(const std::string &key,
+							const std::string &path,
+							const std::vector<int> &hits);
+	explicit SourceCoverage();
+	~SourceCoverage();
+
+	/// Get the source identifier.
+	const std::string &GetKey() const {
+		return m_key;
+	}
+
+	/// Get the path of the source, or the title if it's a string.
+	const std::string &GetPath() const {
+		return m_path;
+	}
+
+	/// Get the hit counts of the lines.
+	const std::vector<int> &GetHits() const {
+		return m_hits;
+	}
+
+	/// Get the hit count of the line, or -1 if it has no code.
+	int GetHit(int line) const {
+		if (line < 0 || (std::size_t)line >= m_hits.size()) {
+			return -1;
+		}
+
+		return m_hits[line];
+	}
+
+private:
+	friend class boost::serialization::access;
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int) {
+		ar & LLDEBUG_MEMBER_NVP(key);
+		ar & LLDEBUG_MEMBER_NVP(path);
+		ar & LLDEBUG_MEMBER_NVP(hits);
+	}
+
+private:
+	std::string m_key;
+	std::string m_path;
+	std::vector<int> m_hits;
+};
+
+typedef std::vector<SourceCoverage> SourceCoverageList;
+
+/// Write the coverage as the lcov tracefile (.info).
+void WriteLcov(std::ostream &stream, const SourceCoverageList &coverage);
+
 /**
  * @brief The manager of the source files displayed when debugging.
  */
@@ -297,6 +493,23 @@ public:
 	/// Get the string source
 	std::list<Source> GetList();
 
+	/// Get the interned id of the source, or -1 if it isn't registered.
+	int GetId(const std::string &key);
+
+	/// Intern the key without the source, and return its id.
+	/** The breakpoints of the source that can't be opened use it.
+	 */
+	int Intern(const std::string &key);
+
+	/// Is the source string of the id anchored in lua ?
+	bool IsAnchored(int id) const {
+		return (id >= 0 && (std::size_t)id < m_anchored.size()
+			&& m_anchored[id]);
+	}
+
+	/// The source string of the id is anchored in lua, it's kept alive.
+	void SetAnchored(int id);
+
 	/// Add a source.
 	int AddSource(const Source &source, bool sendRemote);
 
@@ -312,6 +525,10 @@ private:
 	typedef std::map<std::string, Source> ImplMap;
 	ImplMap m_sourceMap;
 	int m_textCounter;
+
+	typedef std::map<std::string, int> IdMap;
+	IdMap m_idMap;
+	std::vector<bool> m_anchored; ///< it's indexed by the id
 };
 
 
@@ -343,4 +560,6 @@ int ToPortNumber(const Ch *portStr) {
 
 } // end of namespace lldebug
 
+BOOST_CLASS_VERSION(lldebug::Breakpoint, 2)
+
 #endif
@@ -116,10 +116,21 @@ struct BacktraceView::UpdateHandler {
 	};
 
 void BacktraceView::BeginUpdating() {
+	// The backtrace may be sent with the break.
+	const LuaBreakSnapshot *snapshot = Mediator::Get()->GetBreakSnapshot();
+	if (snapshot != NULL && snapshot->HasBacktraces()) {
+		DoUpdate(snapshot->GetBacktraces());
+		return;
+	}
+
 	Mediator::Get()->GetEngine()->SendRequestBacktraceList(
 		UpdateHandler(this));
 }
 
+void BacktraceView::ShowBacktrace(const LuaBacktraceList &backtraces) {
+	DoUpdate(backtraces);
+}
+
 bool BacktraceView::IsSameContents(const LuaBacktraceList &backtraces) {
 	wxTreeItemIdList children = GetItemChildren(GetRootItem());
 
@@ -51,6 +51,9 @@ public:
 	virtual wxTreeItemIdList GetItemChildren(const wxTreeItemId &item);
 	virtual BacktraceViewItemData *GetItemData(const wxTreeItemId &item);
 
+	/// Show the backtrace of another coroutine, until it's updated.
+	void ShowBacktrace(const LuaBacktraceList &backtraces);
+
 private:
 	void CreateGUIControls();
 	void BeginUpdating();
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "precomp.h"
+#include "visual/mediator.h"
+#include "visual/coroutineview.h"
+#include "visual/backtraceview.h"
+#include "visual/strutils.h"
+
+namespace lldebug {
+namespace visual {
+
+/// The number of the rows that are requested at once.
+static const int COROUTINE_PAGE_SIZE = 100;
+
+enum {
+	COROUTINE_COLUMN_ID,
+	COROUTINE_COLUMN_STATUS,
+	COROUTINE_COLUMN_FUNCTION,
+	COROUTINE_COLUMN_LOCATION,
+	COROUTINE_COLUMN_CREATION,
+};
+
+BEGIN_EVENT_TABLE(CoroutineView, wxListCtrl)
+	EVT_SHOW(CoroutineView::OnShow)
+	EVT_LIST_ITEM_ACTIVATED(wxID_ANY, CoroutineView::OnItemActivated)
+	EVT_LIST_COL_CLICK(wxID_ANY, CoroutineView::OnColClick)
+	EVT_DEBUG_CHANGED_STATE(ID_COROUTINEVIEW, CoroutineView::OnChangedState)
+	EVT_DEBUG_END_DEBUG(ID_COROUTINEVIEW, CoroutineView::OnEndDebug)
+END_EVENT_TABLE()
+
+CoroutineView::CoroutineView(wxWindow *parent)
+	: wxListCtrl(parent, ID_COROUTINEVIEW
+		, wxDefaultPosition, wxDefaultSize
+		, wxLC_REPORT | wxLC_VIRTUAL | wxLC_SINGLE_SEL
+		| wxLC_HRULES | wxLC_VRULES)
+	, m_generation(0), m_sortColumn(COROUTINE_COLUMN_ID)
+	, m_isAscending(true) {
+	CreateGUIControls();
+}
+
+CoroutineView::~CoroutineView() {
+}
+
+void CoroutineView::CreateGUIControls() {
+	InsertColumn(COROUTINE_COLUMN_ID, _("Id"), wxLIST_FORMAT_RIGHT, 50);
+	InsertColumn(COROUTINE_COLUMN_STATUS, _("Status"), wxLIST_FORMAT_LEFT, 70);
+	InsertColumn(COROUTINE_COLUMN_FUNCTION, _("Function"), wxLIST_FORMAT_LEFT, 120);
+	InsertColumn(COROUTINE_COLUMN_LOCATION, _("Location"), wxLIST_FORMAT_LEFT, 120);
+	InsertColumn(COROUTINE_COLUMN_CREATION, _("Created at"), wxLIST_FORMAT_LEFT, 120);
+}
+
+struct CoroutineView::UpdateHandler {
+	CoroutineView *m_view;
+	int m_page;
+	int m_generation;
+
+	explicit UpdateHandler(CoroutineView *view, int page, int generation)
+		: m_view(view), m_page(page), m_generation(generation) {
+	}
+
+	int operator()(const lldebug::net::Command &/*command*/,
+				   const LuaCoroutineList &coroutines, int total) {
+		// The order was changed after it was requested.
+		if (m_generation != m_view->m_generation) {
+			return 0;
+		}
+
+		m_view->DoUpdate(m_page, coroutines, total);
+		return 0;
+	}
+};
+
+/**
+ * @brief Show the backtrace of the coroutine, and focus the top frame.
+ */
+struct CoroutineView::BacktraceHandler {
+	CoroutineView *m_view;
+
+	explicit BacktraceHandler(CoroutineView *view)
+		: m_view(view) {
+	}
+
+	int operator()(const lldebug::net::Command &/*command*/,
+				   const LuaBacktraceList &bts) {
+		// The coroutine was collected.
+		if (bts.empty()) {
+			m_view->BeginUpdating();
+			return 0;
+		}
+
+		BacktraceView *view = static_cast<BacktraceView *>(
+			wxWindow::FindWindowById(ID_BACKTRACEVIEW));
+		if (view != NULL) {
+			view->ShowBacktrace(bts);
+		}
+
+		// The locals are of the focused frame.
+		for (LuaBacktraceList::size_type i = 0; i < bts.size(); ++i) {
+			if (bts[i].GetLine() >= 0) {
+				Mediator::Get()->FocusBacktraceLine(bts[i]);
+				break;
+			}
+		}
+
+		return 0;
+	}
+};
+
+void CoroutineView::BeginUpdating() {
+	++m_generation;
+	m_pages.clear();
+	m_requestedPages.clear();
+
+	// The shown rows request their pages again.
+	RequestPage(0);
+	Refresh();
+}
+
+void CoroutineView::RequestPage(int page) {
+	if (m_requestedPages.find(page) != m_requestedPages.end()) {
+		return;
+	}
+
+	static const int sortKeys[] = {
+		COROUTINESORT_SERIAL, // COROUTINE_COLUMN_ID
+		COROUTINESORT_STATUS, // COROUTINE_COLUMN_STATUS
+		COROUTINESORT_FRAME, // COROUTINE_COLUMN_FUNCTION
+		COROUTINESORT_FRAME, // COROUTINE_COLUMN_LOCATION
+		COROUTINESORT_CREATION, // COROUTINE_COLUMN_CREATION
+	};
+
+	m_requestedPages.insert(page);
+	Mediator::Get()->GetEngine()->SendRequestCoroutineList(
+		page * COROUTINE_PAGE_SIZE, COROUTINE_PAGE_SIZE,
+		sortKeys[m_sortColumn], m_isAscending,
+		UpdateHandler(this, page, m_generation));
+}
+
+void CoroutineView::DoUpdate(int page, const LuaCoroutineList &coroutines,
+							 int total) {
+	m_pages[page] = coroutines;
+
+	if (GetItemCount() != total) {
+		SetItemCount(total);
+	}
+
+	long first = (long)page * COROUTINE_PAGE_SIZE;
+	long last = std::min(first + (long)coroutines.size(), (long)total) - 1;
+	if (first <= last) {
+		RefreshItems(first, last);
+	}
+}
+
+const LuaCoroutine *CoroutineView::GetCoroutine(long item) const {
+	PageMap::const_iterator it = m_pages.find(item / COROUTINE_PAGE_SIZE);
+	if (it == m_pages.end()) {
+		return NULL;
+	}
+
+	LuaCoroutineList::size_type index = item % COROUTINE_PAGE_SIZE;
+	return (index < it->second.size() ? &it->second[index] : NULL);
+}
+
+wxString CoroutineView::OnGetItemText(long item, long column) const {
+	const LuaCoroutine *co = GetCoroutine(item);
+	if (co == NULL) {
+		// The row is shown when the page is received.
+		const_cast<CoroutineView *>(this)->RequestPage(
+			item / COROUTINE_PAGE_SIZE);
+		return wxEmptyString;
+	}
+
+	switch (column) {
+	case COROUTINE_COLUMN_ID:
+		return (co->GetSerial() == 0
+			? wxString(wxT("main"))
+			: wxString::Format(wxT("%lu"), co->GetSerial()));
+	case COROUTINE_COLUMN_STATUS:
+		return wxConvFromCtxEnc(co->GetStatus());
+	case COROUTINE_COLUMN_FUNCTION:
+		return wxConvFromCtxEnc(co->GetFuncName());
+	case COROUTINE_COLUMN_LOCATION:
+		if (co->GetLine() < 0) {
+			return wxEmptyString;
+		}
+		return wxString::Format(wxT("%s:%d"),
+			wxConvFromCtxEnc(co->GetTitle()).c_str(), co->GetLine());
+	case COROUTINE_COLUMN_CREATION:
+		if (co->GetCreationLine() < 0) {
+			return wxEmptyString;
+		}
+		return wxString::Format(wxT("%s:%d"),
+			wxConvFromCtxEnc(co->GetCreationTitle()).c_str(),
+			co->GetCreationLine());
+	}
+
+	return wxEmptyString;
+}
+
+void CoroutineView::OnColClick(wxListEvent &event) {
+	event.Skip();
+
+	// Clicking the same column reverses the order.
+	if (event.GetColumn() == m_sortColumn) {
+		m_isAscending = !m_isAscending;
+	}
+	else if (event.GetColumn() >= 0) {
+		m_sortColumn = event.GetColumn();
+		m_isAscending = true;
+	}
+
+	BeginUpdating();
+}
+
+void CoroutineView::OnItemActivated(wxListEvent &event) {
+	event.Skip();
+
+	const LuaCoroutine *co = GetCoroutine(event.GetIndex());
+	if (co == NULL) {
+		return;
+	}
+
+	Mediator::Get()->GetEngine()->SendRequestCoroutineBacktrace(
+		co->GetLua(), BacktraceHandler(this));
+}
+
+void CoroutineView::OnChangedState(wxDebugEvent &event) {
+	event.Skip();
+
+	if (event.IsBreak() && IsShown()) {
+		BeginUpdating();
+	}
+}
+
+void CoroutineView::OnEndDebug(wxDebugEvent &event) {
+	event.Skip();
+
+	++m_generation;
+	m_pages.clear();
+	m_requestedPages.clear();
+	SetItemCount(0);
+	Refresh();
+}
+
+void CoroutineView::OnShow(wxShowEvent &event) {
+	event.Skip();
+
+	if (event.GetShow() && IsShown()) {
+		BeginUpdating();
+	}
+}
+
+} // end of namespace visual
+} // end of namespace lldebug
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __LLDEBUG_COROUTINEVIEW_H__
+#define __LLDEBUG_COROUTINEVIEW_H__
+
+#include "luainfo.h"
+#include "visual/event.h"
+
+#include <wx/listctrl.h>
+
+namespace lldebug {
+namespace visual {
+
+/**
+ * @brief The list of the live coroutines.
+ *
+ * It's a virtual list, the rows are requested page by page when they're
+ * shown, and the context sorts them. Activating a row shows its backtrace
+ * and focuses its top frame.
+ */
+class CoroutineView : public wxListCtrl {
+public:
+	explicit CoroutineView(wxWindow *parent);
+	virtual ~CoroutineView();
+
+	/// Drop the pages, and request the first one again.
+	void BeginUpdating();
+
+protected:
+	virtual wxString OnGetItemText(long item, long column) const;
+
+private:
+	void CreateGUIControls();
+	void RequestPage(int page);
+	void DoUpdate(int page, const LuaCoroutineList &coroutines, int total);
+	const LuaCoroutine *GetCoroutine(long item) const;
+
+	struct UpdateHandler;
+	friend struct UpdateHandler;
+	struct BacktraceHandler;
+
+private:
+	void OnEndDebug(wxDebugEvent &event);
+	void OnChangedState(wxDebugEvent &event);
+	void OnItemActivated(wxListEvent &event);
+	void OnColClick(wxListEvent &event);
+	void OnShow(wxShowEvent &event);
+
+private:
+	typedef std::map<int, LuaCoroutineList> PageMap;
+	PageMap m_pages;
+	std::set<int> m_requestedPages;
+	int m_generation; ///< the responses of older generations are ignored
+	int m_sortColumn;
+	bool m_isAscending;
+
+	DECLARE_EVENT_TABLE();
+};
+
+} // end of namespace visual
+} // end of namespace lldebug
+
+#endif
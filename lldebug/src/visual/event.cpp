@@ -39,6 +39,9 @@ DEFINE_EVENT_TYPE(wxEVT_DEBUG_OUTPUT_LOG)
 DEFINE_EVENT_TYPE(wxEVT_DEBUG_OUTPUT_INTERACTIVEVIEW)
 DEFINE_EVENT_TYPE(wxEVT_DEBUG_FOCUS_ERRORLINE)
 DEFINE_EVENT_TYPE(wxEVT_DEBUG_FOCUS_BACKTRACELINE)
+DEFINE_EVENT_TYPE(wxEVT_DEBUG_CHANGED_COVERAGE)
+DEFINE_EVENT_TYPE(wxEVT_DEBUG_CHANGED_GCSTATS)
+DEFINE_EVENT_TYPE(wxEVT_DEBUG_CHANGED_THREADS)
 
 } // end of namespace visual
 } // end of namespace lldebug
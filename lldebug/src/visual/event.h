@@ -48,6 +48,10 @@ enum {
 	ID_STACKWATCHVIEW,
 	ID_WATCHVIEW,
 	ID_BACKTRACEVIEW,
+	ID_PROFILEVIEW,
+	ID_GCVIEW,
+	ID_COROUTINEVIEW,
+	ID_THREADVIEW,
 };
 
 BEGIN_DECLARE_EVENT_TYPES()
@@ -59,16 +63,23 @@ DECLARE_EVENT_TYPE(wxEVT_DEBUG_CHANGED_BREAKPOINTS, 2655)
 DECLARE_EVENT_TYPE(wxEVT_DEBUG_OUTPUT_LOG, 2656)
 DECLARE_EVENT_TYPE(wxEVT_DEBUG_FOCUS_ERRORLINE, 2658)
 DECLARE_EVENT_TYPE(wxEVT_DEBUG_FOCUS_BACKTRACELINE, 2659)
+DECLARE_EVENT_TYPE(wxEVT_DEBUG_CHANGED_COVERAGE, 2660)
+DECLARE_EVENT_TYPE(wxEVT_DEBUG_CHANGED_GCSTATS, 2661)
+DECLARE_EVENT_TYPE(wxEVT_DEBUG_CHANGED_THREADS, 2662)
 END_DECLARE_EVENT_TYPES()
 
 class wxDebugEvent : public wxEvent {
 public:
-	/// EndDebug, ChangedBreakpointList event
+	/// EndDebug, ChangedBreakpointList, ChangedCoverage, ChangedGcStats,
+	/// ChangedThreads event
 	explicit wxDebugEvent(wxEventType type, int winid)
 		: wxEvent(winid, type) {
 		wxASSERT(
 			type == wxEVT_DEBUG_END_DEBUG ||
-			type == wxEVT_DEBUG_CHANGED_BREAKPOINTS);
+			type == wxEVT_DEBUG_CHANGED_BREAKPOINTS ||
+			type == wxEVT_DEBUG_CHANGED_COVERAGE ||
+			type == wxEVT_DEBUG_CHANGED_GCSTATS ||
+			type == wxEVT_DEBUG_CHANGED_THREADS);
 	}
 
 	/// ChangedState event
@@ -185,6 +196,9 @@ typedef void (wxEvtHandler::*wxDebugEventFunction)(wxDebugEvent &);
 #define EVT_DEBUG_OUTPUT_LOG(id, fn)          DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_OUTPUT_LOG,          id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)(wxDebugEventFunction)(&fn), (wxObject *)NULL),
 #define EVT_DEBUG_FOCUS_ERRORLINE(id, fn)     DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_FOCUS_ERRORLINE,     id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)(wxDebugEventFunction)(&fn), (wxObject *)NULL),
 #define EVT_DEBUG_FOCUS_BACKTRACELINE(id, fn) DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_FOCUS_BACKTRACELINE, id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)(wxDebugEventFunction)(&fn), (wxObject *)NULL),
+#define EVT_DEBUG_CHANGED_COVERAGE(id, fn)    DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_CHANGED_COVERAGE,    id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)(wxDebugEventFunction)(&fn), (wxObject *)NULL),
+#define EVT_DEBUG_CHANGED_GCSTATS(id, fn)     DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_CHANGED_GCSTATS,     id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)(wxDebugEventFunction)(&fn), (wxObject *)NULL),
+#define EVT_DEBUG_CHANGED_THREADS(id, fn)     DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_CHANGED_THREADS,     id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)(wxDebugEventFunction)(&fn), (wxObject *)NULL),
 #else
 #define EVT_DEBUG_END_DEBUG(id, fn)           DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_END_DEBUG,           id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)wxStaticCastEvent(wxDebugEventFunction, &fn), (wxObject *)NULL),
 #define EVT_DEBUG_CHANGED_STATE(id, fn)       DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_CHANGED_STATE,       id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)wxStaticCastEvent(wxDebugEventFunction, &fn), (wxObject *)NULL),
@@ -194,6 +208,9 @@ typedef void (wxEvtHandler::*wxDebugEventFunction)(wxDebugEvent &);
 #define EVT_DEBUG_OUTPUT_LOG(id, fn)          DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_OUTPUT_LOG,          id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)wxStaticCastEvent(wxDebugEventFunction, &fn), (wxObject *)NULL),
 #define EVT_DEBUG_FOCUS_ERRORLINE(id, fn)     DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_FOCUS_ERRORLINE,     id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)wxStaticCastEvent(wxDebugEventFunction, &fn), (wxObject *)NULL),
 #define EVT_DEBUG_FOCUS_BACKTRACELINE(id, fn) DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_FOCUS_BACKTRACELINE, id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)wxStaticCastEvent(wxDebugEventFunction, &fn), (wxObject *)NULL),
+#define EVT_DEBUG_CHANGED_COVERAGE(id, fn)    DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_CHANGED_COVERAGE,    id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)wxStaticCastEvent(wxDebugEventFunction, &fn), (wxObject *)NULL),
+#define EVT_DEBUG_CHANGED_GCSTATS(id, fn)     DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_CHANGED_GCSTATS,     id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)wxStaticCastEvent(wxDebugEventFunction, &fn), (wxObject *)NULL),
+#define EVT_DEBUG_CHANGED_THREADS(id, fn)     DECLARE_EVENT_TABLE_ENTRY(wxEVT_DEBUG_CHANGED_THREADS,     id, wxID_ANY, (wxObjectEventFunction)(wxEventFunction)wxStaticCastEvent(wxDebugEventFunction, &fn), (wxObject *)NULL),
 #endif
 
 } // end of namespace visual
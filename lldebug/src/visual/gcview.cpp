@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "precomp.h"
+#include "visual/mediator.h"
+#include "visual/gcview.h"
+
+#include <wx/dcbuffer.h>
+
+namespace lldebug {
+namespace visual {
+
+/// The margin around the chart. (pixel)
+static const int GCVIEW_MARGIN = 4;
+
+BEGIN_EVENT_TABLE(GcView, wxWindow)
+	EVT_PAINT(GcView::OnPaint)
+	EVT_SIZE(GcView::OnSize)
+	EVT_DEBUG_CHANGED_GCSTATS(ID_GCVIEW, GcView::OnChangedGcStats)
+END_EVENT_TABLE()
+
+GcView::GcView(wxWindow *parent)
+	: wxWindow(parent, ID_GCVIEW
+		, wxDefaultPosition, wxDefaultSize
+		, wxFULL_REPAINT_ON_RESIZE) {
+	SetBackgroundStyle(wxBG_STYLE_CUSTOM);
+}
+
+GcView::~GcView() {
+}
+
+void GcView::OnPaint(wxPaintEvent &/*event*/) {
+	wxBufferedPaintDC dc(this);
+	wxSize size = GetClientSize();
+
+	dc.SetBackground(*wxWHITE_BRUSH);
+	dc.Clear();
+
+	const LuaGcSampleList &samples = Mediator::Get()->GetGcSamples();
+	int width = size.GetWidth() - GCVIEW_MARGIN * 2;
+	int height = size.GetHeight() - GCVIEW_MARGIN * 2;
+	if (samples.empty() || width <= 0 || height <= 0) {
+		return;
+	}
+
+	// The latest samples that fit in the width.
+	LuaGcSampleList::size_type first =
+		(samples.size() > (LuaGcSampleList::size_type)width
+			? samples.size() - width : 0);
+
+	double maxKBytes = 1.0;
+	for (LuaGcSampleList::size_type i = first; i < samples.size(); ++i) {
+		maxKBytes = std::max(maxKBytes, samples[i].GetPeakKBytes());
+	}
+
+	// The points of the size and the peak.
+	std::vector<wxPoint> points, peaks;
+	for (LuaGcSampleList::size_type i = first; i < samples.size(); ++i) {
+		const LuaGcSample &sample = samples[i];
+		int x = GCVIEW_MARGIN + (int)(i - first);
+		int bottom = GCVIEW_MARGIN + height;
+
+		points.push_back(wxPoint(x,
+			bottom - (int)(sample.GetKBytes() / maxKBytes * height)));
+		peaks.push_back(wxPoint(x,
+			bottom - (int)(sample.GetPeakKBytes() / maxKBytes * height)));
+	}
+
+	if (points.size() >= 2) {
+		dc.SetPen(*wxRED_PEN);
+		dc.DrawLines((int)peaks.size(), &peaks[0]);
+		dc.SetPen(wxPen(*wxBLUE, 1, wxSOLID));
+		dc.DrawLines((int)points.size(), &points[0]);
+	}
+
+	// The current and the max size.
+	const LuaGcSample &last = samples.back();
+	dc.SetTextForeground(*wxBLACK);
+	dc.DrawText(
+		wxString::Format(_("%.1f KB (max %.1f KB) at %.1f sec"),
+			last.GetKBytes(), maxKBytes, last.GetTime()),
+		GCVIEW_MARGIN, GCVIEW_MARGIN);
+}
+
+void GcView::OnSize(wxSizeEvent &event) {
+	event.Skip();
+	Refresh(false);
+}
+
+void GcView::OnChangedGcStats(wxDebugEvent &event) {
+	event.Skip();
+
+	if (IsShown()) {
+		Refresh(false);
+	}
+}
+
+} // end of namespace visual
+} // end of namespace lldebug
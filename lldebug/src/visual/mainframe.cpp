@@ -25,6 +25,8 @@
  */
 
 #include "precomp.h"
+#include "configfile.h"
+#include "heapsnapshot.h"
 #include "visual/mediator.h"
 #include "visual/mainframe.h"
 #include "visual/sourceview.h"
@@ -32,6 +34,14 @@
 #include "visual/interactiveview.h"
 #include "visual/watchview.h"
 #include "visual/backtraceview.h"
+#include "visual/profileview.h"
+#include "visual/gcview.h"
+#include "visual/coroutineview.h"
+#include "visual/threadview.h"
+#include "visual/strutils.h"
+
+#include <wx/numdlg.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 namespace lldebug {
 namespace visual {
@@ -43,6 +53,28 @@ enum {
 	ID_MENU_STEPINTO,
 	ID_MENU_STEPRETURN,
 	ID_MENU_TOGGLE_BREAKPOINT,
+	ID_MENU_EDIT_BREAKPOINT,
+	ID_MENU_EDIT_LOGPOINT,
+	ID_MENU_START_PROFILE,
+	ID_MENU_STOP_PROFILE,
+	ID_MENU_START_FUNCPROFILE,
+	ID_MENU_STOP_FUNCPROFILE,
+	ID_MENU_START_COVERAGE,
+	ID_MENU_START_COVERAGE_FIRSTHIT,
+	ID_MENU_STOP_COVERAGE,
+	ID_MENU_START_ALLOCPROFILE,
+	ID_MENU_STOP_ALLOCPROFILE,
+	ID_MENU_START_SCHEDPROFILE,
+	ID_MENU_STOP_SCHEDPROFILE,
+	ID_MENU_START_TRACE,
+	ID_MENU_STOP_TRACE,
+	ID_MENU_SAVE_HEAPSNAPSHOT,
+	ID_MENU_COMPARE_HEAPSNAPSHOTS,
+	ID_MENU_START_GCMONITOR,
+	ID_MENU_STOP_GCMONITOR,
+	ID_MENU_SET_GCTHRESHOLD,
+	ID_MENU_SET_DEBUGFILTER,
+	ID_MENU_MEASURE_LATENCY,
 
 	ID_MENU_SHOW_LOCALWATCH,
 	ID_MENU_SHOW_GLOBALWATCH,
@@ -51,6 +83,10 @@ enum {
 	ID_MENU_SHOW_WATCH,
 	ID_MENU_SHOW_STACKWATCH,
 	ID_MENU_SHOW_BACKTRACEVIEW,
+	ID_MENU_SHOW_PROFILEVIEW,
+	ID_MENU_SHOW_GCVIEW,
+	ID_MENU_SHOW_COROUTINEVIEW,
+	ID_MENU_SHOW_THREADVIEW,
 	ID_MENU_SHOW_INTERACTIVEVIEW,
 };
 
@@ -65,6 +101,28 @@ BEGIN_EVENT_TABLE(MainFrame, wxFrame)
 	EVT_MENU(ID_MENU_STEPINTO, MainFrame::OnMenu)
 	EVT_MENU(ID_MENU_STEPRETURN, MainFrame::OnMenu)
 	EVT_MENU(ID_MENU_TOGGLE_BREAKPOINT, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_EDIT_BREAKPOINT, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_EDIT_LOGPOINT, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_START_PROFILE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_STOP_PROFILE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_START_FUNCPROFILE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_STOP_FUNCPROFILE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_START_COVERAGE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_START_COVERAGE_FIRSTHIT, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_STOP_COVERAGE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_START_ALLOCPROFILE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_STOP_ALLOCPROFILE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_START_SCHEDPROFILE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_STOP_SCHEDPROFILE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_START_TRACE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_STOP_TRACE, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_SAVE_HEAPSNAPSHOT, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_COMPARE_HEAPSNAPSHOTS, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_START_GCMONITOR, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_STOP_GCMONITOR, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_SET_GCTHRESHOLD, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_SET_DEBUGFILTER, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_MEASURE_LATENCY, MainFrame::OnMenu)
 
 	EVT_MENU(ID_MENU_SHOW_LOCALWATCH, MainFrame::OnMenu)
 	EVT_MENU(ID_MENU_SHOW_GLOBALWATCH, MainFrame::OnMenu)
@@ -73,6 +131,10 @@ BEGIN_EVENT_TABLE(MainFrame, wxFrame)
 	EVT_MENU(ID_MENU_SHOW_WATCH, MainFrame::OnMenu)
 	EVT_MENU(ID_MENU_SHOW_STACKWATCH, MainFrame::OnMenu)
 	EVT_MENU(ID_MENU_SHOW_BACKTRACEVIEW, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_SHOW_PROFILEVIEW, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_SHOW_GCVIEW, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_SHOW_COROUTINEVIEW, MainFrame::OnMenu)
+	EVT_MENU(ID_MENU_SHOW_THREADVIEW, MainFrame::OnMenu)
 	EVT_MENU(ID_MENU_SHOW_INTERACTIVEVIEW, MainFrame::OnMenu)
 END_EVENT_TABLE()
 
@@ -128,6 +190,10 @@ void MainFrame::CreateGUIControls() {
 	viewMenu->Append(ID_MENU_SHOW_WATCH, _("&Watch"));
 	viewMenu->Append(ID_MENU_SHOW_STACKWATCH, _("&StackWatch"));
 	viewMenu->Append(ID_MENU_SHOW_BACKTRACEVIEW, _("&BacktraceView"));
+	viewMenu->Append(ID_MENU_SHOW_PROFILEVIEW, _("&ProfileView"));
+	viewMenu->Append(ID_MENU_SHOW_GCVIEW, _("&GcView"));
+	viewMenu->Append(ID_MENU_SHOW_COROUTINEVIEW, _("&CoroutineView"));
+	viewMenu->Append(ID_MENU_SHOW_THREADVIEW, _("&ThreadView"));
 	viewMenu->Append(ID_MENU_SHOW_INTERACTIVEVIEW, _("&InteractiveView"));
 	
 	wxMenu *debugMenu = new wxMenu;
@@ -139,6 +205,29 @@ void MainFrame::CreateGUIControls() {
 	debugMenu->Append(ID_MENU_STEPRETURN, _("Step Return\tF8"));
 	debugMenu->AppendSeparator();
 	debugMenu->Append(ID_MENU_TOGGLE_BREAKPOINT, _("&Toggle Breakpoint\tF9"));
+	debugMenu->Append(ID_MENU_EDIT_BREAKPOINT, _("Breakpoint &Condition...\tCtrl+F9"));
+	debugMenu->Append(ID_MENU_EDIT_LOGPOINT, _("&Logpoint...\tShift+F9"));
+	debugMenu->AppendSeparator();
+	debugMenu->Append(ID_MENU_START_PROFILE, _("Start &Profiling"));
+	debugMenu->Append(ID_MENU_STOP_PROFILE, _("Stop Profiling..."));
+	debugMenu->Append(ID_MENU_START_FUNCPROFILE, _("Start &Function Profiling"));
+	debugMenu->Append(ID_MENU_STOP_FUNCPROFILE, _("Stop Function Profiling"));
+	debugMenu->Append(ID_MENU_START_COVERAGE, _("Start &Coverage"));
+	debugMenu->Append(ID_MENU_START_COVERAGE_FIRSTHIT, _("Start Coverage (First Hit Only)"));
+	debugMenu->Append(ID_MENU_STOP_COVERAGE, _("Stop Coverage..."));
+	debugMenu->Append(ID_MENU_START_ALLOCPROFILE, _("Start &Allocation Profiling"));
+	debugMenu->Append(ID_MENU_STOP_ALLOCPROFILE, _("Stop Allocation Profiling..."));
+	debugMenu->Append(ID_MENU_START_SCHEDPROFILE, _("Start &Scheduler Profiling"));
+	debugMenu->Append(ID_MENU_STOP_SCHEDPROFILE, _("Stop Scheduler Profiling..."));
+	debugMenu->Append(ID_MENU_START_TRACE, _("Start &Tracing..."));
+	debugMenu->Append(ID_MENU_STOP_TRACE, _("Stop Tracing..."));
+	debugMenu->Append(ID_MENU_SAVE_HEAPSNAPSHOT, _("Save &Heap Snapshot..."));
+	debugMenu->Append(ID_MENU_COMPARE_HEAPSNAPSHOTS, _("Compare Heap Snapshots..."));
+	debugMenu->Append(ID_MENU_START_GCMONITOR, _("Start &GC Monitor"));
+	debugMenu->Append(ID_MENU_STOP_GCMONITOR, _("Stop GC Monitor..."));
+	debugMenu->Append(ID_MENU_SET_GCTHRESHOLD, _("Break on Heap Size..."));
+	debugMenu->Append(ID_MENU_SET_DEBUGFILTER, _("Debug &Filter..."));
+	debugMenu->Append(ID_MENU_MEASURE_LATENCY, _("Measure &Latency"));
 
 	wxMenuBar *menuBar = new wxMenuBar(wxMB_DOCKABLE);
 	menuBar->Append(fileMenu, _("&File"));
@@ -265,6 +354,26 @@ void MainFrame::ShowDebugWindow(int wintypeid) {
 			new BacktraceView(this),
 			_("Backtrace"));
 		break;
+	case ID_PROFILEVIEW:
+		auiNotebook->AddPage(
+			new ProfileView(this),
+			_("Profile"));
+		break;
+	case ID_GCVIEW:
+		auiNotebook->AddPage(
+			new GcView(this),
+			_("GC"));
+		break;
+	case ID_COROUTINEVIEW:
+		auiNotebook->AddPage(
+			new CoroutineView(this),
+			_("Coroutines"));
+		break;
+	case ID_THREADVIEW:
+		auiNotebook->AddPage(
+			new ThreadView(this),
+			_("Threads"));
+		break;
 	default:
 		return;
 	}
@@ -275,6 +384,237 @@ void MainFrame::ShowDebugWindow(int wintypeid) {
 	}
 }
 
+/// The sampling interval of the profiler. (msec)
+static const int PROFILE_INTERVAL = 10;
+
+/// The sampling interval of the GC monitor. (msec)
+static const int GCMONITOR_INTERVAL = 100;
+
+/// The number of the calls kept by each OS thread of the call tracer.
+static const int TRACE_BUFFER_SIZE = 65536;
+
+/// The number of the pings sent by the latency measurement.
+static const int PING_COUNT = 100;
+
+/**
+ * @brief Save the folded stacks of the profiler.
+ */
+struct ProfileSaveHandler {
+	std::string m_filename;
+
+	explicit ProfileSaveHandler(const std::string &filename)
+		: m_filename(filename) {
+	}
+
+	int operator()(const lldebug::net::Command &/*command*/,
+				   const std::string &stacks) {
+		// The result is discarded when the dialog was canceled.
+		if (m_filename.empty()) {
+			return 0;
+		}
+
+		safe_ofstream ofs;
+		if (!ofs.open(m_filename, std::ios::out | std::ios::binary)) {
+			return -1;
+		}
+
+		ofs.stream() << stacks;
+		ofs.commit();
+		return 0;
+	}
+};
+
+/**
+ * @brief Show the line coverage and save it as the lcov tracefile.
+ */
+struct CoverageSaveHandler {
+	std::string m_filename;
+
+	explicit CoverageSaveHandler(const std::string &filename)
+		: m_filename(filename) {
+	}
+
+	int operator()(const lldebug::net::Command &/*command*/,
+				   const SourceCoverageList &coverages) {
+		Mediator::Get()->SetCoverage(coverages);
+
+		// The result is only shown when the dialog was canceled.
+		if (m_filename.empty()) {
+			return 0;
+		}
+
+		safe_ofstream ofs;
+		if (!ofs.open(m_filename, std::ios::out)) {
+			return -1;
+		}
+
+		WriteLcov(ofs.stream(), coverages);
+		ofs.commit();
+		return 0;
+	}
+};
+
+/**
+ * @brief Save the report of the allocation profiler.
+ */
+struct AllocProfileSaveHandler {
+	std::string m_filename;
+
+	explicit AllocProfileSaveHandler(const std::string &filename)
+		: m_filename(filename) {
+	}
+
+	int operator()(const lldebug::net::Command &/*command*/,
+				   const LuaAllocProfileList &profiles) {
+		// The result is discarded when the dialog was canceled.
+		if (m_filename.empty()) {
+			return 0;
+		}
+
+		safe_ofstream ofs;
+		if (!ofs.open(m_filename, std::ios::out)) {
+			return -1;
+		}
+
+		WriteAllocProfile(ofs.stream(), profiles);
+		ofs.commit();
+		return 0;
+	}
+};
+
+/**
+ * @brief Save the report of the scheduler profiler.
+ */
+struct SchedProfileSaveHandler {
+	std::string m_filename;
+
+	explicit SchedProfileSaveHandler(const std::string &filename)
+		: m_filename(filename) {
+	}
+
+	int operator()(const lldebug::net::Command &/*command*/,
+				   const LuaSchedProfileList &profiles) {
+		// The result is discarded when the dialog was canceled.
+		if (m_filename.empty()) {
+			return 0;
+		}
+
+		safe_ofstream ofs;
+		if (!ofs.open(m_filename, std::ios::out)) {
+			return -1;
+		}
+
+		WriteSchedProfile(ofs.stream(), profiles, m_filename);
+		ofs.commit();
+		return 0;
+	}
+};
+
+/**
+ * @brief Measure the round trip time of the connection.
+ *
+ * The pings are sent one by one, and the next one is sent
+ * when the previous response is received.
+ */
+struct PingBenchmark {
+	struct State {
+		int remaining;
+		boost::posix_time::ptime sentTime;
+		std::vector<double> samples; ///< msec
+	};
+	shared_ptr<State> m_state;
+
+	explicit PingBenchmark(int count)
+		: m_state(new State) {
+		m_state->remaining = count;
+		m_state->samples.reserve(count);
+	}
+
+	/// Send the next ping.
+	void Send() {
+		--m_state->remaining;
+		m_state->sentTime = boost::posix_time::microsec_clock::universal_time();
+		Mediator::Get()->GetEngine()->SendPing(*this);
+	}
+
+	int operator()(const lldebug::net::Command &/*command*/) {
+		boost::posix_time::time_duration elapsed =
+			boost::posix_time::microsec_clock::universal_time()
+			- m_state->sentTime;
+		m_state->samples.push_back(elapsed.total_microseconds() / 1000.0);
+
+		if (m_state->remaining > 0) {
+			Send();
+		}
+		else {
+			Report();
+		}
+		return 0;
+	}
+
+	/// Output the min/avg/max of the samples.
+	void Report() {
+		const std::vector<double> &samples = m_state->samples;
+		double minValue = samples.front(), maxValue = samples.front();
+		double sum = 0.0;
+		for (std::size_t i = 0; i < samples.size(); ++i) {
+			minValue = std::min(minValue, samples[i]);
+			maxValue = std::max(maxValue, samples[i]);
+			sum += samples[i];
+		}
+
+		Mediator::Get()->OutputLog(LOGTYPE_MESSAGE, wxString::Format(
+			_("Ping: %d samples, min %.3f ms, avg %.3f ms, max %.3f ms"),
+			(int)samples.size(), minValue, sum / samples.size(), maxValue));
+	}
+};
+
+/// Read the heap snapshot selected by the user.
+static bool SelectHeapSnapshot(wxWindow *parent, const wxString &message,
+							   HeapSnapshot &snapshot) {
+	wxString filename = wxFileSelector(
+		message, wxEmptyString, wxEmptyString, wxT("heap"),
+		wxT("*.heap"), wxFD_OPEN | wxFD_FILE_MUST_EXIST, parent);
+	if (filename.IsEmpty()) {
+		return false;
+	}
+
+	std::ifstream ifs(wxConvToCurrent(filename).c_str(),
+		std::ios::in | std::ios::binary);
+	if (!ifs.is_open() || snapshot.Read(ifs) != 0) {
+		wxMessageBox(_("Couldn't read the heap snapshot."),
+			_("Error"), wxOK | wxICON_ERROR, parent);
+		return false;
+	}
+
+	return true;
+}
+
+/// Write the objects retained between two heap snapshots.
+static void CompareHeapSnapshots(wxWindow *parent) {
+	HeapSnapshot before, after;
+	if (!SelectHeapSnapshot(parent, _("Select the older heap snapshot"), before)
+		|| !SelectHeapSnapshot(parent, _("Select the newer heap snapshot"), after)) {
+		return;
+	}
+
+	wxString filename = wxFileSelector(
+		_("Save the retained objects"), wxEmptyString,
+		wxT("heapdiff.tsv"), wxT("tsv"),
+		wxT("*.tsv"), wxFD_SAVE | wxFD_OVERWRITE_PROMPT, parent);
+	if (filename.IsEmpty()) {
+		return;
+	}
+
+	safe_ofstream ofs;
+	if (!ofs.open(wxConvToCurrent(filename), std::ios::out)) {
+		return;
+	}
+
+	WriteHeapDiff(ofs.stream(), before, after);
+	ofs.commit();
+}
+
 void MainFrame::OnMenu(wxCommandEvent &event) {
 	switch (event.GetId()) {
 	case wxID_EXIT:
@@ -298,6 +638,189 @@ void MainFrame::OnMenu(wxCommandEvent &event) {
 	case ID_MENU_TOGGLE_BREAKPOINT:
 		m_sourceView->ToggleBreakpoint();
 		break;
+	case ID_MENU_EDIT_BREAKPOINT:
+		m_sourceView->EditBreakpoint();
+		break;
+	case ID_MENU_EDIT_LOGPOINT:
+		m_sourceView->EditLogpoint();
+		break;
+	case ID_MENU_START_PROFILE:
+		Mediator::Get()->GetEngine()->SendStartProfile(PROFILE_INTERVAL);
+		break;
+	case ID_MENU_STOP_PROFILE:
+		{
+			wxString filename = wxFileSelector(
+				_("Save the folded stacks"), wxEmptyString,
+				wxT("profile.folded"), wxT("folded"),
+				wxT("*.folded"), wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+			Mediator::Get()->GetEngine()->SendStopProfile(
+				ProfileSaveHandler(wxConvToCurrent(filename)));
+		}
+		break;
+	case ID_MENU_START_FUNCPROFILE:
+		Mediator::Get()->GetEngine()->SendStartFuncProfile();
+		break;
+	case ID_MENU_STOP_FUNCPROFILE:
+		{
+			Mediator::Get()->GetEngine()->SendStopFuncProfile();
+
+			// Show the report.
+			ShowDebugWindow(ID_PROFILEVIEW);
+			ProfileView *view = static_cast<ProfileView *>(
+				FindWindowById(ID_PROFILEVIEW));
+			if (view != NULL) {
+				view->BeginUpdating();
+			}
+		}
+		break;
+	case ID_MENU_START_COVERAGE:
+		Mediator::Get()->GetEngine()->SendStartCoverage(false);
+		break;
+	case ID_MENU_START_COVERAGE_FIRSTHIT:
+		Mediator::Get()->GetEngine()->SendStartCoverage(true);
+		break;
+	case ID_MENU_STOP_COVERAGE:
+		{
+			wxString filename = wxFileSelector(
+				_("Save the lcov tracefile"), wxEmptyString,
+				wxT("coverage.info"), wxT("info"),
+				wxT("*.info"), wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+			Mediator::Get()->GetEngine()->SendStopCoverage(
+				CoverageSaveHandler(wxConvToCurrent(filename)));
+		}
+		break;
+	case ID_MENU_START_ALLOCPROFILE:
+		Mediator::Get()->GetEngine()->SendStartAllocProfile();
+		break;
+	case ID_MENU_STOP_ALLOCPROFILE:
+		{
+			wxString filename = wxFileSelector(
+				_("Save the allocation report"), wxEmptyString,
+				wxT("alloc.tsv"), wxT("tsv"),
+				wxT("*.tsv"), wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+			Mediator::Get()->GetEngine()->SendStopAllocProfile(
+				AllocProfileSaveHandler(wxConvToCurrent(filename)));
+		}
+		break;
+	case ID_MENU_START_SCHEDPROFILE:
+		Mediator::Get()->GetEngine()->SendStartSchedProfile();
+		break;
+	case ID_MENU_STOP_SCHEDPROFILE:
+		{
+			// The report is written in json if the name ends with '.json'.
+			wxString filename = wxFileSelector(
+				_("Save the scheduler report"), wxEmptyString,
+				wxT("sched.csv"), wxT("csv"),
+				wxT("CSV files (*.csv)|*.csv|JSON files (*.json)|*.json"),
+				wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+			Mediator::Get()->GetEngine()->SendStopSchedProfile(
+				SchedProfileSaveHandler(wxConvToCurrent(filename)));
+		}
+		break;
+	case ID_MENU_START_TRACE:
+		{
+			// The empty prefix traces all functions.
+			wxString prefix = wxGetTextFromUser(
+				_("Trace the functions whose file name starts with the prefix."),
+				_("Start Tracing"), wxEmptyString, this);
+			Mediator::Get()->GetEngine()->SendStartTrace(
+				TRACE_BUFFER_SIZE, wxConvToCurrent(prefix));
+		}
+		break;
+	case ID_MENU_STOP_TRACE:
+		{
+			wxString filename = wxFileSelector(
+				_("Save the trace events"), wxEmptyString,
+				wxT("trace.json"), wxT("json"),
+				wxT("*.json"), wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+			Mediator::Get()->GetEngine()->SendStopTrace(
+				ProfileSaveHandler(wxConvToCurrent(filename)));
+		}
+		break;
+	case ID_MENU_SAVE_HEAPSNAPSHOT:
+		{
+			// The snapshot is written by the debuggee side.
+			wxString filename = wxFileSelector(
+				_("Save the heap snapshot"), wxEmptyString,
+				wxT("snapshot.heap"), wxT("heap"),
+				wxT("*.heap"), wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+			if (!filename.IsEmpty()) {
+				Mediator::Get()->GetEngine()->SendSaveHeapSnapshot(
+					wxConvToCurrent(filename));
+			}
+		}
+		break;
+	case ID_MENU_COMPARE_HEAPSNAPSHOTS:
+		CompareHeapSnapshots(this);
+		break;
+	case ID_MENU_START_GCMONITOR:
+		Mediator::Get()->ClearGcSamples();
+		Mediator::Get()->GetEngine()->SendStartGcMonitor(GCMONITOR_INTERVAL);
+		ShowDebugWindow(ID_GCVIEW);
+		break;
+	case ID_MENU_STOP_GCMONITOR:
+		{
+			Mediator::Get()->GetEngine()->SendStopGcMonitor();
+
+			// The samples were already sent, so the frame saves them.
+			wxString filename = wxFileSelector(
+				_("Save the GC samples"), wxEmptyString,
+				wxT("gc.csv"), wxT("csv"),
+				wxT("*.csv"), wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+			if (!filename.IsEmpty()) {
+				safe_ofstream ofs;
+				if (ofs.open(wxConvToCurrent(filename), std::ios::out)) {
+					WriteGcSampleHeader(ofs.stream());
+					WriteGcSamples(ofs.stream(), Mediator::Get()->GetGcSamples());
+					ofs.commit();
+				}
+			}
+		}
+		break;
+	case ID_MENU_SET_GCTHRESHOLD:
+		{
+			long kbytes = wxGetNumberFromUser(
+				_("Break when the heap exceeds the size. (0 disarms it)"),
+				_("KBytes:"), _("Break on Heap Size"),
+				0, 0, 0x7fffffff, this);
+			if (kbytes >= 0) {
+				Mediator::Get()->GetEngine()->SendSetGcThreshold((int)kbytes);
+			}
+		}
+		break;
+	case ID_MENU_SET_DEBUGFILTER:
+		{
+			// The order is the one of DebugFilterType.
+			wxString choices[] = {
+				_("All coroutines"),
+				_("Only lldebug.debug_this()"),
+				_("Created in the sources containing..."),
+				_("Tagged with..."),
+			};
+			int type = wxGetSingleChoiceIndex(
+				_("Debug only the coroutines that pass the filter."),
+				_("Debug Filter"), WXSIZEOF(choices), choices, this);
+			if (type < 0) {
+				break;
+			}
+
+			wxString pattern;
+			if (type == DEBUGFILTER_SITE || type == DEBUGFILTER_TAG) {
+				pattern = wxGetTextFromUser(
+					(type == DEBUGFILTER_SITE ? _("Source:") : _("Tag:")),
+					_("Debug Filter"), wxEmptyString, this);
+				if (pattern.IsEmpty()) {
+					break;
+				}
+			}
+
+			Mediator::Get()->GetEngine()->SendSetDebugFilter(
+				(DebugFilterType)type, wxConvToCurrent(pattern));
+		}
+		break;
+	case ID_MENU_MEASURE_LATENCY:
+		PingBenchmark(PING_COUNT).Send();
+		break;
 
 	case ID_MENU_SHOW_LOCALWATCH:
 		ShowDebugWindow(ID_LOCALWATCHVIEW);
@@ -320,6 +843,18 @@ void MainFrame::OnMenu(wxCommandEvent &event) {
 	case ID_MENU_SHOW_BACKTRACEVIEW:
 		ShowDebugWindow(ID_BACKTRACEVIEW);
 		break;
+	case ID_MENU_SHOW_PROFILEVIEW:
+		ShowDebugWindow(ID_PROFILEVIEW);
+		break;
+	case ID_MENU_SHOW_GCVIEW:
+		ShowDebugWindow(ID_GCVIEW);
+		break;
+	case ID_MENU_SHOW_COROUTINEVIEW:
+		ShowDebugWindow(ID_COROUTINEVIEW);
+		break;
+	case ID_MENU_SHOW_THREADVIEW:
+		ShowDebugWindow(ID_THREADVIEW);
+		break;
 	case ID_MENU_SHOW_INTERACTIVEVIEW:
 		ShowDebugWindow(ID_INTERACTIVEVIEW);
 		break;
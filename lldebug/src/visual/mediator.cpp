@@ -39,7 +39,7 @@ Mediator *Mediator::ms_instance = NULL;
 Mediator::Mediator()
 	: m_engine(new RemoteEngine), m_frame(NULL)
 	, m_breakpoints(m_engine), m_sourceManager(m_engine)
-	, m_port(0), m_updateCount(0) {
+	, m_port(0), m_updateCount(0), m_breakSnapshotCount(-1) {
 
 	m_engine->SetOnRemoteCommand(
 		boost::bind1st(
@@ -88,6 +88,47 @@ void Mediator::FocusBacktraceLine(const LuaBacktrace &bt) {
 	frame->ProcessDebugEvent(event, frame, true);
 }
 
+void Mediator::SetCoverage(const SourceCoverageList &coverages) {
+	MainFrame *frame = GetFrame();
+	m_coverages = coverages;
+
+	if (frame != NULL) {
+		wxDebugEvent event(wxEVT_DEBUG_CHANGED_COVERAGE, wxID_ANY);
+		frame->ProcessDebugEvent(event, frame, true);
+	}
+}
+
+const SourceCoverage *Mediator::GetCoverage(const std::string &key) {
+	SourceCoverageList::const_iterator it;
+	for (it = m_coverages.begin(); it != m_coverages.end(); ++it) {
+		if (it->GetKey() == key) {
+			return &*it;
+		}
+	}
+
+	return NULL;
+}
+
+void Mediator::AddGcSample(const LuaGcSample &sample) {
+	MainFrame *frame = GetFrame();
+	m_gcSamples.push_back(sample);
+
+	if (frame != NULL) {
+		wxDebugEvent event(wxEVT_DEBUG_CHANGED_GCSTATS, wxID_ANY);
+		frame->ProcessDebugEvent(event, frame, true);
+	}
+}
+
+void Mediator::ClearGcSamples() {
+	MainFrame *frame = GetFrame();
+	m_gcSamples.clear();
+
+	if (frame != NULL) {
+		wxDebugEvent event(wxEVT_DEBUG_CHANGED_GCSTATS, wxID_ANY);
+		frame->ProcessDebugEvent(event, frame, true);
+	}
+}
+
 void Mediator::OutputLog(LogType type, const wxString &msg) {
 	LogData logData(type, wxConvToCtxEnc(msg));
 	
@@ -120,7 +161,28 @@ void Mediator::OnRemoteCommand(const Command &command) {
 	}
 }
 
+/**
+ * @brief Collect the requests into one batch in the scope.
+ */
+class BatchScope {
+public:
+	explicit BatchScope(const shared_ptr<RemoteEngine> &engine)
+		: m_engine(engine) {
+		m_engine->BeginBatch();
+	}
+
+	~BatchScope() {
+		m_engine->EndBatch();
+	}
+
+private:
+	shared_ptr<RemoteEngine> m_engine;
+};
+
 void Mediator::ProcessAllRemoteCommands() {
+	// The requests sent while updating the views go in one batch.
+	BatchScope batch(m_engine);
+
 	while (!m_readCommands.empty()) {
 		Command command = m_readCommands.front();
 		m_readCommands.pop();
@@ -151,7 +213,10 @@ void Mediator::ProcessRemoteCommand(const Command &command) {
 		m_breakpoints = BreakpointList(m_engine);
 		m_sourceManager = SourceManager(m_engine);
 		m_stackFrame = LuaStackFrame();
+		m_threads.clear();
 		m_updateCount = 0;
+		m_breakSnapshot = LuaBreakSnapshot();
+		m_breakSnapshotCount = -1;
 		if (frame != NULL) {
 			wxDebugEvent event(wxEVT_DEBUG_END_DEBUG, wxID_ANY);
 			frame->ProcessDebugEvent(event, frame, true);
@@ -196,8 +261,9 @@ void Mediator::ProcessRemoteCommand(const Command &command) {
 			std::string key;
 			int line, updateCount;
 			bool isRefreshOnly;
+			LuaBreakSnapshot snapshot;
 			command.GetData().Get_UpdateSource(
-				key, line, updateCount, isRefreshOnly);
+				key, line, updateCount, isRefreshOnly, snapshot);
 
 			// Update info.
 			if (updateCount > m_updateCount) {
@@ -211,6 +277,8 @@ void Mediator::ProcessRemoteCommand(const Command &command) {
 			// If isRefreshOnly is true, don't change the stack frame.
 			if (!isRefreshOnly) {
 				m_stackFrame = LuaStackFrame(LuaHandle(), 0);
+				m_breakSnapshot = snapshot;
+				m_breakSnapshotCount = m_updateCount;
 			}
 
 			if (frame != NULL) {
@@ -249,6 +317,30 @@ void Mediator::ProcessRemoteCommand(const Command &command) {
 		}
 		break;
 
+	case REMOTECOMMANDTYPE_CHANGED_COVERAGE:
+		{
+			SourceCoverageList coverages;
+			command.GetData().Get_ChangedCoverage(coverages);
+			SetCoverage(coverages);
+		}
+		break;
+
+	case REMOTECOMMANDTYPE_CHANGED_GCSTATS:
+		{
+			LuaGcSample sample;
+			command.GetData().Get_ChangedGcStats(sample);
+			AddGcSample(sample);
+		}
+		break;
+
+	case REMOTECOMMANDTYPE_CHANGED_THREADLIST:
+		command.GetData().Get_ChangedThreadList(m_threads);
+		if (frame != NULL) {
+			wxDebugEvent event(wxEVT_DEBUG_CHANGED_THREADS, wxID_ANY);
+			frame->ProcessDebugEvent(event, frame, true);
+		}
+		break;
+
 	case REMOTECOMMANDTYPE_SET_ENCODING:
 		{
 			lldebug_Encoding encoding;
@@ -265,6 +357,16 @@ void Mediator::ProcessRemoteCommand(const Command &command) {
 		}
 		break;
 
+	case REMOTECOMMANDTYPE_OUTPUT_LOGLIST:
+		{
+			LogDataList logs;
+			command.GetData().Get_OutputLogList(logs);
+			for (LogDataList::size_type i = 0; i < logs.size(); ++i) {
+				OutputLogInternal(logs[i], false);
+			}
+		}
+		break;
+
 	case REMOTECOMMANDTYPE_FORCE_UPDATESOURCE:
 	case REMOTECOMMANDTYPE_SAVE_SOURCE:
 	case REMOTECOMMANDTYPE_SET_BREAKPOINT:
@@ -276,16 +378,40 @@ void Mediator::ProcessRemoteCommand(const Command &command) {
 	case REMOTECOMMANDTYPE_STEPRETURN:
 	case REMOTECOMMANDTYPE_BREAK:
 	case REMOTECOMMANDTYPE_RESUME:
+	case REMOTECOMMANDTYPE_SELECT_THREAD:
 	case REMOTECOMMANDTYPE_EVALS_TO_VARLIST:
 	case REMOTECOMMANDTYPE_EVAL_TO_MULTIVAR:
 	case REMOTECOMMANDTYPE_EVAL_TO_VAR:
 	case REMOTECOMMANDTYPE_REQUEST_LOCALVARLIST:
 	case REMOTECOMMANDTYPE_REQUEST_FIELDSVARLIST:
+	case REMOTECOMMANDTYPE_REQUEST_FIELDSQUERY:
 	case REMOTECOMMANDTYPE_REQUEST_GLOBALVARLIST:
 	case REMOTECOMMANDTYPE_REQUEST_REGISTRYVARLIST:
 	case REMOTECOMMANDTYPE_REQUEST_STACKLIST:
 	case REMOTECOMMANDTYPE_REQUEST_BACKTRACELIST:
+	case REMOTECOMMANDTYPE_REQUEST_COROUTINELIST:
+	case REMOTECOMMANDTYPE_REQUEST_COROUTINEBACKTRACE:
 	case REMOTECOMMANDTYPE_REQUEST_SOURCE:
+	case REMOTECOMMANDTYPE_START_PROFILE:
+	case REMOTECOMMANDTYPE_STOP_PROFILE:
+	case REMOTECOMMANDTYPE_START_FUNCPROFILE:
+	case REMOTECOMMANDTYPE_STOP_FUNCPROFILE:
+	case REMOTECOMMANDTYPE_REQUEST_FUNCPROFILELIST:
+	case REMOTECOMMANDTYPE_START_COVERAGE:
+	case REMOTECOMMANDTYPE_STOP_COVERAGE:
+	case REMOTECOMMANDTYPE_START_ALLOCPROFILE:
+	case REMOTECOMMANDTYPE_STOP_ALLOCPROFILE:
+	case REMOTECOMMANDTYPE_START_SCHEDPROFILE:
+	case REMOTECOMMANDTYPE_STOP_SCHEDPROFILE:
+	case REMOTECOMMANDTYPE_START_TRACE:
+	case REMOTECOMMANDTYPE_STOP_TRACE:
+	case REMOTECOMMANDTYPE_SAVE_HEAPSNAPSHOT:
+	case REMOTECOMMANDTYPE_START_GCMONITOR:
+	case REMOTECOMMANDTYPE_STOP_GCMONITOR:
+	case REMOTECOMMANDTYPE_SET_GCTHRESHOLD:
+	case REMOTECOMMANDTYPE_SET_DEBUGFILTER:
+	case REMOTECOMMANDTYPE_PING:
+	case REMOTECOMMANDTYPE_BATCH:
 	case REMOTECOMMANDTYPE_SUCCESSED:
 	case REMOTECOMMANDTYPE_FAILED:
 	case REMOTECOMMANDTYPE_VALUE_STRING:
@@ -294,6 +420,13 @@ void Mediator::ProcessRemoteCommand(const Command &command) {
 	case REMOTECOMMANDTYPE_VALUE_SOURCE:
 	case REMOTECOMMANDTYPE_VALUE_BREAKPOINTLIST:
 	case REMOTECOMMANDTYPE_VALUE_BACKTRACELIST:
+	case REMOTECOMMANDTYPE_VALUE_FUNCPROFILELIST:
+	case REMOTECOMMANDTYPE_VALUE_COVERAGELIST:
+	case REMOTECOMMANDTYPE_VALUE_ALLOCPROFILELIST:
+	case REMOTECOMMANDTYPE_VALUE_SCHEDPROFILELIST:
+	case REMOTECOMMANDTYPE_VALUE_COROUTINELIST:
+	case REMOTECOMMANDTYPE_VALUE_BATCH:
+	case REMOTECOMMANDTYPE_VALUE_VARPAGE:
 		BOOST_ASSERT(false && "Invalid remote command.");
 		break;
 	}
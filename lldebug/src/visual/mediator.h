@@ -115,6 +115,28 @@ public:
 		m_breakpoints.Toggle(key, line);
 	}
 
+	/// Set the line coverage, and notify it to the frame.
+	void SetCoverage(const SourceCoverageList &coverages);
+
+	/// Get the line coverage of the source, or NULL if it has no record.
+	const SourceCoverage *GetCoverage(const std::string &key);
+
+	/// Add the sample of the GC monitor, and notify it to the frame.
+	void AddGcSample(const LuaGcSample &sample);
+
+	/// Forget the samples of the GC monitor.
+	void ClearGcSamples();
+
+	/// Get the samples of the GC monitor.
+	const LuaGcSampleList &GetGcSamples() {
+		return m_gcSamples;
+	}
+
+	/// Get the threads that run lua.
+	const LuaThreadList &GetThreads() {
+		return m_threads;
+	}
+
 	/// Get the stack frame for the local vars.
 	const LuaStackFrame &GetStackFrame() {
 		return m_stackFrame;
@@ -130,6 +152,15 @@ public:
 		return m_updateCount;
 	}
 
+	/// Get the values sent with the break, or NULL if they are old.
+	/**
+	 * They are of the top frame, and valid until the update count changes.
+	 */
+	const LuaBreakSnapshot *GetBreakSnapshot() {
+		return (m_breakSnapshotCount == m_updateCount
+			? &m_breakSnapshot : NULL);
+	}
+
 private:
 	void OutputLogInternal(const LogData &logData, bool sendRemote);
 	void OnRemoteCommand(const Command &command);
@@ -151,12 +182,17 @@ private:
 	shared_ptr<RemoteEngine> m_engine;
 	MainFrame *m_frame;
 	BreakpointList m_breakpoints;
+	SourceCoverageList m_coverages;
+	LuaGcSampleList m_gcSamples;
+	LuaThreadList m_threads;
 	SourceManager m_sourceManager;
 	queue_mt<Command> m_readCommands;
 	unsigned short m_port;
 
 	LuaStackFrame m_stackFrame;
 	int m_updateCount;
+	LuaBreakSnapshot m_breakSnapshot;
+	int m_breakSnapshotCount;
 };
 
 } // end of namespace visual
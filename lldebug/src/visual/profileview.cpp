@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "precomp.h"
+#include "visual/mediator.h"
+#include "visual/profileview.h"
+#include "visual/strutils.h"
+
+namespace lldebug {
+namespace visual {
+
+enum {
+	PROFILE_COLUMN_FUNCTION,
+	PROFILE_COLUMN_CALLS,
+	PROFILE_COLUMN_TOTAL,
+	PROFILE_COLUMN_SELF,
+	PROFILE_COLUMN_TOTALCPU,
+	PROFILE_COLUMN_SELFCPU,
+	PROFILE_COLUMN_FILE,
+	PROFILE_COLUMN_LINE,
+};
+
+BEGIN_EVENT_TABLE(ProfileView, wxListCtrl)
+	EVT_SHOW(ProfileView::OnShow)
+	EVT_LIST_ITEM_ACTIVATED(wxID_ANY, ProfileView::OnItemActivated)
+	EVT_LIST_COL_CLICK(wxID_ANY, ProfileView::OnColClick)
+	EVT_DEBUG_CHANGED_STATE(ID_PROFILEVIEW, ProfileView::OnChangedState)
+	EVT_DEBUG_END_DEBUG(ID_PROFILEVIEW, ProfileView::OnEndDebug)
+END_EVENT_TABLE()
+
+ProfileView::ProfileView(wxWindow *parent)
+	: wxListCtrl(parent, ID_PROFILEVIEW
+		, wxDefaultPosition, wxDefaultSize
+		, wxLC_REPORT | wxLC_SINGLE_SEL | wxLC_HRULES | wxLC_VRULES)
+	, m_sortColumn(PROFILE_COLUMN_SELF), m_isAscending(false) {
+	CreateGUIControls();
+}
+
+ProfileView::~ProfileView() {
+}
+
+void ProfileView::CreateGUIControls() {
+	InsertColumn(PROFILE_COLUMN_FUNCTION, _("Function"), wxLIST_FORMAT_LEFT, 120);
+	InsertColumn(PROFILE_COLUMN_CALLS, _("Calls"), wxLIST_FORMAT_RIGHT, 60);
+	InsertColumn(PROFILE_COLUMN_TOTAL, _("Total(ms)"), wxLIST_FORMAT_RIGHT, 70);
+	InsertColumn(PROFILE_COLUMN_SELF, _("Self(ms)"), wxLIST_FORMAT_RIGHT, 70);
+	InsertColumn(PROFILE_COLUMN_TOTALCPU, _("Total CPU(ms)"), wxLIST_FORMAT_RIGHT, 80);
+	InsertColumn(PROFILE_COLUMN_SELFCPU, _("Self CPU(ms)"), wxLIST_FORMAT_RIGHT, 80);
+	InsertColumn(PROFILE_COLUMN_FILE, _("File"), wxLIST_FORMAT_LEFT, 80);
+	InsertColumn(PROFILE_COLUMN_LINE, _("Line"), wxLIST_FORMAT_RIGHT, 40);
+}
+
+struct ProfileView::UpdateHandler {
+	ProfileView *m_view;
+	explicit UpdateHandler(ProfileView *view)
+		: m_view(view) {
+	}
+	int operator()(const lldebug::net::Command &/*command*/,
+				   const LuaFuncProfileList &profiles) {
+		m_view->DoUpdate(profiles);
+		return 0;
+	}
+};
+
+void ProfileView::BeginUpdating() {
+	Mediator::Get()->GetEngine()->SendRequestFuncProfileList(
+		UpdateHandler(this));
+}
+
+void ProfileView::DoUpdate(const LuaFuncProfileList &profiles) {
+	m_profiles = profiles;
+
+	Freeze();
+	DeleteAllItems();
+	for (LuaFuncProfileList::size_type i = 0; i < m_profiles.size(); ++i) {
+		const LuaFuncProfile &profile = m_profiles[i];
+
+		long item = InsertItem((long)i,
+			wxConvFromCtxEnc(profile.GetFuncName()));
+		SetItem(item, PROFILE_COLUMN_CALLS,
+			wxString::Format(wxT("%lu"), profile.GetCalls()));
+		SetItem(item, PROFILE_COLUMN_TOTAL,
+			wxString::Format(wxT("%.3f"), profile.GetTotalTime() * 1000.0));
+		SetItem(item, PROFILE_COLUMN_SELF,
+			wxString::Format(wxT("%.3f"), profile.GetSelfTime() * 1000.0));
+		SetItem(item, PROFILE_COLUMN_TOTALCPU,
+			wxString::Format(wxT("%.3f"), profile.GetTotalCpuTime() * 1000.0));
+		SetItem(item, PROFILE_COLUMN_SELFCPU,
+			wxString::Format(wxT("%.3f"), profile.GetSelfCpuTime() * 1000.0));
+		SetItem(item, PROFILE_COLUMN_FILE,
+			wxConvFromCtxEnc(profile.GetTitle()));
+		SetItem(item, PROFILE_COLUMN_LINE,
+			(profile.GetLine() >= 0
+				? wxString::Format(wxT("%d"), profile.GetLine())
+				: wxString(wxT("native"))));
+
+		// The item data is the index of m_profiles.
+		SetItemData(item, (long)i);
+	}
+
+	SortRows();
+	Thaw();
+}
+
+void ProfileView::SortRows() {
+	SortItems(ProfileView::CompareRows, (long)this);
+}
+
+/// Compare the rows by the sort column.
+int wxCALLBACK ProfileView::CompareRows(long item1, long item2, long sortData) {
+	ProfileView *view = reinterpret_cast<ProfileView *>(sortData);
+	const LuaFuncProfile &p1 = view->m_profiles[item1];
+	const LuaFuncProfile &p2 = view->m_profiles[item2];
+	int result = 0;
+
+	switch (view->m_sortColumn) {
+	case PROFILE_COLUMN_FUNCTION:
+		result = p1.GetFuncName().compare(p2.GetFuncName());
+		break;
+	case PROFILE_COLUMN_CALLS:
+		result = (p1.GetCalls() < p2.GetCalls() ? -1
+			: (p1.GetCalls() > p2.GetCalls() ? 1 : 0));
+		break;
+	case PROFILE_COLUMN_TOTAL:
+		result = (p1.GetTotalTime() < p2.GetTotalTime() ? -1
+			: (p1.GetTotalTime() > p2.GetTotalTime() ? 1 : 0));
+		break;
+	case PROFILE_COLUMN_SELF:
+		result = (p1.GetSelfTime() < p2.GetSelfTime() ? -1
+			: (p1.GetSelfTime() > p2.GetSelfTime() ? 1 : 0));
+		break;
+	case PROFILE_COLUMN_TOTALCPU:
+		result = (p1.GetTotalCpuTime() < p2.GetTotalCpuTime() ? -1
+			: (p1.GetTotalCpuTime() > p2.GetTotalCpuTime() ? 1 : 0));
+		break;
+	case PROFILE_COLUMN_SELFCPU:
+		result = (p1.GetSelfCpuTime() < p2.GetSelfCpuTime() ? -1
+			: (p1.GetSelfCpuTime() > p2.GetSelfCpuTime() ? 1 : 0));
+		break;
+	case PROFILE_COLUMN_FILE:
+		result = p1.GetTitle().compare(p2.GetTitle());
+		if (result == 0) {
+			result = p1.GetLine() - p2.GetLine();
+		}
+		break;
+	case PROFILE_COLUMN_LINE:
+		result = p1.GetLine() - p2.GetLine();
+		break;
+	}
+
+	return (view->m_isAscending ? result : -result);
+}
+
+void ProfileView::OnColClick(wxListEvent &event) {
+	event.Skip();
+
+	// Clicking the same column reverses the order.
+	if (event.GetColumn() == m_sortColumn) {
+		m_isAscending = !m_isAscending;
+	}
+	else {
+		m_sortColumn = event.GetColumn();
+		m_isAscending = (m_sortColumn == PROFILE_COLUMN_FUNCTION
+			|| m_sortColumn == PROFILE_COLUMN_FILE
+			|| m_sortColumn == PROFILE_COLUMN_LINE);
+	}
+
+	SortRows();
+}
+
+void ProfileView::OnItemActivated(wxListEvent &event) {
+	event.Skip();
+
+	long index = GetItemData(event.GetIndex());
+	if (index < 0 || (size_t)index >= m_profiles.size()) {
+		return;
+	}
+
+	const LuaFuncProfile &profile = m_profiles[index];
+	if (profile.GetLine() >= 0) {
+		Mediator::Get()->FocusErrorLine(profile.GetKey(), profile.GetLine());
+	}
+}
+
+void ProfileView::OnChangedState(wxDebugEvent &event) {
+	event.Skip();
+
+	if (event.IsBreak() && IsShown()) {
+		BeginUpdating();
+	}
+}
+
+void ProfileView::OnEndDebug(wxDebugEvent &event) {
+	event.Skip();
+
+	m_profiles.clear();
+	DeleteAllItems();
+}
+
+void ProfileView::OnShow(wxShowEvent &event) {
+	event.Skip();
+
+	if (event.GetShow() && IsShown()) {
+		BeginUpdating();
+	}
+}
+
+} // end of namespace visual
+} // end of namespace lldebug
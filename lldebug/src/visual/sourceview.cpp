@@ -32,6 +32,7 @@
 #include "visual/langsettings.h"
 
 #include "wx/wxscintilla.h"
+#include <wx/numdlg.h>
 
 namespace lldebug {
 namespace visual {
@@ -62,6 +63,10 @@ class SourceViewPage : public wxScintilla {
 		MARKNUM_BREAKPOINT = 1,
 		MARKNUM_RUNNING = 2,
 		MARKNUM_BACKTRACE = 3,
+		MARKNUM_LOGPOINT = 4,
+		MARKNUM_COVERAGE_NONE = 5,
+		MARKNUM_COVERAGE_LOW = 6,
+		MARKNUM_COVERAGE_HIGH = 7,
 	};
 
 public:
@@ -143,14 +148,17 @@ private:
 		SetMarginWidth(MARGIN_DEBUG, 16);
 		SetMarginSensitive(MARGIN_DEBUG, true);
 		SetMarginMask(MARGIN_DEBUG,
-			(1 << MARKNUM_BREAKPOINT) | (1 << MARKNUM_RUNNING) | (1 << MARKNUM_BACKTRACE));
+			(1 << MARKNUM_BREAKPOINT) | (1 << MARKNUM_RUNNING) | (1 << MARKNUM_BACKTRACE)
+			| (1 << MARKNUM_LOGPOINT));
 
 		// Set the space margin (only the visual).
 		StyleSetBackground(wxSCI_STYLE_DEFAULT, wxColour(wxT("WHITE")));
 		SetMarginType(MARGIN_DIVIDER, wxSCI_MARGIN_BACK);
-		SetMarginWidth(MARGIN_DIVIDER, 4);
+		SetMarginWidth(MARGIN_DIVIDER, 6);
 		SetMarginSensitive(MARGIN_DIVIDER, false);
-		SetMarginMask(MARGIN_DIVIDER, 0);
+		SetMarginMask(MARGIN_DIVIDER,
+			(1 << MARKNUM_COVERAGE_NONE) | (1 << MARKNUM_COVERAGE_LOW)
+			| (1 << MARKNUM_COVERAGE_HIGH));
 
 		// Set the folding margins.
 		SetMarginType(MARGIN_FOLDING, wxSCI_MARGIN_SYMBOL);
@@ -195,6 +203,11 @@ private:
 		MarkerSetForeground(MARKNUM_BREAKPOINT, wxColour(_T("ORANGE")));
 		MarkerSetBackground(MARKNUM_BREAKPOINT, wxColour(_T("RED")));
 
+		// Set the logpoint marker, blue so that it is not taken for a breakpoint.
+		MarkerDefine(MARKNUM_LOGPOINT, wxSCI_MARK_ROUNDRECT);
+		MarkerSetForeground(MARKNUM_LOGPOINT, wxColour(_T("BLUE")));
+		MarkerSetBackground(MARKNUM_LOGPOINT, wxColour(_T("LIGHT BLUE")));
+
 		/// Set the marker indicates current running source and line.
 		MarkerDefine(MARKNUM_RUNNING, wxSCI_MARK_SHORTARROW);
 		MarkerSetForeground(MARKNUM_RUNNING, wxColour(_T("RED")));
@@ -204,6 +217,14 @@ private:
 		MarkerDefine(MARKNUM_BACKTRACE, wxSCI_MARK_BACKGROUND);
 		MarkerSetForeground(MARKNUM_BACKTRACE, wxColour(_T("YELLOW")));
 		MarkerSetBackground(MARKNUM_BACKTRACE, wxColour(_T("GREEN")));
+
+		/// Set the heat markers of the line coverage.
+		MarkerDefine(MARKNUM_COVERAGE_NONE, wxSCI_MARK_FULLRECT);
+		MarkerSetBackground(MARKNUM_COVERAGE_NONE, wxColour(240, 128, 128));
+		MarkerDefine(MARKNUM_COVERAGE_LOW, wxSCI_MARK_FULLRECT);
+		MarkerSetBackground(MARKNUM_COVERAGE_LOW, wxColour(240, 224, 112));
+		MarkerDefine(MARKNUM_COVERAGE_HIGH, wxSCI_MARK_FULLRECT);
+		MarkerSetBackground(MARKNUM_COVERAGE_HIGH, wxColour(96, 192, 96));
 	}
 
 	/// Fold the source, if any.
@@ -329,11 +350,48 @@ private:
 	/// Refresh the breakpoint marks.
 	void OnChangedBreakpoints(wxDebugEvent &/*event*/) {
 		MarkerDeleteAll(MARKNUM_BREAKPOINT);
+		MarkerDeleteAll(MARKNUM_LOGPOINT);
 
 		BreakpointList &bps = Mediator::Get()->GetBreakpoints();
 		Breakpoint bp;
 		for (bp = bps.First(GetKey()); bp.IsOk(); bp = bps.Next(bp)) {
-			MarkerAdd(bp.GetLine(), MARKNUM_BREAKPOINT);
+			MarkerAdd(bp.GetLine(),
+				(bp.IsLogpoint() ? MARKNUM_LOGPOINT : MARKNUM_BREAKPOINT));
+		}
+	}
+
+	/// Refresh the heat markers of the line coverage.
+	/**
+	 * The lines not executed are red, and the lines executed less than
+	 * a tenth of the hottest line are yellow, the others are green.
+	 */
+	void OnChangedCoverage(wxDebugEvent &/*event*/) {
+		MarkerDeleteAll(MARKNUM_COVERAGE_NONE);
+		MarkerDeleteAll(MARKNUM_COVERAGE_LOW);
+		MarkerDeleteAll(MARKNUM_COVERAGE_HIGH);
+
+		const SourceCoverage *coverage = Mediator::Get()->GetCoverage(GetKey());
+		if (coverage == NULL) {
+			return;
+		}
+
+		const std::vector<int> &hits = coverage->GetHits();
+		int maxHit = 0;
+		for (std::vector<int>::size_type i = 0; i < hits.size(); ++i) {
+			maxHit = std::max(maxHit, hits[i]);
+		}
+
+		int lineCount = GetLineCount();
+		for (int line = 0; line < (int)hits.size() && line < lineCount; ++line) {
+			int hit = hits[line];
+			if (hit < 0) {
+				continue;
+			}
+
+			MarkerAdd(line,
+				(hit == 0 ? MARKNUM_COVERAGE_NONE
+				: (hit * 10 < maxHit ? MARKNUM_COVERAGE_LOW
+				: MARKNUM_COVERAGE_HIGH)));
 		}
 	}
 
@@ -375,6 +433,9 @@ public:
 
 		wxDebugEvent event(wxEVT_DEBUG_CHANGED_BREAKPOINTS, GetId());
 		OnChangedBreakpoints(event);
+
+		wxDebugEvent coverageEvent(wxEVT_DEBUG_CHANGED_COVERAGE, GetId());
+		OnChangedCoverage(coverageEvent);
 	}
 
 	/// Focus the current running line.
@@ -433,6 +494,70 @@ public:
 		ToggleBreakpointFromLine(LineFromPosition(to));
 	}
 
+	/// Edit the condition and the hit counts of the breakpoint.
+	void EditBreakpoint() {
+		int from, to;
+		GetSelection(&from, &to);
+		int line = median(LineFromPosition(to), 0, GetLineCount());
+
+		Breakpoint bp = Mediator::Get()->FindBreakpoint(m_key, line);
+		if (!bp.IsOk()) {
+			bp = Breakpoint(m_key, line);
+		}
+
+		wxTextEntryDialog dialog(this,
+			_("Break only if this expression is true (empty: always)"),
+			_("Breakpoint Condition"),
+			wxConvFromCtxEnc(bp.GetCondition()));
+		if (dialog.ShowModal() != wxID_OK) {
+			return;
+		}
+
+		long hitCount = wxGetNumberFromUser(
+			_("Break when the hit count reaches this (0: always)"),
+			_("Hit count"), _("Breakpoint Hit Count"),
+			bp.GetHitCount(), 0, 100000000, this);
+		if (hitCount < 0) {
+			return;
+		}
+
+		long hitEvery = wxGetNumberFromUser(
+			_("Break every N-th hit (0: every hit)"),
+			_("N"), _("Breakpoint Hit Count"),
+			bp.GetHitEvery(), 0, 100000000, this);
+		if (hitEvery < 0) {
+			return;
+		}
+
+		bp.SetCondition(wxConvToCtxEnc(dialog.GetValue()));
+		bp.SetHitCount((int)hitCount);
+		bp.SetHitEvery((int)hitEvery);
+		Mediator::Get()->SetBreakpoint(bp);
+	}
+
+	/// Edit the message of the logpoint.
+	void EditLogpoint() {
+		int from, to;
+		GetSelection(&from, &to);
+		int line = median(LineFromPosition(to), 0, GetLineCount());
+
+		Breakpoint bp = Mediator::Get()->FindBreakpoint(m_key, line);
+		if (!bp.IsOk()) {
+			bp = Breakpoint(m_key, line);
+		}
+
+		wxTextEntryDialog dialog(this,
+			_("Output this message and continue, '{expr}' is replaced by the value\n(empty: break as usual)"),
+			_("Logpoint"),
+			wxConvFromCtxEnc(bp.GetLogMessage()));
+		if (dialog.ShowModal() != wxID_OK) {
+			return;
+		}
+
+		bp.SetLogMessage(wxConvToCtxEnc(dialog.GetValue()));
+		Mediator::Get()->SetBreakpoint(bp);
+	}
+
 	/// Focus the error line.
 	void FocusErrorLine(int line) {
 		if (line <= 0) {
@@ -512,6 +637,7 @@ BEGIN_EVENT_TABLE(SourceViewPage, wxScintilla)
 	EVT_SCI_CHARADDED(wxID_ANY, SourceViewPage::OnCharAdded)
 	EVT_SCI_HOTSPOT_CLICK(wxID_ANY, SourceViewPage::OnHotSpotClick)
 	EVT_DEBUG_CHANGED_BREAKPOINTS(wxID_ANY, SourceViewPage::OnChangedBreakpoints)
+	EVT_DEBUG_CHANGED_COVERAGE(wxID_ANY, SourceViewPage::OnChangedCoverage)
 END_EVENT_TABLE()
 
 
@@ -599,6 +725,22 @@ void SourceView::ToggleBreakpoint() {
 	}
 }
 
+void SourceView::EditBreakpoint() {
+	SourceViewPage *page = GetSelected();
+
+	if (page != NULL) {
+		page->EditBreakpoint();
+	}
+}
+
+void SourceView::EditLogpoint() {
+	SourceViewPage *page = GetSelected();
+
+	if (page != NULL) {
+		page->EditLogpoint();
+	}
+}
+
 struct RequestSourceHandler {
 	SourceView *m_view;
 	wxDebugEvent m_event;
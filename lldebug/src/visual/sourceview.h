@@ -44,6 +44,8 @@ public:
 	virtual ~SourceView();
 
 	void ToggleBreakpoint();
+	void EditBreakpoint();
+	void EditLogpoint();
 	void CreatePage(const Source &source);
 
 private:
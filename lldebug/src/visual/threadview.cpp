@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "precomp.h"
+#include "visual/mediator.h"
+#include "visual/threadview.h"
+#include "visual/strutils.h"
+
+namespace lldebug {
+namespace visual {
+
+enum {
+	THREAD_COLUMN_ID,
+	THREAD_COLUMN_STATE,
+	THREAD_COLUMN_LOCATION,
+};
+
+BEGIN_EVENT_TABLE(ThreadView, wxListCtrl)
+	EVT_SHOW(ThreadView::OnShow)
+	EVT_LIST_ITEM_ACTIVATED(wxID_ANY, ThreadView::OnItemActivated)
+	EVT_DEBUG_CHANGED_THREADS(ID_THREADVIEW, ThreadView::OnChangedThreads)
+	EVT_DEBUG_END_DEBUG(ID_THREADVIEW, ThreadView::OnEndDebug)
+END_EVENT_TABLE()
+
+ThreadView::ThreadView(wxWindow *parent)
+	: wxListCtrl(parent, ID_THREADVIEW
+		, wxDefaultPosition, wxDefaultSize
+		, wxLC_REPORT | wxLC_SINGLE_SEL | wxLC_HRULES | wxLC_VRULES) {
+	CreateGUIControls();
+	UpdateThreads();
+}
+
+ThreadView::~ThreadView() {
+}
+
+void ThreadView::CreateGUIControls() {
+	InsertColumn(THREAD_COLUMN_ID, _("Id"), wxLIST_FORMAT_RIGHT, 50);
+	InsertColumn(THREAD_COLUMN_STATE, _("State"), wxLIST_FORMAT_LEFT, 70);
+	InsertColumn(THREAD_COLUMN_LOCATION, _("Location"), wxLIST_FORMAT_LEFT, 200);
+}
+
+void ThreadView::UpdateThreads() {
+	const LuaThreadList &threads = Mediator::Get()->GetThreads();
+
+	Freeze();
+	DeleteAllItems();
+	for (LuaThreadList::size_type i = 0; i < threads.size(); ++i) {
+		const LuaThread &thread = threads[i];
+
+		// The selected thread is marked.
+		long item = InsertItem((long)i, wxString::Format(
+			(thread.IsSelected() ? wxT("* %d") : wxT("%d")),
+			thread.GetId()));
+		SetItemData(item, (long)thread.GetId());
+		SetItem(item, THREAD_COLUMN_STATE,
+			(thread.IsBreak() ? _("Break") : _("Running")));
+		if (thread.GetLine() >= 0) {
+			SetItem(item, THREAD_COLUMN_LOCATION,
+				wxString::Format(wxT("%s:%d"),
+					wxConvFromCtxEnc(thread.GetTitle()).c_str(),
+					thread.GetLine()));
+		}
+	}
+	Thaw();
+}
+
+void ThreadView::OnChangedThreads(wxDebugEvent &event) {
+	event.Skip();
+
+	if (IsShown()) {
+		UpdateThreads();
+	}
+}
+
+void ThreadView::OnEndDebug(wxDebugEvent &event) {
+	event.Skip();
+
+	DeleteAllItems();
+}
+
+void ThreadView::OnItemActivated(wxListEvent &event) {
+	event.Skip();
+
+	Mediator::Get()->GetEngine()->SendSelectThread(
+		(int)GetItemData(event.GetIndex()));
+}
+
+void ThreadView::OnShow(wxShowEvent &event) {
+	event.Skip();
+
+	if (event.GetShow() && IsShown()) {
+		UpdateThreads();
+	}
+}
+
+} // end of namespace visual
+} // end of namespace lldebug
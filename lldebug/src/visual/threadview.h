@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2005-2008  cielacanth <cielacanth AT s60.xrea.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __LLDEBUG_THREADVIEW_H__
+#define __LLDEBUG_THREADVIEW_H__
+
+#include "luainfo.h"
+#include "visual/event.h"
+
+#include <wx/listctrl.h>
+
+namespace lldebug {
+namespace visual {
+
+/**
+ * @brief The list of the OS threads that run lua.
+ *
+ * Each thread breaks and steps independently, and the frame inspects
+ * the selected one. Activating a row selects the thread.
+ */
+class ThreadView : public wxListCtrl {
+public:
+	explicit ThreadView(wxWindow *parent);
+	virtual ~ThreadView();
+
+	/// Show the threads the mediator has.
+	void UpdateThreads();
+
+private:
+	void CreateGUIControls();
+
+private:
+	void OnChangedThreads(wxDebugEvent &event);
+	void OnEndDebug(wxDebugEvent &event);
+	void OnItemActivated(wxListEvent &event);
+	void OnShow(wxShowEvent &event);
+
+	DECLARE_EVENT_TABLE();
+};
+
+} // end of namespace visual
+} // end of namespace lldebug
+
+#endif
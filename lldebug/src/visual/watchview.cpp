@@ -36,13 +36,22 @@ namespace visual {
 
 typedef std::vector<wxTreeItemId> wxTreeItemIdList;
 
+/// The number of the fields requested at once.
+static const int FIELDS_PAGE_SIZE = 256;
+
+enum {
+	ID_MENU_FILTER_FIELDS = wxID_HIGHEST + 1,
+	ID_MENU_CLEAR_FILTER,
+};
+
 /**
  * @brief The data of the VariableWatch.
  */
 class VariableWatchItemData : public wxTreeItemData {
 public:
-	explicit VariableWatchItemData(const LuaVar &var)
-		: m_var(var), m_requestCount(-1), m_updateCount(-1) {
+	explicit VariableWatchItemData(const LuaVar &var, bool isMore = false)
+		: m_var(var), m_isMore(isMore), m_requestCount(-1), m_updateCount(-1)
+		, m_fieldCount(FIELDS_PAGE_SIZE), m_resume(0) {
 	}
 
 	virtual ~VariableWatchItemData() {
@@ -53,6 +62,41 @@ public:
 		return m_var;
 	}
 
+	/// Is this the item that loads the next page of the fields ?
+	bool IsMore() const {
+		return m_isMore;
+	}
+
+	/// Get the number of the fields shown.
+	int GetFieldCount() const {
+		return m_fieldCount;
+	}
+
+	/// Set the number of the fields shown.
+	void SetFieldCount(int count) {
+		m_fieldCount = count;
+	}
+
+	/// Get the id the next page of the fields continues from, or 0.
+	int GetResume() const {
+		return m_resume;
+	}
+
+	/// Set the id the next page continues from, it's returned with a page.
+	void SetResume(int resume) {
+		m_resume = resume;
+	}
+
+	/// Get the query of the fields, it's run by the context.
+	const LuaFieldQuery &GetQuery() const {
+		return m_query;
+	}
+
+	/// Set the query of the fields.
+	void SetQuery(const LuaFieldQuery &query) {
+		m_query = query;
+	}
+
 	/// Get the request count.
 	int GetRequestCount() const {
 		return m_requestCount;
@@ -86,8 +130,12 @@ public:
 
 private:
 	LuaVar m_var;
+	bool m_isMore;
 	int m_requestCount;
 	int m_updateCount;
+	int m_fieldCount;
+	int m_resume;
+	LuaFieldQuery m_query;
 };
 
 /// The type of a function that requests LuaVarList from RemoteEngine.
@@ -171,7 +219,15 @@ private:
 
 		/// This method may be called from the other thread.
 		/// @param vars    result of the request
-		int operator()(const lldebug::Command &/*command*/, const LuaVarList &vars) {
+		int operator()(const lldebug::Command &command, const LuaVarList &vars) {
+			return (*this)(command, vars, -1, 0, std::string());
+		}
+
+		/// @param total    the number of all the fields, or -1
+		/// @param resume   the id the next page continues from
+		/// @param error    the error of the query, or empty
+		int operator()(const lldebug::Command &/*command*/, const LuaVarList &vars,
+					   int total, int resume, const std::string &error) {
 			// If update count was changed, new request might be sent.
 			if (m_updateCount != Mediator::Get()->GetUpdateCount()) {
 				return -1;
@@ -182,7 +238,8 @@ private:
 				return -1;
 			}
 
-			m_watch->DoUpdateVars(m_item, vars, m_isExpanded);
+			m_watch->DoUpdateVars(m_item, vars, m_isExpanded, total, resume,
+				error);
 			return 0;
 		}
 
@@ -193,12 +250,40 @@ private:
 		int m_updateCount;
 	};
 
+	/// This object is called when the next page of the fields is returned.
+	struct RequestPageCallback {
+		explicit RequestPageCallback(VariableWatch *watch, wxTreeItemId item)
+			: m_watch(watch), m_item(item)
+			, m_updateCount(Mediator::Get()->GetUpdateCount()) {
+		}
+
+		int operator()(const lldebug::Command &/*command*/, const LuaVarList &vars,
+					   int total, int resume, const std::string &error) {
+			if (m_updateCount != Mediator::Get()->GetUpdateCount()) {
+				return -1;
+			}
+
+			if (ms_aliveInstanceSet.find(m_watch) == ms_aliveInstanceSet.end()) {
+				return -1;
+			}
+
+			m_watch->DoAppendVars(m_item, vars, total, resume, error);
+			return 0;
+		}
+
+	private:
+		VariableWatch *m_watch;
+		wxTreeItemId m_item;
+		int m_updateCount;
+	};
+
 	friend struct RequestVarsCallback;
 
 public:
 	/// Begin updating contents.
+	template<class Requester>
 	void BeginUpdating(wxTreeItemId item, bool isExpanded,
-					   const VarListRequester &request) {
+					   Requester request) {
 		VariableWatchItemData *data = GetItemData(item);
 		if (data == NULL) {
 			return;
@@ -223,22 +308,37 @@ public:
 		}
 	}
 
-	/// Request for the fields of the var.
+	/// Request for the shown fields of the var.
 	struct FieldsRequester {
-		explicit FieldsRequester(const LuaVar &var)
-			: m_var(var) {
+		explicit FieldsRequester(const LuaVar &var, const LuaFieldQuery &query,
+								 int count)
+			: m_var(var), m_query(query), m_count(count) {
 		}
-		void operator()(const LuaVarListCallback &callback) {
-			Mediator::Get()->GetEngine()->SendRequestFieldsVarList(
-				m_var, callback);
+		void operator()(const RequestVarListCallback &callback) {
+			if (m_query.IsEmpty()) {
+				Mediator::Get()->GetEngine()->SendRequestFieldsVarList(
+					m_var, 0, m_count, 0, callback);
+			}
+			else {
+				Mediator::Get()->GetEngine()->SendRequestFieldsQuery(
+					m_var, m_query, 0, m_count, callback);
+			}
 		}
 	private:
 		LuaVar m_var;
+		LuaFieldQuery m_query;
+		int m_count;
 		};
 
 	/// Begin the updating the fields of the var.
 	void BeginUpdating(wxTreeItemId item, bool isExpanded, const LuaVar &var) {
-		BeginUpdating(item, isExpanded, FieldsRequester(var));
+		VariableWatchItemData *data = GetItemData(item);
+		if (data == NULL) {
+			return;
+		}
+
+		BeginUpdating(item, isExpanded,
+			FieldsRequester(var, data->GetQuery(), data->GetFieldCount()));
 	}
 
 	/// Request for the results of the label evaluations.
@@ -266,6 +366,14 @@ public:
 				}
 			}
 
+			// The values may be sent with the break.
+			const LuaBreakSnapshot *snapshot = Mediator::Get()->GetBreakSnapshot();
+			if (snapshot != NULL && snapshot->HasWatches()
+				&& snapshot->GetWatchEvals() == labels) {
+				callback(lldebug::Command(), snapshot->GetWatches());
+				return;
+			}
+
 			Mediator::Get()->GetEngine()->SendEvalsToVarList(
 				labels,
 				Mediator::Get()->GetStackFrame(),
@@ -312,8 +420,13 @@ private:
 	};
 
 	/// Update child variables of vars actually.
+	/**
+	 * If 'total' is more than the vars, the item that loads the next page
+	 * is added at the end.
+	 */
 	void DoUpdateVars(wxTreeItemId parent, const LuaVarList &vars,
-					  bool isExpand) {
+					  bool isExpand, int total = -1, int resume = 0,
+					  const std::string &error = std::string()) {
 		VariableWatchItemData *parentData = GetItemData(parent);
 		if (parentData->GetUpdateCount() == Mediator::Get()->GetUpdateCount()) {
 			return;
@@ -355,68 +468,136 @@ private:
 				item = *it;
 				children.erase(it);
 
-				// Replace the item data.
+				// Replace the item data, the loaded pages are kept.
+				VariableWatchItemData *newData = new VariableWatchItemData(var);
 				VariableWatchItemData *oldData = GetItemData(item);
 				if (oldData != NULL) {
+					newData->SetFieldCount(oldData->GetFieldCount());
+					newData->SetQuery(oldData->GetQuery());
 					delete oldData;
 				}
-				SetItemData(item, new VariableWatchItemData(var));
+				SetItemData(item, newData);
 			}
 
-			// To avoid the useless refresh, check change of the title.
-			wxString value = wxConvFromCtxEnc(var.GetValue());
-			if (GetItemText(item, 1) != value) {
-				SetItemText(item, 1, value);
+			UpdateItemVar(item, var, isExpand);
+		}
+
+		// Remove all items that were not refreshed or appended.
+		wxTreeItemIdList::iterator it;
+		for (it = children.begin(); it != children.end(); ++it) {
+			Delete(*it);
+		}
+
+		AppendMoreItem(parent, (int)vars.size(), total);
+		AppendErrorItem(parent, error);
+		parentData->SetResume(resume);
+
+		// Update was done.
+		parentData->Updated();
+	}
+
+	/// Append the next page of the fields.
+	void DoAppendVars(wxTreeItemId parent, const LuaVarList &vars, int total,
+					  int resume, const std::string &error) {
+		// Remove the items that loaded this page and showed the error,
+		// the fields always have their vars.
+		wxTreeItemIdList children = GetItemChildren(parent);
+		wxTreeItemIdList::iterator it;
+		for (it = children.begin(); it != children.end(); ++it) {
+			VariableWatchItemData *data = GetItemData(*it);
+			if (data != NULL && (data->IsMore() || !data->GetVar().IsOk())) {
+				Delete(*it);
 			}
+		}
 
-			// Check whether it has the type column.
-			if (GetColumnCount() >= 3) {
-				wxString type = wxConvFromCtxEnc(var.GetValueTypeName());
-				if (GetItemText(item, 2) != type) {
-					SetItemText(item, 2, type);
-				}
+		for (LuaVarList::size_type i = 0; i < vars.size(); ++i) {
+			const LuaVar &var = vars[i];
+			wxTreeItemId item = AppendItem(
+				parent, wxConvFromCtxEnc(var.GetName()), -1, -1,
+				new VariableWatchItemData(var));
+
+			UpdateItemVar(item, var, false);
+		}
+
+		AppendMoreItem(parent, GetItemData(parent)->GetFieldCount(), total);
+		AppendErrorItem(parent, error);
+		GetItemData(parent)->SetResume(resume);
+	}
+
+	/// Append the item that loads the next page, if some fields aren't shown.
+	void AppendMoreItem(wxTreeItemId parent, int shown, int total) {
+		if (total <= shown) {
+			return;
+		}
+
+		wxTreeItemId item = AppendItem(
+			parent, wxT("..."), -1, -1,
+			new VariableWatchItemData(LuaVar(), true));
+		SetItemText(item, 1, wxString::Format(
+			_("%d more fields"), total - shown));
+
+		// It's loaded when expanded.
+		AppendItem(item, _T(""));
+	}
+
+	/// Append the item that shows the error of the query, if any.
+	void AppendErrorItem(wxTreeItemId parent, const std::string &error) {
+		if (error.empty()) {
+			return;
+		}
+
+		wxTreeItemId item = AppendItem(
+			parent, wxT("<error>"), -1, -1,
+			new VariableWatchItemData(LuaVar()));
+		SetItemText(item, 1, wxConvFromCtxEnc(error));
+	}
+
+	/// Show the var in the item.
+	void UpdateItemVar(wxTreeItemId item, const LuaVar &var, bool isExpand) {
+		// To avoid the useless refresh, check change of the title.
+		wxString value = wxConvFromCtxEnc(var.GetValue());
+		if (GetItemText(item, 1) != value) {
+			SetItemText(item, 1, value);
+		}
+
+		// Check whether it has the type column.
+		if (GetColumnCount() >= 3) {
+			wxString type = wxConvFromCtxEnc(var.GetValueTypeName());
+			if (GetItemText(item, 2) != type) {
+				SetItemText(item, 2, type);
 			}
+		}
 
-			// Refresh the chilren, too.
-			if (var.HasFields()) {
-				if (!HasChildren(item)) {
-					// Item for lazy evalution
-					AppendItem(item, _T(""));
-				}
+		// Refresh the chilren, too.
+		if (var.HasFields()) {
+			if (!HasChildren(item)) {
+				// Item for lazy evalution
+				AppendItem(item, _T(""));
+			}
 
-				if (IsExpanded(item)) {
-					BeginUpdating(item, true, var);
-				}
-				else if (isExpand) {
-					BeginUpdating(item, false, var);
-				}
+			if (IsExpanded(item)) {
+				BeginUpdating(item, true, var);
 			}
-			else {
-				if (HasChildren(item)) {
-					// The state whether the item is expanded or collapsed
-					// has been saved, so collapse it carefully.
-					if (IsExpanded(item)) {
-						//Collapse(item);
-					}
-
-					// Delete all child items.
-					DeleteChildren(item);
+			else if (isExpand) {
+				BeginUpdating(item, false, var);
+			}
+		}
+		else {
+			if (HasChildren(item)) {
+				// The state whether the item is expanded or collapsed
+				// has been saved, so collapse it carefully.
+				if (IsExpanded(item)) {
+					//Collapse(item);
 				}
 
-				// Update was done.
-				VariableWatchItemData *data = GetItemData(item);
-				data->Updated();
+				// Delete all child items.
+				DeleteChildren(item);
 			}
-		}
 
-		// Remove all items that were not refreshed or appended.
-		wxTreeItemIdList::iterator it;
-		for (it = children.begin(); it != children.end(); ++it) {
-			Delete(*it);
+			// Update was done.
+			VariableWatchItemData *data = GetItemData(item);
+			data->Updated();
 		}
-
-		// Update was done.
-		parentData->Updated();
 	}
 
 private:
@@ -424,9 +605,120 @@ private:
 		event.Skip();
 
 		VariableWatchItemData *data = GetItemData(event.GetItem());
+		if (data != NULL && data->IsMore()) {
+			RequestNextPage(GetItemParent(event.GetItem()));
+			return;
+		}
+
 		BeginUpdating(event.GetItem(), true, data->GetVar());
 	}
 
+	/// Request the next page of the fields of the item.
+	void RequestNextPage(wxTreeItemId item) {
+		VariableWatchItemData *data = GetItemData(item);
+		if (data == NULL || !data->GetVar().IsOk()) {
+			return;
+		}
+
+		int offset = data->GetFieldCount();
+		data->SetFieldCount(offset + FIELDS_PAGE_SIZE);
+		if (data->GetQuery().IsEmpty()) {
+			// The context continues from the last key of the previous page.
+			Mediator::Get()->GetEngine()->SendRequestFieldsVarList(
+				data->GetVar(), offset, FIELDS_PAGE_SIZE, data->GetResume(),
+				RequestPageCallback(this, item));
+		}
+		else {
+			Mediator::Get()->GetEngine()->SendRequestFieldsQuery(
+				data->GetVar(), data->GetQuery(), offset, FIELDS_PAGE_SIZE,
+				RequestPageCallback(this, item));
+		}
+	}
+
+	void OnItemRightClick(wxTreeEvent &event) {
+		event.Skip();
+
+		// Only the tables can be filtered.
+		VariableWatchItemData *data = GetItemData(event.GetItem());
+		if (data == NULL || data->IsMore() || !data->GetVar().HasFields()) {
+			return;
+		}
+
+		wxMenu menu;
+		menu.Append(ID_MENU_FILTER_FIELDS, _("&Filter Fields..."));
+		menu.Append(ID_MENU_CLEAR_FILTER, _("&Clear Filter"));
+		menu.Enable(ID_MENU_CLEAR_FILTER, !data->GetQuery().IsEmpty());
+
+		m_menuItem = event.GetItem();
+		PopupMenu(&menu);
+	}
+
+	void OnMenu(wxCommandEvent &event) {
+		VariableWatchItemData *data =
+			(m_menuItem.IsOk() ? GetItemData(m_menuItem) : NULL);
+		if (data == NULL) {
+			return;
+		}
+
+		switch (event.GetId()) {
+		case ID_MENU_FILTER_FIELDS:
+			{
+				const LuaFieldQuery &query = data->GetQuery();
+				wxTextEntryDialog keyDialog(this,
+					_("Show only the fields whose names match this lua pattern (empty: all)"),
+					_("Filter Fields"),
+					wxConvFromCtxEnc(query.GetKeyPattern()));
+				if (keyDialog.ShowModal() != wxID_OK) {
+					return;
+				}
+
+				wxTextEntryDialog predDialog(this,
+					_("Show only the fields for which this expression of 'key' and 'value' is true (empty: all)"),
+					_("Filter Fields"),
+					wxConvFromCtxEnc(query.GetPredicate()));
+				if (predDialog.ShowModal() != wxID_OK) {
+					return;
+				}
+
+				// The order is NONE, NAME and VALUE of FieldSortKey.
+				wxString choices[] = {
+					_("Table order"),
+					_("Name (ascending)"),
+					_("Name (descending)"),
+					_("Value (ascending)"),
+					_("Value (descending)"),
+				};
+				int sort = wxGetSingleChoiceIndex(
+					_("Sort the fields by"),
+					_("Filter Fields"), WXSIZEOF(choices), choices, this);
+				if (sort < 0) {
+					return;
+				}
+
+				SetItemQuery(m_menuItem, LuaFieldQuery(
+					wxConvToCtxEnc(keyDialog.GetValue()),
+					wxConvToCtxEnc(predDialog.GetValue()),
+					(sort + 1) / 2, (sort % 2 != 0)));
+			}
+			break;
+		case ID_MENU_CLEAR_FILTER:
+			SetItemQuery(m_menuItem, LuaFieldQuery());
+			break;
+		}
+	}
+
+	/// Set the query of the fields of the item, and update them.
+	void SetItemQuery(wxTreeItemId item, const LuaFieldQuery &query) {
+		VariableWatchItemData *data = GetItemData(item);
+		data->SetQuery(query);
+		data->SetFieldCount(FIELDS_PAGE_SIZE);
+		data->SetResume(0);
+		SetItemBold(item, !query.IsEmpty());
+
+		Mediator::Get()->IncUpdateCount();
+		BeginUpdating();
+	}
+
 	void OnEndLabelEdit(wxTreeEvent &event) {
 		event.Skip();
 
@@ -534,6 +826,7 @@ private:
 	bool m_isLabelEditable;
 	bool m_isEvalLabels;
 	VarListRequester m_requester;
+	wxTreeItemId m_menuItem;
 
 	DECLARE_EVENT_TABLE();
 };
@@ -545,6 +838,9 @@ BEGIN_EVENT_TABLE(VariableWatch, wxTreeListCtrl)
 	EVT_SIZE(VariableWatch::OnSize)
 	EVT_TREE_ITEM_EXPANDED(wxID_ANY, VariableWatch::OnExpanded)
 	EVT_TREE_END_LABEL_EDIT(wxID_ANY, VariableWatch::OnEndLabelEdit)
+	EVT_TREE_ITEM_RIGHT_CLICK(wxID_ANY, VariableWatch::OnItemRightClick)
+	EVT_MENU(ID_MENU_FILTER_FIELDS, VariableWatch::OnMenu)
+	EVT_MENU(ID_MENU_CLEAR_FILTER, VariableWatch::OnMenu)
 	EVT_LIST_COL_END_DRAG(wxID_ANY, VariableWatch::OnColEndDrag)
 	EVT_DEBUG_END_DEBUG(wxID_ANY, VariableWatch::OnEndDebug)
 END_EVENT_TABLE()
@@ -686,8 +982,16 @@ struct VarUpdateRequester {
 		: m_type(type) {
 	}
 	void operator()(const LuaVarListCallback &callback) {
+		const LuaBreakSnapshot *snapshot = Mediator::Get()->GetBreakSnapshot();
+
 		switch (m_type) {
 		case WatchView::TYPE_LOCALWATCH:
+			// The locals may be sent with the break.
+			if (snapshot != NULL && snapshot->HasLocals()) {
+				callback(lldebug::Command(), snapshot->GetLocals());
+				break;
+			}
+
 			Mediator::Get()->GetEngine()->SendRequestLocalVarList(
 				Mediator::Get()->GetStackFrame(),
 				true, true, false, callback);
@@ -0,0 +1,68 @@
+--
+-- coroutine stress test
+-- creates many short-lived coroutines, and checks that the number of
+-- the tracked coroutines is bounded by the live ones, and that the hooks
+-- still find the context in the cache while they are collected.
+--
+
+local BATCH = 10000
+local ROUNDS = 100
+local maxCount = 0
+
+local function body(a)
+	local b = coroutine.yield(a + 1)
+	return a + b
+end
+
+for round = 1, ROUNDS do
+	for i = 1, BATCH do
+		local co = coroutine.create(body)
+		coroutine.resume(co, i)
+
+		-- A half finishes, the other is left suspended.
+		if i % 2 == 0 then
+			coroutine.resume(co, i)
+		end
+	end
+
+	-- The sentinel of a thread is finalized one cycle after the thread,
+	-- and the main state is tracked too.
+	collectgarbage("collect")
+	collectgarbage("collect")
+	local count = lldebug.threadcount() - 1
+	if count > maxCount then
+		maxCount = count
+	end
+
+	if round % 10 == 0 then
+		print(string.format("round %d: %d coroutines, %.1f KB",
+			round, count, collectgarbage("count")))
+	end
+end
+
+if maxCount > BATCH then
+	error(string.format("%d coroutines are still tracked.", maxCount))
+end
+print("ok: at most " .. maxCount .. " coroutines were tracked.")
+
+-- The main state runs while the dead coroutines are collected step by
+-- step, the evictions mustn't send its hooks back to the lock.
+for i = 1, BATCH do
+	coroutine.resume(coroutine.create(body), i)
+end
+
+local before = lldebug.threadcount()
+local misses = lldebug.pinmisses()
+local s = 0
+for i = 1, BATCH do
+	collectgarbage("step")
+	s = s + i
+end
+misses = lldebug.pinmisses() - misses
+local evicted = before - lldebug.threadcount()
+
+print(string.format("%d coroutines were evicted, the cache missed %d times.",
+	evicted, misses))
+if evicted > 0 and misses > 16 then
+	error(string.format("the cache missed %d times while collecting.", misses))
+end